@@ -0,0 +1,38 @@
+/**
+ * @file binary_vocabulary.hpp
+ * @brief ORB vocabulary with a binary file format that loads without parsing text.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#ifndef ORB_WRAPPER_BINARY_VOCABULARY_HPP_
+#define ORB_WRAPPER_BINARY_VOCABULARY_HPP_
+
+#include <string>
+
+#include "ORBVocabulary.h"
+
+namespace ORB_SLAM3_Wrapper
+{
+    /**
+     * @brief ORBVocabulary that can also be saved to / loaded from a binary file.
+     * @note The binary file holds the tree nodes in the order of the text file (parent, leaf flag,
+     * weight and the raw descriptor bytes) so the word ids are the same as when loading the text file.
+     * Loading it is one read of the file and a copy per node. Convert once with orb_vocabulary_converter.
+     */
+    class BinaryVocabulary : public ORB_SLAM3::ORBVocabulary
+    {
+    public:
+        bool loadFromBinaryFile(const std::string &path);
+
+        bool saveToBinaryFile(const std::string &path) const;
+
+        /**
+         * @brief Loads a binary (.bin) or text vocabulary, chosen by the file extension.
+         */
+        bool loadFromFile(const std::string &path);
+
+        static bool isBinaryVocabularyPath(const std::string &path);
+    };
+}
+
+#endif
@@ -0,0 +1,85 @@
+/**
+ * @file feature_backend.hpp
+ * @brief Preparation of the camera images for the ORB extractor ahead of the track call.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#ifndef ORB_WRAPPER_FEATURE_BACKEND_HPP_
+#define ORB_WRAPPER_FEATURE_BACKEND_HPP_
+
+#include <memory>
+#include <string>
+
+#include <opencv2/core/core.hpp>
+
+namespace ORB_SLAM3_Wrapper
+{
+    /**
+     * @brief cv::COLOR_* code converting an image of a sensor_msgs encoding to gray.
+     * @return -1 for the one channel encodings (mono, depth), ORB_SLAM3 takes them as they are.
+     */
+    int grayConversionCode(const std::string &encoding);
+
+    /**
+     * @brief The images of a frame converted to gray ahead of the track call.
+     */
+    class PreparedFrame
+    {
+    public:
+        virtual ~PreparedFrame() = default;
+
+        /**
+         * @brief Blocks until the conversion started by FeatureBackend::prepare is done.
+         * @param first, second Set to the gray images. An image that needed no conversion is left untouched.
+         * @note The images are valid until the prepared frame is destroyed.
+         */
+        virtual void wait(cv::Mat &first, cv::Mat &second) = 0;
+    };
+
+    /**
+     * @brief Converts the images of a frame to gray before the frame reaches ORB_SLAM3, so that the
+     * tracking thread only runs the extractor. The ORB extractor and its pyramid stay inside ORB_SLAM3.
+     */
+    class FeatureBackend
+    {
+    public:
+        virtual ~FeatureBackend() = default;
+
+        virtual const char *name() const = 0;
+
+        /**
+         * @brief Starts the conversion of the images. Call from the receiving thread, a single thread at a time.
+         * @param firstCode, secondCode From grayConversionCode, -1 keeps the image.
+         * @return Null if no image needs a conversion.
+         * @note The images are only read before prepare returns.
+         */
+        virtual std::shared_ptr<PreparedFrame> prepare(const cv::Mat &first, int firstCode,
+                                                       const cv::Mat &second, int secondCode) = 0;
+    };
+
+    /**
+     * @brief Converts on the receiving thread with cv::cvtColor.
+     */
+    class CpuFeatureBackend : public FeatureBackend
+    {
+    public:
+        const char *name() const override
+        {
+            return "cpu";
+        }
+
+        std::shared_ptr<PreparedFrame> prepare(const cv::Mat &first, int firstCode,
+                                               const cv::Mat &second, int secondCode) override;
+    };
+
+    /**
+     * @brief Creates the backend of a feature_backend parameter value.
+     * @param name orb (ORB_SLAM3 converts in the track call) or cpu.
+     * @param resolvedName The backend in use, orb for an unknown name.
+     * @param message Why the requested backend is not the one in use, empty otherwise.
+     * @return Null for orb.
+     */
+    std::unique_ptr<FeatureBackend> makeFeatureBackend(const std::string &name, std::string &resolvedName, std::string &message);
+}
+
+#endif
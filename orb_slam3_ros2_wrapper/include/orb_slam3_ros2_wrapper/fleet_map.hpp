@@ -0,0 +1,234 @@
+/**
+ * @file fleet_map.hpp
+ * @brief Place recognition and alignment of the keyframes of several robots for the fleet map server.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#ifndef ORB_WRAPPER_FLEET_MAP_HPP_
+#define ORB_WRAPPER_FLEET_MAP_HPP_
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+namespace ORB_SLAM3_Wrapper
+{
+    /**
+     * @brief Token bucket limiting the bytes a stream sends per second.
+     * @note The bucket may go into debt by one message: a message larger than the burst is sent once the
+     * bucket is full, so a large keyframe is delayed but never starves the stream. Not thread safe.
+     */
+    class BandwidthBudget
+    {
+    public:
+        /**
+         * @param bytesPerSecond Sustained rate, 0 or less for no limit.
+         * @param burstBytes Bytes that can be sent at once after an idle period.
+         */
+        BandwidthBudget(double bytesPerSecond, double burstBytes);
+
+        /**
+         * @brief Takes the bytes from the bucket if they fit.
+         * @param now Steady time (s).
+         * @return False if the message has to wait.
+         */
+        bool consume(size_t bytes, double now);
+
+        /**
+         * @brief Takes the bytes whether they fit or not, for messages that cannot wait.
+         */
+        void charge(size_t bytes, double now);
+
+        double available(double now);
+
+    private:
+        void refill(double now);
+
+        double bytesPerSecond_;
+        double burstBytes_;
+        double tokens_;
+        double lastRefill_ = -1.0;
+    };
+
+    typedef std::array<uint8_t, 32> OrbDescriptor;
+
+    /**
+     * @brief Keyframe of a robot as received by the fleet map server.
+     * @note Immutable once in the database, the pose of a keyframe is kept by the database and
+     * updated on its own when the robot corrects its map.
+     */
+    struct FleetKeyFrame
+    {
+        int robot = -1;
+        int32_t id = -1;
+        // bag of words, sorted by word id and L1 normalized (see normalizeBowVector).
+        std::vector<std::pair<uint32_t, float>> words;
+        // map points in the keyframe frame, with the descriptor of the keypoint that observes each.
+        std::vector<Eigen::Vector3f> points;
+        std::vector<OrbDescriptor> descriptors;
+    };
+
+    /**
+     * @brief Sorts the words by id, merges duplicates and scales the weights to a unit L1 norm.
+     */
+    void normalizeBowVector(std::vector<std::pair<uint32_t, float>> &words);
+
+    /**
+     * @brief DBoW2 L1 score of two normalized bag of words vectors, 0 (nothing in common) to 1 (same).
+     */
+    float bowL1Score(const std::vector<std::pair<uint32_t, float>> &a, const std::vector<std::pair<uint32_t, float>> &b);
+
+    int hammingDistance(const OrbDescriptor &a, const OrbDescriptor &b);
+
+    struct DescriptorMatch
+    {
+        size_t query;
+        size_t train;
+    };
+
+    /**
+     * @brief Brute force matching with the nearest neighbour ratio test.
+     * @param maxDistance Matches further than this (bits) are rejected.
+     * @param ratio The best match must be closer than ratio times the second best.
+     * @note Each train descriptor is matched at most once, to the closest query descriptor.
+     */
+    void matchDescriptors(const std::vector<OrbDescriptor> &query, const std::vector<OrbDescriptor> &train,
+                          int maxDistance, float ratio, std::vector<DescriptorMatch> &matches);
+
+    struct RigidAlignment
+    {
+        // maps the source points onto the target points.
+        Eigen::Affine3d transform = Eigen::Affine3d::Identity();
+        std::vector<size_t> inliers;
+    };
+
+    /**
+     * @brief RANSAC over minimal 3 point Umeyama fits, refined on the inliers of the best hypothesis.
+     * @param source Points matched one to one with the target points.
+     * @param inlierThreshold Distance (m) under which a transformed source point is an inlier.
+     * @return False if fewer than minInliers pairs agree with the best transform.
+     * @note Rigid, without scale: the maps must be metric (RGB-D, stereo or inertial).
+     */
+    bool estimateRigidTransformRansac(const std::vector<Eigen::Vector3f> &source, const std::vector<Eigen::Vector3f> &target,
+                                      int iterations, double inlierThreshold, size_t minInliers, uint32_t seed,
+                                      RigidAlignment &result);
+
+    /**
+     * @brief Shared keyframe database of the fleet with an inverted index over the words. Thread safe,
+     * any number of queries run in parallel with each other.
+     */
+    class FleetKeyFrameDatabase
+    {
+    public:
+        struct Candidate
+        {
+            std::shared_ptr<const FleetKeyFrame> keyFrame;
+            float score;
+        };
+
+        /**
+         * @brief Adds the keyframe at the given pose (robot frame), replacing a keyframe of the same robot and id.
+         */
+        void add(const std::shared_ptr<const FleetKeyFrame> &keyFrame, const Eigen::Affine3d &pose);
+
+        void remove(int robot, int32_t id);
+
+        /**
+         * @brief Removes the keyframes of the robot that are not in ids (a snapshot of its map).
+         */
+        void retain(int robot, const std::vector<int32_t> &ids);
+
+        /**
+         * @return False if the keyframe is not in the database.
+         */
+        bool updatePose(int robot, int32_t id, const Eigen::Affine3d &pose);
+
+        bool pose(int robot, int32_t id, Eigen::Affine3d &pose) const;
+
+        /**
+         * @brief Keyframes of the other robots sharing words with the keyframe, best score first.
+         * @param minScore Candidates scoring less are dropped.
+         * @param maxCandidates 0 for no limit.
+         */
+        void query(const FleetKeyFrame &keyFrame, float minScore, size_t maxCandidates, std::vector<Candidate> &candidates) const;
+
+        size_t size() const;
+
+        size_t size(int robot) const;
+
+    private:
+        static uint64_t key(int robot, int32_t id)
+        {
+            return (static_cast<uint64_t>(static_cast<uint32_t>(robot)) << 32) | static_cast<uint32_t>(id);
+        }
+
+        void removeLocked(uint64_t keyFrameKey);
+
+        struct Entry
+        {
+            std::shared_ptr<const FleetKeyFrame> keyFrame;
+            Eigen::Affine3d pose;
+        };
+
+        mutable std::shared_timed_mutex mutex_;
+        std::unordered_map<uint64_t, Entry> keyFrames_;
+        // keyframes holding each word.
+        std::unordered_map<uint32_t, std::vector<uint64_t>> invertedIndex_;
+    };
+
+    /**
+     * @brief A match between the keyframes of two robots.
+     */
+    struct FleetLoop
+    {
+        int robotA = -1;
+        int32_t keyFrameA = -1;
+        int robotB = -1;
+        int32_t keyFrameB = -1;
+        // maps the keyframe frame of B onto the keyframe frame of A.
+        Eigen::Affine3d relative = Eigen::Affine3d::Identity();
+        size_t inliers = 0;
+    };
+
+    /**
+     * @brief Keeps the best loop between each pair of robots and places the robots relative to an anchor.
+     * @note The robot frame transforms are recomputed from the current keyframe poses of the database on
+     * every solve, so they follow the loop closures and bundle adjustments of the robots. Not thread safe.
+     */
+    class FleetAlignmentGraph
+    {
+    public:
+        /**
+         * @return True if it replaced the loop of the pair (it has at least as many inliers).
+         */
+        bool addLoop(const FleetLoop &loop);
+
+        /**
+         * @brief Maximum spanning tree (by inliers) of the robots connected to the anchor.
+         * @param references Resized to numRobots, the transform from each robot frame to the anchor frame.
+         * @param connected Resized to numRobots, false for the robots not connected to the anchor.
+         */
+        void solve(const FleetKeyFrameDatabase &database, int anchor, int numRobots,
+                   std::vector<Eigen::Affine3d> &references, std::vector<bool> &connected) const;
+
+        size_t numLoops() const
+        {
+            return loops_.size();
+        }
+
+    private:
+        // keyed by (lower robot, higher robot).
+        std::map<std::pair<int, int>, FleetLoop> loops_;
+    };
+}
+
+#endif
@@ -0,0 +1,115 @@
+/**
+ * @file frame_permutation.hpp
+ * @brief Compile-time signed axis permutations between the ORB-SLAM3 and ROS coordinate systems.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#ifndef ORB_WRAPPER_FRAME_PERMUTATION_HPP_
+#define ORB_WRAPPER_FRAME_PERMUTATION_HPP_
+
+#include <cstddef>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+namespace ORB_SLAM3_Wrapper
+{
+    /**
+     * @brief Signed permutation out[i] = Si * in[Ii], resolved at compile time.
+     * @note Equivalent to multiplying by the matrix with Si at (i, Ii), without the multiply.
+     */
+    template <int I0, int S0, int I1, int S1, int I2, int S2>
+    struct AxisPermutation
+    {
+        static_assert(I0 != I1 && I1 != I2 && I0 != I2, "AxisPermutation indices must be distinct.");
+        static_assert((S0 == 1 || S0 == -1) && (S1 == 1 || S1 == -1) && (S2 == 1 || S2 == -1),
+                      "AxisPermutation signs must be +1 or -1.");
+
+        template <typename Scalar>
+        static inline void apply(const Scalar *in, Scalar *out)
+        {
+            out[0] = S0 > 0 ? in[I0] : -in[I0];
+            out[1] = S1 > 0 ? in[I1] : -in[I1];
+            out[2] = S2 > 0 ? in[I2] : -in[I2];
+        }
+
+        template <typename Scalar>
+        static inline Eigen::Matrix<Scalar, 3, 1> apply(const Eigen::Matrix<Scalar, 3, 1> &in)
+        {
+            Eigen::Matrix<Scalar, 3, 1> out;
+            apply(in.data(), out.data());
+            return out;
+        }
+
+        /**
+         * @return P * R * P^T, the rotation R expressed in the permuted axes.
+         */
+        template <typename Scalar>
+        static inline Eigen::Matrix<Scalar, 3, 3> conjugate(const Eigen::Matrix<Scalar, 3, 3> &R)
+        {
+            Eigen::Matrix<Scalar, 3, 3> out;
+            out << sign<Scalar>(S0 * S0) * R(I0, I0), sign<Scalar>(S0 * S1) * R(I0, I1), sign<Scalar>(S0 * S2) * R(I0, I2),
+                sign<Scalar>(S1 * S0) * R(I1, I0), sign<Scalar>(S1 * S1) * R(I1, I1), sign<Scalar>(S1 * S2) * R(I1, I2),
+                sign<Scalar>(S2 * S0) * R(I2, I0), sign<Scalar>(S2 * S1) * R(I2, I1), sign<Scalar>(S2 * S2) * R(I2, I2);
+            return out;
+        }
+
+        /**
+         * @brief Batch version of apply over numPoints packed x y z triplets. in and out may alias.
+         */
+        template <typename Scalar>
+        static inline void applyBatch(const Scalar *in, Scalar *out, size_t numPoints)
+        {
+            for (size_t i = 0; i < numPoints; i++)
+            {
+                const Scalar x = in[3 * i], y = in[3 * i + 1], z = in[3 * i + 2];
+                const Scalar p[3] = {x, y, z};
+                apply(p, out + 3 * i);
+            }
+        }
+
+    private:
+        template <typename Scalar>
+        static constexpr Scalar sign(int s)
+        {
+            return s > 0 ? Scalar(1) : Scalar(-1);
+        }
+    };
+
+    // ORB (x right, y down, z forward) to ROS (x forward, y left, z up): (x, y, z) -> (z, -x, -y).
+    typedef AxisPermutation<2, 1, 0, -1, 1, -1> ORBToROSPermutation;
+    // inverse of ORBToROSPermutation: (x, y, z) -> (-y, -z, x).
+    typedef AxisPermutation<1, -1, 2, -1, 0, 1> ROSToORBPermutation;
+    typedef AxisPermutation<0, 1, 1, 1, 2, 1> IdentityPermutation;
+
+    /**
+     * @brief Converts an ORB camera pose (Tcw, ORB axes) to the camera in the world frame of ROS axes.
+     * @note Computes in Scalar, so a double result does not round trip through float.
+     */
+    template <typename Scalar, typename InScalar>
+    Eigen::Transform<Scalar, 3, Eigen::Affine> orbTcwToROSTwc(const Eigen::Matrix<InScalar, 3, 3> &Rcw,
+                                                            const Eigen::Matrix<InScalar, 3, 1> &tcw)
+    {
+        const Eigen::Matrix<Scalar, 3, 3> Rwc = Rcw.template cast<Scalar>().transpose();
+        const Eigen::Matrix<Scalar, 3, 1> twc = -(Rwc * tcw.template cast<Scalar>());
+        Eigen::Transform<Scalar, 3, Eigen::Affine> Twc = Eigen::Transform<Scalar, 3, Eigen::Affine>::Identity();
+        Twc.linear() = ORBToROSPermutation::conjugate(Rwc);
+        Twc.translation() = ORBToROSPermutation::apply(twc);
+        return Twc;
+    }
+
+    /**
+     * @brief Inverse of orbTcwToROSTwc. Twc must be rigid.
+     */
+    template <typename Scalar>
+    void rosTwcToORBTcw(const Eigen::Transform<Scalar, 3, Eigen::Affine> &Twc,
+                        Eigen::Matrix<Scalar, 3, 3> &Rcw, Eigen::Matrix<Scalar, 3, 1> &tcw)
+    {
+        const Eigen::Matrix<Scalar, 3, 3> RwcORB = ROSToORBPermutation::conjugate(Eigen::Matrix<Scalar, 3, 3>(Twc.linear()));
+        const Eigen::Matrix<Scalar, 3, 1> twcORB = ROSToORBPermutation::apply(Eigen::Matrix<Scalar, 3, 1>(Twc.translation()));
+        Rcw = RwcORB.transpose();
+        tcw = -(Rcw * twcORB);
+    }
+}
+
+#endif
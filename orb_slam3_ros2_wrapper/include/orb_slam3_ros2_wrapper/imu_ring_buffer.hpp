@@ -0,0 +1,154 @@
+/**
+ * @file imu_ring_buffer.hpp
+ * @brief Preallocated single producer / single consumer buffer of IMU samples.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#ifndef ORB_WRAPPER_IMU_RING_BUFFER_HPP_
+#define ORB_WRAPPER_IMU_RING_BUFFER_HPP_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace ORB_SLAM3_Wrapper
+{
+    /**
+     * @brief IMU measurement with the stamp in nanoseconds. Plain old data.
+     */
+    struct ImuSample
+    {
+        int64_t stampNs;
+        float acc[3];
+        float gyr[3];
+    };
+
+    inline int64_t toNanoseconds(int32_t sec, uint32_t nanosec)
+    {
+        return static_cast<int64_t>(sec) * 1000000000LL + nanosec;
+    }
+
+    /**
+     * @brief Ring of IMU samples ordered by stamp, safe for one producer (the IMU callback)
+     * and one consumer (the tracker).
+     * @note All the storage is allocated in the constructor, push and the window extraction never allocate
+     * (as long as the output vector has been reserved). Samples older than the newest pushed one are rejected
+     * so the ring stays sorted and the window between two frames is found by binary search.
+     */
+    class ImuRingBuffer
+    {
+    public:
+        /**
+         * @param capacity Rounded up to a power of two.
+         */
+        explicit ImuRingBuffer(size_t capacity)
+            : head_(0), tail_(0)
+        {
+            size_t size = 1;
+            while (size < capacity)
+                size <<= 1;
+            buffer_.resize(size);
+            mask_ = size - 1;
+        }
+
+        ImuRingBuffer(const ImuRingBuffer &) = delete;
+        ImuRingBuffer &operator=(const ImuRingBuffer &) = delete;
+
+        /**
+         * @brief Appends a sample. Producer side only.
+         * @return False if the buffer is full or the sample is older than the last one pushed.
+         */
+        bool push(const ImuSample &sample)
+        {
+            const uint64_t head = head_.load(std::memory_order_relaxed);
+            if (head != 0 && sample.stampNs < lastPushedNs_)
+            {
+                outOfOrder_.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            if (head - tail_.load(std::memory_order_acquire) == buffer_.size())
+            {
+                overflows_.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            buffer_[head & mask_] = sample;
+            lastPushedNs_ = sample.stampNs;
+            head_.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+        /**
+         * @brief Stamp of the newest sample. Consumer side only.
+         * @return False if the buffer is empty.
+         */
+        bool newestStamp(int64_t &stampNs) const
+        {
+            const uint64_t head = head_.load(std::memory_order_acquire);
+            if (head == tail_.load(std::memory_order_relaxed))
+                return false;
+            stampNs = buffer_[(head - 1) & mask_].stampNs;
+            return true;
+        }
+
+        /**
+         * @brief Moves every sample stamped at or before untilNs to out (appended). Consumer side only.
+         * @return Number of samples moved.
+         */
+        size_t popUntil(int64_t untilNs, std::vector<ImuSample> &out)
+        {
+            const uint64_t tail = tail_.load(std::memory_order_relaxed);
+            const uint64_t head = head_.load(std::memory_order_acquire);
+            // first sample after untilNs.
+            uint64_t lo = tail, hi = head;
+            while (lo < hi)
+            {
+                const uint64_t mid = lo + (hi - lo) / 2;
+                if (buffer_[mid & mask_].stampNs <= untilNs)
+                    lo = mid + 1;
+                else
+                    hi = mid;
+            }
+            for (uint64_t i = tail; i < lo; i++)
+                out.push_back(buffer_[i & mask_]);
+            tail_.store(lo, std::memory_order_release);
+            return static_cast<size_t>(lo - tail);
+        }
+
+        /**
+         * @brief Number of queued samples. Exact only when called from the producer or the consumer.
+         */
+        size_t size() const
+        {
+            return static_cast<size_t>(head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire));
+        }
+
+        size_t capacity() const
+        {
+            return buffer_.size();
+        }
+
+        uint64_t overflows() const
+        {
+            return overflows_.load(std::memory_order_relaxed);
+        }
+
+        uint64_t outOfOrder() const
+        {
+            return outOfOrder_.load(std::memory_order_relaxed);
+        }
+
+    private:
+        std::vector<ImuSample> buffer_;
+        uint64_t mask_;
+        // producer only.
+        int64_t lastPushedNs_ = 0;
+        std::atomic<uint64_t> overflows_{0};
+        std::atomic<uint64_t> outOfOrder_{0};
+        // head and tail live on separate cache lines so producer and consumer do not false share.
+        alignas(64) std::atomic<uint64_t> head_;
+        alignas(64) std::atomic<uint64_t> tail_;
+    };
+}
+
+#endif
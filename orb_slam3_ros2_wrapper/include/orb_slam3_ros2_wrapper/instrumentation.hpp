@@ -0,0 +1,227 @@
+/**
+ * @file instrumentation.hpp
+ * @brief Lock-free latency histograms, gauges and their Prometheus text export.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#ifndef ORB_WRAPPER_INSTRUMENTATION_HPP_
+#define ORB_WRAPPER_INSTRUMENTATION_HPP_
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace ORB_SLAM3_Wrapper
+{
+    /**
+     * @brief Bucket counts of a LatencyHistogram at one point in time.
+     */
+    struct HistogramSnapshot
+    {
+        std::vector<uint64_t> counts;
+        uint64_t count = 0;
+        uint64_t sumNs = 0;
+
+        /**
+         * @return The counts recorded after previous was taken.
+         */
+        HistogramSnapshot since(const HistogramSnapshot &previous) const;
+
+        /**
+         * @return Estimate of the q-quantile in nanoseconds, 0 if empty.
+         */
+        double quantileNs(double q) const;
+
+        /**
+         * @return Upper bound of the largest recorded value in nanoseconds, 0 if empty.
+         */
+        double maxNs() const;
+    };
+
+    /**
+     * @brief Log-linear latency histogram. Recording is a few relaxed atomic increments.
+     * @note 8 buckets per power of two, so quantiles are within ~6% of the recorded values,
+     * from 1 ns up to ~18 minutes.
+     */
+    class LatencyHistogram
+    {
+    public:
+        static constexpr size_t kSubBucketBits = 3;
+        static constexpr size_t kSubBuckets = 1 << kSubBucketBits;
+        static constexpr size_t kMaxExponent = 40;
+        static constexpr size_t kNumBuckets = (kMaxExponent - kSubBucketBits + 2) * kSubBuckets;
+
+        LatencyHistogram();
+
+        void record(uint64_t ns);
+
+        template <typename Rep, typename Period>
+        void record(std::chrono::duration<Rep, Period> duration)
+        {
+            const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+            record(ns > 0 ? static_cast<uint64_t>(ns) : 0);
+        }
+
+        HistogramSnapshot snapshot() const;
+
+        static size_t bucketIndex(uint64_t ns);
+
+        /**
+         * @return Middle of the range of values that fall into the bucket.
+         */
+        static double bucketValue(size_t index);
+
+        /**
+         * @return Largest value that falls into the bucket.
+         */
+        static double bucketUpperBound(size_t index);
+
+    private:
+        std::array<std::atomic<uint64_t>, kNumBuckets> counts_;
+        std::atomic<uint64_t> count_;
+        std::atomic<uint64_t> sumNs_;
+    };
+
+    /**
+     * @brief Last value of a quantity (queue depth, number of keyframes...).
+     */
+    class Gauge
+    {
+    public:
+        void set(double value)
+        {
+            value_.store(value, std::memory_order_relaxed);
+        }
+
+        double get() const
+        {
+            return value_.load(std::memory_order_relaxed);
+        }
+
+    private:
+        std::atomic<double> value_{0.0};
+    };
+
+    /**
+     * @brief Records the lifetime of the timer into a histogram.
+     */
+    class ScopedTimer
+    {
+    public:
+        explicit ScopedTimer(LatencyHistogram &histogram)
+            : histogram_(histogram), start_(std::chrono::steady_clock::now())
+        {
+        }
+
+        ~ScopedTimer()
+        {
+            histogram_.record(std::chrono::steady_clock::now() - start_);
+        }
+
+        ScopedTimer(const ScopedTimer &) = delete;
+        ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+    private:
+        LatencyHistogram &histogram_;
+        std::chrono::steady_clock::time_point start_;
+    };
+
+    /**
+     * @brief One exported value. Latencies carry both the totals since start
+     * and the quantiles of the window since the previous collect.
+     */
+    struct MetricSample
+    {
+        std::string name;
+        std::string help;
+        bool isLatency = false;
+        double value = 0.0;
+        uint64_t count = 0;
+        double sumSeconds = 0.0;
+        uint64_t windowCount = 0;
+        double p50Seconds = 0.0;
+        double p99Seconds = 0.0;
+        double maxSeconds = 0.0;
+    };
+
+    /**
+     * @brief Named histograms and gauges.
+     * @note Registration locks, recording does not. Look the metrics up once and keep the reference,
+     * they live as long as the registry.
+     */
+    class MetricsRegistry
+    {
+    public:
+        LatencyHistogram &histogram(const std::string &name, const std::string &help = "");
+
+        Gauge &gauge(const std::string &name, const std::string &help = "");
+
+        /**
+         * @brief Collects all the metrics.
+         * @param windows Snapshots of the previous collect of the caller, updated in place.
+         * Every consumer keeps its own so they do not reset each other's windows.
+         */
+        std::vector<MetricSample> collect(std::map<std::string, HistogramSnapshot> &windows) const;
+
+    private:
+        struct HistogramEntry
+        {
+            std::string help;
+            std::unique_ptr<LatencyHistogram> histogram;
+        };
+
+        struct GaugeEntry
+        {
+            std::string help;
+            std::unique_ptr<Gauge> gauge;
+        };
+
+        mutable std::mutex mutex_;
+        std::map<std::string, HistogramEntry> histograms_;
+        std::map<std::string, GaugeEntry> gauges_;
+    };
+
+    /**
+     * @brief Formats samples in the Prometheus text exposition format.
+     * Latencies are exported as summaries in seconds, gauges as gauges.
+     */
+    std::string formatPrometheus(const std::vector<MetricSample> &samples, const std::string &prefix);
+
+    /**
+     * @brief Minimal HTTP endpoint answering every request with the Prometheus text of a registry.
+     */
+    class PrometheusExporter
+    {
+    public:
+        PrometheusExporter(std::shared_ptr<MetricsRegistry> registry, int port, const std::string &prefix = "orb_slam3_wrapper");
+
+        ~PrometheusExporter();
+
+        /**
+         * @return False if the port could not be bound.
+         */
+        bool start();
+
+        void stop();
+
+    private:
+        void serve();
+
+        std::shared_ptr<MetricsRegistry> registry_;
+        int port_;
+        std::string prefix_;
+        int listenFd_ = -1;
+        std::atomic<bool> running_{false};
+        std::thread thread_;
+        std::map<std::string, HistogramSnapshot> windows_;
+    };
+}
+
+#endif
@@ -0,0 +1,151 @@
+/**
+ * @file keyframe_store.hpp
+ * @brief Memory-mapped store of the keyframes in the output-side keyframe cache.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#ifndef ORB_WRAPPER_KEYFRAME_STORE_HPP_
+#define ORB_WRAPPER_KEYFRAME_STORE_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace ORB_SLAM3_Wrapper
+{
+    /**
+     * @brief What the wrapper publishes about a keyframe. Plain old data.
+     * @note The pose is the one of the keyframe in its map, in the ROS convention. It is not moved by the
+     * reference pose of the map, so a stored keyframe stays valid while the map anchors are recomputed.
+     */
+    struct StoredKeyFrame
+    {
+        uint64_t id;
+        double stamp;
+        double position[3];
+        // x, y, z, w.
+        double orientation[4];
+        uint32_t numPoints;
+        uint32_t reserved;
+    };
+
+    /**
+     * @brief A map point observed by a stored keyframe, in the map of the keyframe (ROS convention).
+     */
+    struct StoredMapPoint
+    {
+        // set when the keyframe is the reference keyframe of the map point. Each map point has exactly
+        // one, so a cloud built from the flagged points of all the stored keyframes has no duplicates.
+        static constexpr uint32_t kReferenceKeyFrame = 1;
+
+        uint64_t id;
+        float position[3];
+        uint32_t flags;
+    };
+
+    /**
+     * @brief Append-only log of keyframe records in a file mapped in memory.
+     * @note A record is a StoredKeyFrame followed by its map points. Replacing or erasing a record only
+     * drops it from the in-memory index, the space is reclaimed by compacting the log in place once more
+     * than half of it is dead. The pages of the file belong to the page cache, so the kernel writes the
+     * records back and reclaims them under memory pressure instead of the wrapper holding them on the heap.
+     * Not thread safe. The file is removed when the store is destroyed.
+     */
+    class MappedKeyFrameStore
+    {
+    public:
+        explicit MappedKeyFrameStore(const std::string &path);
+
+        ~MappedKeyFrameStore();
+
+        MappedKeyFrameStore(const MappedKeyFrameStore &) = delete;
+        MappedKeyFrameStore &operator=(const MappedKeyFrameStore &) = delete;
+
+        /**
+         * @brief Creates (or truncates) the file and maps it.
+         */
+        bool open(size_t initialCapacity = 1 << 20);
+
+        bool isOpen() const
+        {
+            return data_ != nullptr;
+        }
+
+        /**
+         * @brief Stores the keyframe, replacing a previous record with the same id.
+         * @note keyFrame.numPoints is overwritten with points.size().
+         */
+        bool put(const StoredKeyFrame &keyFrame, const std::vector<StoredMapPoint> &points);
+
+        /**
+         * @param points Appended with the map points of the record if not null.
+         */
+        bool get(uint64_t id, StoredKeyFrame &keyFrame, std::vector<StoredMapPoint> *points = nullptr) const;
+
+        /**
+         * @brief Zero-copy access to a record, valid until the next put or erase.
+         */
+        const StoredKeyFrame *find(uint64_t id, const StoredMapPoint **points = nullptr) const;
+
+        bool erase(uint64_t id);
+
+        bool contains(uint64_t id) const
+        {
+            return index_.count(id) > 0;
+        }
+
+        void clear();
+
+        size_t size() const
+        {
+            return index_.size();
+        }
+
+        uint64_t numPoints() const
+        {
+            return numPoints_;
+        }
+
+        /**
+         * @brief Bytes of the live records.
+         */
+        size_t liveBytes() const
+        {
+            return end_ - deadBytes_;
+        }
+
+        size_t mappedBytes() const
+        {
+            return capacity_;
+        }
+
+        const std::string &path() const
+        {
+            return path_;
+        }
+
+    private:
+        static size_t recordSize(uint32_t numPoints)
+        {
+            return sizeof(StoredKeyFrame) + numPoints * sizeof(StoredMapPoint);
+        }
+
+        bool reserve(size_t bytes);
+        void compact();
+        void close();
+
+        std::string path_;
+        int fd_ = -1;
+        char *data_ = nullptr;
+        size_t capacity_ = 0;
+        size_t end_ = 0;
+        size_t deadBytes_ = 0;
+        uint64_t numPoints_ = 0;
+        // record offset per keyframe id.
+        std::unordered_map<uint64_t, size_t> index_;
+    };
+}
+
+#endif
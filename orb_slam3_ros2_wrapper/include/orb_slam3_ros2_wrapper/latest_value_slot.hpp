@@ -0,0 +1,78 @@
+/**
+ * @file latest_value_slot.hpp
+ * @brief Single slot mailbox keeping only the newest value.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#ifndef ORB_WRAPPER_LATEST_VALUE_SLOT_HPP_
+#define ORB_WRAPPER_LATEST_VALUE_SLOT_HPP_
+
+#include <mutex>
+#include <utility>
+
+namespace ORB_SLAM3_Wrapper
+{
+    /**
+     * @brief Holds at most one value. A put replaces the value that was not taken yet, so the consumer always
+     * gets the newest one and the producer never waits for it.
+     * @note The replaced value is released outside the lock, the argument of put is left empty. Any number of
+     * producers and consumers.
+     */
+    template <typename T>
+    class LatestValueSlot
+    {
+    public:
+        LatestValueSlot() = default;
+
+        LatestValueSlot(const LatestValueSlot &) = delete;
+        LatestValueSlot &operator=(const LatestValueSlot &) = delete;
+
+        /**
+         * @return True if a value that was not taken was replaced.
+         */
+        bool put(T &&value)
+        {
+            bool hadValue;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                std::swap(value_, value);
+                hadValue = hasValue_;
+                hasValue_ = true;
+            }
+            // value holds the replaced one.
+            value = T();
+            return hadValue;
+        }
+
+        /**
+         * @return False if the slot is empty.
+         */
+        bool take(T &value)
+        {
+            T taken;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (!hasValue_)
+                    return false;
+                taken = std::move(value_);
+                value_ = T();
+                hasValue_ = false;
+            }
+            value = std::move(taken);
+            return true;
+        }
+
+        bool empty() const
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return !hasValue_;
+        }
+
+    private:
+        mutable std::mutex mutex_;
+        T value_{};
+        bool hasValue_ = false;
+    };
+}
+
+#endif
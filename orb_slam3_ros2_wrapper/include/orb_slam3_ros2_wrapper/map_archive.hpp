@@ -0,0 +1,165 @@
+/**
+ * @file map_archive.hpp
+ * @brief Chunked zstd streams for the persisted Atlas, and the files ORB_SLAM3 needs to load it.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#ifndef ORB_WRAPPER_MAP_ARCHIVE_HPP_
+#define ORB_WRAPPER_MAP_ARCHIVE_HPP_
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+namespace ORB_SLAM3_Wrapper
+{
+    /**
+     * @brief Output stream buffer compressing what is written in independent zstd chunks.
+     * @note Layout: the 8 byte magic "ORBMAPZ1", then per chunk its raw size and compressed size (uint32 each)
+     * followed by the compressed bytes, and a chunk of raw size 0 that ends the stream. Each chunk is
+     * written to the sink as soon as it is full, so the archive can go to a file or a socket without being
+     * held in memory, and a reader only ever holds one chunk.
+     */
+    class CompressedChunkWriter : public std::streambuf
+    {
+    public:
+        explicit CompressedChunkWriter(std::ostream &sink, size_t chunkSize = 1 << 20, int level = 3);
+
+        /**
+         * @brief Calls finish() if it was not called.
+         */
+        ~CompressedChunkWriter();
+
+        CompressedChunkWriter(const CompressedChunkWriter &) = delete;
+        CompressedChunkWriter &operator=(const CompressedChunkWriter &) = delete;
+
+        /**
+         * @brief Writes the last chunk and the end marker.
+         * @return False if the compression or the sink failed at any point.
+         */
+        bool finish();
+
+        uint64_t rawBytes() const
+        {
+            return rawBytes_;
+        }
+
+        uint64_t compressedBytes() const
+        {
+            return compressedBytes_;
+        }
+
+    protected:
+        int_type overflow(int_type ch) override;
+        int sync() override;
+
+    private:
+        bool flushChunk();
+
+        std::ostream &sink_;
+        // ZSTD_CCtx, reused by all the chunks. Opaque so that zstd.h stays out of the header.
+        void *context_;
+        std::vector<char> raw_;
+        std::vector<char> compressed_;
+        uint64_t rawBytes_ = 0;
+        uint64_t compressedBytes_ = 0;
+        bool failed_ = false;
+        bool finished_ = false;
+    };
+
+    /**
+     * @brief Input stream buffer decompressing a CompressedChunkWriter stream one chunk at a time.
+     */
+    class CompressedChunkReader : public std::streambuf
+    {
+    public:
+        explicit CompressedChunkReader(std::istream &source);
+        ~CompressedChunkReader();
+
+        CompressedChunkReader(const CompressedChunkReader &) = delete;
+        CompressedChunkReader &operator=(const CompressedChunkReader &) = delete;
+
+        /**
+         * @return False if the magic, a chunk header or a chunk was invalid, or the stream ended without the end marker.
+         */
+        bool valid() const
+        {
+            return !failed_;
+        }
+
+        /**
+         * @return True once the end marker has been read.
+         */
+        bool complete() const
+        {
+            return complete_;
+        }
+
+    protected:
+        int_type underflow() override;
+
+    private:
+        std::istream &source_;
+        // ZSTD_DCtx
+        void *context_;
+        std::vector<char> raw_;
+        std::vector<char> compressed_;
+        bool failed_ = false;
+        bool complete_ = false;
+    };
+
+    /**
+     * @brief Uniquely named empty file created in /tmp, removed on destruction.
+     * @note Created with mkstemps, so two loads (or two nodes) never share a path.
+     */
+    class TemporaryFile
+    {
+    public:
+        /**
+         * @param suffix Kept at the end of the name, e.g. the extension ORB_SLAM3 expects.
+         */
+        explicit TemporaryFile(const std::string &suffix);
+        ~TemporaryFile();
+
+        TemporaryFile(const TemporaryFile &) = delete;
+        TemporaryFile &operator=(const TemporaryFile &) = delete;
+
+        /**
+         * @return False if the file could not be created, the path is empty then.
+         */
+        bool valid() const
+        {
+            return !path_.empty();
+        }
+
+        const std::string &path() const
+        {
+            return path_;
+        }
+
+    private:
+        std::string path_;
+    };
+
+    /**
+     * @brief Decompresses a map archive to the boost archive file ORB_SLAM3 loads.
+     */
+    bool decompressMapArchive(const std::string &archivePath, const std::string &outputPath, std::string &message);
+
+    /**
+     * @brief Copies an ORB_SLAM3 settings file setting System.LoadAtlasFromFile to atlasBasePath
+     * (ORB_SLAM3 appends the .osa extension).
+     */
+    bool writeSettingsLoadingAtlas(const std::string &settingsPath, const std::string &outputPath, const std::string &atlasBasePath);
+
+    /**
+     * @brief Checksum of the vocabulary file, as ORB_SLAM3 stores it in the saved Atlas and checks it on load.
+     * @return Empty if the file could not be read.
+     */
+    std::string vocabularyChecksum(const std::string &vocabularyPath);
+}
+
+#endif
@@ -0,0 +1,62 @@
+/**
+ * @file map_data_delta.hpp
+ * @brief Encoder turning successive MapGraph messages into MapDataDelta messages.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#ifndef ORB_WRAPPER_MAP_DATA_DELTA_HPP_
+#define ORB_WRAPPER_MAP_DATA_DELTA_HPP_
+
+#include <atomic>
+#include <cstdint>
+#include <unordered_map>
+
+#include <geometry_msgs/msg/pose.hpp>
+#include <slam_msgs/msg/map_graph.hpp>
+#include <slam_msgs/msg/map_data_delta.hpp>
+
+namespace ORB_SLAM3_Wrapper
+{
+    class MapDataDeltaEncoder
+    {
+    public:
+        /**
+         * @param translationThreshold A keyframe is sent again once it moved further than this (m).
+         * @param rotationThreshold A keyframe is sent again once it rotated more than this (rad).
+         * @param snapshotInterval A full snapshot is sent after this many deltas. 0 disables the periodic snapshot.
+         */
+        MapDataDeltaEncoder(double translationThreshold, double rotationThreshold, int snapshotInterval);
+
+        /**
+         * @brief The next call to encode produces a snapshot. Safe to call from any thread.
+         */
+        void requestSnapshot();
+
+        /**
+         * @brief Diffs the graph against what was sent so far.
+         * @param graph Current pose graph.
+         * @param delta Filled with the changes, or the full graph if a snapshot is due. The header is left untouched.
+         * @return False if nothing changed and no snapshot is due, there is nothing to publish then.
+         */
+        bool encode(const slam_msgs::msg::MapGraph &graph, slam_msgs::msg::MapDataDelta &delta);
+
+        uint64_t sequence() const
+        {
+            return sequence_;
+        }
+
+    private:
+        bool hasMoved(const geometry_msgs::msg::Pose &sent, const geometry_msgs::msg::Pose &current) const;
+
+        double translationThreshold_;
+        double rotationThreshold_;
+        int snapshotInterval_;
+        int deltasSinceSnapshot_ = 0;
+        uint64_t sequence_ = 0;
+        std::atomic<bool> snapshotRequested_{true};
+        // keyframe poses as last sent to the subscribers.
+        std::unordered_map<int32_t, geometry_msgs::msg::Pose> sentPoses_;
+    };
+}
+
+#endif
@@ -0,0 +1,137 @@
+/**
+ * @file map_events.hpp
+ * @brief Changes of the Atlas detected by the interface, queued for the node without locks.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#ifndef ORB_WRAPPER_MAP_EVENTS_HPP_
+#define ORB_WRAPPER_MAP_EVENTS_HPP_
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+
+#include "orb_slam3_ros2_wrapper/spsc_ring_buffer.hpp"
+
+namespace ORB_SLAM3_Wrapper
+{
+    /**
+     * @brief Same values as the constants of slam_msgs/MapEvent.
+     */
+    enum class MapEventType : uint8_t
+    {
+        KEYFRAME_INSERTED = 0,
+        KEYFRAME_CULLED = 1,
+        MAP_CREATED = 2,
+        MAP_MERGED = 3,
+        MAP_RESET = 4,
+        LOOP_CLOSED = 5,
+        BUNDLE_ADJUSTMENT = 6
+    };
+
+    inline const char *mapEventTypeName(MapEventType type)
+    {
+        switch (type)
+        {
+        case MapEventType::KEYFRAME_INSERTED:
+            return "keyframe inserted";
+        case MapEventType::KEYFRAME_CULLED:
+            return "keyframe culled";
+        case MapEventType::MAP_CREATED:
+            return "map created";
+        case MapEventType::MAP_MERGED:
+            return "map merged";
+        case MapEventType::MAP_RESET:
+            return "map reset";
+        case MapEventType::LOOP_CLOSED:
+            return "loop closed";
+        default:
+            return "bundle adjustment";
+        }
+    }
+
+    struct MapEvent
+    {
+        MapEventType type = MapEventType::KEYFRAME_INSERTED;
+        // map of the keyframe, the created or corrected map, or the map merged away or reset.
+        uint32_t mapId = 0;
+        // keyframe events only.
+        int64_t keyFrameId = -1;
+        // consecutive for consecutive events, dropped events leave a gap.
+        uint64_t sequence = 0;
+    };
+
+    /**
+     * @brief Bounded single producer / single consumer queue of map events.
+     * @note The producer is the tracking thread. Events that do not fit are dropped but still take a sequence
+     * number, so the consumer sees the gap and can fall back to a full map data read. Set the notifier before
+     * the producer starts, it is called on the producer thread and must not block.
+     */
+    class MapEventQueue
+    {
+    public:
+        explicit MapEventQueue(size_t capacity)
+            : events_(capacity)
+        {
+        }
+
+        void setNotifier(std::function<void()> notifier)
+        {
+            notifier_ = std::move(notifier);
+        }
+
+        /**
+         * @brief Producer side only.
+         */
+        void push(MapEventType type, uint32_t mapId, int64_t keyFrameId = -1)
+        {
+            MapEvent event;
+            event.type = type;
+            event.mapId = mapId;
+            event.keyFrameId = keyFrameId;
+            event.sequence = produced_.fetch_add(1, std::memory_order_relaxed);
+            if (!events_.push(std::move(event)))
+                dropped_.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        /**
+         * @brief Wakes the consumer, once per batch of events. Producer side only.
+         */
+        void notify() const
+        {
+            if (notifier_)
+                notifier_();
+        }
+
+        /**
+         * @brief Consumer side only.
+         */
+        bool pop(MapEvent &event)
+        {
+            return events_.pop(event);
+        }
+
+        uint64_t produced() const
+        {
+            return produced_.load(std::memory_order_relaxed);
+        }
+
+        uint64_t dropped() const
+        {
+            return dropped_.load(std::memory_order_relaxed);
+        }
+
+        size_t size() const
+        {
+            return events_.size();
+        }
+
+    private:
+        SPSCRingBuffer<MapEvent> events_;
+        std::function<void()> notifier_;
+        std::atomic<uint64_t> produced_{0};
+        std::atomic<uint64_t> dropped_{0};
+    };
+}
+
+#endif
@@ -0,0 +1,106 @@
+/**
+ * @file map_signature.hpp
+ * @brief Fingerprints of the Atlas maps and the comparison deciding what an update has to recompute.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#ifndef ORB_WRAPPER_MAP_SIGNATURE_HPP_
+#define ORB_WRAPPER_MAP_SIGNATURE_HPP_
+
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace ORB_SLAM3_Wrapper
+{
+    /**
+     * @brief Cheap fingerprint of a map used to detect structural changes in the Atlas.
+     */
+    struct MapSignature
+    {
+        long unsigned int initKFid = 0;
+        long unsigned int maxKFid = 0;
+        long unsigned int numKFs = 0;
+        // Map::GetMapChangeIndex, incremented by the bundle adjustments.
+        int changeIdx = -1;
+        // Map::GetLastBigChangeIdx, incremented by the loop closures and merges.
+        int bigChangeIdx = -1;
+        const void *originKF = nullptr;
+        // kept for the events of the map once it is gone.
+        long unsigned int mapId = 0;
+    };
+
+    /**
+     * @brief What changed in the Atlas between two sets of signatures.
+     */
+    template <typename MapT>
+    struct AtlasChanges
+    {
+        // new maps and maps whose keyframe set changed, their keyframe table entries are rebuilt.
+        std::vector<MapT *> changed;
+        std::vector<MapT *> created;
+        // loop closure or merge, every keyframe of the map moved.
+        std::vector<MapT *> corrected;
+        // bundle adjustment only.
+        std::vector<MapT *> optimized;
+        // merged into another map or reset.
+        std::vector<MapT *> removed;
+        // false on a steady-state frame: the reference poses and the snapshot are kept as they are.
+        bool atlasChanged = false;
+    };
+
+    /**
+     * @brief Compares the signatures of the current maps with the previous ones.
+     * @param current Maps of the Atlas with their signatures, in the order of the reference poses.
+     * @note O(number of maps), the only cost paid on a steady-state frame.
+     */
+    template <typename MapT>
+    AtlasChanges<MapT> diffMapSignatures(const std::vector<std::pair<MapT *, MapSignature>> &current,
+                                         const std::unordered_map<MapT *, MapSignature> &previous)
+    {
+        AtlasChanges<MapT> changes;
+        changes.atlasChanged = current.size() != previous.size();
+        for (const auto &map : current)
+        {
+            const MapSignature &signature = map.second;
+            auto it = previous.find(map.first);
+            if (it == previous.end())
+            {
+                changes.changed.push_back(map.first);
+                changes.created.push_back(map.first);
+                changes.atlasChanged = true;
+                continue;
+            }
+            const MapSignature &old = it->second;
+            // keyframe insertion / culling or a merge / loop closure rewrites the keyframe set.
+            const bool keyFramesChanged = old.maxKFid != signature.maxKFid || old.numKFs != signature.numKFs ||
+                                          old.bigChangeIdx != signature.bigChangeIdx || old.initKFid != signature.initKFid;
+            // bundle adjustment moves the origin / parent keyframes without changing the set.
+            const bool posesChanged = old.changeIdx != signature.changeIdx || old.originKF != signature.originKF;
+            if (keyFramesChanged)
+                changes.changed.push_back(map.first);
+            if (old.bigChangeIdx != signature.bigChangeIdx)
+                changes.corrected.push_back(map.first);
+            else if (old.changeIdx != signature.changeIdx)
+                changes.optimized.push_back(map.first);
+            if (keyFramesChanged || posesChanged)
+                changes.atlasChanged = true;
+        }
+        if (!changes.atlasChanged)
+            return changes;
+
+        std::unordered_set<MapT *> present;
+        present.reserve(current.size());
+        for (const auto &map : current)
+            present.insert(map.first);
+        for (const auto &old : previous)
+        {
+            if (present.count(old.first) == 0)
+                changes.removed.push_back(old.first);
+        }
+        return changes;
+    }
+}
+
+#endif
@@ -0,0 +1,80 @@
+/**
+ * @file merge_correction.hpp
+ * @brief Takes the published pose from the pre-merge frame to the post-merge frame of a map merge.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#ifndef ORB_WRAPPER_MERGE_CORRECTION_HPP_
+#define ORB_WRAPPER_MERGE_CORRECTION_HPP_
+
+#include <string>
+
+#include <Eigen/Geometry>
+
+namespace ORB_SLAM3_Wrapper
+{
+    /**
+     * @brief How the tracked pose is published while ORB_SLAM3 merges maps.
+     */
+    enum class MergeHandling
+    {
+        // nothing is published until the merge is done (the ORB_SLAM3 default).
+        PAUSE,
+        // published in the pre-merge frame, the correction is applied at once after the merge.
+        HOLD,
+        // published in the pre-merge frame, the correction is blended in over a window after the merge.
+        BLEND
+    };
+
+    /**
+     * @return False if the name is not pause, hold or blend.
+     */
+    bool mergeHandlingFromString(const std::string &name, MergeHandling &handling);
+
+    /**
+     * @brief Blends the correction of a merge into the published pose.
+     * @note The published pose starts where the pre-merge frame would put it and reaches the post-merge pose
+     * at the end of the window, rotation and translation interpolated together. Not thread safe.
+     */
+    class MergeCorrection
+    {
+    public:
+        /**
+         * @param correction Pre-merge frame to post-merge frame: post-merge pose = correction * pre-merge pose.
+         * @param window Blend window (s), 0 applies the correction at once.
+         * @param now Any monotonic time (s).
+         */
+        void start(const Eigen::Affine3d &correction, double window, double now);
+
+        /**
+         * @param pose Pose in the post-merge frame.
+         * @return The pose to publish.
+         */
+        Eigen::Affine3d apply(const Eigen::Affine3d &pose, double now);
+
+        bool active() const
+        {
+            return active_;
+        }
+
+        static double translationMagnitude(const Eigen::Affine3d &correction)
+        {
+            return correction.translation().norm();
+        }
+
+        static double rotationMagnitude(const Eigen::Affine3d &correction)
+        {
+            return Eigen::AngleAxisd(Eigen::Matrix3d(correction.linear())).angle();
+        }
+
+    private:
+        // inverse of the correction, what is left to remove from the post-merge pose.
+        Eigen::Quaterniond residualRotation_ = Eigen::Quaterniond::Identity();
+        Eigen::Vector3d residualTranslation_ = Eigen::Vector3d::Zero();
+        double start_ = 0.0;
+        double window_ = 0.0;
+        bool active_ = false;
+    };
+}
+
+#endif
@@ -0,0 +1,303 @@
+/**
+ * @file occupancy_map.hpp
+ * @brief Voxel occupancy map fused from the depth images of the keyframes, with its 2D projection.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#ifndef ORB_WRAPPER_OCCUPANCY_MAP_HPP_
+#define ORB_WRAPPER_OCCUPANCY_MAP_HPP_
+
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+namespace ORB_SLAM3_Wrapper
+{
+    struct OccupancyMapConfig
+    {
+        // voxel and grid cell size (m).
+        float resolution = 0.05f;
+        // rays are cut at this range (m), the cut end is not marked occupied.
+        float maxRange = 4.0f;
+        // log odds of one hit and one miss of a voxel.
+        float hitLogOdds = 0.85f;
+        float missLogOdds = -0.4f;
+        // a voxel is occupied above the first, free below the second.
+        float occupiedLogOdds = 0.5f;
+        float freeLogOdds = -0.2f;
+        // only the voxels between these heights of the global frame are projected on the grid (m).
+        float minHeight = -0.2f;
+        float maxHeight = 0.5f;
+    };
+
+    /**
+     * @brief Signed voxel / cell coordinates.
+     */
+    struct VoxelIndex
+    {
+        int32_t x, y, z;
+
+        bool operator==(const VoxelIndex &other) const
+        {
+            return x == other.x && y == other.y && z == other.z;
+        }
+    };
+
+    struct VoxelIndexHash
+    {
+        size_t operator()(const VoxelIndex &index) const
+        {
+            return static_cast<size_t>(static_cast<uint32_t>(index.x) * 73856093u ^ static_cast<uint32_t>(index.y) * 19349663u ^
+                                       static_cast<uint32_t>(index.z) * 83492791u);
+        }
+    };
+
+    /**
+     * @brief 2D projection of the voxels, row major from the cell (originX, originY).
+     * @note Values as nav_msgs/OccupancyGrid: -1 unknown, 0 free, 100 occupied.
+     */
+    struct OccupancyGrid
+    {
+        float resolution = 0.0f;
+        int32_t originX = 0;
+        int32_t originY = 0;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        std::vector<int8_t> data;
+    };
+
+    /**
+     * @brief Sparse log odds voxel map.
+     * @note A voxel keeps its hit and miss counts instead of their log odds, so that a scan integrated with
+     * weight -1 removes exactly what the same scan added with weight 1. This is what lets a keyframe that moved be
+     * taken out at its old pose and put back at the new one. A scan counts each voxel once, however many rays cross
+     * it. Not thread safe.
+     */
+    class OccupancyMap
+    {
+    public:
+        explicit OccupancyMap(const OccupancyMapConfig &config = OccupancyMapConfig());
+
+        /**
+         * @param sensorPose Pose of the sensor in the global frame, the origin of the rays.
+         * @param points End points of the rays in the sensor frame.
+         * @param weight 1 to add the scan, -1 to remove a scan added before with the same pose and points.
+         */
+        void integrate(const Eigen::Affine3f &sensorPose, const std::vector<Eigen::Vector3f> &points, int weight);
+
+        void clear();
+
+        /**
+         * @brief Copies the grid, bounded by the cells that were ever observed.
+         */
+        void grid(OccupancyGrid &grid) const;
+
+        /**
+         * @brief Centers of the occupied voxels in the global frame.
+         */
+        void occupiedVoxels(std::vector<Eigen::Vector3f> &centers) const;
+
+        VoxelIndex toIndex(const Eigen::Vector3f &position) const;
+
+        /**
+         * @return -1 unknown, 0 free, 1 occupied.
+         */
+        int voxelState(const VoxelIndex &index) const;
+
+        size_t numVoxels() const
+        {
+            return voxels_.size();
+        }
+
+        size_t numOccupied() const
+        {
+            return numOccupied_;
+        }
+
+        /**
+         * @brief Incremented by every integrate call that changed the state of a voxel.
+         */
+        uint64_t version() const
+        {
+            return version_;
+        }
+
+        const OccupancyMapConfig &config() const
+        {
+            return config_;
+        }
+
+    private:
+        struct Voxel
+        {
+            int32_t hits = 0;
+            int32_t misses = 0;
+        };
+
+        // observed voxels of a column in the height band.
+        struct Column
+        {
+            int32_t occupied = 0;
+            int32_t free = 0;
+        };
+
+        int stateOf(const Voxel &voxel) const;
+        void update(const VoxelIndex &index, int hits, int misses);
+        void castRay(const Eigen::Vector3f &origin, const Eigen::Vector3f &end, std::vector<VoxelIndex> &crossed) const;
+
+        OccupancyMapConfig config_;
+        float invResolution_;
+        int32_t minBandZ_;
+        int32_t maxBandZ_;
+        std::unordered_map<VoxelIndex, Voxel, VoxelIndexHash> voxels_;
+        std::unordered_map<VoxelIndex, Column, VoxelIndexHash> columns_;
+        size_t numOccupied_ = 0;
+        uint64_t version_ = 0;
+        bool changed_ = false;
+        // reused by integrate.
+        std::unordered_map<VoxelIndex, uint8_t, VoxelIndexHash> scanVoxels_;
+        std::vector<VoxelIndex> ray_;
+    };
+
+    /**
+     * @brief Back projects a depth image to points in the camera frame, with the body axes of the keyframe poses
+     * (x forward, y left, z up) instead of the optical axes.
+     * @param depth Row major depth, rowStep elements per row.
+     * @param scale Meters per depth unit (0.001 for 16UC1 millimeters, 1 for 32FC1 meters).
+     * @param stride One pixel in stride, in both directions.
+     * @note Zero, negative and non finite depths are skipped.
+     */
+    template <typename T>
+    void depthToPoints(const T *depth, uint32_t width, uint32_t height, size_t rowStep, float scale,
+                       float fx, float fy, float cx, float cy, uint32_t stride, std::vector<Eigen::Vector3f> &points)
+    {
+        points.clear();
+        stride = stride == 0 ? 1 : stride;
+        points.reserve((width / stride + 1) * (height / stride + 1));
+        const float invFx = 1.0f / fx, invFy = 1.0f / fy;
+        for (uint32_t v = 0; v < height; v += stride)
+        {
+            const T *row = depth + v * rowStep;
+            for (uint32_t u = 0; u < width; u += stride)
+            {
+                const float z = static_cast<float>(row[u]) * scale;
+                if (!(z > 0.0f) || !std::isfinite(z))
+                    continue;
+                // optical (x right, y down, z forward) to body axes.
+                points.emplace_back(z, -(u - cx) * z * invFx, -(v - cy) * z * invFy);
+            }
+        }
+    }
+
+    /**
+     * @brief One point per voxel of the given size, the first seen.
+     */
+    void downsamplePoints(std::vector<Eigen::Vector3f> &points, float resolution);
+
+    struct OccupancyMapperStats
+    {
+        uint64_t integrated = 0;
+        uint64_t reintegrated = 0;
+        uint64_t removed = 0;
+        uint64_t dropped = 0;
+        size_t pending = 0;
+    };
+
+    /**
+     * @brief Keeps an OccupancyMap up to date with the keyframes on a background thread.
+     * @note The scans of new keyframes wait in a bounded queue, a keyframe that does not fit is dropped. Moves and
+     * removals are never dropped, they are coalesced per keyframe instead and a keyframe that moved several times
+     * is integrated again once. The scans are kept in the keyframe frame to be re-integrated when it moves. The
+     * add / move / remove calls and the readers can be on any thread.
+     */
+    class OccupancyMapper
+    {
+    public:
+        /**
+         * @param maxPendingScans New keyframes waiting to be integrated, past it new keyframes are dropped.
+         */
+        OccupancyMapper(const OccupancyMapConfig &config, size_t maxPendingScans);
+        ~OccupancyMapper();
+
+        OccupancyMapper(const OccupancyMapper &) = delete;
+        OccupancyMapper &operator=(const OccupancyMapper &) = delete;
+
+        /**
+         * @param pose Pose of the keyframe (the sensor) in the global frame.
+         * @param points Scan in the keyframe frame, downsampled to the map resolution here.
+         * @return False if the scan was dropped, the queue being full.
+         */
+        bool addKeyFrame(int32_t id, const Eigen::Affine3f &pose, std::vector<Eigen::Vector3f> &&points);
+
+        /**
+         * @brief Keyframes never added are ignored.
+         */
+        void moveKeyFrame(int32_t id, const Eigen::Affine3f &pose);
+        void removeKeyFrame(int32_t id);
+
+        /**
+         * @brief Drops the map, the keyframes and what is pending.
+         */
+        void clear();
+
+        /**
+         * @brief Waits until nothing is pending.
+         */
+        void flush();
+
+        /**
+         * @return The version of the map, see OccupancyMap::version.
+         */
+        uint64_t version() const;
+        void grid(OccupancyGrid &grid) const;
+        void occupiedVoxels(std::vector<Eigen::Vector3f> &centers) const;
+        OccupancyMapperStats stats() const;
+
+    private:
+        struct Pending
+        {
+            bool hasScan = false;
+            bool hasPose = false;
+            bool remove = false;
+            Eigen::Affine3f pose = Eigen::Affine3f::Identity();
+            std::vector<Eigen::Vector3f> points;
+        };
+
+        struct Integrated
+        {
+            Eigen::Affine3f pose;
+            std::vector<Eigen::Vector3f> points;
+        };
+
+        void run();
+        void process(int32_t id, Pending &pending, OccupancyMapperStats &counts);
+
+        mutable std::mutex mapMutex_;
+        OccupancyMap map_;
+        std::unordered_map<int32_t, Integrated> integrated_;
+
+        mutable std::mutex pendingMutex_;
+        std::condition_variable pendingCondition_;
+        std::condition_variable idleCondition_;
+        // by keyframe id, processed lowest id first.
+        std::map<int32_t, Pending> pending_;
+        size_t maxPendingScans_;
+        size_t pendingScans_ = 0;
+        // incremented by clear under both mutexes, what was taken before is not integrated.
+        uint64_t generation_ = 0;
+        bool busy_ = false;
+        bool running_ = true;
+        OccupancyMapperStats stats_;
+        std::thread thread_;
+    };
+}
+
+#endif
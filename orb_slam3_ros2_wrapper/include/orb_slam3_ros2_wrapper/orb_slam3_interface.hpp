@@ -8,6 +8,13 @@
 
 #include <iostream>
 #include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <atomic>
+#include <cstring>
+#include <thread>
+#include <chrono>
 
 #include <Eigen/Core>
 #include <Eigen/Geometry>
@@ -30,12 +37,30 @@
 #include "Map.h"
 #include "Atlas.h"
 #include "orb_slam3_ros2_wrapper/type_conversion.hpp"
+#include "orb_slam3_ros2_wrapper/voxel_hash_index.hpp"
+#include "orb_slam3_ros2_wrapper/visibility_kernel.hpp"
+#include "orb_slam3_ros2_wrapper/instrumentation.hpp"
+#include "orb_slam3_ros2_wrapper/imu_ring_buffer.hpp"
+#include "orb_slam3_ros2_wrapper/vocabulary_cache.hpp"
+#include "orb_slam3_ros2_wrapper/binary_vocabulary.hpp"
+#include "orb_slam3_ros2_wrapper/map_archive.hpp"
+#include "orb_slam3_ros2_wrapper/keyframe_store.hpp"
+#include "orb_slam3_ros2_wrapper/feature_backend.hpp"
+#include "orb_slam3_ros2_wrapper/map_events.hpp"
+#include "orb_slam3_ros2_wrapper/map_signature.hpp"
+#include "orb_slam3_ros2_wrapper/merge_correction.hpp"
+#include "orb_slam3_ros2_wrapper/thread_config.hpp"
+#include "orb_slam3_ros2_wrapper/worker_pool.hpp"
 
 namespace ORB_SLAM3_Wrapper
 {
     class ORBSLAM3Interface
     {
     public:
+        /**
+         * @throws std::runtime_error If another interface of the process is alive and ORB_SLAM3 is not built with
+         * per-system state, see supportsMultipleSystems.
+         */
         ORBSLAM3Interface(const std::string &strVocFile,
                           const std::string &strSettingsFile,
                           ORB_SLAM3::System::eSensor sensor,
@@ -45,10 +70,27 @@ namespace ORB_SLAM3_Wrapper
                           double robotY,
                           std::string globalFrame,
                           std::string odomFrame,
-                          std::string robotFrame);
+                          std::string robotFrame,
+                          std::shared_ptr<MetricsRegistry> metrics = nullptr);
 
         ~ORBSLAM3Interface();
 
+        /**
+         * @brief Whether several ORB_SLAM3 systems can live in one process.
+         * @note Stock ORB_SLAM3 keeps the keyframe, map point and map id counters (KeyFrame::nNextId, MapPoint::nNextId,
+         * Map::nNextId) and the calibration of the frames (Frame::fx, mbInitialComputations...) in process wide statics.
+         * A second system would share them with the first: the keyframe ids collide and its frames get the calibration
+         * of the first camera. Only an ORB_SLAM3 keeping them per system (ORB_SLAM3_HAS_INSTANCE_STATE) allows it.
+         */
+        static constexpr bool supportsMultipleSystems()
+        {
+#ifdef ORB_SLAM3_HAS_INSTANCE_STATE
+            return true;
+#else
+            return false;
+#endif
+        }
+
         /**
          * @brief Generates a map of KeyFrame IDs and their pointers.
          * @param mapsList List of Map pointers.
@@ -58,62 +100,697 @@ namespace ORB_SLAM3_Wrapper
 
         /**
          * @brief Calculates reference poses for each map.
+         * @note This is incremental. The Atlas is fingerprinted on every call and the keyframe table
+         * and reference poses are only updated when a structural change (new map, merge, loop closure / BA,
+         * keyframe insertion or culling) is detected or a new fleet reference is set. Only then is a new MapSnapshot published.
+         * Only the reference poses of the changed, corrected and optimized maps are recomputed, with the maps
+         * anchored to them through their parent keyframe. A removed map or a new fleet reference recomputes all.
+         * Call from the tracking thread only, it owns the working copies of the tables.
+         * @return True if the reference poses were recomputed.
          */
-        void calculateReferencePoses();
+        bool calculateReferencePoses();
 
         /**
          * @brief Converts the entire map data into a ROS Message.
          * @param orbAtlas Pointer to the Atlas object.
-         * @note Only call this after calculating the reference poses.
+         * @note Only call this after calculating the reference poses. The message is overwritten in place, a message
+         * kept from a previous build reuses its sequences and stops allocating once it has seen the largest map.
+         */
+        void mapDataToMsg(slam_msgs::msg::MapData &mapDataMsg, bool currentMapKFOnly, bool includeMapPoints = false, const std::vector<int> &kFIDforMapPoints = std::vector<int>());
+
+        /**
+         * @brief Tracked pose in the global frame from the reference pose of the current map.
+         * @note Tracking thread. The first call after a merge measures the correction of the merge and, in
+         * MergeHandling::BLEND, starts blending it in.
+         * @return False if the current map has no reference pose, the tracked pose is left as it was.
          */
-        void mapDataToMsg(slam_msgs::msg::MapData &mapDataMsg, bool currentMapKFOnly, bool includeMapPoints = false, std::vector<int> kFIDforMapPoints = std::vector<int>());
+        bool correctTrackedPose(Sophus::SE3f &s);
 
-        void correctTrackedPose(Sophus::SE3f &s);
+        /**
+         * @brief Pose of the robot base in the global frame at the last tracked frame.
+         * @note Any thread, the pose is copied out in one step.
+         */
+        Eigen::Affine3d getLatestTrackedPose() const
+        {
+            std::lock_guard<std::mutex> lock(trackedPoseMutex_);
+            return latestTrackedPose_;
+        }
+
+        /**
+         * @brief Intrinsics of the first camera from its calibration, image bounds from Camera.width / Camera.height of the settings.
+         * @return False if there is no camera or it is not a pinhole camera.
+         */
+        bool getPinholeFrustum(PinholeFrustum &frustum) const;
 
         void getDirectMapToRobotTF(std_msgs::msg::Header headerToUse, geometry_msgs::msg::TransformStamped &tf);
 
         void getMapToOdomTF(const nav_msgs::msg::Odometry::SharedPtr msgOdom, geometry_msgs::msg::TransformStamped &tf);
 
-        void getOptimizedPoseGraph(slam_msgs::msg::MapGraph &graph, bool currentMapGraph);
+        /**
+         * @param robotFrame Poses in the robot frame, the global frame before the fleet reference correction (see setFleetReference).
+         * @note Overwrites the graph in place, see mapDataToMsg.
+         */
+        void getOptimizedPoseGraph(slam_msgs::msg::MapGraph &graph, bool currentMapGraph, bool robotFrame = false);
+
+        /**
+         * @brief What the fleet map server needs of a keyframe for place recognition and alignment.
+         */
+        struct KeyFrameDescriptors
+        {
+            int32_t id = -1;
+            // pose in the robot frame.
+            Eigen::Affine3d pose = Eigen::Affine3d::Identity();
+            std::vector<uint32_t> wordIds;
+            std::vector<float> wordWeights;
+            // map points in the keyframe frame packed as x, y, z, with the 32 byte descriptor of the keypoint observing each.
+            std::vector<float> points;
+            std::vector<uint8_t> descriptors;
+        };
+
+        /**
+         * @brief Bag of words, descriptors and map points of a keyframe.
+         * @param maxPoints The map points with the most observations are kept (0 for all).
+         * @note Also answers for the keyframes in the output cache, they are read from ORB_SLAM3.
+         * @return False if the keyframe is unknown or bad.
+         */
+        bool getKeyFrameDescriptors(long unsigned int kfId, size_t maxPoints, KeyFrameDescriptors &descriptors);
+
+        /**
+         * @brief Places the robot frame (the static robot_x / robot_y offset) in the fleet frame.
+         * @note Pushed by the fleet map server. Applied by the next calculateReferencePoses, safe to call from any thread.
+         */
+        void setFleetReference(const Eigen::Affine3d &reference);
+
+        /**
+         * @brief A page of the keyframes of the Atlas in id order, with their map points packed as x, y, z.
+         */
+        struct MapPage
+        {
+            uint32_t totalKeyFrames = 0;
+            uint64_t nextCursor = 0;
+            bool done = true;
+            std::vector<int32_t> ids;
+            std::vector<geometry_msgs::msg::PoseStamped> poses;
+            // number of points of each keyframe of the page, empty without points.
+            std::vector<uint32_t> pointCounts;
+            std::vector<float> points;
+        };
+
+        /**
+         * @brief Fills a page with the keyframes of id cursor and above, at most maxKeyFrames (0 for all) of them.
+         * @param maxPoints The page ends before the keyframe whose points would exceed it (0 for no limit).
+         * A page holds at least one keyframe.
+         * @note Keyframe ids only grow, so a cursor stays valid while the Atlas changes: the pages together
+         * hold every keyframe that existed during the whole walk. The cursor is found by binary search in the
+         * id-sorted keyframes of the snapshot, so a page costs O(log n + page size) whatever the map size.
+         */
+        void getMapPage(uint64_t cursor, size_t maxKeyFrames, bool includePoints, size_t maxPoints, MapPage &page);
 
+        /**
+         * @brief Builds the cloud of all the map points of the Atlas in the global frame.
+         * @note Each map point is emitted once. The reference poses are snapshotted once per call
+         * and the points are transformed in parallel chunks straight into the cloud buffer.
+         */
         void getCurrentMapPoints(sensor_msgs::msg::PointCloud2 &mapPointCloud);
 
         void mapPointsVisibleFromPose(geometry_msgs::msg::Pose cameraPose, std::vector<ORB_SLAM3::MapPoint*>& points, int maxLandmarks, float maxDistance, float maxAngle);
 
+        /**
+         * @brief Map points of the current map visible from the pose of the first camera (ORB coordinates).
+         */
         void mapPointsVisibleFromPose(Sophus::SE3f& cameraPose, std::vector<ORB_SLAM3::MapPoint*>& points, int maxLandmarks, float maxDistance, float maxAngle);
 
+        /**
+         * @brief The map points visible from each of a batch of poses, deduplicated into one table.
+         */
+        struct LandmarksInView
+        {
+            // points in the global frame packed as x, y, z, each once.
+            std::vector<float> points;
+            // number of indices of each pose.
+            std::vector<uint32_t> indexCounts;
+            // indices in points of the visible points of each pose, one pose after the other.
+            std::vector<uint32_t> indices;
+        };
+
+        /**
+         * @brief Visibility of the map points of the current map from several poses of a camera of the calibration.
+         * @param cameraPoses Poses of the camera in the global frame.
+         * @param maxLandmarks Visible points kept per pose (0 for all).
+         * @note The candidate map points of all the poses are snapshotted once, then the poses are evaluated in
+         * parallel against that snapshot. Image bounds are the Camera.width / Camera.height of the settings.
+         * @return False with a message if the camera or the map do not exist.
+         */
+        bool landmarksInViewBatch(const std::vector<Eigen::Affine3d> &cameraPoses, size_t cameraIndex, size_t maxLandmarks,
+                                  float maxDistance, float maxAngle, LandmarksInView &landmarks, std::string &message);
+
+        /**
+         * @brief Takes a structure-of-arrays snapshot of the map points for the batched visibility kernel.
+         * @param snapshotMapPoints The map points backing each row of the snapshot. Bad map points are skipped.
+         */
+        void snapshotMapPointsForVisibility(const std::vector<ORB_SLAM3::MapPoint *> &mapPoints,
+                                            MapPointSoA &snapshot,
+                                            std::vector<ORB_SLAM3::MapPoint *> &snapshotMapPoints);
+
+        /**
+         * @brief Queues an IMU sample for the inertial track functions. Call from a single thread.
+         * @note Never allocates or locks, the samples go to a preallocated ring.
+         */
         void handleIMU(const sensor_msgs::msg::Imu::SharedPtr msgIMU);
 
-        bool trackRGBDi(const sensor_msgs::msg::Image::SharedPtr msgRGB, const sensor_msgs::msg::Image::SharedPtr msgD, Sophus::SE3f &Tcw);
+        /**
+         * @brief Track functions, call them from a single thread.
+         * The inertial variants (suffix i) track with the IMU samples up to the frame stamp
+         * and return false without consuming them while the IMU does not cover the frame yet.
+         * @param prepared Gray images of the frame from a FeatureBackend, null to hand the images to ORB_SLAM3 as they are.
+         * @return True if the frame was tracked.
+         */
+        bool trackRGBDi(const sensor_msgs::msg::Image::ConstSharedPtr msgRGB, const sensor_msgs::msg::Image::ConstSharedPtr msgD, Sophus::SE3f &Tcw,
+                        const std::shared_ptr<PreparedFrame> &prepared = nullptr);
+
+        bool trackRGBD(const sensor_msgs::msg::Image::ConstSharedPtr msgRGB, const sensor_msgs::msg::Image::ConstSharedPtr msgD, Sophus::SE3f &Tcw,
+                        const std::shared_ptr<PreparedFrame> &prepared = nullptr);
+
+        bool trackStereo(const sensor_msgs::msg::Image::ConstSharedPtr msgLeft, const sensor_msgs::msg::Image::ConstSharedPtr msgRight, Sophus::SE3f &Tcw,
+                        const std::shared_ptr<PreparedFrame> &prepared = nullptr);
+
+        bool trackStereoi(const sensor_msgs::msg::Image::ConstSharedPtr msgLeft, const sensor_msgs::msg::Image::ConstSharedPtr msgRight, Sophus::SE3f &Tcw,
+                        const std::shared_ptr<PreparedFrame> &prepared = nullptr);
+
+        bool trackMonocular(const sensor_msgs::msg::Image::ConstSharedPtr msgImage, Sophus::SE3f &Tcw,
+                        const std::shared_ptr<PreparedFrame> &prepared = nullptr);
+
+        bool trackMonoculari(const sensor_msgs::msg::Image::ConstSharedPtr msgImage, Sophus::SE3f &Tcw,
+                        const std::shared_ptr<PreparedFrame> &prepared = nullptr);
+
+        /**
+         * @brief Counters of the image ingestion path.
+         * @note Shared bytes reach ORB_SLAM3::System::TrackRGBD straight from the message buffer,
+         * copied bytes had to be converted by cv_bridge first.
+         */
+        struct IngestionStats
+        {
+            uint64_t frames = 0;
+            uint64_t bytesShared = 0;
+            uint64_t bytesCopied = 0;
+        };
 
-        bool trackRGBD(const sensor_msgs::msg::Image::SharedPtr msgRGB, const sensor_msgs::msg::Image::SharedPtr msgD, Sophus::SE3f &Tcw);
+        IngestionStats getIngestionStats();
+
+        /**
+         * @brief Map points matched in the last tracked frame, 0 if it was not tracked.
+         */
+        int getTrackedMapPoints() const
+        {
+            return trackedMapPoints_;
+        }
+
+        /**
+         * @brief Hint of where the camera is, in the global frame (the same pose as the tracked one), to relocalize after
+         * tracking is lost.
+         * @param radius The keyframes of the Atlas within this distance (m) of the hint are the relocalization candidates.
+         * @param maxAge The hint is dropped if tracking is not lost within this time (s).
+         * @note Safe to call from any thread, taken by the tracking thread on the next lost frame. ORB_SLAM3 is only
+         * restricted to the candidates with ORB_SLAM3_HAS_RELOCALIZATION_CANDIDATES. Either way the wrapper rejects a
+         * relocalization in the known maps further than the radius from the hint, for maxAge after the loss
+         * (see rejectRelocalization).
+         */
+        void setPoseHint(const Eigen::Affine3d &pose, float radius, double maxAge);
+
+        /**
+         * @brief What is published while ORB_SLAM3 merges maps, PAUSE by default.
+         * @param blendWindow Time (s) to blend the correction in with MergeHandling::BLEND.
+         * @note Call once, before tracking starts. Only the tracked pose is held and blended, the map data
+         * switches to the merged map as soon as the merge is done.
+         */
+        void setMergeHandling(MergeHandling handling, double blendWindow);
+
+        /**
+         * @brief CPU sets of the ORB_SLAM3 threads, an empty set leaves the thread as it is.
+         */
+        struct ThreadLayout
+        {
+            std::vector<int> localMapping;
+            std::vector<int> loopClosing;
+            std::vector<int> viewer;
+        };
+
+        /**
+         * @brief Pins the local mapping, loop closing and viewer threads of ORB_SLAM3.
+         * @note ORB_SLAM3 does not expose its threads. They are the threads started by the construction of
+         * ORB_SLAM3::System, in the order it starts them: local mapping, loop closing, then the viewer. The global
+         * bundle adjustment threads the loop closing starts later inherit its set.
+         * @return False if a thread was not found or could not be pinned, with the reason in message.
+         */
+        bool applyThreadLayout(const ThreadLayout &layout, std::string &message);
+
+        /**
+         * @brief Name and thread id of the ORB_SLAM3 threads found at construction, empty if they were not found.
+         */
+        const std::vector<std::pair<std::string, int>> &orbThreads() const
+        {
+            return orbThreads_;
+        }
+
+        /**
+         * @brief Pool of getCurrentMapPoints and landmarksInViewBatch.
+         * @note Without one the queries use WorkerPool::shared with a thread per core.
+         */
+        void setWorkerPool(std::shared_ptr<WorkerPool> pool);
 
         std::shared_ptr<WrapperTypeConversions> getTypeConversionPtr()
         {
             return typeConversions_;
         };
 
+        /**
+         * @brief Registry of the latency histograms and gauges of the wrapper. Shared with the node.
+         */
+        std::shared_ptr<MetricsRegistry> getMetrics()
+        {
+            return metrics_;
+        };
+
+        /**
+         * @brief Refreshes the map, keyframe and map point count gauges.
+         */
+        void updateMapMetrics();
+
+        /**
+         * @brief Saves the Atlas to a chunked zstd map archive (see CompressedChunkWriter).
+         * @note The Atlas is serialized to memory with the track calls and the map updates held off, then
+         * compressed and written with the system live again. The SLAM mode is not changed. The archive
+         * decompresses to the ORB_SLAM3 .osa format (vocabulary name and checksum, then the Atlas).
+         * Call from a thread other than the tracking one.
+         */
+        bool saveMap(const std::string &path, std::string &message, uint64_t &rawBytes, uint64_t &compressedBytes);
+
+        /**
+         * @brief Keyframes and map points the output reads live from ORB_SLAM3, the others come from the
+         * output cache. 0 for no limit.
+         */
+        struct OutputCacheLimits
+        {
+            size_t keyFrames = 0;
+            size_t mapPoints = 0;
+            // file of the MappedKeyFrameStore, removed with the interface.
+            std::string storePath;
+        };
+
+        /**
+         * @brief Enables the output-side keyframe cache if any limit is set.
+         * @note Only the keyframes of the current map nearest to the camera are read live, the others are
+         * copied to a MappedKeyFrameStore and the map data, the cloud and the services read them from there
+         * instead of locking every ORB_SLAM3 keyframe and map point ever created. It bounds the work of the
+         * output, not the memory: ORB_SLAM3 keeps every keyframe in the Atlas and the keyframe database for
+         * relocalization and loop closing. Call once, before tracking starts.
+         */
+        bool setOutputCache(const OutputCacheLimits &limits);
+
+        /**
+         * @brief Pages keyframes in and out of the output cache around the last tracked camera position.
+         * @note Cached keyframes are paged back in when they come within the limits again and after a
+         * relocalization. Their stored poses go stale when ORB_SLAM3 moves them: every cached keyframe of
+         * a map corrected by a loop closure or a merge is refreshed, and after a local bundle adjustment
+         * the ones covisible with the live keyframes, which is as far as the local window reaches.
+         * @return True if any keyframe was paged in or out.
+         */
+        bool updateResidency();
+
+        /**
+         * @brief Queues the changes of the Atlas found by calculateReferencePoses: keyframes inserted and culled,
+         * maps created, merged and reset, loop closures and bundle adjustments.
+         * @param notifier Called on the tracking thread after each batch of events, it must not block.
+         * @note Call once, before tracking starts. A keyframe moved to another map by a merge is reported
+         * by the merge only. A loop closure event is also raised by the global bundle adjustment that follows it.
+         */
+        void enableMapEvents(size_t capacity, std::function<void()> notifier);
+
+        /**
+         * @return Null unless enableMapEvents was called. Pop the events from a single consumer thread.
+         */
+        MapEventQueue *mapEvents()
+        {
+            return mapEvents_.get();
+        }
+
+        /**
+         * @brief Incremented whenever a keyframe, a map or a reference pose changes.
+         */
+        uint64_t mapVersion() const
+        {
+            return currentSnapshot()->version;
+        }
+
     private:
+        typedef std::unordered_map<long unsigned int, ORB_SLAM3::KeyFrame *> KeyFrameTable;
+        typedef std::vector<std::pair<long unsigned int, ORB_SLAM3::KeyFrame *>> KeyFramesById;
+
+        /**
+         * @brief Immutable version of the keyframe table and of the map reference poses.
+         * @note The tracking thread owns the working copies (allKFs_, mapReferencePoses_) and publishes a new
+         * snapshot with an atomic shared_ptr swap whenever calculateReferencePoses changes something. Readers take
+         * one with currentSnapshot() and see a consistent table without any lock. A version that only moves the
+         * reference poses shares the keyframe table of the previous one.
+         */
+        struct MapSnapshot
+        {
+            uint64_t version = 0;
+            std::unordered_map<ORB_SLAM3::Map *, Eigen::Affine3d> referencePoses;
+            // robot frame to global frame, part of every reference pose.
+            Eigen::Affine3d fleetReference = Eigen::Affine3d::Identity();
+            std::shared_ptr<const KeyFrameTable> keyFrames = std::make_shared<KeyFrameTable>();
+            // the same keyframes sorted by id, for the map pages.
+            std::shared_ptr<const KeyFramesById> keyFramesById = std::make_shared<KeyFramesById>();
+
+            /**
+             * @brief Identity for a map without a reference pose yet.
+             */
+            Eigen::Affine3d referencePose(ORB_SLAM3::Map *pMap) const
+            {
+                auto it = referencePoses.find(pMap);
+                return it == referencePoses.end() ? Eigen::Affine3d::Identity() : it->second;
+            }
+        };
+
+        std::shared_ptr<const MapSnapshot> currentSnapshot() const
+        {
+            return std::atomic_load(&mapSnapshot_);
+        }
+
+        /**
+         * @brief Keyframes added to / removed from a map since the last update.
+         */
+        struct KeyFrameDelta
+        {
+            std::vector<ORB_SLAM3::KeyFrame *> added;
+            std::vector<ORB_SLAM3::KeyFrame *> removed;
+        };
+
+        MapSignature makeMapSignature(ORB_SLAM3::Map *pMap);
+
+        /**
+         * @brief Publishes the tracked pose to the other threads.
+         * @note Tracking thread, the only writer, so it reads latestTrackedPose_ without the lock.
+         */
+        void setLatestTrackedPose(const Eigen::Affine3d &pose)
+        {
+            std::lock_guard<std::mutex> lock(trackedPoseMutex_);
+            latestTrackedPose_ = pose;
+        }
+
+        /**
+         * @brief Applies the keyframe delta of the given maps to allKFs_.
+         * @param changedMaps Maps whose keyframe set changed since the last update.
+         * @param removedMaps Maps that are no longer in the Atlas (merged or reset).
+         * @param deltas Filled with the keyframes added / removed per map.
+         */
+        void updateKFTable(const std::vector<ORB_SLAM3::Map *> &changedMaps,
+                           const std::vector<ORB_SLAM3::Map *> &removedMaps,
+                           std::unordered_map<ORB_SLAM3::Map *, KeyFrameDelta> &deltas);
+
+        /**
+         * @brief Applies the keyframe deltas to the spatial index.
+         * @param correctedMaps Maps whose keyframes were all moved (loop closure, merge). They are re-indexed lazily.
+         */
+        void updateSpatialIndex(const std::unordered_map<ORB_SLAM3::Map *, KeyFrameDelta> &deltas,
+                                const std::vector<ORB_SLAM3::Map *> &correctedMaps,
+                                const std::vector<ORB_SLAM3::Map *> &removedMaps);
+
+        /**
+         * @brief Queues the events of one update, see enableMapEvents. Call before mapSignatures_ is replaced.
+         * @param optimizedMaps Maps moved by a local bundle adjustment only.
+         */
+        void pushMapEvents(const std::vector<ORB_SLAM3::Map *> &createdMaps,
+                           const std::vector<ORB_SLAM3::Map *> &correctedMaps,
+                           const std::vector<ORB_SLAM3::Map *> &optimizedMaps,
+                           const std::vector<ORB_SLAM3::Map *> &removedMaps,
+                           const std::unordered_map<ORB_SLAM3::Map *, KeyFrameDelta> &deltas);
+
+        std::unique_ptr<MapEventQueue> mapEvents_;
+
+        /**
+         * @brief Returns candidate keyframes of the map whose camera center is near the position (ORB coordinates).
+         * @note The candidates are padded by one voxel to absorb the drift of local BA, filter by exact distance afterwards.
+         */
+        void keyFramesNearPosition(ORB_SLAM3::Map *pMap, const Eigen::Vector3f &position, float radius,
+                                   std::vector<ORB_SLAM3::KeyFrame *> &keyFrames);
+
+        /**
+         * @brief Snapshot of map points shared by the poses of a visibility query, each map point once.
+         */
+        struct LandmarkCandidates
+        {
+            MapPointSoA snapshot;
+            std::vector<ORB_SLAM3::MapPoint *> mapPoints;
+            // row of each map point in the snapshot.
+            std::unordered_map<ORB_SLAM3::MapPoint *, uint32_t> rows;
+        };
+
+        /**
+         * @brief The pool set with setWorkerPool, or the shared one.
+         */
+        std::shared_ptr<WorkerPool> workerPool();
+
+        /**
+         * @brief Intrinsics of a camera of the calibration with the image bounds of the settings.
+         * @return False if there is no such camera.
+         */
+        bool cameraFrustum(size_t cameraIndex, ORB_SLAM3::GeometricCamera *&camera, PinholeFrustum &frustum) const;
+
+        /**
+         * @brief Adds to the shared snapshot the map points of the keyframes near the pose and looking the same way.
+         * @param candidates Rows of the snapshot to test for the pose, in keyframe id order.
+         * @return Number of keyframes kept.
+         */
+        size_t gatherLandmarkCandidates(ORB_SLAM3::Map *pMap, const Sophus::SE3f &Tcw, float maxDistance, float maxAngle,
+                                        LandmarkCandidates &shared, std::vector<uint32_t> &candidates);
+
+        /**
+         * @brief The candidate rows visible from the pose, at most maxLandmarks of them.
+         * @note Only reads the snapshot, safe to run for several poses at once with their own scratch and flags.
+         */
+        void visibleCandidates(const MapPointSoA &snapshot, const std::vector<uint32_t> &candidates,
+                               ORB_SLAM3::GeometricCamera *camera, const PinholeFrustum &frustum,
+                               const Sophus::SE3f &Tcw, size_t maxLandmarks, MapPointSoA &scratch,
+                               std::vector<uint8_t> &flags, std::vector<uint32_t> &visible) const;
+
+        void accountIngestion(const sensor_msgs::msg::Image &msg, const cv::Mat &image);
+
+        /**
+         * @brief Shares the image buffers as cv::Mat and accounts for the ingestion.
+         * @param msgSecond May be null (monocular).
+         */
+        bool shareImages(const sensor_msgs::msg::Image::ConstSharedPtr &msgFirst, const char *firstName,
+                         const sensor_msgs::msg::Image::ConstSharedPtr &msgSecond, const char *secondName,
+                         cv_bridge::CvImageConstPtr &cvFirst, cv_bridge::CvImageConstPtr &cvSecond);
+
+        /**
+         * @brief Waits for the prepared frame and swaps its gray images in.
+         * @param second Unused for the monocular sensors.
+         */
+        void takePreparedImages(const std::shared_ptr<PreparedFrame> &prepared, cv::Mat &first, cv::Mat &second);
+
+        /**
+         * @brief Fills vImuMeas_ with the queued IMU samples up to the frame stamp.
+         * @return False if the IMU does not cover the frame yet.
+         */
+        bool takeImuMeasurements(int64_t frameStampNs);
+
+        /**
+         * @brief Common handling of the tracking state after a track call.
+         */
+        bool processTrackingResult(Sophus::SE3f &Tcw);
+
+        /**
+         * @brief Tracking thread, hands the pending pose hint to the relocalization.
+         */
+        void applyPoseHint();
+
+        /**
+         * @brief Tracking thread, first tracked frame after a lost one. Records the recovery and checks the hint.
+         */
+        void finishLostEpisode();
+
+        /**
+         * @brief Tracking thread, a tracked frame of a lost episode. True if the pose is too far from the applied hint
+         * to be published: the frame counts as lost until ORB_SLAM3 tracks within the radius (after a loop closure
+         * or a merge), starts a new map, or the hint expires.
+         */
+        bool rejectRelocalization(const Sophus::SE3f &Tcw);
+
+        /**
+         * @brief Poses of the keyframes in the global frame, from the store for the evicted ones.
+         * @param robotFrame Poses in the robot frame instead, without the fleet reference.
+         */
+        void keyFrameWorldPoses(const std::vector<ORB_SLAM3::KeyFrame *> &keyFrames, std::vector<Eigen::Affine3d> &worldPoses,
+                                bool robotFrame = false);
+
+        /**
+         * @brief Appends the map points (global frame) observed by the keyframe.
+         * @return False if the keyframe is unknown.
+         */
+        bool keyFrameMapPoints(long unsigned int kfId, std::vector<Eigen::Vector3f> &points);
+
+        /**
+         * @brief Copies the keyframe and its map points to the output cache. Call with residencyMutex_ held.
+         */
+        bool evictKeyFrame(ORB_SLAM3::KeyFrame *pKF);
+
+        /**
+         * @brief getCurrentMapPoints with the output cache, live map points from ORB_SLAM3 and the others from the store.
+         */
+        void getCachedMapPoints(sensor_msgs::msg::PointCloud2 &mapPointCloud, const MapSnapshot &snapshot);
+
+        /**
+         * @brief Counts the systems of the process, the constructor throws if one is alive and supportsMultipleSystems is false.
+         */
+        class SystemSlot
+        {
+        public:
+            SystemSlot();
+            ~SystemSlot();
+
+            SystemSlot(const SystemSlot &) = delete;
+            SystemSlot &operator=(const SystemSlot &) = delete;
+
+        private:
+            static std::atomic<int> systems_;
+        };
+
+        // declared before mSLAM_, it is released once the system is gone and also if the system throws.
+        SystemSlot systemSlot_;
+#ifdef ORB_SLAM3_HAS_SHARED_VOCABULARY
+        // declared before mSLAM_ so that it outlives the system.
+        std::shared_ptr<ORB_SLAM3::ORBVocabulary> vocabulary_;
+#endif
         std::shared_ptr<ORB_SLAM3::System> mSLAM_;
         std::shared_ptr<WrapperTypeConversions> typeConversions_;
+        std::shared_ptr<MetricsRegistry> metrics_;
+        LatencyHistogram *cvBridgeLatency_;
+        LatencyHistogram *preparedFrameLatency_;
+        LatencyHistogram *trackLatency_;
+        LatencyHistogram *referencePosesLatency_;
+        LatencyHistogram *mapDataToMsgLatency_;
+        LatencyHistogram *mapPointsCloudLatency_;
+        LatencyHistogram *visibleMapPointsLatency_;
+        LatencyHistogram *visibleMapPointsBatchLatency_;
+        LatencyHistogram *residencyLatency_;
+        LatencyHistogram *mapPageLatency_;
+        LatencyHistogram *recoveryLatency_;
+        LatencyHistogram *mergeLatency_;
         ORB_SLAM3::Atlas *orbAtlas_;
         std::string strVocFile_;
         std::string strSettingsFile_;
+        // image size read from the settings, 640 x 480 if they do not have it.
+        float imageWidth_ = 640.0f;
+        float imageHeight_ = 480.0f;
         ORB_SLAM3::System::eSensor sensor_;
         bool bUseViewer_;
         bool rosViz_;
 
-        queue<sensor_msgs::msg::Imu::SharedPtr> imuBuf_;
-        std::mutex bufMutex_;
+        ImuRingBuffer imuBuffer_;
+        // scratch buffers of the tracking thread.
+        std::vector<ImuSample> imuWindow_;
+        std::vector<ORB_SLAM3::IMU::Point> vImuMeas_;
+        std::atomic<uint64_t> framesWithoutImu_{0};
+        std::mutex mapPersistenceMutex_;
+        // held by every track call, a map save takes it for its snapshot.
+        std::mutex trackCallMutex_;
         std::mutex mapDataMutex_;
         std::mutex currentMapPointsMutex_;
 
+        // working copies of the tracking thread, every other thread reads mapSnapshot_.
         std::unordered_map<ORB_SLAM3::Map *, Eigen::Affine3d> mapReferencePoses_;
-        std::mutex mapReferencesMutex_;
-        std::unordered_map<long unsigned int, ORB_SLAM3::KeyFrame *> allKFs_;
-        Eigen::Affine3d latestTrackedPose_;
-        bool hasTracked_ = false;
+        KeyFrameTable allKFs_;
+        std::shared_ptr<const MapSnapshot> mapSnapshot_;
+        std::unordered_map<ORB_SLAM3::Map *, std::vector<long unsigned int>> mapKFIds_;
+        std::unordered_map<ORB_SLAM3::Map *, MapSignature> mapSignatures_;
+        // spatial index over the keyframe camera centers of every map.
+        std::unordered_map<ORB_SLAM3::Map *, VoxelHashIndex<ORB_SLAM3::KeyFrame *>> keyFrameIndex_;
+        std::unordered_set<ORB_SLAM3::Map *> dirtyIndexMaps_;
+        std::mutex spatialIndexMutex_;
+        float spatialIndexVoxelSize_ = 1.0f;
+        // output-side keyframe cache, see setOutputCache.
+        OutputCacheLimits outputCacheLimits_;
+        std::atomic<bool> outputCache_{false};
+        std::unique_ptr<MappedKeyFrameStore> keyFrameStore_;
+        // map of each evicted keyframe.
+        std::unordered_map<long unsigned int, ORB_SLAM3::Map *> evictedKFs_;
+        // maps corrected or removed since the last residency update, their cached keyframes are stale.
+        std::unordered_set<ORB_SLAM3::Map *> staleStoreMaps_;
+        // maps locally optimized since the last residency update, see updateResidency.
+        std::unordered_set<ORB_SLAM3::Map *> optimizedStoreMaps_;
+        std::vector<StoredMapPoint> evictionPoints_;
+        size_t residentMapPoints_ = 0;
+        uint64_t keyFramesPagedIn_ = 0;
+        uint64_t keyFramesPagedOut_ = 0;
+        Eigen::Vector3f residencyCenter_ = Eigen::Vector3f::Zero();
+        ORB_SLAM3::Map *residencyMap_ = nullptr;
+        uint64_t residencySnapshotVersion_ = 0;
+        std::mutex residencyMutex_;
+        // camera center of the last tracked frame (ORB coordinates), for the residency update.
+        Eigen::Vector3f latestCameraCenter_ = Eigen::Vector3f::Zero();
+        std::mutex trackedCameraMutex_;
+        int lastTrackingState_ = 0;
+        // lost episode, from the first lost frame to the next tracked one (tracking thread).
+        bool lostEpisode_ = false;
+        std::chrono::steady_clock::time_point lostSince_;
+        std::atomic<int64_t> lostSinceNs_{0};
+        size_t mapsWhenLost_ = 0;
+        // pose hint, set by setPoseHint and taken by the tracking thread.
+        std::mutex poseHintMutex_;
+        bool hasPoseHint_ = false;
+        Eigen::Vector3d poseHintPosition_ = Eigen::Vector3d::Zero();
+        float poseHintRadius_ = 0.0f;
+        std::chrono::steady_clock::duration poseHintMaxAge_{};
+        std::chrono::steady_clock::time_point poseHintExpiry_;
+        // the hint handed to the relocalization of the current lost episode.
+        bool hintApplied_ = false;
+        Eigen::Vector3d appliedHintPosition_ = Eigen::Vector3d::Zero();
+        float appliedHintRadius_ = 0.0f;
+        std::chrono::steady_clock::time_point appliedHintExpiry_;
+        bool rejectingRelocalization_ = false;
+        std::atomic<uint64_t> relocalizations_{0};
+        std::atomic<uint64_t> hintedRelocalizations_{0};
+        std::atomic<uint64_t> hintMismatches_{0};
+        std::atomic<uint64_t> hintRejections_{0};
+        std::atomic<uint64_t> mapsCreatedWhileLost_{0};
+        std::atomic<size_t> hintCandidates_{0};
+        std::atomic<bool> relocalized_{false};
+        // local mapping, loop closing and viewer, see applyThreadLayout.
+        std::vector<std::pair<std::string, int>> orbThreads_;
+        // parallel map queries, see setWorkerPool.
+        std::shared_ptr<WorkerPool> workerPool_;
+        // map merge, from the first frame that saw it to the first one after it (tracking thread).
+        MergeHandling mergeHandling_ = MergeHandling::PAUSE;
+        double mergeBlendWindow_ = 0.0;
+        bool merging_ = false;
+        std::chrono::steady_clock::time_point mergeStart_;
+        // reference pose of the current map when the merge started, the tracked pose stays in it during the merge.
+        Eigen::Affine3d mergeReference_ = Eigen::Affine3d::Identity();
+        bool hasMergeReference_ = false;
+        // the correction is measured by the next tracked frame.
+        bool mergeCorrectionPending_ = false;
+        MergeCorrection mergeCorrection_;
+        std::atomic<bool> mergeInProgress_{false};
+        std::atomic<uint64_t> mapMerges_{0};
+        std::atomic<uint64_t> referencePosesRecomputed_{0};
+        std::atomic<double> mergeTranslation_{0.0};
+        std::atomic<double> mergeRotation_{0.0};
+        std::atomic<int> trackedMapPoints_{0};
+        std::atomic<uint64_t> ingestedFrames_{0};
+        std::atomic<uint64_t> ingestedBytesShared_{0};
+        std::atomic<uint64_t> ingestedBytesCopied_{0};
+        // written by the tracking thread, read by the odometry callback and the timers.
+        Eigen::Affine3d latestTrackedPose_ = Eigen::Affine3d::Identity();
+        mutable std::mutex trackedPoseMutex_;
+        std::atomic<bool> hasTracked_{false};
         double robotX_, robotY_;
+        // set by the fleet map server, see setFleetReference.
+        Eigen::Affine3d fleetReference_ = Eigen::Affine3d::Identity();
+        std::atomic<bool> fleetReferenceChanged_{false};
+        std::mutex fleetReferenceMutex_;
         std::string globalFrame_;
         std::string odomFrame_;
         std::string robotFrame_;
@@ -0,0 +1,121 @@
+/**
+ * @file overload_controller.hpp
+ * @brief Adapts the tracked frame rate to the tracking latency and the motion of the robot.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#ifndef ORB_WRAPPER_OVERLOAD_CONTROLLER_HPP_
+#define ORB_WRAPPER_OVERLOAD_CONTROLLER_HPP_
+
+#include <mutex>
+
+namespace ORB_SLAM3_Wrapper
+{
+    struct OverloadControllerConfig
+    {
+        // frames are skipped when the track latency exceeds this fraction of the tracked frame period...
+        double maxUtilization = 0.9;
+        // ...and tracked at a higher rate again once it would stay below this fraction.
+        double restoreUtilization = 0.7;
+        int maxFrameSkip = 3;
+        // the robot is moving slowly below both speeds (m/s, rad/s).
+        double slowLinearSpeed = 0.2;
+        double slowAngularSpeed = 0.3;
+        // fewer tracked map points than this restores the full rate.
+        int minTrackedMapPoints = 100;
+        // a motion sample older than this (s) is not used.
+        double motionTimeout = 0.5;
+        // weight of a new sample in the moving averages of the latency and the camera period.
+        double smoothing = 0.1;
+        // tracked frames between two changes of the frame skip, so each change is measured before the next one.
+        int holdFrames = 15;
+    };
+
+    /**
+     * @brief Decides how many camera frames to skip per tracked frame.
+     * @note Frames are only skipped while the robot is known to move slowly, so that consecutive tracked
+     * frames still overlap. Fast motion, a missing motion estimate or a drop of the tracking quality
+     * restore the full rate at once. Thread safe.
+     */
+    class OverloadController
+    {
+    public:
+        enum class Decision
+        {
+            FULL_RATE,
+            SKIPPING,
+            FAST_MOTION,
+            NO_MOTION_ESTIMATE,
+            TRACKING_QUALITY
+        };
+
+        explicit OverloadController(const OverloadControllerConfig &config = OverloadControllerConfig());
+
+        /**
+         * @brief Call for every received frame, before it is queued or tracked.
+         * @param stamp Stamp of the frame (s), measures the camera period.
+         * @return False if the frame should be skipped.
+         */
+        bool admitFrame(double stamp);
+
+        /**
+         * @brief Call after every track call.
+         * @param latency Duration of the track call (s).
+         * @param now Steady time (s), the same clock as for the motion samples.
+         */
+        void recordTrack(double latency, bool tracked, int trackedMapPoints, double now);
+
+        /**
+         * @brief Speeds from the odometry.
+         */
+        void recordOdometry(double linearSpeed, double angularSpeed, double now);
+
+        /**
+         * @brief Angular speed from the gyroscope.
+         */
+        void recordAngularRate(double angularSpeed, double now);
+
+        Decision decision() const;
+
+        static const char *decisionName(Decision decision);
+
+        /**
+         * @brief Camera frames skipped per tracked frame.
+         */
+        int frameSkip() const;
+
+        /**
+         * @brief 1 - track latency / tracked frame period. Negative when the tracker falls behind.
+         */
+        double headroom() const;
+
+        /**
+         * @brief Smoothed camera frame period (s), 0 until two frames were received.
+         */
+        double cameraPeriod() const;
+
+        double trackLatency() const;
+
+    private:
+        bool isSlow(double now, bool &motionKnown) const;
+
+        OverloadControllerConfig config_;
+        mutable std::mutex mutex_;
+        double cameraPeriod_ = 0.0;
+        double lastFrameStamp_ = 0.0;
+        bool hasFrameStamp_ = false;
+        double trackLatency_ = 0.0;
+        bool hasTrackLatency_ = false;
+        int frameSkip_ = 0;
+        int framesSinceTracked_ = 0;
+        int framesSinceChange_ = 0;
+        Decision decision_ = Decision::FULL_RATE;
+        double linearSpeed_ = 0.0;
+        double odometryAngularSpeed_ = 0.0;
+        double odometryStamp_ = -1.0;
+        double gyroAngularSpeed_ = 0.0;
+        double gyroStamp_ = -1.0;
+    };
+}
+
+#endif
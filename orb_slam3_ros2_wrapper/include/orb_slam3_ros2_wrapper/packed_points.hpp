@@ -0,0 +1,42 @@
+/**
+ * @file packed_points.hpp
+ * @brief Packing of x, y, z points into slam_msgs/PackedPoints, float32 or quantized, optionally zstd compressed.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#ifndef ORB_WRAPPER_PACKED_POINTS_HPP_
+#define ORB_WRAPPER_PACKED_POINTS_HPP_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <slam_msgs/msg/packed_points.hpp>
+
+namespace ORB_SLAM3_Wrapper
+{
+    struct PointPacking
+    {
+        uint8_t encoding = slam_msgs::msg::PackedPoints::ENCODING_FLOAT32;
+        uint8_t compression = slam_msgs::msg::PackedPoints::COMPRESSION_NONE;
+        // quantization step (m) of ENCODING_UINT16, the error is at most half of it.
+        double resolution = 0.001;
+        int compressionLevel = 3;
+    };
+
+    /**
+     * @param xyz count points, x y z one after the other.
+     * @note ENCODING_UINT16 falls back to ENCODING_FLOAT32 (and says so in packed.encoding) when the points span
+     * more than 65535 steps on an axis. The raw buffer is in host order, little endian on every platform ROS 2 runs on.
+     * @return False if the encoding or compression is unknown or the compression failed.
+     */
+    bool packPoints(const float *xyz, size_t count, const PointPacking &packing, slam_msgs::msg::PackedPoints &packed);
+
+    /**
+     * @param xyz Resized to 3 * packed.count and filled with the points.
+     * @return False if the message is malformed, with the reason in message.
+     */
+    bool unpackPoints(const slam_msgs::msg::PackedPoints &packed, std::vector<float> &xyz, std::string &message);
+}
+
+#endif
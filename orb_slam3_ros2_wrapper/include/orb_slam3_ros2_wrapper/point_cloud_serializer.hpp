@@ -0,0 +1,167 @@
+/**
+ * @file point_cloud_serializer.hpp
+ * @brief Writes map points and their optional attributes straight into a PointCloud2 buffer.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#ifndef ORB_WRAPPER_POINT_CLOUD_SERIALIZER_HPP_
+#define ORB_WRAPPER_POINT_CLOUD_SERIALIZER_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include <sensor_msgs/msg/point_cloud2.hpp>
+
+#include "orb_slam3_ros2_wrapper/frame_permutation.hpp"
+
+namespace ORB_SLAM3_Wrapper
+{
+    /**
+     * @brief Optional channels appended after x y z, in this order. Combine with |.
+     */
+    enum MapPointChannel : uint32_t
+    {
+        CHANNEL_XYZ = 0,
+        // uint32, number of keyframes observing the point.
+        CHANNEL_OBSERVATIONS = 1u << 0,
+        // float32, found / visible ratio of the point.
+        CHANNEL_FOUND_RATIO = 1u << 1,
+        // uint32, id of the keyframe that created the point.
+        CHANNEL_KEYFRAME_ID = 1u << 2,
+        // uint32, FNV-1a hash of the point descriptor.
+        CHANNEL_DESCRIPTOR_HASH = 1u << 3
+    };
+
+    /**
+     * @brief Values of the optional channels of one point.
+     */
+    struct MapPointChannelValues
+    {
+        uint32_t observations = 0;
+        float foundRatio = 0.0f;
+        uint32_t keyFrameId = 0;
+        uint32_t descriptorHash = 0;
+    };
+
+    /**
+     * @brief 32 bit FNV-1a hash, used to fingerprint descriptors.
+     */
+    inline uint32_t descriptorHash(const uint8_t *bytes, size_t numBytes)
+    {
+        uint32_t hash = 2166136261u;
+        for (size_t i = 0; i < numBytes; i++)
+        {
+            hash ^= bytes[i];
+            hash *= 16777619u;
+        }
+        return hash;
+    }
+
+    /**
+     * @brief Sets up an unorganized cloud with float32 x y z and the requested channels
+     * and sizes its data buffer for numPoints points.
+     */
+    inline void initMapPointCloud(sensor_msgs::msg::PointCloud2 &cloud, size_t numPoints, uint32_t channels = CHANNEL_XYZ)
+    {
+        struct ChannelField
+        {
+            uint32_t flag;
+            const char *name;
+            uint8_t datatype;
+        };
+        static const ChannelField extraFields[] = {
+            {CHANNEL_OBSERVATIONS, "observations", sensor_msgs::msg::PointField::UINT32},
+            {CHANNEL_FOUND_RATIO, "found_ratio", sensor_msgs::msg::PointField::FLOAT32},
+            {CHANNEL_KEYFRAME_ID, "keyframe_id", sensor_msgs::msg::PointField::UINT32},
+            {CHANNEL_DESCRIPTOR_HASH, "descriptor_hash", sensor_msgs::msg::PointField::UINT32}};
+
+        cloud.header.frame_id = "map";
+        cloud.height = 1;
+        cloud.width = numPoints;
+        cloud.is_bigendian = false;
+        cloud.is_dense = true;
+        cloud.fields.clear();
+        const char *xyz[] = {"x", "y", "z"};
+        uint32_t offset = 0;
+        for (const char *name : xyz)
+        {
+            sensor_msgs::msg::PointField field;
+            field.name = name;
+            field.offset = offset;
+            field.count = 1;
+            field.datatype = sensor_msgs::msg::PointField::FLOAT32;
+            cloud.fields.push_back(field);
+            offset += sizeof(float);
+        }
+        // every channel is 4 bytes wide, so the cloud can be written through a 32 bit pointer.
+        for (const auto &extra : extraFields)
+        {
+            if (!(channels & extra.flag))
+                continue;
+            sensor_msgs::msg::PointField field;
+            field.name = extra.name;
+            field.offset = offset;
+            field.count = 1;
+            field.datatype = extra.datatype;
+            cloud.fields.push_back(field);
+            offset += sizeof(uint32_t);
+        }
+        cloud.point_step = offset;
+        cloud.row_step = cloud.point_step * cloud.width;
+        cloud.data.resize(cloud.row_step * cloud.height);
+    }
+
+    /**
+     * @brief Writes positions[i], permuted by Permutation, as the x y z of point i.
+     * @note The cloud must have been set up by initMapPointCloud for at least numPoints points.
+     * With no extra channels the points are packed back to back and the loop vectorizes.
+     */
+    template <typename Permutation = IdentityPermutation>
+    void writeCloudXYZ(sensor_msgs::msg::PointCloud2 &cloud, const Eigen::Vector3f *positions, size_t numPoints)
+    {
+        float *out = reinterpret_cast<float *>(cloud.data.data());
+        const size_t stride = cloud.point_step / sizeof(float);
+        if (stride == 3)
+        {
+            for (size_t i = 0; i < numPoints; i++)
+                Permutation::apply(positions[i].data(), out + 3 * i);
+            return;
+        }
+        for (size_t i = 0; i < numPoints; i++)
+            Permutation::apply(positions[i].data(), out + stride * i);
+    }
+
+    /**
+     * @brief Writes the requested optional channels of every point, after x y z.
+     * @param channels Must match the channels passed to initMapPointCloud.
+     */
+    inline void writeCloudChannels(sensor_msgs::msg::PointCloud2 &cloud, const MapPointChannelValues *values,
+                                   size_t numPoints, uint32_t channels)
+    {
+        if (channels == CHANNEL_XYZ)
+            return;
+        uint32_t *out = reinterpret_cast<uint32_t *>(cloud.data.data());
+        const size_t stride = cloud.point_step / sizeof(uint32_t);
+        for (size_t i = 0; i < numPoints; i++)
+        {
+            uint32_t *point = out + stride * i + 3;
+            if (channels & CHANNEL_OBSERVATIONS)
+                *point++ = values[i].observations;
+            if (channels & CHANNEL_FOUND_RATIO)
+            {
+                float *ratio = reinterpret_cast<float *>(point++);
+                *ratio = values[i].foundRatio;
+            }
+            if (channels & CHANNEL_KEYFRAME_ID)
+                *point++ = values[i].keyFrameId;
+            if (channels & CHANNEL_DESCRIPTOR_HASH)
+                *point++ = values[i].descriptorHash;
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,138 @@
+/**
+ * @file pose_predictor.hpp
+ * @brief Propagates the last tracked pose with odometry or the gyroscope between camera frames.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#ifndef ORB_WRAPPER_POSE_PREDICTOR_HPP_
+#define ORB_WRAPPER_POSE_PREDICTOR_HPP_
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+
+#include <Eigen/Geometry>
+
+namespace ORB_SLAM3_Wrapper
+{
+    struct PosePredictorConfig
+    {
+        // no pose is predicted further than this (s) past the newest tracked frame or odometry sample.
+        double maxHorizon = 0.5;
+        // odometry and gyroscope samples kept, the oldest are dropped.
+        size_t bufferSize = 512;
+    };
+
+    /**
+     * @brief Difference between the predicted and the tracked pose of a frame.
+     */
+    struct PredictionError
+    {
+        double translation = 0.0; // m
+        double rotation = 0.0;    // rad
+        double horizon = 0.0;     // s since the previous tracked frame
+    };
+
+    struct PredictionStats
+    {
+        uint64_t count = 0;
+        PredictionError last;
+        double rmsTranslation = 0.0;
+        double rmsRotation = 0.0;
+    };
+
+    /**
+     * @brief Predicts the map -> base pose at any stamp from the last tracked frame.
+     * @note With odometry the pose follows the odometry since the tracked frame, interpolated at the stamp of
+     * the frame and extrapolated past the newest sample. Without it a constant velocity is assumed from the last
+     * two tracked frames, the gyroscope replacing the constant rotation rate if there are samples. Stamps are in
+     * seconds of the ROS clock. Thread safe.
+     */
+    class PosePredictor
+    {
+    public:
+        explicit PosePredictor(const PosePredictorConfig &config = PosePredictorConfig());
+
+        /**
+         * @param odomToBase Pose of the base in the odometry frame.
+         */
+        void addOdometry(double stamp, const Eigen::Affine3d &odomToBase);
+
+        /**
+         * @param angularVelocity Angular velocity of the base, in the base frame (rad/s).
+         */
+        void addAngularVelocity(double stamp, const Eigen::Vector3d &angularVelocity);
+
+        /**
+         * @brief Sets the tracked pose of a frame.
+         * @param error Set to the error of the pose predicted for this frame before it was tracked.
+         * @return False if no pose could be predicted for the frame (first frame, beyond the horizon...).
+         */
+        bool correct(double stamp, const Eigen::Affine3d &mapToBase, PredictionError &error);
+
+        /**
+         * @return False before the first tracked frame or beyond the horizon.
+         */
+        bool predict(double stamp, Eigen::Affine3d &mapToBase) const;
+
+        /**
+         * @brief The map -> odom transform at the last tracked frame, the odometry being interpolated at its stamp.
+         * @return False before the first tracked frame with odometry around it.
+         */
+        bool mapToOdom(Eigen::Affine3d &mapToOdom) const;
+
+        /**
+         * @brief Forgets the tracked frames, after the map is replaced. The odometry is kept.
+         */
+        void reset();
+
+        PredictionStats stats() const;
+
+    private:
+        struct OdometrySample
+        {
+            double stamp;
+            Eigen::Affine3d pose;
+        };
+
+        struct GyroSample
+        {
+            double stamp;
+            Eigen::Vector3d angularVelocity;
+        };
+
+        bool predictLocked(double stamp, Eigen::Affine3d &mapToBase) const;
+
+        /**
+         * @brief The odometry at the stamp, extrapolated up to the horizon past the newest sample.
+         */
+        bool odometryAt(double stamp, Eigen::Affine3d &odomToBase) const;
+
+        /**
+         * @brief Integrates the gyroscope over (from, to].
+         * @return False if there is no sample within the horizon of from.
+         */
+        bool integrateGyro(double from, double to, Eigen::Quaterniond &rotation) const;
+
+        PosePredictorConfig config_;
+        mutable std::mutex mutex_;
+        std::deque<OdometrySample> odometry_;
+        std::deque<GyroSample> gyro_;
+
+        bool hasTracked_ = false;
+        double trackedStamp_ = 0.0;
+        Eigen::Affine3d trackedPose_ = Eigen::Affine3d::Identity();
+        bool hasMapToOdom_ = false;
+        Eigen::Affine3d mapToOdom_ = Eigen::Affine3d::Identity();
+        // motion between the last two tracked frames, in the frame of the older one, over velocityPeriod_.
+        bool hasVelocity_ = false;
+        Eigen::Affine3d velocityDelta_ = Eigen::Affine3d::Identity();
+        double velocityPeriod_ = 0.0;
+
+        PredictionStats stats_;
+        double sumSquaredTranslation_ = 0.0;
+        double sumSquaredRotation_ = 0.0;
+    };
+}
+
+#endif
@@ -0,0 +1,119 @@
+/**
+ * @file spsc_ring_buffer.hpp
+ * @brief Bounded lock-free single producer / single consumer ring buffer.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#ifndef ORB_WRAPPER_SPSC_RING_BUFFER_HPP_
+#define ORB_WRAPPER_SPSC_RING_BUFFER_HPP_
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+#include <utility>
+
+namespace ORB_SLAM3_Wrapper
+{
+    /**
+     * @brief Fixed capacity ring buffer that is safe for exactly one producer thread and one consumer thread.
+     * @note All the storage is allocated in the constructor. push / pop never allocate.
+     * Producers (or consumers) running on different threads must be serialized externally,
+     * e.g. by a mutually exclusive callback group.
+     */
+    template <typename T>
+    class SPSCRingBuffer
+    {
+    public:
+        explicit SPSCRingBuffer(size_t capacity)
+            : buffer_(capacity + 1), head_(0), tail_(0)
+        {
+        }
+
+        SPSCRingBuffer(const SPSCRingBuffer &) = delete;
+        SPSCRingBuffer &operator=(const SPSCRingBuffer &) = delete;
+
+        /**
+         * @brief Enqueues an element. Producer side only.
+         * @return False if the buffer is full, the element is left untouched in that case.
+         */
+        bool push(T &&item)
+        {
+            const size_t head = head_.load(std::memory_order_relaxed);
+            const size_t next = increment(head);
+            if (next == tail_.load(std::memory_order_acquire))
+                return false;
+            buffer_[head] = std::move(item);
+            head_.store(next, std::memory_order_release);
+            return true;
+        }
+
+        bool push(const T &item)
+        {
+            T copy(item);
+            return push(std::move(copy));
+        }
+
+        /**
+         * @brief Dequeues the oldest element. Consumer side only.
+         * @return False if the buffer is empty.
+         */
+        bool pop(T &item)
+        {
+            const size_t tail = tail_.load(std::memory_order_relaxed);
+            if (tail == head_.load(std::memory_order_acquire))
+                return false;
+            item = std::move(buffer_[tail]);
+            buffer_[tail] = T();
+            tail_.store(increment(tail), std::memory_order_release);
+            return true;
+        }
+
+        /**
+         * @brief Dequeues the newest element and discards everything older. Consumer side only.
+         * @param discarded Number of elements that were dropped to get to the newest one.
+         * @return False if the buffer is empty.
+         */
+        bool popLatest(T &item, size_t &discarded)
+        {
+            discarded = 0;
+            if (!pop(item))
+                return false;
+            while (pop(item))
+                ++discarded;
+            return true;
+        }
+
+        /**
+         * @brief Number of queued elements. Exact only when called from the producer or the consumer.
+         */
+        size_t size() const
+        {
+            const size_t head = head_.load(std::memory_order_acquire);
+            const size_t tail = tail_.load(std::memory_order_acquire);
+            return head >= tail ? head - tail : head + buffer_.size() - tail;
+        }
+
+        bool empty() const
+        {
+            return size() == 0;
+        }
+
+        size_t capacity() const
+        {
+            return buffer_.size() - 1;
+        }
+
+    private:
+        size_t increment(size_t idx) const
+        {
+            return (idx + 1) == buffer_.size() ? 0 : idx + 1;
+        }
+
+        std::vector<T> buffer_;
+        // head and tail live on separate cache lines so producer and consumer do not false share.
+        alignas(64) std::atomic<size_t> head_;
+        alignas(64) std::atomic<size_t> tail_;
+    };
+}
+
+#endif
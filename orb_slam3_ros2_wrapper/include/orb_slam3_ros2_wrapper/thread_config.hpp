@@ -0,0 +1,130 @@
+/**
+ * @file thread_config.hpp
+ * @brief CPU set parsing, thread affinity and scheduling helpers.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#ifndef ORB_WRAPPER_THREAD_CONFIG_HPP_
+#define ORB_WRAPPER_THREAD_CONFIG_HPP_
+
+#include <string>
+#include <vector>
+
+namespace ORB_SLAM3_Wrapper
+{
+    /**
+     * @brief Parses a CPU list in the taskset / cpuset format, e.g. "0-3,6".
+     * @param cpus Sorted, without duplicates.
+     * @return False if the list is malformed or empty.
+     */
+    bool parseCpuSet(const std::string &spec, std::vector<int> &cpus);
+
+    /**
+     * @brief Formats a CPU list back to "0-3,6".
+     */
+    std::string formatCpuSet(const std::vector<int> &cpus);
+
+    bool getCurrentThreadAffinity(std::vector<int> &cpus);
+
+    bool setCurrentThreadAffinity(const std::vector<int> &cpus);
+
+    /**
+     * @return Linux thread id of the calling thread.
+     */
+    int currentThreadId();
+
+    /**
+     * @brief Thread ids of the process, from /proc/self/task, sorted.
+     */
+    std::vector<int> processThreadIds();
+
+    /**
+     * @brief Affinity of any thread of the process by its thread id.
+     */
+    bool getThreadAffinity(int tid, std::vector<int> &cpus);
+
+    bool setThreadAffinity(int tid, const std::vector<int> &cpus);
+
+    /**
+     * @param priority 1 to 99 for SCHED_FIFO, 0 for the default SCHED_OTHER.
+     * @note SCHED_FIFO needs CAP_SYS_NICE or an rtprio limit (ulimit -r), false without them.
+     */
+    bool setThreadPriority(int tid, int priority);
+
+    /**
+     * @param priority The SCHED_FIFO / SCHED_RR priority, 0 for the other policies.
+     * @param realtime True for SCHED_FIFO and SCHED_RR.
+     */
+    bool getThreadPriority(int tid, int &priority, bool &realtime);
+
+    /**
+     * @brief Renames a thread of the process, as shown by top -H and ps -L. Names are cut at 15 characters.
+     */
+    bool setThreadName(int tid, const std::string &name);
+
+    /**
+     * @return Name of a thread of the process, empty if it is gone.
+     */
+    std::string getThreadName(int tid);
+
+    /**
+     * @brief "cpus 2-3, realtime priority 80" from the affinity and the scheduling of the thread, read back from the kernel.
+     */
+    std::string describeThread(int tid);
+
+    /**
+     * @brief Restricts the calling thread to a CPU set for its lifetime and restores the previous set on destruction.
+     * @note Threads created meanwhile inherit the set (Linux semantics), which is how the ORB_SLAM3 threads
+     * of a system get pinned: construct it inside the scope.
+     */
+    class ScopedThreadAffinity
+    {
+    public:
+        /**
+         * @param cpus An empty set leaves the affinity unchanged.
+         */
+        explicit ScopedThreadAffinity(const std::vector<int> &cpus);
+        ~ScopedThreadAffinity();
+
+        ScopedThreadAffinity(const ScopedThreadAffinity &) = delete;
+        ScopedThreadAffinity &operator=(const ScopedThreadAffinity &) = delete;
+
+        bool applied() const
+        {
+            return applied_;
+        }
+
+    private:
+        std::vector<int> previous_;
+        bool applied_ = false;
+    };
+
+    /**
+     * @brief Finds the threads the calling thread creates in its scope. The calling thread is renamed to a marker
+     * unique in the process, which Linux copies to the threads it creates, and gets its name back on destruction.
+     * @note Threads that other threads start meanwhile keep their own names, so the DDS and executor threads or
+     * the threads of another system constructed at the same time are never caught. A created thread that renames
+     * itself is missed.
+     */
+    class ScopedThreadCreationTracker
+    {
+    public:
+        ScopedThreadCreationTracker();
+        ~ScopedThreadCreationTracker();
+
+        ScopedThreadCreationTracker(const ScopedThreadCreationTracker &) = delete;
+        ScopedThreadCreationTracker &operator=(const ScopedThreadCreationTracker &) = delete;
+
+        /**
+         * @return Thread ids of the threads created in the scope so far and still running, sorted.
+         */
+        std::vector<int> created() const;
+
+    private:
+        int tid_;
+        std::string previousName_;
+        std::string marker_;
+    };
+}
+
+#endif
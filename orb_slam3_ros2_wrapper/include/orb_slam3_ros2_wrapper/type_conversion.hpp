@@ -17,6 +17,10 @@
 
 #include <sensor_msgs/msg/point_cloud2.hpp>
 
+#include <slam_msgs/msg/map_data.hpp>
+#include <slam_msgs/msg/packed_map_data.hpp>
+#include <slam_msgs/msg/packed_map_points.hpp>
+
 #include <tf2/LinearMath/Matrix3x3.h>
 #include <tf2/LinearMath/Vector3.h>
 #include <tf2/LinearMath/Transform.h>
@@ -24,6 +28,9 @@
 #include <tf2_eigen/tf2_eigen.hpp>
 
 #include "MapPoint.h"
+#include "orb_slam3_ros2_wrapper/frame_permutation.hpp"
+#include "orb_slam3_ros2_wrapper/point_cloud_serializer.hpp"
+#include "orb_slam3_ros2_wrapper/packed_points.hpp"
 
 namespace ORB_SLAM3_Wrapper
 {
@@ -79,13 +86,28 @@ namespace ORB_SLAM3_Wrapper
          */
         Eigen::Vector3f vector3fORBToROS(const Eigen::Vector3f &s);
 
+        /**
+         * @brief Batch version of vector3fORBToROS.
+         * @param points Vectors in ORB coordinates.
+         * @param rosPoints Resized and filled with the vectors in ROS coordinates.
+         */
+        void vector3fORBToROS(const std::vector<Eigen::Vector3f> &points, std::vector<Eigen::Vector3f> &rosPoints);
+
         /**
          * @brief Converts a Sophus SE3f transform to an Eigen Affine3d transform.
          * @param s The Sophus SE3f transform.
          * @return The corresponding Eigen Affine3d transform.
+         * @note Computed in double, not converted from the float result of se3ORBToROS.
          */
         Eigen::Affine3d se3ToAffine(const Sophus::SE3f &s);
 
+        /**
+         * @brief Batch version of se3ToAffine.
+         * @param poses Tcw poses in ORB coordinates.
+         * @param affines Resized and filled with the corresponding transforms.
+         */
+        void se3ToAffine(const std::vector<Sophus::SE3f> &poses, std::vector<Eigen::Affine3d> &affines);
+
         Eigen::Affine3f poseToAffine(const geometry_msgs::msg::Pose &pose);
 
         /**
@@ -95,9 +117,42 @@ namespace ORB_SLAM3_Wrapper
          */
         geometry_msgs::msg::Pose se3ToPoseMsg(const Sophus::SE3f &s);
 
+        /**
+         * @brief Sets up an unorganized float32 x y z cloud and sizes its data buffer for numPoints points.
+         * @param cloud The cloud to initialize. Its data is resized, not cleared.
+         * @param numPoints Number of points.
+         */
+        void initXYZCloud(sensor_msgs::msg::PointCloud2 &cloud, size_t numPoints);
+
+        /**
+         * @brief Serializes points already in ROS coordinates to a float32 x y z cloud.
+         */
         sensor_msgs::msg::PointCloud2 MapPointsToPCL(std::vector<Eigen::Vector3f>& mapPoints);
 
-        sensor_msgs::msg::PointCloud2 MapPointsToPCL(std::vector<ORB_SLAM3::MapPoint*>& mapPoints);
+        /**
+         * @brief Serializes ORB-SLAM3 map points to a cloud in ROS coordinates.
+         * @param channels MapPointChannel flags of the optional channels appended after x y z.
+         */
+        sensor_msgs::msg::PointCloud2 MapPointsToPCL(std::vector<ORB_SLAM3::MapPoint*>& mapPoints, uint32_t channels = CHANNEL_XYZ);
+
+        // **************************************PACKED MESSAGES*************************************
+        /**
+         * @brief Packs the points of the keyframes of a map data message, the graph is copied as is.
+         * @param packed Overwritten, its sequences are reused.
+         * @return False if packPoints failed.
+         */
+        bool mapDataToPacked(const slam_msgs::msg::MapData &mapData, const PointPacking &packing, slam_msgs::msg::PackedMapData &packed);
+
+        /**
+         * @brief Inverse of mapDataToPacked, up to the float32 precision (and the quantization) of the points.
+         * @return False if the message is malformed, with the reason in message.
+         */
+        bool packedToMapData(const slam_msgs::msg::PackedMapData &packed, slam_msgs::msg::MapData &mapData, std::string &message);
+
+        /**
+         * @brief Packs ORB-SLAM3 map points in ROS coordinates, with the ids of the keyframes observing them.
+         */
+        bool mapPointsToPacked(const std::vector<ORB_SLAM3::MapPoint*> &mapPoints, const PointPacking &packing, slam_msgs::msg::PackedMapPoints &packed);
 
         // **************************************TRANSFORMATIONS*************************************
         /**
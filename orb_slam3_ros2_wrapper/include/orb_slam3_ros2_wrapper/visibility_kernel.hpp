@@ -0,0 +1,79 @@
+/**
+ * @file visibility_kernel.hpp
+ * @brief Batched map point visibility tests on a structure-of-arrays snapshot.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#ifndef ORB_WRAPPER_VISIBILITY_KERNEL_HPP_
+#define ORB_WRAPPER_VISIBILITY_KERNEL_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <Eigen/Core>
+
+namespace ORB_SLAM3_Wrapper
+{
+    /**
+     * @brief Snapshot of the map point attributes needed for visibility tests (ORB world coordinates).
+     * @note Taking the snapshot locks every map point once, the kernels below never touch ORB-SLAM3 objects.
+     */
+    struct MapPointSoA
+    {
+        std::vector<float> x, y, z;
+        std::vector<float> nx, ny, nz;
+        std::vector<float> minDistance, maxDistance;
+
+        size_t size() const
+        {
+            return x.size();
+        }
+
+        void clear();
+
+        void reserve(size_t numPoints);
+
+        void push_back(const Eigen::Vector3f &position, const Eigen::Vector3f &normal, float minDist, float maxDist);
+    };
+
+    /**
+     * @brief Pinhole intrinsics and the image bounds a projection must fall into.
+     */
+    struct PinholeFrustum
+    {
+        float fx, fy, cx, cy;
+        float minX, maxX, minY, maxY;
+    };
+
+    /**
+     * @brief Camera pose (Tcw) and thresholds of a visibility query.
+     */
+    struct VisibilityQuery
+    {
+        Eigen::Matrix3f Rcw;
+        Eigen::Vector3f tcw;
+        // camera center in world coordinates.
+        Eigen::Vector3f Ow;
+        float viewingCosLimit = 0.5f;
+    };
+
+    /**
+     * @brief Vectorized visibility test. Same checks as Tracking::isInFrustum:
+     * positive depth, projection inside the image, distance inside the scale invariance region
+     * and viewing angle against the mean viewing direction.
+     * @param visible Resized to the number of points, 1 if the point is visible.
+     * @note Uses Eigen array expressions, which compile to SSE / AVX2 / NEON depending on the target flags.
+     * Define ORB_WRAPPER_SCALAR_VISIBILITY to always use the scalar kernel.
+     */
+    void computeVisibility(const MapPointSoA &points, const PinholeFrustum &frustum,
+                           const VisibilityQuery &query, std::vector<uint8_t> &visible);
+
+    /**
+     * @brief Scalar reference implementation of computeVisibility.
+     */
+    void computeVisibilityScalar(const MapPointSoA &points, const PinholeFrustum &frustum,
+                                 const VisibilityQuery &query, std::vector<uint8_t> &visible);
+}
+
+#endif
@@ -0,0 +1,40 @@
+/**
+ * @file vocabulary_cache.hpp
+ * @brief Process wide cache of loaded ORB vocabularies.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#ifndef ORB_WRAPPER_VOCABULARY_CACHE_HPP_
+#define ORB_WRAPPER_VOCABULARY_CACHE_HPP_
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "ORBVocabulary.h"
+
+namespace ORB_SLAM3_Wrapper
+{
+    /**
+     * @brief Loads each vocabulary file once per process and hands out shared read-only references.
+     * @note The vocabulary is freed when the last holder releases it. ORB_SLAM3 only reads the vocabulary
+     * after loading it (transform and scoring), so concurrent systems can share one instance.
+     */
+    class VocabularyCache
+    {
+    public:
+        /**
+         * @param path Binary (.bin, see BinaryVocabulary) or text vocabulary.
+         * @param loadSeconds If set, the time spent loading the file (0 if it was already loaded).
+         * @return The loaded vocabulary, null if the file could not be loaded.
+         */
+        static std::shared_ptr<ORB_SLAM3::ORBVocabulary> get(const std::string &path, double *loadSeconds = nullptr);
+
+    private:
+        static std::mutex mutex_;
+        static std::map<std::string, std::weak_ptr<ORB_SLAM3::ORBVocabulary>> vocabularies_;
+    };
+}
+
+#endif
@@ -0,0 +1,249 @@
+/**
+ * @file voxel_hash_index.hpp
+ * @brief Spatial hash of 3D positions used to answer neighbourhood queries over the map.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#ifndef ORB_WRAPPER_VOXEL_HASH_INDEX_HPP_
+#define ORB_WRAPPER_VOXEL_HASH_INDEX_HPP_
+
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <Eigen/Core>
+
+namespace ORB_SLAM3_Wrapper
+{
+    /**
+     * @brief Sparse voxel hash mapping positions to items.
+     * @note The cost of a query depends on the number of voxels overlapping the query volume
+     * and on the items in them, not on the total number of indexed items.
+     * T must be hashable (pointers, ids).
+     */
+    template <typename T>
+    class VoxelHashIndex
+    {
+    public:
+        explicit VoxelHashIndex(float voxelSize = 1.0f)
+            : voxelSize_(voxelSize), invVoxelSize_(1.0f / voxelSize)
+        {
+        }
+
+        /**
+         * @brief Inserts an item or moves it if it is already indexed.
+         */
+        void insert(const T &item, const Eigen::Vector3f &position)
+        {
+            const VoxelKey key = toKey(position);
+            auto it = locations_.find(item);
+            if (it != locations_.end())
+            {
+                if (it->second.key == key)
+                {
+                    it->second.position = position;
+                    updateEntry(key, item, position);
+                    return;
+                }
+                removeEntry(it->second.key, item);
+                it->second.key = key;
+                it->second.position = position;
+            }
+            else
+                locations_.emplace(item, Location{key, position});
+            voxels_[key].push_back(Entry{item, position});
+        }
+
+        /**
+         * @return False if the item was not indexed.
+         */
+        bool erase(const T &item)
+        {
+            auto it = locations_.find(item);
+            if (it == locations_.end())
+                return false;
+            removeEntry(it->second.key, item);
+            locations_.erase(it);
+            return true;
+        }
+
+        bool contains(const T &item) const
+        {
+            return locations_.count(item) > 0;
+        }
+
+        void clear()
+        {
+            voxels_.clear();
+            locations_.clear();
+        }
+
+        size_t size() const
+        {
+            return locations_.size();
+        }
+
+        size_t numVoxels() const
+        {
+            return voxels_.size();
+        }
+
+        float voxelSize() const
+        {
+            return voxelSize_;
+        }
+
+        /**
+         * @brief Collects all the items within radius of center.
+         */
+        void queryRadius(const Eigen::Vector3f &center, float radius, std::vector<T> &items) const
+        {
+            const float radiusSq = radius * radius;
+            forEachCandidateVoxel(center, radius, [&](const std::vector<Entry> &entries)
+                                  {
+                for (const auto &entry : entries)
+                {
+                    if ((entry.position - center).squaredNorm() <= radiusSq)
+                        items.push_back(entry.item);
+                } });
+        }
+
+        /**
+         * @brief Collects the items within radius of apex and inside the cone around direction.
+         * @param direction Unit vector along the cone axis.
+         * @param cosHalfAngle Cosine of the half opening angle of the cone.
+         */
+        void queryCone(const Eigen::Vector3f &apex, const Eigen::Vector3f &direction, float radius,
+                       float cosHalfAngle, std::vector<T> &items) const
+        {
+            const float radiusSq = radius * radius;
+            forEachCandidateVoxel(apex, radius, [&](const std::vector<Entry> &entries)
+                                  {
+                for (const auto &entry : entries)
+                {
+                    const Eigen::Vector3f offset = entry.position - apex;
+                    const float distSq = offset.squaredNorm();
+                    if (distSq > radiusSq)
+                        continue;
+                    // the apex itself is always inside.
+                    if (distSq > 0.0f && offset.dot(direction) < cosHalfAngle * std::sqrt(distSq))
+                        continue;
+                    items.push_back(entry.item);
+                } });
+        }
+
+    private:
+        struct VoxelKey
+        {
+            int32_t x, y, z;
+            bool operator==(const VoxelKey &other) const
+            {
+                return x == other.x && y == other.y && z == other.z;
+            }
+        };
+
+        struct VoxelKeyHash
+        {
+            size_t operator()(const VoxelKey &key) const
+            {
+                // large primes from Teschner et al. "Optimized Spatial Hashing for Collision Detection of Deformable Objects".
+                return static_cast<size_t>((static_cast<int64_t>(key.x) * 73856093) ^
+                                           (static_cast<int64_t>(key.y) * 19349663) ^
+                                           (static_cast<int64_t>(key.z) * 83492791));
+            }
+        };
+
+        struct Entry
+        {
+            T item;
+            Eigen::Vector3f position;
+        };
+
+        struct Location
+        {
+            VoxelKey key;
+            Eigen::Vector3f position;
+        };
+
+        VoxelKey toKey(const Eigen::Vector3f &position) const
+        {
+            return VoxelKey{static_cast<int32_t>(std::floor(position.x() * invVoxelSize_)),
+                            static_cast<int32_t>(std::floor(position.y() * invVoxelSize_)),
+                            static_cast<int32_t>(std::floor(position.z() * invVoxelSize_))};
+        }
+
+        void removeEntry(const VoxelKey &key, const T &item)
+        {
+            auto voxel = voxels_.find(key);
+            if (voxel == voxels_.end())
+                return;
+            auto &entries = voxel->second;
+            for (size_t i = 0; i < entries.size(); i++)
+            {
+                if (entries[i].item == item)
+                {
+                    entries[i] = std::move(entries.back());
+                    entries.pop_back();
+                    break;
+                }
+            }
+            if (entries.empty())
+                voxels_.erase(voxel);
+        }
+
+        void updateEntry(const VoxelKey &key, const T &item, const Eigen::Vector3f &position)
+        {
+            auto &entries = voxels_[key];
+            for (auto &entry : entries)
+            {
+                if (entry.item == item)
+                {
+                    entry.position = position;
+                    return;
+                }
+            }
+        }
+
+        template <typename Visitor>
+        void forEachCandidateVoxel(const Eigen::Vector3f &center, float radius, Visitor visit) const
+        {
+            const Eigen::Vector3f extent = Eigen::Vector3f::Constant(radius);
+            const VoxelKey minKey = toKey(center - extent);
+            const VoxelKey maxKey = toKey(center + extent);
+            const int64_t numCells = (static_cast<int64_t>(maxKey.x) - minKey.x + 1) *
+                                     (static_cast<int64_t>(maxKey.y) - minKey.y + 1) *
+                                     (static_cast<int64_t>(maxKey.z) - minKey.z + 1);
+            // a query larger than the occupied space is cheaper as a walk over the occupied voxels.
+            if (numCells > static_cast<int64_t>(voxels_.size()))
+            {
+                for (const auto &voxel : voxels_)
+                {
+                    const VoxelKey &key = voxel.first;
+                    if (key.x < minKey.x || key.x > maxKey.x || key.y < minKey.y || key.y > maxKey.y ||
+                        key.z < minKey.z || key.z > maxKey.z)
+                        continue;
+                    visit(voxel.second);
+                }
+                return;
+            }
+            for (int32_t x = minKey.x; x <= maxKey.x; x++)
+                for (int32_t y = minKey.y; y <= maxKey.y; y++)
+                    for (int32_t z = minKey.z; z <= maxKey.z; z++)
+                    {
+                        auto voxel = voxels_.find(VoxelKey{x, y, z});
+                        if (voxel != voxels_.end())
+                            visit(voxel->second);
+                    }
+        }
+
+        float voxelSize_;
+        float invVoxelSize_;
+        std::unordered_map<VoxelKey, std::vector<Entry>, VoxelKeyHash> voxels_;
+        std::unordered_map<T, Location> locations_;
+    };
+}
+
+#endif
@@ -0,0 +1,85 @@
+/**
+ * @file worker_pool.hpp
+ * @brief Persistent worker threads for the parallel map queries.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#ifndef ORB_WRAPPER_WORKER_POOL_HPP_
+#define ORB_WRAPPER_WORKER_POOL_HPP_
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ORB_SLAM3_Wrapper
+{
+    /**
+     * @brief Fixed set of threads running the tasks of parallelFor calls.
+     * @note The calling thread runs tasks too, so a pool with no worker runs everything inline. Several
+     * threads can call parallelFor at once, their jobs are served in order.
+     */
+    class WorkerPool
+    {
+    public:
+        /**
+         * @param numWorkers Threads started besides the callers.
+         */
+        explicit WorkerPool(size_t numWorkers);
+        ~WorkerPool();
+
+        WorkerPool(const WorkerPool &) = delete;
+        WorkerPool &operator=(const WorkerPool &) = delete;
+
+        /**
+         * @brief Runs task(0) to task(numTasks - 1) on the workers and the calling thread and returns once all are done.
+         * @note A task must not call parallelFor on the same pool.
+         */
+        void parallelFor(size_t numTasks, const std::function<void(size_t)> &task);
+
+        /**
+         * @return Threads a parallelFor call can run on, the caller included.
+         */
+        size_t concurrency() const
+        {
+            return workers_.size() + 1;
+        }
+
+        /**
+         * @brief Process wide pool, so that the robots of a multi robot host share the cores instead of each
+         * starting a thread per core.
+         * @param numThreads Threads of the pool, the callers included. 0 for one per core. Only the first call
+         * creating the pool sets it, the later ones share the pool as it is.
+         */
+        static std::shared_ptr<WorkerPool> shared(size_t numThreads);
+
+    private:
+        struct Job
+        {
+            const std::function<void(size_t)> *task;
+            size_t numTasks;
+            std::atomic<size_t> next{0};
+            std::atomic<size_t> remaining{0};
+            std::mutex mutex;
+            std::condition_variable done;
+        };
+
+        void workerLoop();
+        static void runTasks(Job &job);
+
+        std::mutex mutex_;
+        std::condition_variable condition_;
+        std::deque<std::shared_ptr<Job>> jobs_;
+        bool running_ = true;
+        std::vector<std::thread> workers_;
+
+        static std::mutex sharedMutex_;
+        static std::weak_ptr<WorkerPool> shared_;
+    };
+}
+
+#endif
@@ -0,0 +1,43 @@
+#!/usr/bin/python3
+# -*- coding: utf-8 -*-
+import os
+
+from ament_index_python.packages import get_package_share_directory
+from launch import LaunchDescription
+from launch.actions import DeclareLaunchArgument
+from launch.substitutions import LaunchConfiguration
+from launch_ros.actions import Node
+
+def generate_launch_description():
+
+#---------------------------------------------
+
+    #Essential_paths
+    orb_wrapper_pkg = get_package_share_directory('orb_slam3_ros2_wrapper')
+#---------------------------------------------
+
+    # LAUNCH ARGS
+    use_sim_time = LaunchConfiguration('use_sim_time')
+    declare_use_sim_time_cmd = DeclareLaunchArgument(
+        name='use_sim_time',
+        default_value='True',
+        description='Use simulation (Gazebo) clock if true')
+
+    params_file = LaunchConfiguration('params_file')
+    declare_params_file_cmd = DeclareLaunchArgument(
+        'params_file',
+        default_value=os.path.join(orb_wrapper_pkg, 'params', 'fleet-map-server-params.yaml'),
+        description='Robots of the fleet and place recognition parameters')
+#---------------------------------------------
+
+    fleet_map_server = Node(
+        package='orb_slam3_ros2_wrapper',
+        executable='fleet_map_server',
+        output='screen',
+        parameters=[params_file, {'use_sim_time': use_sim_time}])
+
+    return LaunchDescription([
+        declare_use_sim_time_cmd,
+        declare_params_file_cmd,
+        fleet_map_server
+    ])
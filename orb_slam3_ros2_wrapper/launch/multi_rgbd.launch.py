@@ -0,0 +1,101 @@
+#!/usr/bin/python3
+# -*- coding: utf-8 -*-
+import os
+
+import yaml
+from ament_index_python.packages import get_package_share_directory
+from launch import LaunchDescription
+from launch.actions import DeclareLaunchArgument, OpaqueFunction
+from launch.substitutions import LaunchConfiguration
+from launch_ros.actions import Node
+
+# sensor_type of the host -> executable running one robot per process.
+PROCESS_EXECUTABLES = {
+    'rgbd': 'rgbd',
+    'rgbd_inertial': 'rgbd_inertial',
+    'stereo_inertial': 'stereo_inertial',
+    'mono_inertial': 'mono_inertial',
+}
+
+def generate_launch_description():
+
+#---------------------------------------------
+
+    #Essential_paths
+    orb_wrapper_pkg = get_package_share_directory('orb_slam3_ros2_wrapper')
+#---------------------------------------------
+
+    # LAUNCH ARGS
+    use_sim_time = LaunchConfiguration('use_sim_time')
+    declare_use_sim_time_cmd = DeclareLaunchArgument(
+        name='use_sim_time',
+        default_value='True',
+        description='Use simulation (Gazebo) clock if true')
+
+    params_file = LaunchConfiguration('params_file')
+    declare_params_file_cmd = DeclareLaunchArgument(
+        'params_file',
+        default_value=os.path.join(orb_wrapper_pkg, 'params', 'multi-rgbd-ros-params.yaml'),
+        description='Parameters of the host (robot namespaces, CPU sets) and of every robot node')
+
+    isolation = LaunchConfiguration('isolation')
+    declare_isolation_cmd = DeclareLaunchArgument(
+        'isolation',
+        default_value='process',
+        description='process: one ORB-SLAM3 process per robot (stock ORB-SLAM3), '
+                    'shared: every robot in one multi_rgbd process (needs -DORB_SLAM3_HAS_INSTANCE_STATE=ON)')
+#---------------------------------------------
+
+    vocabulary_file_path = LaunchConfiguration('vocabulary_file_path')
+    declare_vocabulary_file_path_cmd = DeclareLaunchArgument(
+        'vocabulary_file_path',
+        default_value="/home/orb/ORB_SLAM3/Vocabulary/ORBvoc.txt",
+        description='ORB vocabulary, text (.txt) or converted with orb_vocabulary_converter (.bin)')
+    config_file_path = "/root/colcon_ws/src/orb_slam3_ros2_wrapper/params/gazebo_rgbd.yaml"
+
+    def robot_nodes_launch(context):
+        mode = isolation.perform(context)
+        if mode == 'shared':
+            # every robot of the params file runs in this one process.
+            return [Node(
+                package='orb_slam3_ros2_wrapper',
+                executable='multi_rgbd',
+                output='screen',
+                arguments=[vocabulary_file_path, config_file_path],
+                parameters=[params_file, {'use_sim_time': use_sim_time}])]
+        if mode != 'process':
+            raise RuntimeError('isolation must be process or shared, not ' + mode)
+
+        # one process per robot, each with its own ORB-SLAM3 statics. The robot nodes read the same
+        # /<robot_namespace>/<node name> sections of the params file as in the shared host.
+        with open(params_file.perform(context)) as f:
+            host = yaml.safe_load(f)['ORB_SLAM3_HOST']['ros__parameters']
+        sensor_type = host.get('sensor_type', 'rgbd')
+        if sensor_type not in PROCESS_EXECUTABLES:
+            raise RuntimeError('No per-process executable for sensor_type ' + sensor_type)
+        robot_namespaces = host.get('robot_namespaces', [])
+        robot_cpu_sets = host.get('robot_cpu_sets', [])
+        nodes = []
+        for i, robot_namespace in enumerate(robot_namespaces):
+            cpus = robot_cpu_sets[i] if i < len(robot_cpu_sets) else ''
+            nodes.append(Node(
+                package='orb_slam3_ros2_wrapper',
+                executable=PROCESS_EXECUTABLES[sensor_type],
+                output='screen',
+                namespace=robot_namespace,
+                # the whole process, ORB-SLAM3 threads included, is pinned to the CPU set of the robot.
+                prefix='taskset -c ' + cpus if cpus else None,
+                arguments=[vocabulary_file_path, config_file_path],
+                parameters=[params_file, {'use_sim_time': use_sim_time,
+                                          'visualization': host.get('visualization', False)}]))
+        return nodes
+
+    opaque_function = OpaqueFunction(function=robot_nodes_launch)
+
+    return LaunchDescription([
+        declare_use_sim_time_cmd,
+        declare_params_file_cmd,
+        declare_isolation_cmd,
+        declare_vocabulary_file_path_cmd,
+        opaque_function
+    ])
@@ -39,11 +39,14 @@ def generate_launch_description():
     robot_y = LaunchConfiguration('robot_y')
     robot_y_arg = DeclareLaunchArgument('robot_y', default_value="1.0",
         description='The namespace of the robot')
+
+    vocabulary_file_path_arg = DeclareLaunchArgument('vocabulary_file_path', default_value="/home/orb/ORB_SLAM3/Vocabulary/ORBvoc.txt",
+        description='ORB vocabulary, text (.txt) or converted with orb_vocabulary_converter (.bin)')
 #---------------------------------------------
 
     def all_nodes_launch(context, robot_namespace, robot_x, robot_y):
         params_file = LaunchConfiguration('params_file')
-        vocabulary_file_path = "/home/orb/ORB_SLAM3/Vocabulary/ORBvoc.txt"
+        vocabulary_file_path = LaunchConfiguration('vocabulary_file_path').perform(context)
         config_file_path = "/root/colcon_ws/src/orb_slam3_ros2_wrapper/params/gazebo_rgbd.yaml"
         declare_params_file_cmd = DeclareLaunchArgument(
             'params_file',
@@ -82,5 +85,6 @@ def generate_launch_description():
         robot_namespace_arg,
         robot_x_arg,
         robot_y_arg,
+        vocabulary_file_path_arg,
         opaque_function
     ])
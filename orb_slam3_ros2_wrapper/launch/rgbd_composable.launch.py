@@ -0,0 +1,110 @@
+#!/usr/bin/python3
+# -*- coding: utf-8 -*-
+import os
+
+from ament_index_python.packages import get_package_share_directory
+from launch import LaunchDescription
+from launch.actions import DeclareLaunchArgument
+from launch.actions import OpaqueFunction
+from launch.substitutions import LaunchConfiguration
+from launch_ros.actions import ComposableNodeContainer, LoadComposableNodes
+from launch_ros.descriptions import ComposableNode
+from nav2_common.launch import RewrittenYaml
+
+def generate_launch_description():
+
+#---------------------------------------------
+
+    #Essential_paths
+    orb_wrapper_pkg = get_package_share_directory('orb_slam3_ros2_wrapper')
+#---------------------------------------------
+
+    # LAUNCH ARGS
+    use_sim_time = LaunchConfiguration('use_sim_time')
+    declare_use_sim_time_cmd = DeclareLaunchArgument(
+        name='use_sim_time',
+        default_value='True',
+        description='Use simulation (Gazebo) clock if true')
+
+    robot_namespace =  LaunchConfiguration('robot_namespace')
+    robot_namespace_arg = DeclareLaunchArgument('robot_namespace', default_value="robot",
+        description='The namespace of the robot')
+
+    robot_x = LaunchConfiguration('robot_x')
+    robot_x_arg = DeclareLaunchArgument('robot_x', default_value="1.0",
+        description='The initial x position of the robot')
+
+    robot_y = LaunchConfiguration('robot_y')
+    robot_y_arg = DeclareLaunchArgument('robot_y', default_value="1.0",
+        description='The initial y position of the robot')
+
+    container_name = LaunchConfiguration('container_name')
+    container_name_arg = DeclareLaunchArgument('container_name', default_value="",
+        description='Name of an existing component container (e.g. the one running the camera driver). '
+                    'If empty, a new container is started.')
+
+    vocabulary_file_path_arg = DeclareLaunchArgument('vocabulary_file_path', default_value="/home/orb/ORB_SLAM3/Vocabulary/ORBvoc.txt",
+        description='ORB vocabulary, text (.txt) or converted with orb_vocabulary_converter (.bin)')
+#---------------------------------------------
+
+    def all_nodes_launch(context, robot_namespace, robot_x, robot_y, container_name):
+        params_file = LaunchConfiguration('params_file')
+        vocabulary_file_path = LaunchConfiguration('vocabulary_file_path').perform(context)
+        config_file_path = "/root/colcon_ws/src/orb_slam3_ros2_wrapper/params/gazebo_rgbd.yaml"
+        declare_params_file_cmd = DeclareLaunchArgument(
+            'params_file',
+            default_value=os.path.join(orb_wrapper_pkg, 'params', 'rgbd-ros-params.yaml'),
+            description='Full path to the ROS2 parameters file to use for all launched nodes')
+
+        param_substitutions = {
+            'robot_base_frame': robot_namespace.perform(context) + '/base_footprint',
+            'odom_frame': robot_namespace.perform(context) + '/odom',
+            'robot_x': robot_x.perform(context),
+            'robot_y': robot_y.perform(context)
+            }
+
+        configured_params = RewrittenYaml(
+            source_file=params_file,
+            root_key=robot_namespace.perform(context),
+            param_rewrites=param_substitutions,
+            convert_types=True)
+
+        # the images are handed over as shared pointers when the camera driver runs in the same container.
+        orb_slam3_component = ComposableNode(
+            package='orb_slam3_ros2_wrapper',
+            plugin='ORB_SLAM3_Wrapper::RgbdSlamNode',
+            name='ORB_SLAM3_RGBD_ROS2',
+            namespace=robot_namespace.perform(context),
+            parameters=[configured_params,
+                        {'vocabulary_file_path': vocabulary_file_path,
+                         'settings_file_path': config_file_path}],
+            extra_arguments=[{'use_intra_process_comms': True}])
+
+        if container_name.perform(context) != "":
+            load_cmd = LoadComposableNodes(
+                target_container=container_name.perform(context),
+                composable_node_descriptions=[orb_slam3_component])
+            return [declare_params_file_cmd, load_cmd]
+
+        container = ComposableNodeContainer(
+            name='orb_slam3_container',
+            namespace=robot_namespace.perform(context),
+            package='rclcpp_components',
+            executable='component_container_mt',
+            output='screen',
+            composable_node_descriptions=[orb_slam3_component])
+
+        return [declare_params_file_cmd, container]
+
+    opaque_function = OpaqueFunction(function=all_nodes_launch, args=[robot_namespace, robot_x, robot_y, container_name])
+#---------------------------------------------
+
+    return LaunchDescription([
+        declare_use_sim_time_cmd,
+        robot_namespace_arg,
+        robot_x_arg,
+        robot_y_arg,
+        vocabulary_file_path_arg,
+        container_name_arg,
+        opaque_function
+    ])
@@ -0,0 +1,166 @@
+/**
+ * @file binary_vocabulary.cpp
+ * @brief ORB vocabulary with a binary file format that loads without parsing text.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#include "orb_slam3_ros2_wrapper/binary_vocabulary.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+namespace ORB_SLAM3_Wrapper
+{
+    namespace
+    {
+        const char kMagic[8] = {'O', 'R', 'B', 'V', 'O', 'C', 'B', '1'};
+
+        struct BinaryHeader
+        {
+            char magic[8];
+            int32_t k;
+            int32_t L;
+            int32_t weighting;
+            int32_t scoring;
+            uint32_t numNodes;
+            uint32_t descriptorBytes;
+        };
+
+        // parent, leaf flag, weight, descriptor.
+        size_t recordSize(uint32_t descriptorBytes)
+        {
+            return sizeof(int32_t) + sizeof(uint8_t) + sizeof(double) + descriptorBytes;
+        }
+    }
+
+    bool BinaryVocabulary::isBinaryVocabularyPath(const std::string &path)
+    {
+        const std::string extension = ".bin";
+        return path.size() >= extension.size() && path.compare(path.size() - extension.size(), extension.size(), extension) == 0;
+    }
+
+    bool BinaryVocabulary::loadFromFile(const std::string &path)
+    {
+        if (isBinaryVocabularyPath(path))
+            return loadFromBinaryFile(path);
+        return loadFromTextFile(path);
+    }
+
+    bool BinaryVocabulary::saveToBinaryFile(const std::string &path) const
+    {
+        const uint32_t descriptorBytes = DBoW2::FORB::L;
+        BinaryHeader header;
+        std::memcpy(header.magic, kMagic, sizeof(kMagic));
+        header.k = m_k;
+        header.L = m_L;
+        header.weighting = static_cast<int32_t>(m_weighting);
+        header.scoring = static_cast<int32_t>(m_scoring);
+        header.numNodes = static_cast<uint32_t>(m_nodes.size());
+        header.descriptorBytes = descriptorBytes;
+
+        const size_t record = recordSize(descriptorBytes);
+        std::vector<char> buffer(sizeof(header) + (m_nodes.empty() ? 0 : (m_nodes.size() - 1) * record));
+        std::memcpy(buffer.data(), &header, sizeof(header));
+        char *out = buffer.data() + sizeof(header);
+        // node 0 is the root, it has no descriptor.
+        for (size_t i = 1; i < m_nodes.size(); i++)
+        {
+            const auto &node = m_nodes[i];
+            if (node.descriptor.total() * node.descriptor.elemSize() != descriptorBytes || !node.descriptor.isContinuous())
+            {
+                std::cerr << "Unexpected descriptor of vocabulary node " << i << std::endl;
+                return false;
+            }
+            const int32_t parent = static_cast<int32_t>(node.parent);
+            const uint8_t leaf = node.isLeaf() ? 1 : 0;
+            const double weight = node.weight;
+            std::memcpy(out, &parent, sizeof(parent));
+            out += sizeof(parent);
+            std::memcpy(out, &leaf, sizeof(leaf));
+            out += sizeof(leaf);
+            std::memcpy(out, &weight, sizeof(weight));
+            out += sizeof(weight);
+            std::memcpy(out, node.descriptor.data, descriptorBytes);
+            out += descriptorBytes;
+        }
+
+        std::ofstream file(path, std::ios::binary);
+        if (!file)
+            return false;
+        file.write(buffer.data(), buffer.size());
+        return file.good();
+    }
+
+    bool BinaryVocabulary::loadFromBinaryFile(const std::string &path)
+    {
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if (!file)
+            return false;
+        const std::streamsize size = file.tellg();
+        file.seekg(0);
+        std::vector<char> buffer(size > 0 ? static_cast<size_t>(size) : 0);
+        if (buffer.size() < sizeof(BinaryHeader) || !file.read(buffer.data(), buffer.size()))
+            return false;
+
+        BinaryHeader header;
+        std::memcpy(&header, buffer.data(), sizeof(header));
+        const size_t record = recordSize(header.descriptorBytes);
+        if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.numNodes == 0 ||
+            header.descriptorBytes != static_cast<uint32_t>(DBoW2::FORB::L) ||
+            buffer.size() != sizeof(header) + (header.numNodes - 1) * record)
+        {
+            std::cerr << path << " is not a binary ORB vocabulary." << std::endl;
+            return false;
+        }
+
+        m_k = header.k;
+        m_L = header.L;
+        m_weighting = static_cast<DBoW2::WeightingType>(header.weighting);
+        m_scoring = static_cast<DBoW2::ScoringType>(header.scoring);
+        createScoringObject();
+
+        m_words.clear();
+        m_nodes.clear();
+        // m_words points into m_nodes, so it is sized once before taking any pointer.
+        m_nodes.resize(header.numNodes);
+        m_nodes[0].id = 0;
+        const char *in = buffer.data() + sizeof(header);
+        for (uint32_t i = 1; i < header.numNodes; i++)
+        {
+            int32_t parent;
+            uint8_t leaf;
+            double weight;
+            std::memcpy(&parent, in, sizeof(parent));
+            in += sizeof(parent);
+            std::memcpy(&leaf, in, sizeof(leaf));
+            in += sizeof(leaf);
+            std::memcpy(&weight, in, sizeof(weight));
+            in += sizeof(weight);
+            if (parent < 0 || static_cast<uint32_t>(parent) >= i)
+            {
+                std::cerr << path << ": node " << i << " has an invalid parent." << std::endl;
+                m_nodes.clear();
+                return false;
+            }
+
+            auto &node = m_nodes[i];
+            node.id = i;
+            node.parent = parent;
+            node.weight = weight;
+            node.descriptor.create(1, header.descriptorBytes, CV_8U);
+            std::memcpy(node.descriptor.data, in, header.descriptorBytes);
+            in += header.descriptorBytes;
+            m_nodes[parent].children.push_back(i);
+            // same word ids as the text loader: leaves in node order.
+            if (leaf)
+            {
+                node.word_id = m_words.size();
+                m_words.push_back(&node);
+            }
+        }
+        return true;
+    }
+}
@@ -0,0 +1,78 @@
+/**
+ * @file feature_backend.cpp
+ * @brief Preparation of the camera images for the ORB extractor ahead of the track call.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#include "orb_slam3_ros2_wrapper/feature_backend.hpp"
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+namespace ORB_SLAM3_Wrapper
+{
+    int grayConversionCode(const std::string &encoding)
+    {
+        if (encoding == "rgb8" || encoding == "rgb16")
+            return cv::COLOR_RGB2GRAY;
+        if (encoding == "bgr8" || encoding == "bgr16")
+            return cv::COLOR_BGR2GRAY;
+        if (encoding == "rgba8" || encoding == "rgba16")
+            return cv::COLOR_RGBA2GRAY;
+        if (encoding == "bgra8" || encoding == "bgra16")
+            return cv::COLOR_BGRA2GRAY;
+        return -1;
+    }
+
+    namespace
+    {
+        /**
+         * @brief A frame converted before prepare returned.
+         */
+        class ConvertedFrame : public PreparedFrame
+        {
+        public:
+            ConvertedFrame(const cv::Mat &first, int firstCode, const cv::Mat &second, int secondCode)
+            {
+                if (firstCode >= 0)
+                    cv::cvtColor(first, first_, firstCode);
+                if (secondCode >= 0)
+                    cv::cvtColor(second, second_, secondCode);
+            }
+
+            void wait(cv::Mat &first, cv::Mat &second) override
+            {
+                if (!first_.empty())
+                    first = first_;
+                if (!second_.empty())
+                    second = second_;
+            }
+
+        private:
+            cv::Mat first_;
+            cv::Mat second_;
+        };
+    }
+
+    std::shared_ptr<PreparedFrame> CpuFeatureBackend::prepare(const cv::Mat &first, int firstCode,
+                                                              const cv::Mat &second, int secondCode)
+    {
+        if (firstCode < 0 && secondCode < 0)
+            return nullptr;
+        return std::make_shared<ConvertedFrame>(first, firstCode, second, secondCode);
+    }
+
+    std::unique_ptr<FeatureBackend> makeFeatureBackend(const std::string &name, std::string &resolvedName, std::string &message)
+    {
+        message.clear();
+        resolvedName = "orb";
+        if (name == "orb")
+            return nullptr;
+        if (name == "cpu")
+        {
+            resolvedName = name;
+            return std::unique_ptr<FeatureBackend>(new CpuFeatureBackend());
+        }
+        message = "Unknown feature_backend " + name + ", ORB_SLAM3 converts the images on the CPU.";
+        return nullptr;
+    }
+}
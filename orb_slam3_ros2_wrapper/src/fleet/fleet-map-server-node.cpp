@@ -0,0 +1,283 @@
+/**
+ * @file fleet-map-server-node.cpp
+ * @brief Implementation of the FleetMapServerNode class.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+#include "fleet-map-server-node.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include <tf2_eigen/tf2_eigen.hpp>
+
+namespace ORB_SLAM3_Wrapper
+{
+    FleetMapServerNode::FleetMapServerNode(const rclcpp::NodeOptions &options)
+        : Node("ORB_SLAM3_FLEET_MAP_SERVER", options)
+    {
+        this->declare_parameter("robot_namespaces", rclcpp::ParameterValue(std::vector<std::string>()));
+        auto robotNamespaces = this->get_parameter("robot_namespaces").as_string_array();
+        if (robotNamespaces.empty())
+            throw std::runtime_error("robot_namespaces must be set.");
+
+        std::string anchorRobot;
+        this->declare_parameter("anchor_robot", rclcpp::ParameterValue(std::string("")));
+        this->get_parameter("anchor_robot", anchorRobot);
+        auto anchor = std::find(robotNamespaces.begin(), robotNamespaces.end(), anchorRobot);
+        if (!anchorRobot.empty() && anchor == robotNamespaces.end())
+            RCLCPP_WARN_STREAM(this->get_logger(), "anchor_robot " << anchorRobot << " is not in robot_namespaces, using " << robotNamespaces.front());
+        anchor_ = anchor == robotNamespaces.end() ? 0 : static_cast<int>(anchor - robotNamespaces.begin());
+
+        this->declare_parameter("fleet_frame", rclcpp::ParameterValue(std::string("map")));
+        this->get_parameter("fleet_frame", fleetFrame_);
+
+        double minBowScore, descriptorRatio;
+        int maxPendingQueries, workerThreads, referencePublishPeriod;
+        this->declare_parameter("min_bow_score", rclcpp::ParameterValue(0.05));
+        this->get_parameter("min_bow_score", minBowScore);
+        minBowScore_ = static_cast<float>(minBowScore);
+        this->declare_parameter("max_candidates", rclcpp::ParameterValue(3));
+        this->get_parameter("max_candidates", maxCandidates_);
+        this->declare_parameter("descriptor_max_distance", rclcpp::ParameterValue(50));
+        this->get_parameter("descriptor_max_distance", descriptorMaxDistance_);
+        this->declare_parameter("descriptor_ratio", rclcpp::ParameterValue(0.8));
+        this->get_parameter("descriptor_ratio", descriptorRatio);
+        descriptorRatio_ = static_cast<float>(descriptorRatio);
+        this->declare_parameter("ransac_iterations", rclcpp::ParameterValue(200));
+        this->get_parameter("ransac_iterations", ransacIterations_);
+        this->declare_parameter("ransac_inlier_threshold", rclcpp::ParameterValue(0.1));
+        this->get_parameter("ransac_inlier_threshold", ransacInlierThreshold_);
+        this->declare_parameter("min_inliers", rclcpp::ParameterValue(30));
+        this->get_parameter("min_inliers", minInliers_);
+        this->declare_parameter("max_pending_queries", rclcpp::ParameterValue(512));
+        this->get_parameter("max_pending_queries", maxPendingQueries);
+        maxPendingQueries_ = static_cast<size_t>(std::max(1, maxPendingQueries));
+        this->declare_parameter("worker_threads", rclcpp::ParameterValue(0));
+        this->get_parameter("worker_threads", workerThreads);
+        this->declare_parameter("reference_publish_period", rclcpp::ParameterValue(1000));
+        this->get_parameter("reference_publish_period", referencePublishPeriod);
+
+        // one callback group per robot: the messages of a robot stay in order, the robots are handled in parallel.
+        robots_.resize(robotNamespaces.size());
+        for (size_t i = 0; i < robotNamespaces.size(); i++)
+        {
+            RobotState &robot = robots_[i];
+            robot.name = robotNamespaces[i];
+            robot.callbackGroup = this->create_callback_group(rclcpp::CallbackGroupType::MutuallyExclusive);
+            rclcpp::SubscriptionOptions subscriptionOptions;
+            subscriptionOptions.callback_group = robot.callbackGroup;
+            robot.descriptorsSub = this->create_subscription<slam_msgs::msg::KeyFrameDescriptors>(
+                "/" + robot.name + "/keyframe_descriptors", rclcpp::QoS(10).reliable(),
+                [this, i](const slam_msgs::msg::KeyFrameDescriptors::SharedPtr msg)
+                { KeyFrameDescriptorsCallback(i, msg); },
+                subscriptionOptions);
+            // latched, a robot that restarts gets its reference at once.
+            robot.referencePub = this->create_publisher<geometry_msgs::msg::TransformStamped>("/" + robot.name + "/fleet_reference", rclcpp::QoS(1).reliable().transient_local());
+        }
+
+        if (workerThreads <= 0)
+            workerThreads = std::max(1u, std::thread::hardware_concurrency());
+        for (int i = 0; i < workerThreads; i++)
+            workers_.emplace_back(&FleetMapServerNode::workerLoop, this);
+
+        referenceCallbackGroup_ = this->create_callback_group(rclcpp::CallbackGroupType::MutuallyExclusive);
+        referenceTimer_ = this->create_wall_timer(std::chrono::milliseconds(std::max(1, referencePublishPeriod)), std::bind(&FleetMapServerNode::publishReferences, this), referenceCallbackGroup_);
+        RCLCPP_INFO_STREAM(this->get_logger(), "Fleet map server for " << robots_.size() << " robots, anchor " << robots_[anchor_].name
+                                                                      << ", " << workerThreads << " worker threads.");
+    }
+
+    FleetMapServerNode::~FleetMapServerNode()
+    {
+        running_ = false;
+        queriesCondition_.notify_all();
+        for (auto &worker : workers_)
+            worker.join();
+    }
+
+    void FleetMapServerNode::KeyFrameDescriptorsCallback(size_t robot, const slam_msgs::msg::KeyFrameDescriptors::SharedPtr msg)
+    {
+        RobotState &state = robots_[robot];
+        if (msg->poses.sequence != 0)
+        {
+            if (state.lastSequence != 0 && msg->poses.sequence != state.lastSequence + 1 && !msg->poses.is_snapshot)
+            {
+                // the periodic snapshot of the robot resynchronizes the poses.
+                ++state.sequenceGaps;
+                RCLCPP_WARN_STREAM(this->get_logger(), "Lost " << msg->poses.sequence - state.lastSequence - 1 << " pose deltas of " << state.name);
+            }
+            state.lastSequence = msg->poses.sequence;
+            applyPoseDelta(robot, msg->poses);
+        }
+
+        const size_t numKeyFrames = msg->ids.size();
+        size_t numWords = 0, numPoints = 0;
+        for (auto count : msg->word_counts)
+            numWords += count;
+        for (auto count : msg->point_counts)
+            numPoints += count;
+        if (msg->keyframe_poses.size() != numKeyFrames || msg->word_counts.size() != numKeyFrames || msg->point_counts.size() != numKeyFrames ||
+            msg->word_ids.size() != numWords || msg->word_weights.size() != numWords ||
+            msg->points.size() != 3 * numPoints || msg->descriptors.size() != sizeof(OrbDescriptor) * numPoints)
+        {
+            RCLCPP_WARN_STREAM(this->get_logger(), "Dropping malformed keyframe descriptors of " << state.name);
+            return;
+        }
+
+        size_t word = 0, point = 0;
+        for (size_t k = 0; k < numKeyFrames; k++)
+        {
+            auto keyFrame = std::make_shared<FleetKeyFrame>();
+            keyFrame->robot = static_cast<int>(robot);
+            keyFrame->id = msg->ids[k];
+            keyFrame->words.reserve(msg->word_counts[k]);
+            for (uint32_t w = 0; w < msg->word_counts[k]; w++, word++)
+                keyFrame->words.emplace_back(msg->word_ids[word], msg->word_weights[word]);
+            normalizeBowVector(keyFrame->words);
+            keyFrame->points.reserve(msg->point_counts[k]);
+            keyFrame->descriptors.resize(msg->point_counts[k]);
+            for (uint32_t p = 0; p < msg->point_counts[k]; p++, point++)
+            {
+                keyFrame->points.emplace_back(msg->points[3 * point], msg->points[3 * point + 1], msg->points[3 * point + 2]);
+                std::memcpy(keyFrame->descriptors[p].data(), msg->descriptors.data() + sizeof(OrbDescriptor) * point, sizeof(OrbDescriptor));
+            }
+            Eigen::Affine3d pose;
+            tf2::fromMsg(msg->keyframe_poses[k], pose);
+            // in the database before its query runs, so that two robots seeing a place at once still match.
+            database_.add(keyFrame, pose);
+            queueQuery(keyFrame);
+        }
+    }
+
+    void FleetMapServerNode::applyPoseDelta(size_t robot, const slam_msgs::msg::MapDataDelta &delta)
+    {
+        const int robotId = static_cast<int>(robot);
+        if (delta.is_snapshot)
+            database_.retain(robotId, delta.added_ids);
+        for (auto id : delta.removed_ids)
+            database_.remove(robotId, id);
+        // keyframes whose descriptors have not arrived yet come with their own pose.
+        Eigen::Affine3d pose;
+        for (size_t i = 0; i < delta.added_ids.size() && i < delta.added_poses.size(); i++)
+        {
+            tf2::fromMsg(delta.added_poses[i].pose, pose);
+            database_.updatePose(robotId, delta.added_ids[i], pose);
+        }
+        for (size_t i = 0; i < delta.moved_ids.size() && i < delta.moved_poses.size(); i++)
+        {
+            tf2::fromMsg(delta.moved_poses[i].pose, pose);
+            database_.updatePose(robotId, delta.moved_ids[i], pose);
+        }
+    }
+
+    void FleetMapServerNode::queueQuery(const std::shared_ptr<const FleetKeyFrame> &keyFrame)
+    {
+        {
+            std::lock_guard<std::mutex> lock(queriesMutex_);
+            if (queries_.size() >= maxPendingQueries_)
+            {
+                // the newest keyframes are the most likely to close a loop with what the others see now.
+                queries_.pop_front();
+                ++queriesDropped_;
+            }
+            queries_.push_back(keyFrame);
+        }
+        queriesCondition_.notify_one();
+    }
+
+    void FleetMapServerNode::workerLoop()
+    {
+        while (running_)
+        {
+            std::shared_ptr<const FleetKeyFrame> keyFrame;
+            {
+                std::unique_lock<std::mutex> lock(queriesMutex_);
+                queriesCondition_.wait(lock, [this]()
+                                       { return !running_ || !queries_.empty(); });
+                if (!running_)
+                    return;
+                keyFrame = queries_.front();
+                queries_.pop_front();
+            }
+            processQuery(*keyFrame);
+            ++queriesDone_;
+        }
+    }
+
+    void FleetMapServerNode::processQuery(const FleetKeyFrame &keyFrame)
+    {
+        if (keyFrame.points.size() < static_cast<size_t>(minInliers_))
+            return;
+        std::vector<FleetKeyFrameDatabase::Candidate> candidates;
+        database_.query(keyFrame, minBowScore_, static_cast<size_t>(std::max(0, maxCandidates_)), candidates);
+        std::vector<DescriptorMatch> matches;
+        std::vector<Eigen::Vector3f> source, target;
+        for (const auto &candidate : candidates)
+        {
+            const FleetKeyFrame &other = *candidate.keyFrame;
+            matchDescriptors(keyFrame.descriptors, other.descriptors, descriptorMaxDistance_, descriptorRatio_, matches);
+            if (matches.size() < static_cast<size_t>(minInliers_))
+                continue;
+            source.clear();
+            target.clear();
+            for (const auto &match : matches)
+            {
+                source.push_back(other.points[match.train]);
+                target.push_back(keyFrame.points[match.query]);
+            }
+            RigidAlignment alignment;
+            const uint32_t seed = static_cast<uint32_t>(keyFrame.id) * 2654435761u ^ static_cast<uint32_t>(other.id);
+            if (!estimateRigidTransformRansac(source, target, ransacIterations_, ransacInlierThreshold_, static_cast<size_t>(minInliers_), seed, alignment))
+                continue;
+
+            FleetLoop loop;
+            loop.robotA = keyFrame.robot;
+            loop.keyFrameA = keyFrame.id;
+            loop.robotB = other.robot;
+            loop.keyFrameB = other.id;
+            loop.relative = alignment.transform;
+            loop.inliers = alignment.inliers.size();
+            bool replaced;
+            {
+                std::lock_guard<std::mutex> lock(graphMutex_);
+                replaced = graph_.addLoop(loop);
+            }
+            ++loopsFound_;
+            RCLCPP_INFO_STREAM(this->get_logger(), "Loop between " << robots_[keyFrame.robot].name << " keyframe " << keyFrame.id << " and "
+                                                                  << robots_[other.robot].name << " keyframe " << other.id << ": score " << candidate.score
+                                                                  << ", " << loop.inliers << " inliers of " << matches.size() << " matches"
+                                                                  << (replaced ? "" : " (a stronger loop links these robots)"));
+            return;
+        }
+    }
+
+    void FleetMapServerNode::publishReferences()
+    {
+        std::vector<Eigen::Affine3d> references;
+        std::vector<bool> connected;
+        {
+            std::lock_guard<std::mutex> lock(graphMutex_);
+            graph_.solve(database_, anchor_, static_cast<int>(robots_.size()), references, connected);
+        }
+        for (size_t i = 0; i < robots_.size(); i++)
+        {
+            RobotState &robot = robots_[i];
+            if (!connected[i])
+                continue;
+            // the poses of the robots keep moving slightly with their bundle adjustments.
+            const Eigen::Affine3d change = robot.publishedReference.inverse() * references[i];
+            const double angle = Eigen::AngleAxisd(change.linear()).angle();
+            if (robot.referencePublished && change.translation().norm() < 1e-3 && angle < 1e-3)
+                continue;
+            geometry_msgs::msg::TransformStamped reference = tf2::eigenToTransform(references[i]);
+            reference.header.stamp = this->now();
+            reference.header.frame_id = fleetFrame_;
+            reference.child_frame_id = robot.name;
+            robot.referencePub->publish(reference);
+            robot.publishedReference = references[i];
+            robot.referencePublished = true;
+        }
+        RCLCPP_DEBUG_STREAM(this->get_logger(), "Fleet keyframes: " << database_.size() << " loops: " << loopsFound_ << " queries: " << queriesDone_
+                                                                    << " dropped: " << queriesDropped_);
+    }
+}
@@ -0,0 +1,107 @@
+/**
+ * @file fleet-map-server-node.hpp
+ * @brief Definition of the FleetMapServerNode class, place recognition across the maps of a fleet.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#ifndef FLEET_MAP_SERVER_NODE_HPP_
+#define FLEET_MAP_SERVER_NODE_HPP_
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <rclcpp/rclcpp.hpp>
+#include <geometry_msgs/msg/transform_stamped.hpp>
+#include <slam_msgs/msg/key_frame_descriptors.hpp>
+
+#include "orb_slam3_ros2_wrapper/fleet_map.hpp"
+
+namespace ORB_SLAM3_Wrapper
+{
+    /**
+     * @brief Receives the keyframe_descriptors stream of every robot, finds the places seen by two robots
+     * in a shared keyframe database and publishes the reference of each robot frame in the fleet frame on
+     * /<robot_namespace>/fleet_reference.
+     * @note The messages of a robot are handled in order on its own callback group, the place recognition
+     * queries run on a pool of worker threads. The fleet frame is the frame of the anchor robot.
+     */
+    class FleetMapServerNode : public rclcpp::Node
+    {
+    public:
+        explicit FleetMapServerNode(const rclcpp::NodeOptions &options = rclcpp::NodeOptions());
+        ~FleetMapServerNode();
+
+    private:
+        struct RobotState
+        {
+            std::string name;
+            rclcpp::CallbackGroup::SharedPtr callbackGroup;
+            rclcpp::Subscription<slam_msgs::msg::KeyFrameDescriptors>::SharedPtr descriptorsSub;
+            rclcpp::Publisher<geometry_msgs::msg::TransformStamped>::SharedPtr referencePub;
+            uint64_t lastSequence = 0;
+            uint64_t sequenceGaps = 0;
+            bool referencePublished = false;
+            Eigen::Affine3d publishedReference = Eigen::Affine3d::Identity();
+        };
+
+        void KeyFrameDescriptorsCallback(size_t robot, const slam_msgs::msg::KeyFrameDescriptors::SharedPtr msg);
+
+        /**
+         * @brief Applies the pose delta of a robot to the database.
+         */
+        void applyPoseDelta(size_t robot, const slam_msgs::msg::MapDataDelta &delta);
+
+        /**
+         * @brief Queues a place recognition query, the oldest query is dropped when the queue is full.
+         */
+        void queueQuery(const std::shared_ptr<const FleetKeyFrame> &keyFrame);
+
+        void workerLoop();
+
+        /**
+         * @brief Matches the keyframe against its candidates of the other robots, adds the first aligned one as a loop.
+         */
+        void processQuery(const FleetKeyFrame &keyFrame);
+
+        /**
+         * @brief Places the robots connected to the anchor and publishes the references that changed.
+         */
+        void publishReferences();
+
+        // ROS Params
+        std::string fleetFrame_;
+        int anchor_;
+        float minBowScore_;
+        int maxCandidates_;
+        int descriptorMaxDistance_;
+        float descriptorRatio_;
+        int ransacIterations_;
+        double ransacInlierThreshold_;
+        int minInliers_;
+        size_t maxPendingQueries_;
+
+        std::vector<RobotState> robots_;
+        FleetKeyFrameDatabase database_;
+        FleetAlignmentGraph graph_;
+        std::mutex graphMutex_;
+        rclcpp::TimerBase::SharedPtr referenceTimer_;
+        rclcpp::CallbackGroup::SharedPtr referenceCallbackGroup_;
+
+        // Worker pool
+        std::vector<std::thread> workers_;
+        std::deque<std::shared_ptr<const FleetKeyFrame>> queries_;
+        std::mutex queriesMutex_;
+        std::condition_variable queriesCondition_;
+        std::atomic<bool> running_{true};
+        std::atomic<uint64_t> queriesDone_{0};
+        std::atomic<uint64_t> queriesDropped_{0};
+        std::atomic<uint64_t> loopsFound_{0};
+    };
+}
+
+#endif
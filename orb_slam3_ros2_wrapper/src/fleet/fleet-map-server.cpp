@@ -0,0 +1,35 @@
+/**
+ * @file fleet-map-server.cpp
+ * @brief Runs the fleet map server.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+#include <iostream>
+
+#include "rclcpp/rclcpp.hpp"
+#include "fleet-map-server-node.hpp"
+
+int main(int argc, char **argv)
+{
+    rclcpp::init(argc, argv);
+    std::shared_ptr<ORB_SLAM3_Wrapper::FleetMapServerNode> node;
+    try
+    {
+        node = std::make_shared<ORB_SLAM3_Wrapper::FleetMapServerNode>();
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "\nUsage: ros2 run orb_slam3_ros2_wrapper fleet_map_server --ros-args --params-file path_to_params\n"
+                  << e.what() << std::endl;
+        rclcpp::shutdown();
+        return 1;
+    }
+    // the robots are handled in parallel, one callback group each.
+    rclcpp::executors::MultiThreadedExecutor executor;
+    executor.add_node(node);
+    executor.spin();
+    executor.remove_node(node);
+    node.reset();
+    rclcpp::shutdown();
+
+    return 0;
+}
@@ -0,0 +1,422 @@
+/**
+ * @file fleet_map.cpp
+ * @brief Place recognition and alignment of the keyframes of several robots for the fleet map server.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#include "orb_slam3_ros2_wrapper/fleet_map.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <unordered_set>
+
+namespace ORB_SLAM3_Wrapper
+{
+    BandwidthBudget::BandwidthBudget(double bytesPerSecond, double burstBytes)
+        : bytesPerSecond_(bytesPerSecond),
+          burstBytes_(std::max(burstBytes, 1.0)),
+          tokens_(burstBytes_)
+    {
+    }
+
+    void BandwidthBudget::refill(double now)
+    {
+        if (lastRefill_ >= 0.0 && now > lastRefill_)
+            tokens_ = std::min(burstBytes_, tokens_ + (now - lastRefill_) * bytesPerSecond_);
+        if (now > lastRefill_)
+            lastRefill_ = now;
+    }
+
+    bool BandwidthBudget::consume(size_t bytes, double now)
+    {
+        if (bytesPerSecond_ <= 0.0)
+            return true;
+        refill(now);
+        // a full bucket lets through a message larger than the burst, the debt is paid back before the next one.
+        if (tokens_ < static_cast<double>(bytes) && tokens_ < burstBytes_)
+            return false;
+        tokens_ -= bytes;
+        return true;
+    }
+
+    void BandwidthBudget::charge(size_t bytes, double now)
+    {
+        if (bytesPerSecond_ <= 0.0)
+            return;
+        refill(now);
+        tokens_ -= bytes;
+    }
+
+    double BandwidthBudget::available(double now)
+    {
+        if (bytesPerSecond_ <= 0.0)
+            return std::numeric_limits<double>::infinity();
+        refill(now);
+        return tokens_;
+    }
+
+    void normalizeBowVector(std::vector<std::pair<uint32_t, float>> &words)
+    {
+        std::sort(words.begin(), words.end(), [](const std::pair<uint32_t, float> &a, const std::pair<uint32_t, float> &b)
+                  { return a.first < b.first; });
+        size_t out = 0;
+        for (size_t i = 0; i < words.size(); i++)
+        {
+            if (out > 0 && words[out - 1].first == words[i].first)
+                words[out - 1].second += words[i].second;
+            else
+                words[out++] = words[i];
+        }
+        words.resize(out);
+        double norm = 0.0;
+        for (const auto &word : words)
+            norm += std::abs(word.second);
+        if (norm <= 0.0)
+            return;
+        for (auto &word : words)
+            word.second = static_cast<float>(std::abs(word.second) / norm);
+    }
+
+    float bowL1Score(const std::vector<std::pair<uint32_t, float>> &a, const std::vector<std::pair<uint32_t, float>> &b)
+    {
+        // 1 - |a - b|_1 / 2 reduces to the sum of the minimum weights of the common words.
+        float score = 0.0f;
+        size_t i = 0, j = 0;
+        while (i < a.size() && j < b.size())
+        {
+            if (a[i].first < b[j].first)
+                ++i;
+            else if (b[j].first < a[i].first)
+                ++j;
+            else
+            {
+                score += std::min(a[i].second, b[j].second);
+                ++i;
+                ++j;
+            }
+        }
+        return score;
+    }
+
+    int hammingDistance(const OrbDescriptor &a, const OrbDescriptor &b)
+    {
+        int distance = 0;
+        for (size_t i = 0; i < a.size(); i += sizeof(uint64_t))
+        {
+            uint64_t wordA, wordB;
+            std::memcpy(&wordA, a.data() + i, sizeof(uint64_t));
+            std::memcpy(&wordB, b.data() + i, sizeof(uint64_t));
+            distance += __builtin_popcountll(wordA ^ wordB);
+        }
+        return distance;
+    }
+
+    void matchDescriptors(const std::vector<OrbDescriptor> &query, const std::vector<OrbDescriptor> &train,
+                          int maxDistance, float ratio, std::vector<DescriptorMatch> &matches)
+    {
+        matches.clear();
+        if (train.empty())
+            return;
+        // best query per train descriptor, so that a train descriptor is used once.
+        std::vector<int> bestQuery(train.size(), -1);
+        std::vector<int> bestQueryDistance(train.size(), std::numeric_limits<int>::max());
+        for (size_t q = 0; q < query.size(); q++)
+        {
+            int best = std::numeric_limits<int>::max();
+            int second = std::numeric_limits<int>::max();
+            size_t bestTrain = 0;
+            for (size_t t = 0; t < train.size(); t++)
+            {
+                const int distance = hammingDistance(query[q], train[t]);
+                if (distance < best)
+                {
+                    second = best;
+                    best = distance;
+                    bestTrain = t;
+                }
+                else if (distance < second)
+                    second = distance;
+            }
+            if (best > maxDistance)
+                continue;
+            if (second != std::numeric_limits<int>::max() && static_cast<float>(best) >= ratio * static_cast<float>(second))
+                continue;
+            if (best < bestQueryDistance[bestTrain])
+            {
+                bestQueryDistance[bestTrain] = best;
+                bestQuery[bestTrain] = static_cast<int>(q);
+            }
+        }
+        for (size_t t = 0; t < train.size(); t++)
+        {
+            if (bestQuery[t] >= 0)
+                matches.push_back(DescriptorMatch{static_cast<size_t>(bestQuery[t]), t});
+        }
+    }
+
+    namespace
+    {
+        Eigen::Affine3d fitRigid(const std::vector<Eigen::Vector3f> &source, const std::vector<Eigen::Vector3f> &target,
+                                 const std::vector<size_t> &indices)
+        {
+            Eigen::Matrix3Xd src(3, indices.size());
+            Eigen::Matrix3Xd dst(3, indices.size());
+            for (size_t i = 0; i < indices.size(); i++)
+            {
+                src.col(i) = source[indices[i]].cast<double>();
+                dst.col(i) = target[indices[i]].cast<double>();
+            }
+            return Eigen::Affine3d(Eigen::umeyama(src, dst, false));
+        }
+
+        void findInliers(const std::vector<Eigen::Vector3f> &source, const std::vector<Eigen::Vector3f> &target,
+                         const Eigen::Affine3d &transform, double inlierThreshold, std::vector<size_t> &inliers)
+        {
+            inliers.clear();
+            const double squaredThreshold = inlierThreshold * inlierThreshold;
+            for (size_t i = 0; i < source.size(); i++)
+            {
+                if ((transform * source[i].cast<double>() - target[i].cast<double>()).squaredNorm() < squaredThreshold)
+                    inliers.push_back(i);
+            }
+        }
+    }
+
+    bool estimateRigidTransformRansac(const std::vector<Eigen::Vector3f> &source, const std::vector<Eigen::Vector3f> &target,
+                                      int iterations, double inlierThreshold, size_t minInliers, uint32_t seed,
+                                      RigidAlignment &result)
+    {
+        result = RigidAlignment();
+        if (source.size() != target.size() || source.size() < std::max<size_t>(minInliers, 3))
+            return false;
+        std::mt19937 random(seed);
+        std::uniform_int_distribution<size_t> pick(0, source.size() - 1);
+        std::vector<size_t> sample(3);
+        std::vector<size_t> inliers;
+        for (int it = 0; it < iterations; it++)
+        {
+            sample[0] = pick(random);
+            sample[1] = pick(random);
+            sample[2] = pick(random);
+            if (sample[0] == sample[1] || sample[0] == sample[2] || sample[1] == sample[2])
+                continue;
+            // nearly collinear samples do not fix the rotation.
+            const Eigen::Vector3f u = source[sample[1]] - source[sample[0]];
+            const Eigen::Vector3f v = source[sample[2]] - source[sample[0]];
+            if (u.cross(v).norm() < 1e-4f)
+                continue;
+            const Eigen::Affine3d hypothesis = fitRigid(source, target, sample);
+            findInliers(source, target, hypothesis, inlierThreshold, inliers);
+            if (inliers.size() > result.inliers.size())
+            {
+                result.transform = hypothesis;
+                result.inliers = inliers;
+            }
+        }
+        if (result.inliers.size() < std::max<size_t>(minInliers, 3))
+            return false;
+        // refit on every inlier, keep the refit only if it does not lose support.
+        const Eigen::Affine3d refined = fitRigid(source, target, result.inliers);
+        findInliers(source, target, refined, inlierThreshold, inliers);
+        if (inliers.size() >= result.inliers.size())
+        {
+            result.transform = refined;
+            result.inliers = inliers;
+        }
+        return result.inliers.size() >= minInliers;
+    }
+
+    void FleetKeyFrameDatabase::add(const std::shared_ptr<const FleetKeyFrame> &keyFrame, const Eigen::Affine3d &pose)
+    {
+        std::unique_lock<std::shared_timed_mutex> lock(mutex_);
+        const uint64_t keyFrameKey = key(keyFrame->robot, keyFrame->id);
+        removeLocked(keyFrameKey);
+        keyFrames_[keyFrameKey] = Entry{keyFrame, pose};
+        for (const auto &word : keyFrame->words)
+            invertedIndex_[word.first].push_back(keyFrameKey);
+    }
+
+    void FleetKeyFrameDatabase::removeLocked(uint64_t keyFrameKey)
+    {
+        auto it = keyFrames_.find(keyFrameKey);
+        if (it == keyFrames_.end())
+            return;
+        for (const auto &word : it->second.keyFrame->words)
+        {
+            auto postings = invertedIndex_.find(word.first);
+            if (postings == invertedIndex_.end())
+                continue;
+            auto &list = postings->second;
+            list.erase(std::remove(list.begin(), list.end(), keyFrameKey), list.end());
+            if (list.empty())
+                invertedIndex_.erase(postings);
+        }
+        keyFrames_.erase(it);
+    }
+
+    void FleetKeyFrameDatabase::remove(int robot, int32_t id)
+    {
+        std::unique_lock<std::shared_timed_mutex> lock(mutex_);
+        removeLocked(key(robot, id));
+    }
+
+    void FleetKeyFrameDatabase::retain(int robot, const std::vector<int32_t> &ids)
+    {
+        std::unordered_set<uint64_t> kept;
+        kept.reserve(ids.size());
+        for (auto id : ids)
+            kept.insert(key(robot, id));
+        std::unique_lock<std::shared_timed_mutex> lock(mutex_);
+        std::vector<uint64_t> removed;
+        for (const auto &entry : keyFrames_)
+        {
+            if (entry.second.keyFrame->robot == robot && kept.count(entry.first) == 0)
+                removed.push_back(entry.first);
+        }
+        for (auto keyFrameKey : removed)
+            removeLocked(keyFrameKey);
+    }
+
+    bool FleetKeyFrameDatabase::updatePose(int robot, int32_t id, const Eigen::Affine3d &pose)
+    {
+        std::unique_lock<std::shared_timed_mutex> lock(mutex_);
+        auto it = keyFrames_.find(key(robot, id));
+        if (it == keyFrames_.end())
+            return false;
+        it->second.pose = pose;
+        return true;
+    }
+
+    bool FleetKeyFrameDatabase::pose(int robot, int32_t id, Eigen::Affine3d &pose) const
+    {
+        std::shared_lock<std::shared_timed_mutex> lock(mutex_);
+        auto it = keyFrames_.find(key(robot, id));
+        if (it == keyFrames_.end())
+            return false;
+        pose = it->second.pose;
+        return true;
+    }
+
+    void FleetKeyFrameDatabase::query(const FleetKeyFrame &keyFrame, float minScore, size_t maxCandidates, std::vector<Candidate> &candidates) const
+    {
+        candidates.clear();
+        std::shared_lock<std::shared_timed_mutex> lock(mutex_);
+        // only the keyframes sharing a word with the query are scored.
+        std::unordered_map<uint64_t, float> scores;
+        for (const auto &word : keyFrame.words)
+        {
+            auto postings = invertedIndex_.find(word.first);
+            if (postings == invertedIndex_.end())
+                continue;
+            for (auto keyFrameKey : postings->second)
+            {
+                const FleetKeyFrame &other = *keyFrames_.at(keyFrameKey).keyFrame;
+                if (other.robot == keyFrame.robot)
+                    continue;
+                // the words of a keyframe are unique, so the minimum weight is found by a binary search.
+                auto otherWord = std::lower_bound(other.words.begin(), other.words.end(), word.first,
+                                                  [](const std::pair<uint32_t, float> &w, uint32_t id)
+                                                  { return w.first < id; });
+                scores[keyFrameKey] += std::min(word.second, otherWord->second);
+            }
+        }
+        for (const auto &score : scores)
+        {
+            if (score.second >= minScore)
+                candidates.push_back(Candidate{keyFrames_.at(score.first).keyFrame, score.second});
+        }
+        std::sort(candidates.begin(), candidates.end(), [](const Candidate &a, const Candidate &b)
+                  { return a.score > b.score; });
+        if (maxCandidates > 0 && candidates.size() > maxCandidates)
+            candidates.resize(maxCandidates);
+    }
+
+    size_t FleetKeyFrameDatabase::size() const
+    {
+        std::shared_lock<std::shared_timed_mutex> lock(mutex_);
+        return keyFrames_.size();
+    }
+
+    size_t FleetKeyFrameDatabase::size(int robot) const
+    {
+        std::shared_lock<std::shared_timed_mutex> lock(mutex_);
+        size_t count = 0;
+        for (const auto &entry : keyFrames_)
+        {
+            if (entry.second.keyFrame->robot == robot)
+                ++count;
+        }
+        return count;
+    }
+
+    bool FleetAlignmentGraph::addLoop(const FleetLoop &loop)
+    {
+        FleetLoop stored = loop;
+        if (stored.robotA > stored.robotB)
+        {
+            std::swap(stored.robotA, stored.robotB);
+            std::swap(stored.keyFrameA, stored.keyFrameB);
+            stored.relative = loop.relative.inverse();
+        }
+        const auto pair = std::make_pair(stored.robotA, stored.robotB);
+        auto it = loops_.find(pair);
+        if (it != loops_.end() && it->second.inliers > stored.inliers)
+            return false;
+        loops_[pair] = stored;
+        return true;
+    }
+
+    void FleetAlignmentGraph::solve(const FleetKeyFrameDatabase &database, int anchor, int numRobots,
+                                    std::vector<Eigen::Affine3d> &references, std::vector<bool> &connected) const
+    {
+        references.assign(numRobots, Eigen::Affine3d::Identity());
+        connected.assign(numRobots, false);
+        if (anchor < 0 || anchor >= numRobots)
+            return;
+
+        // transform from the frame of robotB to the frame of robotA, from the current keyframe poses.
+        struct Edge
+        {
+            int robotA;
+            int robotB;
+            Eigen::Affine3d transform;
+            size_t inliers;
+        };
+        std::vector<Edge> edges;
+        for (const auto &entry : loops_)
+        {
+            const FleetLoop &loop = entry.second;
+            if (loop.robotA < 0 || loop.robotB < 0 || loop.robotA >= numRobots || loop.robotB >= numRobots)
+                continue;
+            Eigen::Affine3d poseA, poseB;
+            // a loop whose keyframe was culled is dropped until a new one is found.
+            if (!database.pose(loop.robotA, loop.keyFrameA, poseA) || !database.pose(loop.robotB, loop.keyFrameB, poseB))
+                continue;
+            edges.push_back(Edge{loop.robotA, loop.robotB, poseA * loop.relative * poseB.inverse(), loop.inliers});
+        }
+
+        connected[anchor] = true;
+        while (true)
+        {
+            const Edge *best = nullptr;
+            for (const auto &edge : edges)
+            {
+                if (connected[edge.robotA] == connected[edge.robotB])
+                    continue;
+                if (best == nullptr || edge.inliers > best->inliers)
+                    best = &edge;
+            }
+            if (best == nullptr)
+                break;
+            if (connected[best->robotA])
+                references[best->robotB] = references[best->robotA] * best->transform;
+            else
+                references[best->robotA] = references[best->robotB] * best->transform.inverse();
+            connected[best->robotA] = true;
+            connected[best->robotB] = true;
+        }
+    }
+}
@@ -0,0 +1,293 @@
+/**
+ * @file instrumentation.cpp
+ * @brief Lock-free latency histograms, gauges and their Prometheus text export.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#include "orb_slam3_ros2_wrapper/instrumentation.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <sstream>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace ORB_SLAM3_Wrapper
+{
+    constexpr size_t LatencyHistogram::kSubBucketBits;
+    constexpr size_t LatencyHistogram::kSubBuckets;
+    constexpr size_t LatencyHistogram::kMaxExponent;
+    constexpr size_t LatencyHistogram::kNumBuckets;
+
+    HistogramSnapshot HistogramSnapshot::since(const HistogramSnapshot &previous) const
+    {
+        HistogramSnapshot window = *this;
+        if (previous.counts.size() != counts.size())
+            return window;
+        for (size_t i = 0; i < counts.size(); i++)
+            window.counts[i] -= std::min(window.counts[i], previous.counts[i]);
+        window.count -= std::min(count, previous.count);
+        window.sumNs -= std::min(sumNs, previous.sumNs);
+        return window;
+    }
+
+    double HistogramSnapshot::quantileNs(double q) const
+    {
+        uint64_t total = 0;
+        for (auto c : counts)
+            total += c;
+        if (total == 0)
+            return 0.0;
+        const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(q * total)));
+        uint64_t cumulative = 0;
+        for (size_t i = 0; i < counts.size(); i++)
+        {
+            cumulative += counts[i];
+            if (cumulative >= rank)
+                return LatencyHistogram::bucketValue(i);
+        }
+        return maxNs();
+    }
+
+    double HistogramSnapshot::maxNs() const
+    {
+        for (size_t i = counts.size(); i > 0; i--)
+        {
+            if (counts[i - 1] > 0)
+                return LatencyHistogram::bucketUpperBound(i - 1);
+        }
+        return 0.0;
+    }
+
+    LatencyHistogram::LatencyHistogram()
+        : count_(0), sumNs_(0)
+    {
+        for (auto &c : counts_)
+            c.store(0, std::memory_order_relaxed);
+    }
+
+    size_t LatencyHistogram::bucketIndex(uint64_t ns)
+    {
+        if (ns < kSubBuckets)
+            return static_cast<size_t>(ns);
+        const size_t exponent = 63 - __builtin_clzll(ns);
+        if (exponent > kMaxExponent)
+            return kNumBuckets - 1;
+        const size_t sub = static_cast<size_t>(ns >> (exponent - kSubBucketBits)) & (kSubBuckets - 1);
+        return (exponent - kSubBucketBits + 1) * kSubBuckets + sub;
+    }
+
+    double LatencyHistogram::bucketValue(size_t index)
+    {
+        if (index < kSubBuckets)
+            return static_cast<double>(index);
+        const size_t exponent = index / kSubBuckets + kSubBucketBits - 1;
+        const double width = std::ldexp(1.0, static_cast<int>(exponent - kSubBucketBits));
+        const double lower = (kSubBuckets + index % kSubBuckets) * width;
+        return lower + 0.5 * (width - 1.0);
+    }
+
+    double LatencyHistogram::bucketUpperBound(size_t index)
+    {
+        if (index < kSubBuckets)
+            return static_cast<double>(index);
+        const size_t exponent = index / kSubBuckets + kSubBucketBits - 1;
+        const double width = std::ldexp(1.0, static_cast<int>(exponent - kSubBucketBits));
+        return (kSubBuckets + index % kSubBuckets + 1) * width - 1.0;
+    }
+
+    void LatencyHistogram::record(uint64_t ns)
+    {
+        counts_[bucketIndex(ns)].fetch_add(1, std::memory_order_relaxed);
+        count_.fetch_add(1, std::memory_order_relaxed);
+        sumNs_.fetch_add(ns, std::memory_order_relaxed);
+    }
+
+    HistogramSnapshot LatencyHistogram::snapshot() const
+    {
+        HistogramSnapshot snapshot;
+        snapshot.counts.resize(kNumBuckets);
+        for (size_t i = 0; i < kNumBuckets; i++)
+            snapshot.counts[i] = counts_[i].load(std::memory_order_relaxed);
+        snapshot.count = count_.load(std::memory_order_relaxed);
+        snapshot.sumNs = sumNs_.load(std::memory_order_relaxed);
+        return snapshot;
+    }
+
+    LatencyHistogram &MetricsRegistry::histogram(const std::string &name, const std::string &help)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto &entry = histograms_[name];
+        if (!entry.histogram)
+        {
+            entry.help = help;
+            entry.histogram.reset(new LatencyHistogram());
+        }
+        return *entry.histogram;
+    }
+
+    Gauge &MetricsRegistry::gauge(const std::string &name, const std::string &help)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto &entry = gauges_[name];
+        if (!entry.gauge)
+        {
+            entry.help = help;
+            entry.gauge.reset(new Gauge());
+        }
+        return *entry.gauge;
+    }
+
+    std::vector<MetricSample> MetricsRegistry::collect(std::map<std::string, HistogramSnapshot> &windows) const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::vector<MetricSample> samples;
+        samples.reserve(histograms_.size() + gauges_.size());
+        for (const auto &entry : histograms_)
+        {
+            const HistogramSnapshot current = entry.second.histogram->snapshot();
+            auto &previous = windows[entry.first];
+            const HistogramSnapshot window = current.since(previous);
+            previous = current;
+
+            MetricSample sample;
+            sample.name = entry.first;
+            sample.help = entry.second.help;
+            sample.isLatency = true;
+            sample.count = current.count;
+            sample.sumSeconds = current.sumNs * 1e-9;
+            sample.windowCount = window.count;
+            sample.p50Seconds = window.quantileNs(0.5) * 1e-9;
+            sample.p99Seconds = window.quantileNs(0.99) * 1e-9;
+            sample.maxSeconds = window.maxNs() * 1e-9;
+            samples.push_back(sample);
+        }
+        for (const auto &entry : gauges_)
+        {
+            MetricSample sample;
+            sample.name = entry.first;
+            sample.help = entry.second.help;
+            sample.value = entry.second.gauge->get();
+            samples.push_back(sample);
+        }
+        return samples;
+    }
+
+    std::string formatPrometheus(const std::vector<MetricSample> &samples, const std::string &prefix)
+    {
+        std::ostringstream out;
+        for (const auto &sample : samples)
+        {
+            if (sample.isLatency)
+            {
+                const std::string name = prefix + "_" + sample.name + "_seconds";
+                if (!sample.help.empty())
+                    out << "# HELP " << name << " " << sample.help << "\n";
+                out << "# TYPE " << name << " summary\n";
+                out << name << "{quantile=\"0.5\"} " << sample.p50Seconds << "\n";
+                out << name << "{quantile=\"0.99\"} " << sample.p99Seconds << "\n";
+                out << name << "_sum " << sample.sumSeconds << "\n";
+                out << name << "_count " << sample.count << "\n";
+            }
+            else
+            {
+                const std::string name = prefix + "_" + sample.name;
+                if (!sample.help.empty())
+                    out << "# HELP " << name << " " << sample.help << "\n";
+                out << "# TYPE " << name << " gauge\n";
+                out << name << " " << sample.value << "\n";
+            }
+        }
+        return out.str();
+    }
+
+    PrometheusExporter::PrometheusExporter(std::shared_ptr<MetricsRegistry> registry, int port, const std::string &prefix)
+        : registry_(registry), port_(port), prefix_(prefix)
+    {
+    }
+
+    PrometheusExporter::~PrometheusExporter()
+    {
+        stop();
+    }
+
+    bool PrometheusExporter::start()
+    {
+        listenFd_ = socket(AF_INET, SOCK_STREAM, 0);
+        if (listenFd_ < 0)
+        {
+            std::cerr << "Prometheus exporter: could not create the socket." << std::endl;
+            return false;
+        }
+        int reuse = 1;
+        setsockopt(listenFd_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_ANY);
+        address.sin_port = htons(static_cast<uint16_t>(port_));
+        if (bind(listenFd_, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0 || listen(listenFd_, 4) < 0)
+        {
+            std::cerr << "Prometheus exporter: could not listen on port " << port_ << "." << std::endl;
+            close(listenFd_);
+            listenFd_ = -1;
+            return false;
+        }
+        running_ = true;
+        thread_ = std::thread(&PrometheusExporter::serve, this);
+        return true;
+    }
+
+    void PrometheusExporter::stop()
+    {
+        running_ = false;
+        if (thread_.joinable())
+            thread_.join();
+        if (listenFd_ >= 0)
+        {
+            close(listenFd_);
+            listenFd_ = -1;
+        }
+    }
+
+    void PrometheusExporter::serve()
+    {
+        while (running_)
+        {
+            // the timeout bounds the time stop() waits for the thread.
+            pollfd listenPoll{listenFd_, POLLIN, 0};
+            if (poll(&listenPoll, 1, 200) <= 0)
+                continue;
+            int clientFd = accept(listenFd_, nullptr, nullptr);
+            if (clientFd < 0)
+                continue;
+            // the request itself is not parsed, every path returns the metrics.
+            char request[1024];
+            pollfd clientPoll{clientFd, POLLIN, 0};
+            if (poll(&clientPoll, 1, 200) > 0)
+                (void)recv(clientFd, request, sizeof(request), 0);
+
+            const std::string body = formatPrometheus(registry_->collect(windows_), prefix_);
+            std::ostringstream response;
+            response << "HTTP/1.0 200 OK\r\n"
+                     << "Content-Type: text/plain; version=0.0.4\r\n"
+                     << "Content-Length: " << body.size() << "\r\n"
+                     << "Connection: close\r\n\r\n"
+                     << body;
+            const std::string payload = response.str();
+            size_t sent = 0;
+            while (sent < payload.size())
+            {
+                ssize_t n = send(clientFd, payload.data() + sent, payload.size() - sent, MSG_NOSIGNAL);
+                if (n <= 0)
+                    break;
+                sent += static_cast<size_t>(n);
+            }
+            close(clientFd);
+        }
+    }
+}
@@ -0,0 +1,182 @@
+/**
+ * @file keyframe_store.cpp
+ * @brief Memory-mapped store of the keyframes in the output-side keyframe cache.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#include "orb_slam3_ros2_wrapper/keyframe_store.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace ORB_SLAM3_Wrapper
+{
+    constexpr uint32_t StoredMapPoint::kReferenceKeyFrame;
+
+    MappedKeyFrameStore::MappedKeyFrameStore(const std::string &path)
+        : path_(path)
+    {
+    }
+
+    MappedKeyFrameStore::~MappedKeyFrameStore()
+    {
+        close();
+        if (!path_.empty())
+            ::unlink(path_.c_str());
+    }
+
+    bool MappedKeyFrameStore::open(size_t initialCapacity)
+    {
+        close();
+        fd_ = ::open(path_.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+        if (fd_ < 0)
+        {
+            std::cerr << "Keyframe store: could not open " << path_ << std::endl;
+            return false;
+        }
+        if (!reserve(std::max<size_t>(initialCapacity, 4096)))
+        {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void MappedKeyFrameStore::close()
+    {
+        if (data_ != nullptr)
+            ::munmap(data_, capacity_);
+        if (fd_ >= 0)
+            ::close(fd_);
+        data_ = nullptr;
+        fd_ = -1;
+        capacity_ = 0;
+        end_ = 0;
+        deadBytes_ = 0;
+        numPoints_ = 0;
+        index_.clear();
+    }
+
+    bool MappedKeyFrameStore::reserve(size_t bytes)
+    {
+        if (fd_ < 0)
+            return false;
+        if (bytes <= capacity_)
+            return true;
+        size_t capacity = std::max<size_t>(capacity_, 4096);
+        while (capacity < bytes)
+            capacity *= 2;
+        if (::ftruncate(fd_, static_cast<off_t>(capacity)) != 0)
+        {
+            std::cerr << "Keyframe store: could not grow " << path_ << " to " << capacity << " bytes." << std::endl;
+            return false;
+        }
+        void *data = ::mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+        if (data == MAP_FAILED)
+        {
+            std::cerr << "Keyframe store: could not map " << path_ << std::endl;
+            return false;
+        }
+        if (data_ != nullptr)
+            ::munmap(data_, capacity_);
+        data_ = static_cast<char *>(data);
+        capacity_ = capacity;
+        return true;
+    }
+
+    void MappedKeyFrameStore::compact()
+    {
+        // records only ever move towards the start, so they are moved in offset order.
+        std::vector<std::pair<size_t, uint64_t>> records;
+        records.reserve(index_.size());
+        for (const auto &entry : index_)
+            records.emplace_back(entry.second, entry.first);
+        std::sort(records.begin(), records.end());
+        size_t end = 0;
+        for (const auto &record : records)
+        {
+            StoredKeyFrame header;
+            std::memcpy(&header, data_ + record.first, sizeof(header));
+            const size_t size = recordSize(header.numPoints);
+            if (record.first != end)
+                std::memmove(data_ + end, data_ + record.first, size);
+            index_[record.second] = end;
+            end += size;
+        }
+        end_ = end;
+        deadBytes_ = 0;
+    }
+
+    bool MappedKeyFrameStore::put(const StoredKeyFrame &keyFrame, const std::vector<StoredMapPoint> &points)
+    {
+        if (data_ == nullptr)
+            return false;
+        erase(keyFrame.id);
+        const size_t size = recordSize(static_cast<uint32_t>(points.size()));
+        if (end_ + size > capacity_ && deadBytes_ > liveBytes())
+            compact();
+        if (!reserve(end_ + size))
+            return false;
+
+        StoredKeyFrame header = keyFrame;
+        header.numPoints = static_cast<uint32_t>(points.size());
+        header.reserved = 0;
+        std::memcpy(data_ + end_, &header, sizeof(header));
+        if (!points.empty())
+            std::memcpy(data_ + end_ + sizeof(header), points.data(), points.size() * sizeof(StoredMapPoint));
+        index_[keyFrame.id] = end_;
+        end_ += size;
+        numPoints_ += points.size();
+        return true;
+    }
+
+    const StoredKeyFrame *MappedKeyFrameStore::find(uint64_t id, const StoredMapPoint **points) const
+    {
+        auto it = index_.find(id);
+        if (it == index_.end())
+            return nullptr;
+        // every record size is a multiple of 8, so the records stay aligned in the mapping.
+        const StoredKeyFrame *header = reinterpret_cast<const StoredKeyFrame *>(data_ + it->second);
+        if (points != nullptr)
+            *points = reinterpret_cast<const StoredMapPoint *>(data_ + it->second + sizeof(StoredKeyFrame));
+        return header;
+    }
+
+    bool MappedKeyFrameStore::get(uint64_t id, StoredKeyFrame &keyFrame, std::vector<StoredMapPoint> *points) const
+    {
+        const StoredMapPoint *storedPoints;
+        const StoredKeyFrame *header = find(id, &storedPoints);
+        if (header == nullptr)
+            return false;
+        keyFrame = *header;
+        if (points != nullptr)
+            points->insert(points->end(), storedPoints, storedPoints + header->numPoints);
+        return true;
+    }
+
+    bool MappedKeyFrameStore::erase(uint64_t id)
+    {
+        auto it = index_.find(id);
+        if (it == index_.end())
+            return false;
+        StoredKeyFrame header;
+        std::memcpy(&header, data_ + it->second, sizeof(header));
+        deadBytes_ += recordSize(header.numPoints);
+        numPoints_ -= header.numPoints;
+        index_.erase(it);
+        return true;
+    }
+
+    void MappedKeyFrameStore::clear()
+    {
+        index_.clear();
+        end_ = 0;
+        deadBytes_ = 0;
+        numPoints_ = 0;
+    }
+}
@@ -0,0 +1,260 @@
+/**
+ * @file map_archive.cpp
+ * @brief Chunked zstd streams for the persisted Atlas, and the files ORB_SLAM3 needs to load it.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#include "orb_slam3_ros2_wrapper/map_archive.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <openssl/evp.h>
+#include <zstd.h>
+
+namespace ORB_SLAM3_Wrapper
+{
+    namespace
+    {
+        const char kMagic[8] = {'O', 'R', 'B', 'M', 'A', 'P', 'Z', '1'};
+        // bounds the memory a corrupt chunk header can make the reader allocate.
+        const uint32_t kMaxChunkSize = 64u << 20;
+    }
+
+    CompressedChunkWriter::CompressedChunkWriter(std::ostream &sink, size_t chunkSize, int level)
+        : sink_(sink), context_(ZSTD_createCCtx()), raw_(std::max<size_t>(chunkSize, 1))
+    {
+        // the frame checksum makes a corrupt chunk fail to decompress instead of decoding to garbage.
+        ZSTD_CCtx_setParameter(static_cast<ZSTD_CCtx *>(context_), ZSTD_c_compressionLevel, level);
+        ZSTD_CCtx_setParameter(static_cast<ZSTD_CCtx *>(context_), ZSTD_c_checksumFlag, 1);
+        if (raw_.size() > kMaxChunkSize)
+            raw_.resize(kMaxChunkSize);
+        setp(raw_.data(), raw_.data() + raw_.size());
+        sink_.write(kMagic, sizeof(kMagic));
+        compressedBytes_ += sizeof(kMagic);
+        failed_ = !sink_.good();
+    }
+
+    CompressedChunkWriter::~CompressedChunkWriter()
+    {
+        if (!finished_)
+            finish();
+        ZSTD_freeCCtx(static_cast<ZSTD_CCtx *>(context_));
+    }
+
+    bool CompressedChunkWriter::flushChunk()
+    {
+        const size_t size = static_cast<size_t>(pptr() - pbase());
+        if (size == 0 || failed_)
+            return !failed_;
+        compressed_.resize(ZSTD_compressBound(size));
+        const size_t compressedSize = ZSTD_compress2(static_cast<ZSTD_CCtx *>(context_), compressed_.data(), compressed_.size(), raw_.data(), size);
+        if (ZSTD_isError(compressedSize))
+        {
+            failed_ = true;
+            return false;
+        }
+        const uint32_t header[2] = {static_cast<uint32_t>(size), static_cast<uint32_t>(compressedSize)};
+        sink_.write(reinterpret_cast<const char *>(header), sizeof(header));
+        sink_.write(compressed_.data(), compressedSize);
+        rawBytes_ += size;
+        compressedBytes_ += sizeof(header) + compressedSize;
+        failed_ = !sink_.good();
+        setp(raw_.data(), raw_.data() + raw_.size());
+        return !failed_;
+    }
+
+    CompressedChunkWriter::int_type CompressedChunkWriter::overflow(int_type ch)
+    {
+        if (finished_ || !flushChunk())
+            return traits_type::eof();
+        if (!traits_type::eq_int_type(ch, traits_type::eof()))
+        {
+            *pptr() = traits_type::to_char_type(ch);
+            pbump(1);
+        }
+        return traits_type::not_eof(ch);
+    }
+
+    int CompressedChunkWriter::sync()
+    {
+        // a flush of the stream closes the current chunk so that it reaches the sink.
+        if (finished_ || !flushChunk())
+            return -1;
+        sink_.flush();
+        return sink_.good() ? 0 : -1;
+    }
+
+    bool CompressedChunkWriter::finish()
+    {
+        if (finished_)
+            return !failed_;
+        flushChunk();
+        finished_ = true;
+        const uint32_t end[2] = {0, 0};
+        sink_.write(reinterpret_cast<const char *>(end), sizeof(end));
+        compressedBytes_ += sizeof(end);
+        sink_.flush();
+        failed_ = failed_ || !sink_.good();
+        return !failed_;
+    }
+
+    CompressedChunkReader::CompressedChunkReader(std::istream &source)
+        : source_(source), context_(ZSTD_createDCtx())
+    {
+        char magic[sizeof(kMagic)];
+        source_.read(magic, sizeof(magic));
+        failed_ = !source_ || std::memcmp(magic, kMagic, sizeof(kMagic)) != 0;
+        setg(nullptr, nullptr, nullptr);
+    }
+
+    CompressedChunkReader::~CompressedChunkReader()
+    {
+        ZSTD_freeDCtx(static_cast<ZSTD_DCtx *>(context_));
+    }
+
+    CompressedChunkReader::int_type CompressedChunkReader::underflow()
+    {
+        if (gptr() < egptr())
+            return traits_type::to_int_type(*gptr());
+        if (failed_ || complete_)
+            return traits_type::eof();
+
+        uint32_t header[2];
+        source_.read(reinterpret_cast<char *>(header), sizeof(header));
+        if (!source_)
+        {
+            // truncated, the end marker is missing.
+            failed_ = true;
+            return traits_type::eof();
+        }
+        const uint32_t size = header[0];
+        const uint32_t compressedSize = header[1];
+        if (size == 0)
+        {
+            complete_ = true;
+            failed_ = compressedSize != 0;
+            return traits_type::eof();
+        }
+        if (size > kMaxChunkSize || compressedSize > ZSTD_compressBound(size))
+        {
+            failed_ = true;
+            return traits_type::eof();
+        }
+        compressed_.resize(compressedSize);
+        source_.read(compressed_.data(), compressedSize);
+        raw_.resize(size);
+        if (!source_ || ZSTD_decompressDCtx(static_cast<ZSTD_DCtx *>(context_), raw_.data(), size, compressed_.data(), compressedSize) != size)
+        {
+            failed_ = true;
+            return traits_type::eof();
+        }
+        setg(raw_.data(), raw_.data(), raw_.data() + size);
+        return traits_type::to_int_type(*gptr());
+    }
+
+    TemporaryFile::TemporaryFile(const std::string &suffix)
+    {
+        std::string pattern = "/tmp/orb_slam3_wrapper_XXXXXX" + suffix;
+        std::vector<char> path(pattern.begin(), pattern.end());
+        path.push_back('\0');
+        const int fd = mkstemps(path.data(), static_cast<int>(suffix.size()));
+        if (fd < 0)
+            return;
+        close(fd);
+        path_ = path.data();
+    }
+
+    TemporaryFile::~TemporaryFile()
+    {
+        if (!path_.empty())
+            std::remove(path_.c_str());
+    }
+
+    bool decompressMapArchive(const std::string &archivePath, const std::string &outputPath, std::string &message)
+    {
+        std::ifstream archive(archivePath, std::ios::binary);
+        if (!archive)
+        {
+            message = "Could not open " + archivePath;
+            return false;
+        }
+        CompressedChunkReader reader(archive);
+        if (!reader.valid())
+        {
+            message = archivePath + " is not a map archive.";
+            return false;
+        }
+        std::ofstream output(outputPath, std::ios::binary);
+        if (!output)
+        {
+            message = "Could not write " + outputPath;
+            return false;
+        }
+        std::istream stream(&reader);
+        std::vector<char> buffer(1 << 16);
+        while (stream.read(buffer.data(), buffer.size()) || stream.gcount() > 0)
+            output.write(buffer.data(), stream.gcount());
+        output.flush();
+        if (!reader.valid() || !reader.complete())
+        {
+            message = archivePath + " is corrupt or truncated.";
+            return false;
+        }
+        if (!output)
+        {
+            message = "Could not write " + outputPath;
+            return false;
+        }
+        return true;
+    }
+
+    bool writeSettingsLoadingAtlas(const std::string &settingsPath, const std::string &outputPath, const std::string &atlasBasePath)
+    {
+        std::ifstream settings(settingsPath);
+        std::ofstream output(outputPath);
+        if (!settings || !output)
+            return false;
+        const std::string key = "System.LoadAtlasFromFile";
+        std::string line;
+        while (std::getline(settings, line))
+        {
+            const size_t start = line.find_first_not_of(" \t");
+            if (start != std::string::npos && line.compare(start, key.size(), key) == 0)
+                continue;
+            output << line << "\n";
+        }
+        output << key << ": \"" << atlasBasePath << "\"\n";
+        return output.good();
+    }
+
+    std::string vocabularyChecksum(const std::string &vocabularyPath)
+    {
+        // same reads as ORB_SLAM3::System::CalculateCheckSum so the checksums compare equal.
+        std::ifstream file(vocabularyPath.c_str(), std::ios::in);
+        if (!file.is_open())
+            return "";
+        std::unique_ptr<EVP_MD_CTX, void (*)(EVP_MD_CTX *)> context(EVP_MD_CTX_new(), EVP_MD_CTX_free);
+        EVP_DigestInit_ex(context.get(), EVP_md5(), nullptr);
+        char buffer[1024];
+        while (std::streamsize count = file.readsome(buffer, sizeof(buffer)))
+            EVP_DigestUpdate(context.get(), buffer, count);
+        unsigned char digest[EVP_MAX_MD_SIZE];
+        unsigned int digestSize = 0;
+        EVP_DigestFinal_ex(context.get(), digest, &digestSize);
+        std::string checksum;
+        for (unsigned int i = 0; i < digestSize; i++)
+        {
+            char hex[3];
+            std::snprintf(hex, sizeof(hex), "%02x", digest[i]);
+            checksum += hex;
+        }
+        return checksum;
+    }
+}
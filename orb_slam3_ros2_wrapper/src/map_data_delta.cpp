@@ -0,0 +1,109 @@
+/**
+ * @file map_data_delta.cpp
+ * @brief Encoder turning successive MapGraph messages into MapDataDelta messages.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#include "orb_slam3_ros2_wrapper/map_data_delta.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_set>
+
+namespace ORB_SLAM3_Wrapper
+{
+    MapDataDeltaEncoder::MapDataDeltaEncoder(double translationThreshold, double rotationThreshold, int snapshotInterval)
+        : translationThreshold_(translationThreshold),
+          rotationThreshold_(rotationThreshold),
+          snapshotInterval_(snapshotInterval)
+    {
+    }
+
+    void MapDataDeltaEncoder::requestSnapshot()
+    {
+        snapshotRequested_ = true;
+    }
+
+    bool MapDataDeltaEncoder::hasMoved(const geometry_msgs::msg::Pose &sent, const geometry_msgs::msg::Pose &current) const
+    {
+        const double dx = current.position.x - sent.position.x;
+        const double dy = current.position.y - sent.position.y;
+        const double dz = current.position.z - sent.position.z;
+        if (dx * dx + dy * dy + dz * dz > translationThreshold_ * translationThreshold_)
+            return true;
+        // angle between the two orientations from the quaternion dot product.
+        const double dot = std::abs(sent.orientation.w * current.orientation.w + sent.orientation.x * current.orientation.x +
+                                    sent.orientation.y * current.orientation.y + sent.orientation.z * current.orientation.z);
+        const double angle = 2.0 * std::acos(std::min(1.0, dot));
+        return angle > rotationThreshold_;
+    }
+
+    bool MapDataDeltaEncoder::encode(const slam_msgs::msg::MapGraph &graph, slam_msgs::msg::MapDataDelta &delta)
+    {
+        const size_t numPoses = std::min(graph.poses_id.size(), graph.poses.size());
+        delta.added_ids.clear();
+        delta.added_poses.clear();
+        delta.moved_ids.clear();
+        delta.moved_poses.clear();
+        delta.removed_ids.clear();
+
+        bool snapshot = snapshotRequested_.exchange(false);
+        if (snapshotInterval_ > 0 && deltasSinceSnapshot_ >= snapshotInterval_)
+            snapshot = true;
+
+        if (snapshot)
+        {
+            sentPoses_.clear();
+            delta.added_ids.reserve(numPoses);
+            delta.added_poses.reserve(numPoses);
+            for (size_t i = 0; i < numPoses; i++)
+            {
+                delta.added_ids.push_back(graph.poses_id[i]);
+                delta.added_poses.push_back(graph.poses[i]);
+                sentPoses_[graph.poses_id[i]] = graph.poses[i].pose;
+            }
+            delta.is_snapshot = true;
+            delta.sequence = ++sequence_;
+            deltasSinceSnapshot_ = 0;
+            return true;
+        }
+
+        std::unordered_set<int32_t> currentIds;
+        currentIds.reserve(numPoses);
+        for (size_t i = 0; i < numPoses; i++)
+        {
+            const int32_t id = graph.poses_id[i];
+            currentIds.insert(id);
+            auto sent = sentPoses_.find(id);
+            if (sent == sentPoses_.end())
+            {
+                delta.added_ids.push_back(id);
+                delta.added_poses.push_back(graph.poses[i]);
+                sentPoses_.emplace(id, graph.poses[i].pose);
+            }
+            else if (hasMoved(sent->second, graph.poses[i].pose))
+            {
+                delta.moved_ids.push_back(id);
+                delta.moved_poses.push_back(graph.poses[i]);
+                sent->second = graph.poses[i].pose;
+            }
+        }
+        for (auto it = sentPoses_.begin(); it != sentPoses_.end();)
+        {
+            if (currentIds.count(it->first) == 0)
+            {
+                delta.removed_ids.push_back(it->first);
+                it = sentPoses_.erase(it);
+            }
+            else
+                ++it;
+        }
+
+        if (delta.added_ids.empty() && delta.moved_ids.empty() && delta.removed_ids.empty())
+            return false;
+        delta.is_snapshot = false;
+        delta.sequence = ++sequence_;
+        ++deltasSinceSnapshot_;
+        return true;
+    }
+}
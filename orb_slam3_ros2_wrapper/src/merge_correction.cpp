@@ -0,0 +1,53 @@
+/**
+ * @file merge_correction.cpp
+ * @brief Takes the published pose from the pre-merge frame to the post-merge frame of a map merge.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#include "orb_slam3_ros2_wrapper/merge_correction.hpp"
+
+#include <algorithm>
+
+namespace ORB_SLAM3_Wrapper
+{
+    bool mergeHandlingFromString(const std::string &name, MergeHandling &handling)
+    {
+        if (name == "pause")
+            handling = MergeHandling::PAUSE;
+        else if (name == "hold")
+            handling = MergeHandling::HOLD;
+        else if (name == "blend")
+            handling = MergeHandling::BLEND;
+        else
+            return false;
+        return true;
+    }
+
+    void MergeCorrection::start(const Eigen::Affine3d &correction, double window, double now)
+    {
+        const Eigen::Affine3d residual = correction.inverse();
+        residualRotation_ = Eigen::Quaterniond(Eigen::Matrix3d(residual.linear())).normalized();
+        residualTranslation_ = residual.translation();
+        start_ = now;
+        window_ = window;
+        active_ = window > 0.0;
+    }
+
+    Eigen::Affine3d MergeCorrection::apply(const Eigen::Affine3d &pose, double now)
+    {
+        if (!active_)
+            return pose;
+        const double fraction = (now - start_) / window_;
+        if (fraction >= 1.0)
+        {
+            active_ = false;
+            return pose;
+        }
+        // the residual goes from the whole inverse correction to the identity.
+        const double remaining = 1.0 - std::max(0.0, fraction);
+        Eigen::Affine3d residual = Eigen::Affine3d::Identity();
+        residual.linear() = Eigen::Quaterniond::Identity().slerp(remaining, residualRotation_).toRotationMatrix();
+        residual.translation() = remaining * residualTranslation_;
+        return residual * pose;
+    }
+}
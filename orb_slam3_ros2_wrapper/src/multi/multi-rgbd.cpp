@@ -0,0 +1,93 @@
+/**
+ * @file multi-rgbd.cpp
+ * @brief Hosts one SLAM node per robot in a single process.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+
+#include "rclcpp/rclcpp.hpp"
+#include "../rgbd/rgbd-slam-node.hpp"
+#include "orb_slam3_ros2_wrapper/thread_config.hpp"
+
+// CMake only builds the host with ORB_SLAM3_HAS_INSTANCE_STATE, stock ORB-SLAM3 runs one robot per process.
+static_assert(ORB_SLAM3_Wrapper::ORBSLAM3Interface::supportsMultipleSystems(),
+              "multi_rgbd needs an ORB-SLAM3 with per-system state (-DORB_SLAM3_HAS_INSTANCE_STATE=ON)");
+
+int main(int argc, char **argv)
+{
+    if(argc < 3)
+    {
+        std::cerr << "\nUsage: ros2 run orbslam multi_rgbd path_to_vocabulary path_to_settings --ros-args --params-file path_to_params" << std::endl;
+        return 1;
+    }
+
+    rclcpp::init(argc, argv);
+
+    // The host parameters. The parameters of every robot node are read from the same params file
+    // under /<robot_namespace>/<node name>.
+    auto host = std::make_shared<rclcpp::Node>("ORB_SLAM3_HOST");
+    host->declare_parameter("robot_namespaces", rclcpp::ParameterValue(std::vector<std::string>()));
+    host->declare_parameter("robot_cpu_sets", rclcpp::ParameterValue(std::vector<std::string>()));
+    host->declare_parameter("executor_threads", rclcpp::ParameterValue(0));
+    host->declare_parameter("sensor_type", rclcpp::ParameterValue(std::string("rgbd")));
+    host->declare_parameter("visualization", rclcpp::ParameterValue(false));
+    auto robotNamespaces = host->get_parameter("robot_namespaces").as_string_array();
+    auto robotCpuSets = host->get_parameter("robot_cpu_sets").as_string_array();
+    int executorThreads = host->get_parameter("executor_threads").as_int();
+    auto sensorType = host->get_parameter("sensor_type").as_string();
+    bool visualization = host->get_parameter("visualization").as_bool();
+
+    ORB_SLAM3::System::eSensor sensor;
+    if (robotNamespaces.empty() || !ORB_SLAM3_Wrapper::RgbdSlamNode::sensorFromString(sensorType, sensor))
+    {
+        RCLCPP_FATAL(host->get_logger(), "robot_namespaces must be set and sensor_type must be a known sensor.");
+        rclcpp::shutdown();
+        return 1;
+    }
+    if (!robotCpuSets.empty() && robotCpuSets.size() != robotNamespaces.size())
+    {
+        RCLCPP_FATAL(host->get_logger(), "robot_cpu_sets must be empty or have one entry per robot.");
+        rclcpp::shutdown();
+        return 1;
+    }
+
+    if (executorThreads <= 0)
+        executorThreads = std::max(1u, std::thread::hardware_concurrency());
+    rclcpp::executors::MultiThreadedExecutor executor(rclcpp::ExecutorOptions(), executorThreads);
+    executor.add_node(host);
+
+    std::vector<std::shared_ptr<ORB_SLAM3_Wrapper::RgbdSlamNode>> nodes;
+    for (size_t i = 0; i < robotNamespaces.size(); i++)
+    {
+        std::vector<int> cpus;
+        if (!robotCpuSets.empty() && !robotCpuSets[i].empty() && !ORB_SLAM3_Wrapper::parseCpuSet(robotCpuSets[i], cpus))
+            RCLCPP_WARN_STREAM(host->get_logger(), "Ignoring the malformed CPU set " << robotCpuSets[i] << " of " << robotNamespaces[i]);
+
+        auto start = std::chrono::steady_clock::now();
+        auto options = rclcpp::NodeOptions()
+                           .use_intra_process_comms(true)
+                           .arguments({"--ros-args", "-r", "__ns:=/" + robotNamespaces[i]})
+                           .parameter_overrides({rclcpp::Parameter("visualization", visualization)});
+        {
+            // the ORB_SLAM3 threads (local mapping, loop closing) and the tracking pipeline threads
+            // are started in the constructor and inherit the CPU set of the robot.
+            ORB_SLAM3_Wrapper::ScopedThreadAffinity affinity(cpus);
+            nodes.push_back(std::make_shared<ORB_SLAM3_Wrapper::RgbdSlamNode>(argv[1], argv[2], sensor, options));
+        }
+        executor.add_node(nodes.back());
+        RCLCPP_INFO_STREAM(host->get_logger(), "Started " << robotNamespaces[i] << " in "
+                                                          << std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() << " s"
+                                                          << (cpus.empty() ? std::string() : " on CPUs " + ORB_SLAM3_Wrapper::formatCpuSet(cpus)));
+    }
+    std::cout << "============================ " << std::endl;
+
+    executor.spin();
+    for (auto &node : nodes)
+        executor.remove_node(node);
+    nodes.clear();
+    rclcpp::shutdown();
+
+    return 0;
+}
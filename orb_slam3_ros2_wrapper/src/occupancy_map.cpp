@@ -0,0 +1,408 @@
+/**
+ * @file occupancy_map.cpp
+ * @brief Voxel occupancy map fused from the depth images of the keyframes, with its 2D projection.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#include "orb_slam3_ros2_wrapper/occupancy_map.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <unordered_set>
+
+namespace ORB_SLAM3_Wrapper
+{
+    namespace
+    {
+        const uint8_t kMiss = 1;
+        const uint8_t kHit = 2;
+    }
+
+    OccupancyMap::OccupancyMap(const OccupancyMapConfig &config)
+        : config_(config),
+          invResolution_(1.0f / config.resolution),
+          minBandZ_(static_cast<int32_t>(std::floor(config.minHeight / config.resolution))),
+          maxBandZ_(static_cast<int32_t>(std::floor(config.maxHeight / config.resolution)))
+    {
+    }
+
+    VoxelIndex OccupancyMap::toIndex(const Eigen::Vector3f &position) const
+    {
+        return VoxelIndex{static_cast<int32_t>(std::floor(position.x() * invResolution_)),
+                          static_cast<int32_t>(std::floor(position.y() * invResolution_)),
+                          static_cast<int32_t>(std::floor(position.z() * invResolution_))};
+    }
+
+    void OccupancyMap::integrate(const Eigen::Affine3f &sensorPose, const std::vector<Eigen::Vector3f> &points, int weight)
+    {
+        // a voxel hit by one ray and crossed by another is a hit.
+        scanVoxels_.clear();
+        const Eigen::Vector3f origin = sensorPose.translation();
+        for (const auto &point : points)
+        {
+            const Eigen::Vector3f end = sensorPose * point;
+            const float distance = (end - origin).norm();
+            if (distance < 1e-6f)
+                continue;
+            const bool hit = distance <= config_.maxRange;
+            const Eigen::Vector3f rayEnd = hit ? end : Eigen::Vector3f(origin + (end - origin) * (config_.maxRange / distance));
+            castRay(origin, rayEnd, ray_);
+            for (const auto &voxel : ray_)
+                scanVoxels_.emplace(voxel, kMiss);
+            if (hit)
+                scanVoxels_[toIndex(rayEnd)] = kHit;
+        }
+
+        changed_ = false;
+        for (const auto &voxel : scanVoxels_)
+        {
+            if (voxel.second == kHit)
+                update(voxel.first, weight, 0);
+            else
+                update(voxel.first, 0, weight);
+        }
+        if (changed_)
+            ++version_;
+    }
+
+    void OccupancyMap::clear()
+    {
+        voxels_.clear();
+        columns_.clear();
+        numOccupied_ = 0;
+        ++version_;
+    }
+
+    int OccupancyMap::stateOf(const Voxel &voxel) const
+    {
+        if (voxel.hits <= 0 && voxel.misses <= 0)
+            return -1;
+        const float logOdds = voxel.hits * config_.hitLogOdds + voxel.misses * config_.missLogOdds;
+        if (logOdds > config_.occupiedLogOdds)
+            return 1;
+        if (logOdds < config_.freeLogOdds)
+            return 0;
+        return -1;
+    }
+
+    int OccupancyMap::voxelState(const VoxelIndex &index) const
+    {
+        auto it = voxels_.find(index);
+        return it == voxels_.end() ? -1 : stateOf(it->second);
+    }
+
+    void OccupancyMap::update(const VoxelIndex &index, int hits, int misses)
+    {
+        auto it = voxels_.find(index);
+        if (it == voxels_.end())
+            it = voxels_.emplace(index, Voxel()).first;
+        const int before = stateOf(it->second);
+        it->second.hits += hits;
+        it->second.misses += misses;
+        const int after = stateOf(it->second);
+        if (it->second.hits == 0 && it->second.misses == 0)
+            voxels_.erase(it);
+        if (before == after)
+            return;
+
+        changed_ = true;
+        if (before == 1)
+            --numOccupied_;
+        if (after == 1)
+            ++numOccupied_;
+        if (index.z < minBandZ_ || index.z > maxBandZ_)
+            return;
+        // columns are kept once observed, the grid does not shrink.
+        Column &column = columns_[VoxelIndex{index.x, index.y, 0}];
+        if (before == 1)
+            --column.occupied;
+        else if (before == 0)
+            --column.free;
+        if (after == 1)
+            ++column.occupied;
+        else if (after == 0)
+            ++column.free;
+    }
+
+    void OccupancyMap::castRay(const Eigen::Vector3f &origin, const Eigen::Vector3f &end, std::vector<VoxelIndex> &crossed) const
+    {
+        // voxel traversal of Amanatides and Woo, from the voxel of origin to the one before the voxel of end.
+        crossed.clear();
+        int32_t current[3], last[3], step[3];
+        float tMax[3], tDelta[3];
+        const VoxelIndex first = toIndex(origin), final = toIndex(end);
+        current[0] = first.x, current[1] = first.y, current[2] = first.z;
+        last[0] = final.x, last[1] = final.y, last[2] = final.z;
+        const Eigen::Vector3f direction = end - origin;
+        int64_t maxSteps = 1;
+        for (int i = 0; i < 3; i++)
+        {
+            maxSteps += std::abs(static_cast<int64_t>(last[i]) - current[i]);
+            step[i] = direction[i] > 0.0f ? 1 : (direction[i] < 0.0f ? -1 : 0);
+            if (step[i] == 0)
+            {
+                tMax[i] = std::numeric_limits<float>::infinity();
+                tDelta[i] = std::numeric_limits<float>::infinity();
+                continue;
+            }
+            const float boundary = (current[i] + (step[i] > 0 ? 1 : 0)) * config_.resolution;
+            tMax[i] = (boundary - origin[i]) / direction[i];
+            tDelta[i] = config_.resolution / std::abs(direction[i]);
+        }
+        // the step count bounds the loop against rounding at the voxel boundaries.
+        for (int64_t n = 0; n < maxSteps; n++)
+        {
+            if (current[0] == last[0] && current[1] == last[1] && current[2] == last[2])
+                break;
+            crossed.push_back(VoxelIndex{current[0], current[1], current[2]});
+            const int axis = tMax[0] < tMax[1] ? (tMax[0] < tMax[2] ? 0 : 2) : (tMax[1] < tMax[2] ? 1 : 2);
+            current[axis] += step[axis];
+            tMax[axis] += tDelta[axis];
+        }
+    }
+
+    void OccupancyMap::grid(OccupancyGrid &grid) const
+    {
+        grid.resolution = config_.resolution;
+        grid.data.clear();
+        if (columns_.empty())
+        {
+            grid.originX = grid.originY = 0;
+            grid.width = grid.height = 0;
+            return;
+        }
+        int32_t minX = std::numeric_limits<int32_t>::max(), minY = minX;
+        int32_t maxX = std::numeric_limits<int32_t>::min(), maxY = maxX;
+        for (const auto &column : columns_)
+        {
+            minX = std::min(minX, column.first.x);
+            maxX = std::max(maxX, column.first.x);
+            minY = std::min(minY, column.first.y);
+            maxY = std::max(maxY, column.first.y);
+        }
+        grid.originX = minX;
+        grid.originY = minY;
+        grid.width = static_cast<uint32_t>(maxX - minX + 1);
+        grid.height = static_cast<uint32_t>(maxY - minY + 1);
+        grid.data.assign(static_cast<size_t>(grid.width) * grid.height, -1);
+        for (const auto &column : columns_)
+        {
+            int8_t value = -1;
+            if (column.second.occupied > 0)
+                value = 100;
+            else if (column.second.free > 0)
+                value = 0;
+            grid.data[static_cast<size_t>(column.first.y - minY) * grid.width + (column.first.x - minX)] = value;
+        }
+    }
+
+    void OccupancyMap::occupiedVoxels(std::vector<Eigen::Vector3f> &centers) const
+    {
+        centers.clear();
+        centers.reserve(numOccupied_);
+        for (const auto &voxel : voxels_)
+        {
+            if (stateOf(voxel.second) != 1)
+                continue;
+            centers.emplace_back((voxel.first.x + 0.5f) * config_.resolution, (voxel.first.y + 0.5f) * config_.resolution,
+                                 (voxel.first.z + 0.5f) * config_.resolution);
+        }
+    }
+
+    void downsamplePoints(std::vector<Eigen::Vector3f> &points, float resolution)
+    {
+        const float invResolution = 1.0f / resolution;
+        std::unordered_set<VoxelIndex, VoxelIndexHash> seen;
+        seen.reserve(points.size());
+        size_t kept = 0;
+        for (size_t i = 0; i < points.size(); i++)
+        {
+            const VoxelIndex index{static_cast<int32_t>(std::floor(points[i].x() * invResolution)),
+                                   static_cast<int32_t>(std::floor(points[i].y() * invResolution)),
+                                   static_cast<int32_t>(std::floor(points[i].z() * invResolution))};
+            if (seen.insert(index).second)
+                points[kept++] = points[i];
+        }
+        points.resize(kept);
+    }
+
+    OccupancyMapper::OccupancyMapper(const OccupancyMapConfig &config, size_t maxPendingScans)
+        : map_(config),
+          maxPendingScans_(std::max<size_t>(1, maxPendingScans))
+    {
+        thread_ = std::thread(&OccupancyMapper::run, this);
+    }
+
+    OccupancyMapper::~OccupancyMapper()
+    {
+        {
+            std::lock_guard<std::mutex> lock(pendingMutex_);
+            running_ = false;
+        }
+        pendingCondition_.notify_all();
+        idleCondition_.notify_all();
+        if (thread_.joinable())
+            thread_.join();
+    }
+
+    bool OccupancyMapper::addKeyFrame(int32_t id, const Eigen::Affine3f &pose, std::vector<Eigen::Vector3f> &&points)
+    {
+        downsamplePoints(points, map_.config().resolution);
+        {
+            std::lock_guard<std::mutex> lock(pendingMutex_);
+            auto it = pending_.find(id);
+            const bool queued = it != pending_.end() && it->second.hasScan;
+            if (!queued && pendingScans_ >= maxPendingScans_)
+            {
+                ++stats_.dropped;
+                return false;
+            }
+            Pending &pending = pending_[id];
+            if (!queued)
+                ++pendingScans_;
+            pending = Pending();
+            pending.hasScan = true;
+            pending.pose = pose;
+            pending.points = std::move(points);
+        }
+        pendingCondition_.notify_one();
+        return true;
+    }
+
+    void OccupancyMapper::moveKeyFrame(int32_t id, const Eigen::Affine3f &pose)
+    {
+        {
+            std::lock_guard<std::mutex> lock(pendingMutex_);
+            Pending &pending = pending_[id];
+            if (pending.remove)
+                return;
+            // a scan not integrated yet is integrated at the new pose directly.
+            pending.hasPose = !pending.hasScan;
+            pending.pose = pose;
+        }
+        pendingCondition_.notify_one();
+    }
+
+    void OccupancyMapper::removeKeyFrame(int32_t id)
+    {
+        {
+            std::lock_guard<std::mutex> lock(pendingMutex_);
+            Pending &pending = pending_[id];
+            if (pending.hasScan)
+                --pendingScans_;
+            pending = Pending();
+            pending.remove = true;
+        }
+        pendingCondition_.notify_one();
+    }
+
+    void OccupancyMapper::clear()
+    {
+        std::lock_guard<std::mutex> lock(pendingMutex_);
+        pending_.clear();
+        pendingScans_ = 0;
+        std::lock_guard<std::mutex> mapLock(mapMutex_);
+        ++generation_;
+        map_.clear();
+        integrated_.clear();
+    }
+
+    void OccupancyMapper::flush()
+    {
+        std::unique_lock<std::mutex> lock(pendingMutex_);
+        idleCondition_.wait(lock, [this]()
+                            { return !running_ || (pending_.empty() && !busy_); });
+    }
+
+    uint64_t OccupancyMapper::version() const
+    {
+        std::lock_guard<std::mutex> lock(mapMutex_);
+        return map_.version();
+    }
+
+    void OccupancyMapper::grid(OccupancyGrid &grid) const
+    {
+        std::lock_guard<std::mutex> lock(mapMutex_);
+        map_.grid(grid);
+    }
+
+    void OccupancyMapper::occupiedVoxels(std::vector<Eigen::Vector3f> &centers) const
+    {
+        std::lock_guard<std::mutex> lock(mapMutex_);
+        map_.occupiedVoxels(centers);
+    }
+
+    OccupancyMapperStats OccupancyMapper::stats() const
+    {
+        std::lock_guard<std::mutex> lock(pendingMutex_);
+        OccupancyMapperStats stats = stats_;
+        stats.pending = pending_.size();
+        return stats;
+    }
+
+    void OccupancyMapper::run()
+    {
+        std::unique_lock<std::mutex> lock(pendingMutex_);
+        while (true)
+        {
+            pendingCondition_.wait(lock, [this]()
+                                   { return !running_ || !pending_.empty(); });
+            if (!running_)
+                return;
+            auto next = pending_.begin();
+            const int32_t id = next->first;
+            Pending pending = std::move(next->second);
+            pending_.erase(next);
+            if (pending.hasScan)
+                --pendingScans_;
+            const uint64_t generation = generation_;
+            busy_ = true;
+            lock.unlock();
+
+            OccupancyMapperStats counts;
+            {
+                std::lock_guard<std::mutex> mapLock(mapMutex_);
+                if (generation == generation_)
+                    process(id, pending, counts);
+            }
+
+            lock.lock();
+            busy_ = false;
+            stats_.integrated += counts.integrated;
+            stats_.reintegrated += counts.reintegrated;
+            stats_.removed += counts.removed;
+            if (pending_.empty())
+                idleCondition_.notify_all();
+        }
+    }
+
+    void OccupancyMapper::process(int32_t id, Pending &pending, OccupancyMapperStats &counts)
+    {
+        auto integrated = integrated_.find(id);
+        if (pending.remove)
+        {
+            if (integrated == integrated_.end())
+                return;
+            map_.integrate(integrated->second.pose, integrated->second.points, -1);
+            integrated_.erase(integrated);
+            ++counts.removed;
+            return;
+        }
+        if (pending.hasScan)
+        {
+            if (integrated != integrated_.end())
+                map_.integrate(integrated->second.pose, integrated->second.points, -1);
+            map_.integrate(pending.pose, pending.points, 1);
+            integrated_[id] = Integrated{pending.pose, std::move(pending.points)};
+            ++counts.integrated;
+            return;
+        }
+        if (pending.hasPose && integrated != integrated_.end())
+        {
+            map_.integrate(integrated->second.pose, integrated->second.points, -1);
+            integrated->second.pose = pending.pose;
+            map_.integrate(pending.pose, integrated->second.points, 1);
+            ++counts.reintegrated;
+        }
+    }
+}
@@ -5,8 +5,32 @@
  */
 #include "orb_slam3_ros2_wrapper/orb_slam3_interface.hpp"
 
+#include <fstream>
+#include <limits>
+#include <sstream>
+
+#include <boost/archive/binary_oarchive.hpp>
+
 namespace ORB_SLAM3_Wrapper
 {
+    std::atomic<int> ORBSLAM3Interface::SystemSlot::systems_{0};
+
+    ORBSLAM3Interface::SystemSlot::SystemSlot()
+    {
+        if (systems_.fetch_add(1) > 0 && !supportsMultipleSystems())
+        {
+            systems_--;
+            throw std::runtime_error("Another ORB_SLAM3 system is running in this process. Stock ORB_SLAM3 shares its id counters "
+                                     "and camera calibration between systems, run one process per robot or build with "
+                                     "ORB_SLAM3_HAS_INSTANCE_STATE.");
+        }
+    }
+
+    ORBSLAM3Interface::SystemSlot::~SystemSlot()
+    {
+        systems_--;
+    }
+
     ORBSLAM3Interface::ORBSLAM3Interface(const std::string &strVocFile,
                                          const std::string &strSettingsFile,
                                          ORB_SLAM3::System::eSensor sensor,
@@ -16,12 +40,15 @@ namespace ORB_SLAM3_Wrapper
                                          double robotY,
                                          std::string globalFrame,
                                          std::string odomFrame,
-                                         std::string robotFrame)
-        : strVocFile_(strVocFile),
+                                         std::string robotFrame,
+                                         std::shared_ptr<MetricsRegistry> metrics)
+        : metrics_(metrics ? metrics : std::make_shared<MetricsRegistry>()),
+          strVocFile_(strVocFile),
           strSettingsFile_(strSettingsFile),
           sensor_(sensor),
           bUseViewer_(bUseViewer),
           rosViz_(rosViz),
+          imuBuffer_(4096),
           robotX_(robotX),
           robotY_(robotY),
           globalFrame_(globalFrame),
@@ -29,8 +56,80 @@ namespace ORB_SLAM3_Wrapper
           robotFrame_(robotFrame)
     {
         std::cout << "Interface constructor started" << endl;
-        mSLAM_ = std::make_shared<ORB_SLAM3::System>(strVocFile_, strSettingsFile_, sensor_, bUseViewer_);
+        auto startupStart = std::chrono::steady_clock::now();
+        // the threads ORB_SLAM3::System starts, not the ones the rest of the process starts meanwhile.
+        auto threadTracker = std::make_unique<ScopedThreadCreationTracker>();
+#ifdef ORB_SLAM3_HAS_SHARED_VOCABULARY
+        // the interfaces of a process (multi robot host) share one read-only vocabulary.
+        double vocabularyLoadSeconds;
+        vocabulary_ = VocabularyCache::get(strVocFile_, &vocabularyLoadSeconds);
+        if (!vocabulary_)
+            throw std::runtime_error("Could not load the vocabulary " + strVocFile_);
+        metrics_->gauge("startup_vocabulary_load_seconds", "Time spent loading the vocabulary file.").set(vocabularyLoadSeconds);
+        mSLAM_ = std::make_shared<ORB_SLAM3::System>(vocabulary_.get(), strSettingsFile_, sensor_, bUseViewer_);
+#else
+        // ORB_SLAM3::System parses the vocabulary itself and only reads the text format, a binary one falls back to
+        // the text vocabulary it was converted from when it sits next to it.
+        std::string vocabularyFile = strVocFile_;
+        if (BinaryVocabulary::isBinaryVocabularyPath(vocabularyFile))
+        {
+            const std::string textFile = vocabularyFile.substr(0, vocabularyFile.size() - 4) + ".txt";
+            if (!std::ifstream(textFile).good())
+                throw std::runtime_error("Binary vocabularies need an ORB-SLAM3 built with ORB_SLAM3_HAS_SHARED_VOCABULARY and " + textFile +
+                                         " does not exist, set vocabulary_file_path to the text vocabulary instead of " + strVocFile_);
+            std::cerr << "Binary vocabularies need an ORB-SLAM3 built with ORB_SLAM3_HAS_SHARED_VOCABULARY, loading " << textFile
+                      << " instead of " << strVocFile_ << endl;
+            vocabularyFile = textFile;
+        }
+        mSLAM_ = std::make_shared<ORB_SLAM3::System>(vocabularyFile, strSettingsFile_, sensor_, bUseViewer_);
+#endif
+        const std::vector<int> systemThreads = threadTracker->created();
+        threadTracker.reset();
+        const double startupSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startupStart).count();
+        metrics_->gauge("startup_system_seconds", "Construction of ORB_SLAM3::System, vocabulary included.").set(startupSeconds);
+        // System starts local mapping, loop closing and then the viewer if it is enabled. The ids grow in that order
+        // unless they wrap around. Any other count means a different ORB_SLAM3, nothing is named or pinned then.
+        const size_t expectedThreads = bUseViewer_ ? 3 : 2;
+        if (systemThreads.size() == expectedThreads)
+        {
+            const char *const names[] = {"orb_local_map", "orb_loop_close", "orb_viewer"};
+            for (size_t i = 0; i < systemThreads.size(); i++)
+                orbThreads_.emplace_back(names[i], systemThreads[i]);
+        }
+        else
+            std::cerr << "ORB_SLAM3 started " << systemThreads.size() << " threads instead of " << expectedThreads
+                      << ", they are not identified and cannot be pinned." << endl;
+        // the created threads still carry the marker name of the tracker.
+        for (int tid : systemThreads)
+            setThreadName(tid, "orb_system");
+        for (const auto &thread : orbThreads_)
+            setThreadName(thread.second, thread.first);
+        std::cout << "ORB_SLAM3 system constructed in " << startupSeconds << " s" << endl;
+        cv::FileStorage settings(strSettingsFile_, cv::FileStorage::READ);
+        if (settings.isOpened())
+        {
+            if (!settings["Camera.width"].empty())
+                imageWidth_ = static_cast<float>(settings["Camera.width"].real());
+            if (!settings["Camera.height"].empty())
+                imageHeight_ = static_cast<float>(settings["Camera.height"].real());
+        }
         typeConversions_ = std::make_shared<WrapperTypeConversions>();
+        mapSnapshot_ = std::make_shared<MapSnapshot>();
+        // no allocation per frame on the inertial tracking path.
+        imuWindow_.reserve(imuBuffer_.capacity());
+        vImuMeas_.reserve(imuBuffer_.capacity());
+        cvBridgeLatency_ = &metrics_->histogram("cv_bridge", "cv_bridge conversion of the input images.");
+        preparedFrameLatency_ = &metrics_->histogram("prepared_frame_wait", "Wait of the tracking thread for the images of the feature backend.");
+        trackLatency_ = &metrics_->histogram("track_rgbd", "ORB_SLAM3::System track call of a frame.");
+        referencePosesLatency_ = &metrics_->histogram("calculate_reference_poses", "Reference pose update of the Atlas maps.");
+        mapDataToMsgLatency_ = &metrics_->histogram("map_data_to_msg", "Conversion of the map data to a ROS message.");
+        mapPointsCloudLatency_ = &metrics_->histogram("map_points_cloud", "Build of the cloud of all the map points.");
+        visibleMapPointsLatency_ = &metrics_->histogram("visible_map_points", "Query of the map points visible from a pose.");
+        visibleMapPointsBatchLatency_ = &metrics_->histogram("visible_map_points_batch", "Query of the map points visible from a batch of poses.");
+        residencyLatency_ = &metrics_->histogram("keyframe_residency", "Paging of the keyframes in and out of the keyframe store.");
+        mapPageLatency_ = &metrics_->histogram("map_page", "Build of a page of the map data.");
+        recoveryLatency_ = &metrics_->histogram("tracking_recovery", "Time from the first lost frame to the next tracked one.");
+        mergeLatency_ = &metrics_->histogram("map_merge", "Time from the first frame that saw a map merge to the first one after it.");
         std::cout << "Interface constructor complete" << endl;
         std::cout << "Robot X: " << robotX_ << " Robot Y: " << robotY_ << std::endl;
     }
@@ -43,6 +142,9 @@ namespace ORB_SLAM3_Wrapper
         typeConversions_.reset();
         mapReferencePoses_.clear();
         allKFs_.clear();
+        mapKFIds_.clear();
+        mapSignatures_.clear();
+        keyFrameStore_.reset();
     }
 
     std::unordered_map<long unsigned int, ORB_SLAM3::KeyFrame *> ORBSLAM3Interface::makeKFIdPair(std::vector<ORB_SLAM3::Map *> mapsList)
@@ -61,8 +163,136 @@ namespace ORB_SLAM3_Wrapper
         return mpIdKFs;
     }
 
-    void ORBSLAM3Interface::calculateReferencePoses()
+    MapSignature ORBSLAM3Interface::makeMapSignature(ORB_SLAM3::Map *pMap)
+    {
+        MapSignature signature;
+        signature.initKFid = pMap->GetInitKFid();
+        signature.maxKFid = pMap->GetMaxKFid();
+        signature.numKFs = pMap->KeyFramesInMap();
+        signature.changeIdx = pMap->GetMapChangeIndex();
+        signature.bigChangeIdx = pMap->GetLastBigChangeIdx();
+        signature.originKF = pMap->GetOriginKF();
+        signature.mapId = pMap->GetId();
+        return signature;
+    }
+
+    void ORBSLAM3Interface::updateKFTable(const std::vector<ORB_SLAM3::Map *> &changedMaps,
+                                          const std::vector<ORB_SLAM3::Map *> &removedMaps,
+                                          std::unordered_map<ORB_SLAM3::Map *, KeyFrameDelta> &deltas)
     {
+        // Erase everything first. During a merge keyframes move from one map to the other,
+        // so the inserts below must not be undone by the erase of the old map.
+        for (ORB_SLAM3::Map *pMap : removedMaps)
+        {
+            auto it = mapKFIds_.find(pMap);
+            if (it == mapKFIds_.end())
+                continue;
+            KeyFrameDelta &delta = deltas[pMap];
+            for (auto kfId : it->second)
+            {
+                auto kf = allKFs_.find(kfId);
+                if (kf == allKFs_.end())
+                    continue;
+                delta.removed.push_back(kf->second);
+                allKFs_.erase(kf);
+            }
+            mapKFIds_.erase(it);
+        }
+
+        std::vector<std::vector<ORB_SLAM3::KeyFrame *>> currentKFs(changedMaps.size());
+        std::vector<std::unordered_set<long unsigned int>> previousIds(changedMaps.size());
+        for (size_t m = 0; m < changedMaps.size(); m++)
+        {
+            ORB_SLAM3::Map *pMap = changedMaps[m];
+            currentKFs[m] = pMap->GetAllKeyFrames();
+            auto it = mapKFIds_.find(pMap);
+            if (it == mapKFIds_.end())
+                continue;
+            previousIds[m].insert(it->second.begin(), it->second.end());
+            std::unordered_set<long unsigned int> currentIds;
+            currentIds.reserve(currentKFs[m].size());
+            for (ORB_SLAM3::KeyFrame *pKF : currentKFs[m])
+                currentIds.insert(pKF->mnId);
+            // culled or moved to another map.
+            KeyFrameDelta &delta = deltas[pMap];
+            for (auto kfId : it->second)
+            {
+                if (currentIds.count(kfId) > 0)
+                    continue;
+                auto kf = allKFs_.find(kfId);
+                if (kf == allKFs_.end())
+                    continue;
+                delta.removed.push_back(kf->second);
+                allKFs_.erase(kf);
+            }
+        }
+
+        for (size_t m = 0; m < changedMaps.size(); m++)
+        {
+            ORB_SLAM3::Map *pMap = changedMaps[m];
+            KeyFrameDelta &delta = deltas[pMap];
+            std::vector<long unsigned int> &kfIds = mapKFIds_[pMap];
+            kfIds.clear();
+            kfIds.reserve(currentKFs[m].size());
+            for (ORB_SLAM3::KeyFrame *pKF : currentKFs[m])
+            {
+                allKFs_[pKF->mnId] = pKF;
+                kfIds.push_back(pKF->mnId);
+                if (previousIds[m].count(pKF->mnId) == 0)
+                    delta.added.push_back(pKF);
+            }
+        }
+    }
+
+    void ORBSLAM3Interface::updateSpatialIndex(const std::unordered_map<ORB_SLAM3::Map *, KeyFrameDelta> &deltas,
+                                               const std::vector<ORB_SLAM3::Map *> &correctedMaps,
+                                               const std::vector<ORB_SLAM3::Map *> &removedMaps)
+    {
+        std::lock_guard<std::mutex> lock(spatialIndexMutex_);
+        for (ORB_SLAM3::Map *pMap : removedMaps)
+        {
+            keyFrameIndex_.erase(pMap);
+            dirtyIndexMaps_.erase(pMap);
+        }
+        for (const auto &mapDelta : deltas)
+        {
+            auto it = keyFrameIndex_.find(mapDelta.first);
+            if (it == keyFrameIndex_.end())
+                it = keyFrameIndex_.emplace(mapDelta.first, VoxelHashIndex<ORB_SLAM3::KeyFrame *>(spatialIndexVoxelSize_)).first;
+            for (ORB_SLAM3::KeyFrame *pKF : mapDelta.second.removed)
+                it->second.erase(pKF);
+            for (ORB_SLAM3::KeyFrame *pKF : mapDelta.second.added)
+                it->second.insert(pKF, pKF->GetCameraCenter());
+        }
+        // a loop closure or merge moves every keyframe of the map, local BA only moves them slightly
+        // and is absorbed by the query slack.
+        for (ORB_SLAM3::Map *pMap : correctedMaps)
+            dirtyIndexMaps_.insert(pMap);
+    }
+
+    void ORBSLAM3Interface::keyFramesNearPosition(ORB_SLAM3::Map *pMap, const Eigen::Vector3f &position, float radius,
+                                                  std::vector<ORB_SLAM3::KeyFrame *> &keyFrames)
+    {
+        std::lock_guard<std::mutex> lock(spatialIndexMutex_);
+        auto it = keyFrameIndex_.find(pMap);
+        if (it == keyFrameIndex_.end() || dirtyIndexMaps_.count(pMap) > 0)
+        {
+            VoxelHashIndex<ORB_SLAM3::KeyFrame *> &index = keyFrameIndex_[pMap];
+            index = VoxelHashIndex<ORB_SLAM3::KeyFrame *>(spatialIndexVoxelSize_);
+            for (ORB_SLAM3::KeyFrame *pKF : pMap->GetAllKeyFrames())
+            {
+                if (!pKF->isBad())
+                    index.insert(pKF, pKF->GetCameraCenter());
+            }
+            it = keyFrameIndex_.find(pMap);
+            dirtyIndexMaps_.erase(pMap);
+        }
+        it->second.queryRadius(position, radius + spatialIndexVoxelSize_, keyFrames);
+    }
+
+    bool ORBSLAM3Interface::calculateReferencePoses()
+    {
+        ScopedTimer timer(*referencePosesLatency_);
         struct compareInitKFid
         {
             inline bool operator()(ORB_SLAM3::Map *elem1, ORB_SLAM3::Map *elem2)
@@ -71,92 +301,264 @@ namespace ORB_SLAM3_Wrapper
             }
         };
 
-        mapReferencesMutex_.lock();
-        mapReferencePoses_.clear();
         std::vector<ORB_SLAM3::Map *> mapsList = orbAtlas_->GetAllMaps();
         // sort the map array in init kf id order.
         std::sort(mapsList.begin(), mapsList.end(), compareInitKFid());
-        allKFs_ = makeKFIdPair(mapsList);
-        std::vector<ORB_SLAM3::Map *> mapsList2 = orbAtlas_->GetAllMaps();
-        // std::cout << "Current map id: " << orbAtlas_->GetCurrentMap()->GetId() << std::endl;
-        // for (auto mp : mapsList2)
-        // {
-        //     if (mp != nullptr && mp->GetOriginKF() != nullptr)
-        //     {
-        //         std::cout << "Map id: " << mp->GetId() << std::endl;
-        //         std::cout << "Map init id: " << mp->GetInitKFid() << std::endl;
-        //         std::cout << "Map origin kf id: " << mp->GetOriginKF()->mnId << std::endl;
-        //         std::cout << "Map max kf id: " << mp->GetMaxKFid() << std::endl;
-        //         std::cout << "================" << std::endl;
-        //     }
-        // }
-        // std::cout << "+++++++++++++++++++++++++++++++++" << std::endl;
+
+        // fingerprint the atlas, see diffMapSignatures.
+        std::vector<std::pair<ORB_SLAM3::Map *, MapSignature>> signatures;
+        signatures.reserve(mapsList.size());
+        for (ORB_SLAM3::Map *pMap : mapsList)
+            signatures.emplace_back(pMap, makeMapSignature(pMap));
+        const AtlasChanges<ORB_SLAM3::Map> changes = diffMapSignatures(signatures, mapSignatures_);
+        const bool fleetReferenceChanged = fleetReferenceChanged_.exchange(false);
+        if (!changes.atlasChanged && !fleetReferenceChanged)
+            return false;
+        const std::vector<ORB_SLAM3::Map *> &changedMaps = changes.changed;
+        const std::vector<ORB_SLAM3::Map *> &correctedMaps = changes.corrected;
+        const std::vector<ORB_SLAM3::Map *> &removedMaps = changes.removed;
+        std::unordered_map<ORB_SLAM3::Map *, MapSignature> newSignatures(signatures.begin(), signatures.end());
+
+        std::unordered_map<ORB_SLAM3::Map *, KeyFrameDelta> deltas;
+        updateKFTable(changedMaps, removedMaps, deltas);
+        updateSpatialIndex(deltas, correctedMaps, removedMaps);
+        pushMapEvents(changes.created, correctedMaps, changes.optimized, removedMaps, deltas);
+        mapSignatures_.swap(newSignatures);
+        if (outputCache_)
+        {
+            std::lock_guard<std::mutex> residencyLock(residencyMutex_);
+            staleStoreMaps_.insert(correctedMaps.begin(), correctedMaps.end());
+            staleStoreMaps_.insert(removedMaps.begin(), removedMaps.end());
+            optimizedStoreMaps_.insert(changes.optimized.begin(), changes.optimized.end());
+        }
+
+        const bool keyFrameTableChanged = !changedMaps.empty() || !removedMaps.empty();
+        Eigen::Affine3d fleetReference;
+        {
+            std::lock_guard<std::mutex> fleetLock(fleetReferenceMutex_);
+            fleetReference = fleetReference_;
+        }
+        // only the maps whose keyframes moved are recomputed, with the maps anchored to them through their parent
+        // keyframe. A removed map or a new fleet reference can move the anchor of any map, every map is recomputed then.
+        const bool recomputeAll = fleetReferenceChanged || !removedMaps.empty() || mapReferencePoses_.empty();
+        std::unordered_set<ORB_SLAM3::Map *> dirtyMaps(changedMaps.begin(), changedMaps.end());
+        dirtyMaps.insert(correctedMaps.begin(), correctedMaps.end());
+        dirtyMaps.insert(changes.optimized.begin(), changes.optimized.end());
+        std::unordered_set<ORB_SLAM3::Map *> recomputedMaps;
+        if (recomputeAll)
+            mapReferencePoses_.clear();
         for (size_t c = 0; c < mapsList.size(); c++)
         {
-            // std::cout << "Map ID: " << mapsList[c]->GetId() << " origin kf ID: " << mapsList[c]->GetOriginKF()->mnId << " init kf id: " << mapsList[c]->GetInitKFid() << " max kf id: " << mapsList[c]->GetMaxKFid() << std::endl;
+            const bool dirty = recomputeAll || dirtyMaps.count(mapsList[c]) > 0 || mapReferencePoses_.count(mapsList[c]) == 0;
             if (c == 0)
             {
+                if (!dirty)
+                    continue;
                 auto poseWithoutOffset = typeConversions_->se3ToAffine(mapsList[c]->GetOriginKF()->GetPose());
                 auto poseOffset = Eigen::Affine3d(
                     Eigen::Translation3d(robotX_, robotY_, 0.0) *
                     Eigen::Quaterniond(1.0, 0.0, 0.0, 0.0));
-                mapReferencePoses_[mapsList[c]] = poseOffset * poseWithoutOffset;
+                mapReferencePoses_[mapsList[c]] = fleetReference * poseOffset * poseWithoutOffset;
+                recomputedMaps.insert(mapsList[c]);
             }
             else
             {
-                bool parentMapFound = false;
-                int parentMapID = mapsList[c]->GetInitKFid() - 1;
-                while (!parentMapFound)
+                long int parentMapID = static_cast<long int>(mapsList[c]->GetInitKFid()) - 1;
+                auto parentKF = allKFs_.end();
+                while (parentKF == allKFs_.end())
                 {
                     if (parentMapID < 0)
                     {
                         throw std::runtime_error("The init KF id - 1 is lesser than 0. This should not happen");
                     }
-                    if (allKFs_.count(parentMapID) > 0)
-                    {
-                        parentMapFound = true;
-                        break;
-                    }
+                    parentKF = allKFs_.find(parentMapID);
                     parentMapID -= 1;
                 }
-                if (mapReferencePoses_.count(allKFs_[parentMapID]->GetMap()) == 0)
+                ORB_SLAM3::Map *parentMap = parentKF->second->GetMap();
+                if (!dirty && recomputedMaps.count(parentMap) == 0)
+                    continue;
+                auto parentReference = mapReferencePoses_.find(parentMap);
+                if (parentReference == mapReferencePoses_.end())
                 {
                     throw std::runtime_error("The parent map pose for this map ID does not exist. This should not happen.");
                 }
-                auto parentMapORBPose = allKFs_[parentMapID]->GetPose();
-                mapReferencePoses_[mapsList[c]] = typeConversions_->transformPoseWithReference<Eigen::Affine3d>(mapReferencePoses_[allKFs_[parentMapID]->GetMap()], parentMapORBPose);
+                auto parentMapORBPose = parentKF->second->GetPose();
+                mapReferencePoses_[mapsList[c]] = typeConversions_->transformPoseWithReference<Eigen::Affine3d>(parentReference->second, parentMapORBPose);
+                recomputedMaps.insert(mapsList[c]);
             }
         }
-        // std::cout << "+++++++++++++++++++++++++++++++++" << std::endl;
-        mapReferencesMutex_.unlock();
+        referencePosesRecomputed_ += recomputedMaps.size();
+
+        // publish the new version. Readers holding the previous one keep it until they are done.
+        auto previous = currentSnapshot();
+        auto snapshot = std::make_shared<MapSnapshot>();
+        snapshot->version = previous->version + 1;
+        snapshot->referencePoses = mapReferencePoses_;
+        snapshot->fleetReference = fleetReference;
+        if (keyFrameTableChanged)
+        {
+            snapshot->keyFrames = std::make_shared<const KeyFrameTable>(allKFs_);
+            // sorted once per keyframe set, so that a map page finds its cursor by binary search.
+            auto keyFramesById = std::make_shared<KeyFramesById>(allKFs_.begin(), allKFs_.end());
+            std::sort(keyFramesById->begin(), keyFramesById->end());
+            snapshot->keyFramesById = keyFramesById;
+        }
+        else
+        {
+            snapshot->keyFrames = previous->keyFrames;
+            snapshot->keyFramesById = previous->keyFramesById;
+        }
+        std::atomic_store(&mapSnapshot_, std::shared_ptr<const MapSnapshot>(snapshot));
+        return true;
+    }
+
+    void ORBSLAM3Interface::enableMapEvents(size_t capacity, std::function<void()> notifier)
+    {
+        mapEvents_ = std::make_unique<MapEventQueue>(std::max<size_t>(capacity, 1));
+        mapEvents_->setNotifier(std::move(notifier));
+    }
+
+    void ORBSLAM3Interface::pushMapEvents(const std::vector<ORB_SLAM3::Map *> &createdMaps,
+                                          const std::vector<ORB_SLAM3::Map *> &correctedMaps,
+                                          const std::vector<ORB_SLAM3::Map *> &optimizedMaps,
+                                          const std::vector<ORB_SLAM3::Map *> &removedMaps,
+                                          const std::unordered_map<ORB_SLAM3::Map *, KeyFrameDelta> &deltas)
+    {
+        if (!mapEvents_)
+            return;
+        const uint64_t produced = mapEvents_->produced();
+        // the removed maps are only known by their last signature.
+        auto mapId = [this](ORB_SLAM3::Map *pMap)
+        {
+            auto it = mapSignatures_.find(pMap);
+            return static_cast<uint32_t>(it != mapSignatures_.end() ? it->second.mapId : pMap->GetId());
+        };
+        for (ORB_SLAM3::Map *pMap : createdMaps)
+            mapEvents_->push(MapEventType::MAP_CREATED, mapId(pMap));
+        // a map removed while another one was corrected was merged into it.
+        for (ORB_SLAM3::Map *pMap : removedMaps)
+            mapEvents_->push(correctedMaps.empty() ? MapEventType::MAP_RESET : MapEventType::MAP_MERGED, mapId(pMap));
+
+        // a keyframe that moved to another map is neither inserted nor culled.
+        std::unordered_set<long unsigned int> addedIds, removedIds;
+        for (const auto &delta : deltas)
+        {
+            for (ORB_SLAM3::KeyFrame *pKF : delta.second.added)
+                addedIds.insert(pKF->mnId);
+            for (ORB_SLAM3::KeyFrame *pKF : delta.second.removed)
+                removedIds.insert(pKF->mnId);
+        }
+        for (const auto &delta : deltas)
+        {
+            const uint32_t id = mapId(delta.first);
+            for (ORB_SLAM3::KeyFrame *pKF : delta.second.added)
+            {
+                if (removedIds.count(pKF->mnId) == 0)
+                    mapEvents_->push(MapEventType::KEYFRAME_INSERTED, id, static_cast<int64_t>(pKF->mnId));
+            }
+            for (ORB_SLAM3::KeyFrame *pKF : delta.second.removed)
+            {
+                if (addedIds.count(pKF->mnId) == 0)
+                    mapEvents_->push(MapEventType::KEYFRAME_CULLED, id, static_cast<int64_t>(pKF->mnId));
+            }
+        }
+
+        if (removedMaps.empty())
+        {
+            for (ORB_SLAM3::Map *pMap : correctedMaps)
+                mapEvents_->push(MapEventType::LOOP_CLOSED, mapId(pMap));
+        }
+        for (ORB_SLAM3::Map *pMap : optimizedMaps)
+            mapEvents_->push(MapEventType::BUNDLE_ADJUSTMENT, mapId(pMap));
+        if (mapEvents_->produced() != produced)
+            mapEvents_->notify();
     }
 
     void ORBSLAM3Interface::getCurrentMapPoints(sensor_msgs::msg::PointCloud2 &mapPointCloud)
     {
+        ScopedTimer timer(*mapPointsCloudLatency_);
         std::lock_guard<std::mutex> lock(currentMapPointsMutex_);
-        // this flag serves to support
-        std::vector<Eigen::Vector3f> trackedMapPoints;
-        auto atlasAllKFs_ = orbAtlas_->GetAllKeyFrames();
-        for (auto &KF : atlasAllKFs_)
+        // one snapshot of the reference poses for the whole cloud.
+        auto snapshot = currentSnapshot();
+        if (outputCache_)
+        {
+            getCachedMapPoints(mapPointCloud, *snapshot);
+            return;
+        }
+        std::vector<ORB_SLAM3::Map *> maps;
+        std::vector<Eigen::Affine3f> referencePoses;
+        maps.reserve(snapshot->referencePoses.size());
+        referencePoses.reserve(snapshot->referencePoses.size());
+        for (const auto &reference : snapshot->referencePoses)
+        {
+            maps.push_back(reference.first);
+            referencePoses.push_back(reference.second.cast<float>());
+        }
+
+        // every map holds each of its map points exactly once, however many keyframes observe it.
+        struct Segment
+        {
+            size_t mapIdx;
+            size_t begin;
+        };
+        std::vector<ORB_SLAM3::MapPoint *> mapPoints;
+        std::vector<Segment> segments;
+        for (size_t m = 0; m < maps.size(); m++)
+        {
+            auto pointsInMap = maps[m]->GetAllMapPoints();
+            segments.push_back(Segment{m, mapPoints.size()});
+            mapPoints.insert(mapPoints.end(), pointsInMap.begin(), pointsInMap.end());
+        }
+
+        typeConversions_->initXYZCloud(mapPointCloud, mapPoints.size());
+        if (mapPoints.empty())
+            return;
+
+        // each chunk writes its valid points contiguously from its own offset, the gaps left by bad points are closed afterwards.
+        const size_t minChunkSize = 4096;
+        auto pool = workerPool();
+        const size_t numThreads = std::max<size_t>(1, std::min<size_t>(pool->concurrency(),
+                                                                       (mapPoints.size() + minChunkSize - 1) / minChunkSize));
+        const size_t chunkSize = (mapPoints.size() + numThreads - 1) / numThreads;
+        float *cloudData = reinterpret_cast<float *>(mapPointCloud.data.data());
+        std::vector<size_t> validPerChunk(numThreads, 0);
+        auto buildChunk = [&](size_t chunk)
         {
-            for (auto &mapPoint : KF->GetMapPoints())
+            const size_t begin = chunk * chunkSize;
+            const size_t end = std::min(mapPoints.size(), begin + chunkSize);
+            // segment of the first point in the chunk.
+            size_t segment = std::upper_bound(segments.begin(), segments.end(), begin, [](size_t idx, const Segment &seg)
+                                              { return idx < seg.begin; }) -
+                             segments.begin() - 1;
+            size_t written = 0;
+            float *out = cloudData + 3 * begin;
+            for (size_t i = begin; i < end; i++)
             {
-                if (!mapPoint->isBad())
-                {
-                    auto worldPos = typeConversions_->vector3fORBToROS(mapPoint->GetWorldPos());
-                    mapReferencesMutex_.lock();
-                    if (allKFs_.count(KF->mnId) == 0)
-                    {
-                        mapReferencesMutex_.unlock();
-                        continue;
-                    }
-                    auto mapPointWorld = typeConversions_->transformPointWithReference<Eigen::Vector3f>(mapReferencePoses_[allKFs_[KF->mnId]->GetMap()], worldPos);
-                    mapReferencesMutex_.unlock();
-                    trackedMapPoints.push_back(mapPointWorld);
-                }
+                while (segment + 1 < segments.size() && i >= segments[segment + 1].begin)
+                    ++segment;
+                ORB_SLAM3::MapPoint *pMP = mapPoints[i];
+                if (pMP == nullptr || pMP->isBad())
+                    continue;
+                const Eigen::Vector3f mapPointWorld = referencePoses[segments[segment].mapIdx] * typeConversions_->vector3fORBToROS(pMP->GetWorldPos());
+                out[3 * written] = mapPointWorld.x();
+                out[3 * written + 1] = mapPointWorld.y();
+                out[3 * written + 2] = mapPointWorld.z();
+                ++written;
             }
+            validPerChunk[chunk] = written;
+        };
+
+        pool->parallelFor(numThreads, buildChunk);
+
+        size_t numValid = validPerChunk[0];
+        for (size_t chunk = 1; chunk < numThreads; chunk++)
+        {
+            std::memmove(cloudData + 3 * numValid, cloudData + 3 * chunk * chunkSize, validPerChunk[chunk] * 3 * sizeof(float));
+            numValid += validPerChunk[chunk];
         }
-        mapPointCloud = typeConversions_->MapPointsToPCL(trackedMapPoints);
+        mapPointCloud.width = numValid;
+        mapPointCloud.row_step = mapPointCloud.point_step * mapPointCloud.width;
+        mapPointCloud.data.resize(mapPointCloud.row_step * mapPointCloud.height);
     }
 
     void ORBSLAM3Interface::mapPointsVisibleFromPose(geometry_msgs::msg::Pose cameraPose, std::vector<ORB_SLAM3::MapPoint*>& points, int maxLandmarks, float maxDistance, float maxAngle)
@@ -165,132 +567,269 @@ namespace ORB_SLAM3_Wrapper
         mapPointsVisibleFromPose(camPose, points, maxLandmarks, maxDistance, maxAngle);
     }
 
-    void ORBSLAM3Interface::mapPointsVisibleFromPose(Sophus::SE3f& cameraPose, std::vector<ORB_SLAM3::MapPoint*>& points, int maxLandmarks, float maxDistance, float maxAngle)
+    bool ORBSLAM3Interface::getPinholeFrustum(PinholeFrustum &frustum) const
     {
-        auto Tcw = cameraPose;
-        auto Twc = Tcw.inverse();
-
-        auto mRwc = Twc.rotationMatrix();
-        auto mOw = Twc.translation();
+        ORB_SLAM3::GeometricCamera *camera = nullptr;
+        return cameraFrustum(0, camera, frustum) && camera->GetType() == ORB_SLAM3::GeometricCamera::CAM_PINHOLE;
+    }
 
-        auto mRcw = Tcw.rotationMatrix();
-        auto mtcw = Tcw.translation();
-        if(orbAtlas_->GetAllCameras().size() > 1)
-        {
-            throw std::runtime_error("The number of cameras is greater than 1. This will be catered later. You cannot check if a map point is visible within a keyframe in this version. Check if there have been version updates.");
-        }
-        auto pCameraModel = orbAtlas_->GetAllCameras()[0];
+    bool ORBSLAM3Interface::cameraFrustum(size_t cameraIndex, ORB_SLAM3::GeometricCamera *&camera, PinholeFrustum &frustum) const
+    {
+        const auto cameras = mSLAM_->GetAtlas()->GetAllCameras();
+        if (cameraIndex >= cameras.size())
+            return false;
+        // the pinhole and the Kannala-Brandt models both start with fx, fy, cx, cy.
+        camera = cameras[cameraIndex];
+        frustum.fx = camera->getParameter(0);
+        frustum.fy = camera->getParameter(1);
+        frustum.cx = camera->getParameter(2);
+        frustum.cy = camera->getParameter(3);
+        frustum.minX = 0.0f;
+        frustum.maxX = imageWidth_;
+        frustum.minY = 0.0f;
+        frustum.maxY = imageHeight_;
+        return true;
+    }
 
-        float mnMinX = 0.0f;
-        float mnMaxX = 640.0f;
-        float mnMinY = 0.0f;
-        float mnMaxY = 480.0f;
-        int numVisibleMapPoints = 0;
-        int numKFsChecked = 0;
+    size_t ORBSLAM3Interface::gatherLandmarkCandidates(ORB_SLAM3::Map *pMap, const Sophus::SE3f &Tcw, float maxDistance, float maxAngle,
+                                                       LandmarkCandidates &shared, std::vector<uint32_t> &candidates)
+    {
+        const Sophus::SE3f Twc = Tcw.inverse();
+        const Eigen::Matrix3f mRwc = Twc.rotationMatrix();
+        const Eigen::Vector3f mOw = Twc.translation();
 
-        auto mapKFs_ = orbAtlas_->GetCurrentMap()->GetAllKeyFrames();
+        // only the keyframes around the pose are checked. Sorted by id to keep the order of a full map scan.
+        std::vector<ORB_SLAM3::KeyFrame *> mapKFs_;
+        keyFramesNearPosition(pMap, mOw, maxDistance, mapKFs_);
+        std::sort(mapKFs_.begin(), mapKFs_.end(), [](ORB_SLAM3::KeyFrame *a, ORB_SLAM3::KeyFrame *b)
+                  { return a->mnId < b->mnId; });
 
+        // gather the unique map points of the keyframes looking in the same direction, each snapshotted once
+        // (one lock per map point) for all the poses.
+        candidates.clear();
+        size_t numKFsChecked = 0;
         std::unordered_set<ORB_SLAM3::MapPoint*> processedMapPoints;
         for(auto pKFMp : mapKFs_)
         {
-            auto tempKFPose = typeConversions_->se3ORBToROS(pKFMp->GetPoseInverse());
-            // std::cout << "Distance between mOw and pKFMp->GetPoseInverse().translation(): " 
-            //           << (mOw - pKFMp->GetPoseInverse().translation()).norm() << std::endl;
             float distBwKfs = (mOw - pKFMp->GetPoseInverse().translation()).norm();
             if(distBwKfs > maxDistance)
                 continue;
             auto eulerAngles = (mRwc * pKFMp->GetPoseInverse().rotationMatrix().transpose()).eulerAngles(2, 1, 0);
-            // std::cout << "Euler angles: " << eulerAngles << std::endl;
             if(eulerAngles(0) > maxAngle || eulerAngles(1) > maxAngle || eulerAngles(2) > maxAngle)
                 continue;
             numKFsChecked++;
-            if(numVisibleMapPoints > maxLandmarks)
-                break;
-            auto currentKFMp = pKFMp->GetMapPoints();
-            for (auto pMP : currentKFMp)
+            for (auto pMP : pKFMp->GetMapPoints())
             {
-                if (processedMapPoints.find(pMP) != processedMapPoints.end())
+                if (!processedMapPoints.insert(pMP).second)
                     continue;
-                processedMapPoints.insert(pMP);
-                // 3D in absolute coordinates
-                Eigen::Matrix<float,3,1> P = pMP->GetWorldPos();
+                auto it = shared.rows.find(pMP);
+                if (it == shared.rows.end())
+                {
+                    if (pMP == nullptr || pMP->isBad())
+                        continue;
+                    it = shared.rows.emplace(pMP, static_cast<uint32_t>(shared.mapPoints.size())).first;
+                    shared.snapshot.push_back(pMP->GetWorldPos(), pMP->GetNormal(),
+                                              pMP->GetMinDistanceInvariance(), pMP->GetMaxDistanceInvariance());
+                    shared.mapPoints.push_back(pMP);
+                }
+                candidates.push_back(it->second);
+            }
+        }
+        return numKFsChecked;
+    }
 
-                // 3D in camera coordinates
-                const Eigen::Matrix<float,3,1> Pc = mRcw * P + mtcw;
+    void ORBSLAM3Interface::visibleCandidates(const MapPointSoA &snapshot, const std::vector<uint32_t> &candidates,
+                                              ORB_SLAM3::GeometricCamera *camera, const PinholeFrustum &frustum,
+                                              const Sophus::SE3f &Tcw, size_t maxLandmarks, MapPointSoA &scratch,
+                                              std::vector<uint8_t> &flags, std::vector<uint32_t> &visible) const
+    {
+        // the rows of the pose are copied out of the shared snapshot so that the kernel runs on contiguous arrays.
+        scratch.clear();
+        scratch.reserve(candidates.size());
+        for (auto row : candidates)
+        {
+            scratch.push_back(Eigen::Vector3f(snapshot.x[row], snapshot.y[row], snapshot.z[row]),
+                              Eigen::Vector3f(snapshot.nx[row], snapshot.ny[row], snapshot.nz[row]),
+                              snapshot.minDistance[row], snapshot.maxDistance[row]);
+        }
 
-                // Check positive depth
-                const float &PcZ = Pc(2);
-                const float invz = 1.0f/PcZ;
-                if(PcZ<0.0f)
+        VisibilityQuery query;
+        query.Rcw = Tcw.rotationMatrix();
+        query.tcw = Tcw.translation();
+        query.Ow = Tcw.inverse().translation();
+        query.viewingCosLimit = 0.5f;
+        if (camera->GetType() == ORB_SLAM3::GeometricCamera::CAM_PINHOLE)
+        {
+            computeVisibility(scratch, frustum, query, flags);
+        }
+        else
+        {
+            // distorted camera models have no closed form batch projection, project them one by one.
+            flags.assign(scratch.size(), 0);
+            for (size_t i = 0; i < scratch.size(); i++)
+            {
+                const Eigen::Vector3f P(scratch.x[i], scratch.y[i], scratch.z[i]);
+                const Eigen::Vector3f Pc = query.Rcw * P + query.tcw;
+                if (Pc(2) < 0.0f)
                     continue;
-
-                const Eigen::Vector2f uv = pCameraModel->project(Pc);
-
-                if(uv(0)<mnMinX || uv(0)>mnMaxX)
+                const Eigen::Vector2f uv = camera->project(Pc);
+                if (uv(0) < frustum.minX || uv(0) > frustum.maxX || uv(1) < frustum.minY || uv(1) > frustum.maxY)
+                    continue;
+                const Eigen::Vector3f PO = P - query.Ow;
+                const float dist = PO.norm();
+                if (dist < scratch.minDistance[i] || dist > scratch.maxDistance[i])
                     continue;
-                if(uv(1)<mnMinY || uv(1)>mnMaxY)
+                const Eigen::Vector3f Pn(scratch.nx[i], scratch.ny[i], scratch.nz[i]);
+                if (PO.dot(Pn) < query.viewingCosLimit * dist)
                     continue;
+                flags[i] = 1;
+            }
+        }
 
-                // Check distance is in the scale invariance region of the MapPoint
-                const float maxDistance = pMP->GetMaxDistanceInvariance();
-                const float minDistance = pMP->GetMinDistanceInvariance();
-                const Eigen::Vector3f PO = P - mOw;
-                const float dist = PO.norm();
+        visible.clear();
+        for (size_t i = 0; i < flags.size() && visible.size() < maxLandmarks; i++)
+        {
+            if (flags[i])
+                visible.push_back(candidates[i]);
+        }
+    }
 
-                if(dist<minDistance || dist>maxDistance)
-                    continue;
+    void ORBSLAM3Interface::mapPointsVisibleFromPose(Sophus::SE3f& cameraPose, std::vector<ORB_SLAM3::MapPoint*>& points, int maxLandmarks, float maxDistance, float maxAngle)
+    {
+        ScopedTimer timer(*visibleMapPointsLatency_);
+        // the first camera of the calibration, landmarksInViewBatch answers for the others.
+        ORB_SLAM3::GeometricCamera *pCameraModel = nullptr;
+        PinholeFrustum frustum;
+        if (!cameraFrustum(0, pCameraModel, frustum))
+            return;
 
-                // Check viewing angle
-                Eigen::Vector3f Pn = pMP->GetNormal();
+        LandmarkCandidates shared;
+        std::vector<uint32_t> candidates;
+        gatherLandmarkCandidates(orbAtlas_->GetCurrentMap(), cameraPose, maxDistance, maxAngle, shared, candidates);
+        MapPointSoA scratch;
+        std::vector<uint8_t> flags;
+        std::vector<uint32_t> visible;
+        visibleCandidates(shared.snapshot, candidates, pCameraModel, frustum, cameraPose,
+                          static_cast<size_t>(std::max(0, maxLandmarks)), scratch, flags, visible);
+        for (auto row : visible)
+            points.push_back(shared.mapPoints[row]);
+    }
 
-                const float viewCos = PO.dot(Pn)/dist;
+    bool ORBSLAM3Interface::landmarksInViewBatch(const std::vector<Eigen::Affine3d> &cameraPoses, size_t cameraIndex, size_t maxLandmarks,
+                                                 float maxDistance, float maxAngle, LandmarksInView &landmarks, std::string &message)
+    {
+        ScopedTimer timer(*visibleMapPointsBatchLatency_);
+        landmarks = LandmarksInView();
+        ORB_SLAM3::GeometricCamera *camera = nullptr;
+        PinholeFrustum frustum;
+        if (!cameraFrustum(cameraIndex, camera, frustum))
+        {
+            message = "The calibration has no camera " + std::to_string(cameraIndex) + ".";
+            return false;
+        }
+        ORB_SLAM3::Map *pMap = mSLAM_->GetAtlas()->GetCurrentMap();
+        if (pMap == nullptr)
+        {
+            message = "There is no map yet.";
+            return false;
+        }
+        if (maxLandmarks == 0)
+            maxLandmarks = std::numeric_limits<size_t>::max();
 
-                float viewingCosLimit = 0.5;
-                if(viewCos<viewingCosLimit)
-                    continue;
-                points.push_back(pMP);
-                numVisibleMapPoints++;
+        // the poses are in the global frame, the map points in the frame of the current map.
+        auto snapshot = currentSnapshot();
+        const Eigen::Affine3d referencePose = snapshot->referencePose(pMap);
+        const Eigen::Affine3d globalToMap = referencePose.inverse();
+        const size_t numPoses = cameraPoses.size();
+        std::vector<Sophus::SE3f> Tcws;
+        Tcws.reserve(numPoses);
+        LandmarkCandidates shared;
+        std::vector<std::vector<uint32_t>> candidates(numPoses);
+        for (size_t i = 0; i < numPoses; i++)
+        {
+            Tcws.push_back(typeConversions_->se3ROSToORB((globalToMap * cameraPoses[i]).cast<float>()));
+            gatherLandmarkCandidates(pMap, Tcws[i], maxDistance, maxAngle, shared, candidates[i]);
+        }
+
+        // the shared snapshot is read only from here, the poses are evaluated in parallel with a scratch per thread.
+        std::vector<std::vector<uint32_t>> visible(numPoses);
+        std::atomic<size_t> nextPose(0);
+        auto evaluate = [&]()
+        {
+            MapPointSoA scratch;
+            std::vector<uint8_t> flags;
+            for (size_t i = nextPose++; i < numPoses; i = nextPose++)
+                visibleCandidates(shared.snapshot, candidates[i], camera, frustum, Tcws[i], maxLandmarks, scratch, flags, visible[i]);
+        };
+        auto pool = workerPool();
+        pool->parallelFor(std::min(pool->concurrency(), numPoses), [&evaluate](size_t)
+                          { evaluate(); });
+
+        // one table of the points seen from any pose, in the order they are first seen.
+        std::vector<int64_t> tableIndex(shared.mapPoints.size(), -1);
+        const Eigen::Affine3f referencePosef = referencePose.cast<float>();
+        landmarks.indexCounts.reserve(numPoses);
+        for (const auto &poseVisible : visible)
+        {
+            landmarks.indexCounts.push_back(static_cast<uint32_t>(poseVisible.size()));
+            for (auto row : poseVisible)
+            {
+                if (tableIndex[row] < 0)
+                {
+                    tableIndex[row] = static_cast<int64_t>(landmarks.points.size() / 3);
+                    const Eigen::Vector3f point = referencePosef * typeConversions_->vector3fORBToROS(
+                        Eigen::Vector3f(shared.snapshot.x[row], shared.snapshot.y[row], shared.snapshot.z[row]));
+                    landmarks.points.insert(landmarks.points.end(), {point.x(), point.y(), point.z()});
+                }
+                landmarks.indices.push_back(static_cast<uint32_t>(tableIndex[row]));
             }
         }
-        /**
-        Added the stuff below just to see prints if the num kfs become 0. */
-        std::cout << "******" << std::endl;
-        std::cout << "Number of visible map points: " << numVisibleMapPoints << std::endl;
-        std::cout << "Number of keyframes checked: " << numKFsChecked << std::endl;
-        
-        // Print the input camera pose translation and rotation
-        std::cout << "Input camera pose translation: " << mOw.transpose() << std::endl;
-        std::cout << "Input camera pose rotation:\n" << mRwc << std::endl;
+        return true;
     }
 
-    void ORBSLAM3Interface::mapDataToMsg(slam_msgs::msg::MapData &mapDataMsg, bool currentMapKFOnly, bool includeMapPoints, std::vector<int> kFIDforMapPoints)
+    void ORBSLAM3Interface::snapshotMapPointsForVisibility(const std::vector<ORB_SLAM3::MapPoint *> &mapPoints,
+                                                           MapPointSoA &snapshot,
+                                                           std::vector<ORB_SLAM3::MapPoint *> &snapshotMapPoints)
     {
+        snapshot.clear();
+        snapshot.reserve(mapPoints.size());
+        snapshotMapPoints.clear();
+        snapshotMapPoints.reserve(mapPoints.size());
+        for (auto pMP : mapPoints)
+        {
+            if (pMP == nullptr || pMP->isBad())
+                continue;
+            snapshot.push_back(pMP->GetWorldPos(), pMP->GetNormal(),
+                               pMP->GetMinDistanceInvariance(), pMP->GetMaxDistanceInvariance());
+            snapshotMapPoints.push_back(pMP);
+        }
+    }
+
+    void ORBSLAM3Interface::mapDataToMsg(slam_msgs::msg::MapData &mapDataMsg, bool currentMapKFOnly, bool includeMapPoints, const std::vector<int> &kFIDforMapPoints)
+    {
+        ScopedTimer timer(*mapDataToMsgLatency_);
         std::lock_guard<std::mutex> lock(mapDataMutex_);
-        slam_msgs::msg::MapGraph poseGraph_;
-        getOptimizedPoseGraph(poseGraph_, currentMapKFOnly);
-        // publish the map data
-        mapDataMsg.graph = poseGraph_;
+        // built straight into the message, no intermediate graph to copy.
+        getOptimizedPoseGraph(mapDataMsg.graph, currentMapKFOnly);
         mapDataMsg.header.frame_id = globalFrame_;
+        size_t numNodes = 0;
         if (includeMapPoints)
         {
+            mapDataMsg.nodes.reserve(kFIDforMapPoints.size());
+            std::vector<Eigen::Vector3f> points;
             for (auto kFId : kFIDforMapPoints)
             {
-                slam_msgs::msg::KeyFrame pushedKf;
-                pushedKf.id = kFId;
-                if (allKFs_.find(kFId) != allKFs_.end())
+                points.clear();
+                if (kFId >= 0 && keyFrameMapPoints(kFId, points))
                 {
-                    for (auto mapPoint : allKFs_[kFId]->GetMapPoints())
-                    {
-                        if (!mapPoint->isBad())
-                        {
-                            auto worldPos = typeConversions_->vector3fORBToROS(mapPoint->GetWorldPos());
-                            mapReferencesMutex_.lock();
-                            auto mapPointWorld = typeConversions_->transformPointWithReference<geometry_msgs::msg::Point>(mapReferencePoses_[allKFs_[kFId]->GetMap()], worldPos);
-                            mapReferencesMutex_.unlock();
-                            pushedKf.word_pts.push_back(mapPointWorld);
-                        }
-                    }
-                    mapDataMsg.nodes.push_back(pushedKf);
+                    // the nodes and their points left by the previous build are overwritten.
+                    if (numNodes == mapDataMsg.nodes.size())
+                        mapDataMsg.nodes.emplace_back();
+                    slam_msgs::msg::KeyFrame &pushedKf = mapDataMsg.nodes[numNodes++];
+                    pushedKf.id = kFId;
+                    pushedKf.word_pts.resize(points.size());
+                    for (size_t i = 0; i < points.size(); i++)
+                        pushedKf.word_pts[i] = typeConversions_->eigenToPointMsg(points[i]);
                 }
                 else
                 {
@@ -298,15 +837,136 @@ namespace ORB_SLAM3_Wrapper
                 }
             }
         }
-        mapDataMutex_.unlock();
+        mapDataMsg.nodes.resize(numNodes);
     }
 
-    void ORBSLAM3Interface::correctTrackedPose(Sophus::SE3f &s)
+    bool ORBSLAM3Interface::keyFrameMapPoints(long unsigned int kfId, std::vector<Eigen::Vector3f> &points)
     {
-        mapReferencesMutex_.lock();
-        latestTrackedPose_ = typeConversions_->transformPoseWithReference<Eigen::Affine3d>(
-            mapReferencePoses_[orbAtlas_->GetCurrentMap()], s);
-        mapReferencesMutex_.unlock();
+        auto snapshot = currentSnapshot();
+        if (outputCache_)
+        {
+            // evicted keyframes are answered from the store.
+            ORB_SLAM3::Map *storedMap = nullptr;
+            StoredKeyFrame stored;
+            std::vector<StoredMapPoint> storedPoints;
+            {
+                std::lock_guard<std::mutex> residencyLock(residencyMutex_);
+                auto evicted = evictedKFs_.find(kfId);
+                if (evicted != evictedKFs_.end() && keyFrameStore_->get(evicted->first, stored, &storedPoints))
+                    storedMap = evicted->second;
+            }
+            if (storedMap != nullptr)
+            {
+                const Eigen::Affine3f referencePose = snapshot->referencePose(storedMap).cast<float>();
+                points.reserve(points.size() + storedPoints.size());
+                for (const auto &storedPoint : storedPoints)
+                    points.push_back(referencePose * Eigen::Vector3f(storedPoint.position[0], storedPoint.position[1], storedPoint.position[2]));
+                return true;
+            }
+        }
+        auto kf = snapshot->keyFrames->find(kfId);
+        if (kf == snapshot->keyFrames->end())
+            return false;
+        ORB_SLAM3::KeyFrame *pKF = kf->second;
+        Eigen::Affine3d referencePose = snapshot->referencePose(pKF->GetMap());
+        const auto mapPoints = pKF->GetMapPoints();
+        points.reserve(points.size() + mapPoints.size());
+        for (auto mapPoint : mapPoints)
+        {
+            if (mapPoint == nullptr || mapPoint->isBad())
+                continue;
+            auto worldPos = typeConversions_->vector3fORBToROS(mapPoint->GetWorldPos());
+            points.push_back(typeConversions_->transformPointWithReference<Eigen::Vector3f>(referencePose, worldPos));
+        }
+        return true;
+    }
+
+    void ORBSLAM3Interface::getMapPage(uint64_t cursor, size_t maxKeyFrames, bool includePoints, size_t maxPoints, MapPage &page)
+    {
+        ScopedTimer timer(*mapPageLatency_);
+        page = MapPage();
+        auto snapshot = currentSnapshot();
+        const KeyFramesById &keyFramesById = *snapshot->keyFramesById;
+        page.totalKeyFrames = keyFramesById.size();
+        auto remaining = std::lower_bound(keyFramesById.begin(), keyFramesById.end(), cursor,
+                                          [](const std::pair<long unsigned int, ORB_SLAM3::KeyFrame *> &kf, uint64_t id)
+                                          { return kf.first < id; });
+        const size_t numRemaining = keyFramesById.end() - remaining;
+        if (maxKeyFrames == 0)
+            maxKeyFrames = numRemaining;
+        const size_t pageSize = std::min(maxKeyFrames, numRemaining);
+
+        std::vector<ORB_SLAM3::KeyFrame *> keyFrames;
+        keyFrames.reserve(pageSize);
+        std::vector<Eigen::Vector3f> points;
+        if (includePoints)
+            page.pointCounts.reserve(pageSize);
+        for (size_t i = 0; i < pageSize; i++)
+        {
+            if (includePoints)
+            {
+                // a page holds at least one keyframe, whatever its number of points.
+                const size_t previous = points.size();
+                keyFrameMapPoints(remaining[i].first, points);
+                if (maxPoints > 0 && !keyFrames.empty() && points.size() > maxPoints)
+                {
+                    points.resize(previous);
+                    break;
+                }
+                page.pointCounts.push_back(points.size() - previous);
+            }
+            keyFrames.push_back(remaining[i].second);
+        }
+
+        std::vector<Eigen::Affine3d> worldPoses;
+        keyFrameWorldPoses(keyFrames, worldPoses);
+        page.ids.reserve(keyFrames.size());
+        page.poses.reserve(keyFrames.size());
+        for (size_t i = 0; i < keyFrames.size(); i++)
+        {
+            page.poses.emplace_back();
+            geometry_msgs::msg::PoseStamped &poseStamped = page.poses.back();
+            poseStamped.pose = tf2::toMsg(worldPoses[i]);
+            poseStamped.header.frame_id = globalFrame_;
+            poseStamped.header.stamp = typeConversions_->secToStamp(keyFrames[i]->mTimeStamp);
+            page.ids.push_back(keyFrames[i]->mnId);
+        }
+        page.points.resize(3 * points.size());
+        for (size_t i = 0; i < points.size(); i++)
+        {
+            page.points[3 * i] = points[i].x();
+            page.points[3 * i + 1] = points[i].y();
+            page.points[3 * i + 2] = points[i].z();
+        }
+        page.done = keyFrames.size() == numRemaining;
+        page.nextCursor = keyFrames.empty() ? cursor : keyFrames.back()->mnId + 1;
+    }
+
+    bool ORBSLAM3Interface::correctTrackedPose(Sophus::SE3f &s)
+    {
+        // tracking thread, the working copy is up to date.
+        auto reference = mapReferencePoses_.find(orbAtlas_->GetCurrentMap());
+        if (reference == mapReferencePoses_.end())
+        {
+            std::cerr << "The current map has no reference pose yet, the frame is not published." << endl;
+            return false;
+        }
+        const Eigen::Affine3d pose = typeConversions_->transformPoseWithReference<Eigen::Affine3d>(reference->second, s);
+        const double now = std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        if (mergeCorrectionPending_)
+        {
+            mergeCorrectionPending_ = false;
+            // the last published pose is still in the pre-merge frame (a frame of motion is taken in as well).
+            const Eigen::Affine3d correction = pose * latestTrackedPose_.inverse();
+            const double translation = MergeCorrection::translationMagnitude(correction);
+            const double rotation = MergeCorrection::rotationMagnitude(correction);
+            mergeTranslation_ = translation;
+            mergeRotation_ = rotation;
+            std::cout << "Map merge moved the tracked pose by " << translation << " m and " << rotation << " rad." << endl;
+            mergeCorrection_.start(correction, mergeHandling_ == MergeHandling::BLEND ? mergeBlendWindow_ : 0.0, now);
+        }
+        setLatestTrackedPose(mergeCorrection_.apply(pose, now));
+        return true;
     }
 
     void ORBSLAM3Interface::getDirectMapToRobotTF(std_msgs::msg::Header headerToUse, geometry_msgs::msg::TransformStamped &tf)
@@ -316,11 +976,10 @@ namespace ORB_SLAM3_Wrapper
         if (hasTracked_)
         {
             // get transform between map and odom and send the transform.
-            auto tfMapOdom = latestTrackedPose_;
+            auto tfMapOdom = getLatestTrackedPose();
             geometry_msgs::msg::Pose poseMapOdom = tf2::toMsg(tfMapOdom);
-            rclcpp::Duration transformTimeout_ = rclcpp::Duration::from_seconds(0.5);
-            rclcpp::Time odomTimestamp = headerToUse.stamp;
-            tf.header.stamp = odomTimestamp + transformTimeout_;
+            // the stamp of the frame the pose was tracked at, consumers bridge the frame period with their tolerance.
+            tf.header.stamp = headerToUse.stamp;
             tf.header.frame_id = globalFrame_;
             tf.child_frame_id = robotFrame_;
             tf.transform.translation.x = poseMapOdom.position.x;
@@ -347,11 +1006,10 @@ namespace ORB_SLAM3_Wrapper
                                    msgOdom->pose.pose.orientation.y,
                                    msgOdom->pose.pose.orientation.z));
             // get transform between map and odom and send the transform.
-            auto tfMapOdom = latestTrackedPose_ * latestOdomTransform_.inverse();
+            auto tfMapOdom = getLatestTrackedPose() * latestOdomTransform_.inverse();
             geometry_msgs::msg::Pose poseMapOdom = tf2::toMsg(tfMapOdom);
-            rclcpp::Duration transformTimeout_ = rclcpp::Duration::from_seconds(0.5);
-            rclcpp::Time odomTimestamp = msgOdom->header.stamp;
-            tf.header.stamp = odomTimestamp + transformTimeout_;
+            // the stamp of the odometry it was composed with, consumers bridge the frame period with their tolerance.
+            tf.header.stamp = msgOdom->header.stamp;
             tf.header.frame_id = globalFrame_;
             tf.child_frame_id = odomFrame_;
             tf.transform.translation.x = poseMapOdom.position.x;
@@ -361,196 +1019,983 @@ namespace ORB_SLAM3_Wrapper
         }
     }
 
-    void ORBSLAM3Interface::getOptimizedPoseGraph(slam_msgs::msg::MapGraph &graph, bool currentMapKFOnly)
+    void ORBSLAM3Interface::getOptimizedPoseGraph(slam_msgs::msg::MapGraph &graph, bool currentMapKFOnly, bool robotFrame)
     {
+        std::vector<ORB_SLAM3::KeyFrame *> vKeyFrames;
         if (!currentMapKFOnly)
         {
-            for (const auto &cKf : allKFs_)
-            {
-                ORB_SLAM3::KeyFrame *kf = cKf.second;
-                Sophus::SE3f kfPose = kf->GetPose();
-                geometry_msgs::msg::PoseStamped kfPoseStamped;
-                mapReferencesMutex_.lock();
-                kfPoseStamped.pose = typeConversions_->transformPoseWithReference<geometry_msgs::msg::Pose>(mapReferencePoses_[kf->GetMap()], kfPose);
-                mapReferencesMutex_.unlock();
-                kfPoseStamped.header.frame_id = globalFrame_;
-                kfPoseStamped.header.stamp = typeConversions_->secToStamp(kf->mTimeStamp);
-                graph.poses.push_back(kfPoseStamped);
-                graph.poses_id.push_back(kf->mnId);
-            }
+            auto snapshot = currentSnapshot();
+            vKeyFrames.reserve(snapshot->keyFrames->size());
+            for (const auto &cKf : *snapshot->keyFrames)
+                vKeyFrames.push_back(cKf.second);
         }
         else
         {
-            vector<ORB_SLAM3::KeyFrame *> vKeyFrames = orbAtlas_->GetAllKeyFrames();
             // TODO: add isBad() check for keyframes. Evaluate mapping if you do this.
-            // iterate over current keyframes.
-            for (auto pKFcurr : vKeyFrames)
+            vKeyFrames = orbAtlas_->GetAllKeyFrames();
+        }
+
+        std::vector<Eigen::Affine3d> worldPoses;
+        keyFrameWorldPoses(vKeyFrames, worldPoses, robotFrame);
+
+        // sized once and filled in place, the poses kept from a previous build keep their frame_id buffers.
+        graph.poses.resize(vKeyFrames.size());
+        graph.poses_id.resize(vKeyFrames.size());
+        for (size_t i = 0; i < vKeyFrames.size(); i++)
+        {
+            geometry_msgs::msg::PoseStamped &poseStamped = graph.poses[i];
+            poseStamped.pose = tf2::toMsg(worldPoses[i]);
+            poseStamped.header.frame_id = globalFrame_;
+            poseStamped.header.stamp = typeConversions_->secToStamp(vKeyFrames[i]->mTimeStamp);
+            graph.poses_id[i] = vKeyFrames[i]->mnId;
+        }
+    }
+
+    void ORBSLAM3Interface::keyFrameWorldPoses(const std::vector<ORB_SLAM3::KeyFrame *> &keyFrames, std::vector<Eigen::Affine3d> &worldPoses,
+                                               bool robotFrame)
+    {
+        // the poses of the evicted keyframes come from the store, without locking the keyframe.
+        std::vector<ORB_SLAM3::Map *> kfMaps(keyFrames.size(), nullptr);
+        std::vector<Eigen::Affine3d> kfAffines(keyFrames.size());
+        std::vector<size_t> residentIdx;
+        residentIdx.reserve(keyFrames.size());
+        if (outputCache_)
+        {
+            std::lock_guard<std::mutex> residencyLock(residencyMutex_);
+            for (size_t i = 0; i < keyFrames.size(); i++)
             {
-                mapReferencesMutex_.lock();
-                auto currReferencePose_ = mapReferencePoses_[pKFcurr->GetMap()];
-                mapReferencesMutex_.unlock();
-                Sophus::SE3f kFPose = pKFcurr->GetPose();
-                geometry_msgs::msg::PoseStamped poseStamped;
-                poseStamped.pose = typeConversions_->transformPoseWithReference<geometry_msgs::msg::Pose>(currReferencePose_, kFPose);
-                poseStamped.header.frame_id = globalFrame_;
-                poseStamped.header.stamp = typeConversions_->secToStamp(pKFcurr->mTimeStamp);
-                // push to pose graph.
-                graph.poses.push_back(poseStamped);
-                graph.poses_id.push_back(pKFcurr->mnId);
+                auto evicted = evictedKFs_.find(keyFrames[i]->mnId);
+                const StoredKeyFrame *stored = evicted == evictedKFs_.end() ? nullptr : keyFrameStore_->find(evicted->first);
+                if (stored == nullptr)
+                {
+                    residentIdx.push_back(i);
+                    continue;
+                }
+                kfMaps[i] = evicted->second;
+                kfAffines[i] = Eigen::Affine3d(Eigen::Translation3d(stored->position[0], stored->position[1], stored->position[2]) *
+                                               Eigen::Quaterniond(stored->orientation[3], stored->orientation[0], stored->orientation[1], stored->orientation[2]));
             }
         }
+        else
+        {
+            for (size_t i = 0; i < keyFrames.size(); i++)
+                residentIdx.push_back(i);
+        }
+
+        std::vector<Sophus::SE3f> kfPoses;
+        kfPoses.reserve(residentIdx.size());
+        for (auto i : residentIdx)
+        {
+            kfPoses.push_back(keyFrames[i]->GetPose());
+            kfMaps[i] = keyFrames[i]->GetMap();
+        }
+        std::vector<Eigen::Affine3d> residentAffines;
+        typeConversions_->se3ToAffine(kfPoses, residentAffines);
+        for (size_t r = 0; r < residentIdx.size(); r++)
+            kfAffines[residentIdx[r]] = residentAffines[r];
+
+        auto snapshot = currentSnapshot();
+        const Eigen::Affine3d frame = robotFrame ? snapshot->fleetReference.inverse() : Eigen::Affine3d::Identity();
+        worldPoses.resize(keyFrames.size());
+        for (size_t i = 0; i < keyFrames.size(); i++)
+            worldPoses[i] = frame * snapshot->referencePose(kfMaps[i]) * kfAffines[i];
     }
 
-    void ORBSLAM3Interface::handleIMU(const sensor_msgs::msg::Imu::SharedPtr msgIMU)
+    bool ORBSLAM3Interface::getKeyFrameDescriptors(long unsigned int kfId, size_t maxPoints, KeyFrameDescriptors &descriptors)
+    {
+        descriptors = KeyFrameDescriptors();
+        auto snapshot = currentSnapshot();
+        auto kf = snapshot->keyFrames->find(kfId);
+        if (kf == snapshot->keyFrames->end() || kf->second->isBad())
+            return false;
+        ORB_SLAM3::KeyFrame *pKF = kf->second;
+        const Eigen::Affine3d worldPose = snapshot->referencePose(pKF->GetMap()) * typeConversions_->se3ToAffine(pKF->GetPose());
+        descriptors.id = static_cast<int32_t>(pKF->mnId);
+        descriptors.pose = snapshot->fleetReference.inverse() * worldPose;
+
+        // the bag of words and the descriptors are set when the keyframe is created and never change.
+        descriptors.wordIds.reserve(pKF->mBowVec.size());
+        descriptors.wordWeights.reserve(pKF->mBowVec.size());
+        for (const auto &word : pKF->mBowVec)
+        {
+            descriptors.wordIds.push_back(word.first);
+            descriptors.wordWeights.push_back(static_cast<float>(word.second));
+        }
+
+        // keypoints with a map point, the most observed first.
+        const std::vector<ORB_SLAM3::MapPoint *> matches = pKF->GetMapPointMatches();
+        std::vector<std::pair<int, size_t>> observed;
+        observed.reserve(matches.size());
+        for (size_t idx = 0; idx < matches.size(); idx++)
+        {
+            ORB_SLAM3::MapPoint *pMP = matches[idx];
+            if (pMP == nullptr || pMP->isBad() || static_cast<int>(idx) >= pKF->mDescriptors.rows)
+                continue;
+            observed.emplace_back(pMP->Observations(), idx);
+        }
+        if (maxPoints > 0 && observed.size() > maxPoints)
+        {
+            std::partial_sort(observed.begin(), observed.begin() + maxPoints, observed.end(),
+                              [](const std::pair<int, size_t> &a, const std::pair<int, size_t> &b)
+                              { return a.first > b.first; });
+            observed.resize(maxPoints);
+        }
+
+        const Eigen::Affine3f worldToKeyFrame = (worldPose.inverse() * snapshot->referencePose(pKF->GetMap())).cast<float>();
+        const int descriptorBytes = std::min(pKF->mDescriptors.cols, 32);
+        descriptors.points.reserve(3 * observed.size());
+        descriptors.descriptors.assign(32 * observed.size(), 0);
+        for (size_t i = 0; i < observed.size(); i++)
+        {
+            const size_t idx = observed[i].second;
+            const Eigen::Vector3f point = worldToKeyFrame * typeConversions_->vector3fORBToROS(matches[idx]->GetWorldPos());
+            descriptors.points.push_back(point.x());
+            descriptors.points.push_back(point.y());
+            descriptors.points.push_back(point.z());
+            std::memcpy(descriptors.descriptors.data() + 32 * i, pKF->mDescriptors.ptr<uint8_t>(static_cast<int>(idx)), descriptorBytes);
+        }
+        return true;
+    }
+
+    void ORBSLAM3Interface::setFleetReference(const Eigen::Affine3d &reference)
     {
-        bufMutex_.lock();
-        imuBuf_.push(msgIMU);
-        bufMutex_.unlock();
+        std::lock_guard<std::mutex> lock(fleetReferenceMutex_);
+        fleetReference_ = reference;
+        fleetReferenceChanged_ = true;
     }
 
-    bool ORBSLAM3Interface::trackRGBDi(const sensor_msgs::msg::Image::SharedPtr msgRGB, const sensor_msgs::msg::Image::SharedPtr msgD, Sophus::SE3f &Tcw)
+    void ORBSLAM3Interface::accountIngestion(const sensor_msgs::msg::Image &msg, const cv::Mat &image)
     {
-        orbAtlas_ = mSLAM_->GetAtlas();
-        cv_bridge::CvImageConstPtr cvRGB;
-        cv_bridge::CvImageConstPtr cvD;
-        // Copy the ros rgb image message to cv::Mat.
-        try
+        const uint64_t numBytes = msg.data.size();
+        // toCvShare only converts (and copies) when the encoding cannot be used as is.
+        if (!msg.data.empty() && image.data == msg.data.data())
+            ingestedBytesShared_ += numBytes;
+        else
+            ingestedBytesCopied_ += numBytes;
+    }
+
+    ORBSLAM3Interface::IngestionStats ORBSLAM3Interface::getIngestionStats()
+    {
+        IngestionStats stats;
+        stats.frames = ingestedFrames_;
+        stats.bytesShared = ingestedBytesShared_;
+        stats.bytesCopied = ingestedBytesCopied_;
+        return stats;
+    }
+
+    void ORBSLAM3Interface::updateMapMetrics()
+    {
+        auto atlas = mSLAM_->GetAtlas();
+        auto maps = atlas->GetAllMaps();
+        long unsigned int numMapPoints = 0;
+        for (auto pMap : maps)
+            numMapPoints += pMap->MapPointsInMap();
+        auto snapshot = currentSnapshot();
+        const size_t numKFs = snapshot->keyFrames->size();
+        metrics_->gauge("maps", "Maps in the Atlas.").set(maps.size());
+        metrics_->gauge("reference_poses_recomputed", "Map reference poses recomputed since start.").set(referencePosesRecomputed_);
+        metrics_->gauge("keyframes", "Keyframes of the maps with a reference pose.").set(numKFs);
+        metrics_->gauge("map_points", "Map points in the Atlas.").set(numMapPoints);
+        metrics_->gauge("map_snapshot_version", "Versions of the keyframe table and reference poses published by the tracker.").set(snapshot->version);
+        metrics_->gauge("tracking_state", "ORB_SLAM3 tracking state, 2 is OK and 3 is LOST.").set(mSLAM_->GetTrackingState());
+        metrics_->gauge("tracked_map_points", "Map points matched in the last tracked frame.").set(trackedMapPoints_);
+        const int64_t lostSinceNs = lostSinceNs_;
+        const int64_t nowNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        metrics_->gauge("tracking_lost_seconds", "Time since tracking was lost, 0 while tracking.").set(lostSinceNs > 0 ? 1e-9 * (nowNs - lostSinceNs) : 0.0);
+        metrics_->gauge("relocalizations", "Recoveries from lost tracking in an existing map.").set(relocalizations_);
+        metrics_->gauge("relocalizations_with_hint", "Relocalizations of a lost episode that had a pose hint.").set(hintedRelocalizations_);
+        metrics_->gauge("relocalization_hint_mismatches", "Relocalizations further than the hint radius from the pose hint.").set(hintMismatches_);
+        metrics_->gauge("relocalization_hint_rejections", "Tracked frames withheld because they were further than the hint radius from the pose hint.").set(hintRejections_);
+        metrics_->gauge("maps_created_while_lost", "Lost episodes that ended in a new map instead of a relocalization.").set(mapsCreatedWhileLost_);
+        metrics_->gauge("relocalization_hint_candidates", "Keyframes near the pose hint of the current lost episode.").set(hintCandidates_);
+        metrics_->gauge("map_merge_in_progress", "1 while ORB_SLAM3 merges maps.").set(mergeInProgress_ ? 1 : 0);
+        metrics_->gauge("map_merges", "Map merges seen by the tracking thread.").set(mapMerges_);
+        metrics_->gauge("merge_correction_translation", "Translation (m) of the tracked pose by the last map merge.").set(mergeTranslation_);
+        metrics_->gauge("merge_correction_rotation", "Rotation (rad) of the tracked pose by the last map merge.").set(mergeRotation_);
+        metrics_->gauge("imu_queue_depth", "IMU samples waiting for a frame.").set(imuBuffer_.size());
+        metrics_->gauge("imu_overflows", "IMU samples dropped because the IMU buffer was full.").set(imuBuffer_.overflows());
+        metrics_->gauge("imu_out_of_order", "IMU samples dropped because they were older than the previous one.").set(imuBuffer_.outOfOrder());
+        metrics_->gauge("frames_without_imu", "Frames skipped because the IMU did not cover them yet.").set(framesWithoutImu_);
+        if (outputCache_)
         {
-            cvRGB = cv_bridge::toCvShare(msgRGB);
+            std::lock_guard<std::mutex> lock(residencyMutex_);
+            metrics_->gauge("live_keyframes", "Keyframes the output reads live from ORB_SLAM3.").set(numKFs > evictedKFs_.size() ? numKFs - evictedKFs_.size() : 0);
+            metrics_->gauge("cached_keyframes", "Keyframes the output reads from the output cache.").set(evictedKFs_.size());
+            metrics_->gauge("live_map_points", "Map points observed by the live keyframes.").set(residentMapPoints_);
+            metrics_->gauge("cached_map_points", "Map point observations in the output cache.").set(keyFrameStore_->numPoints());
+            metrics_->gauge("keyframe_store_bytes", "Live bytes of the keyframe store.").set(keyFrameStore_->liveBytes());
+            metrics_->gauge("keyframes_paged_in", "Keyframes paged back in since start.").set(keyFramesPagedIn_);
+            metrics_->gauge("keyframes_paged_out", "Keyframes paged out since start.").set(keyFramesPagedOut_);
         }
-        catch (cv_bridge::Exception &e)
+    }
+
+    void ORBSLAM3Interface::handleIMU(const sensor_msgs::msg::Imu::SharedPtr msgIMU)
+    {
+        ImuSample sample;
+        sample.stampNs = toNanoseconds(msgIMU->header.stamp.sec, msgIMU->header.stamp.nanosec);
+        sample.acc[0] = msgIMU->linear_acceleration.x;
+        sample.acc[1] = msgIMU->linear_acceleration.y;
+        sample.acc[2] = msgIMU->linear_acceleration.z;
+        sample.gyr[0] = msgIMU->angular_velocity.x;
+        sample.gyr[1] = msgIMU->angular_velocity.y;
+        sample.gyr[2] = msgIMU->angular_velocity.z;
+        imuBuffer_.push(sample);
+    }
+
+    bool ORBSLAM3Interface::takeImuMeasurements(int64_t frameStampNs)
+    {
+        int64_t newestStampNs;
+        // the IMU must cover the frame. Otherwise the samples stay queued for the next frame.
+        if (!imuBuffer_.newestStamp(newestStampNs) || newestStampNs < frameStampNs)
         {
-            std::cerr << "cv_bridge exception RGB!" << endl;
+            ++framesWithoutImu_;
             return false;
         }
+        imuWindow_.clear();
+        imuBuffer_.popUntil(frameStampNs, imuWindow_);
+        vImuMeas_.clear();
+        for (const auto &sample : imuWindow_)
+        {
+            vImuMeas_.push_back(ORB_SLAM3::IMU::Point(sample.acc[0], sample.acc[1], sample.acc[2],
+                                                      sample.gyr[0], sample.gyr[1], sample.gyr[2],
+                                                      sample.stampNs * 1e-9));
+        }
+        return true;
+    }
 
-        // Copy the ros depth image message to cv::Mat.
+    bool ORBSLAM3Interface::shareImages(const sensor_msgs::msg::Image::ConstSharedPtr &msgFirst, const char *firstName,
+                                        const sensor_msgs::msg::Image::ConstSharedPtr &msgSecond, const char *secondName,
+                                        cv_bridge::CvImageConstPtr &cvFirst, cv_bridge::CvImageConstPtr &cvSecond)
+    {
+        ScopedTimer timer(*cvBridgeLatency_);
+        // Share the ros image message buffers as cv::Mat.
         try
         {
-            cvD = cv_bridge::toCvShare(msgD);
+            cvFirst = cv_bridge::toCvShare(msgFirst);
         }
         catch (cv_bridge::Exception &e)
         {
-            std::cerr << "cv_bridge exception D!" << endl;
+            std::cerr << "cv_bridge exception " << firstName << "!" << endl;
             return false;
         }
-
-        vector<ORB_SLAM3::IMU::Point> vImuMeas;
-        bufMutex_.lock();
-        if (!imuBuf_.empty())
+        if (msgSecond)
         {
-            // Load imu measurements from buffer
-            vImuMeas.clear();
-            while (!imuBuf_.empty() && typeConversions_->stampToSec(imuBuf_.front()->header.stamp) <= std::min(typeConversions_->stampToSec(msgRGB->header.stamp), typeConversions_->stampToSec(msgD->header.stamp)))
+            try
             {
-                double t = typeConversions_->stampToSec(imuBuf_.front()->header.stamp);
-                cv::Point3f acc(imuBuf_.front()->linear_acceleration.x, imuBuf_.front()->linear_acceleration.y, imuBuf_.front()->linear_acceleration.z);
-                cv::Point3f gyr(imuBuf_.front()->angular_velocity.x, imuBuf_.front()->angular_velocity.y, imuBuf_.front()->angular_velocity.z);
-                vImuMeas.push_back(ORB_SLAM3::IMU::Point(acc, gyr, t));
-                imuBuf_.pop();
+                cvSecond = cv_bridge::toCvShare(msgSecond);
+            }
+            catch (cv_bridge::Exception &e)
+            {
+                std::cerr << "cv_bridge exception " << secondName << "!" << endl;
+                return false;
             }
         }
-        bufMutex_.unlock();
-        if (imuBuf_.size() > 0)
+        ++ingestedFrames_;
+        accountIngestion(*msgFirst, cvFirst->image);
+        if (msgSecond)
+            accountIngestion(*msgSecond, cvSecond->image);
+        return true;
+    }
+
+    void ORBSLAM3Interface::takePreparedImages(const std::shared_ptr<PreparedFrame> &prepared, cv::Mat &first, cv::Mat &second)
+    {
+        if (!prepared)
+            return;
+        ScopedTimer timer(*preparedFrameLatency_);
+        prepared->wait(first, second);
+    }
+
+    bool ORBSLAM3Interface::processTrackingResult(Sophus::SE3f &Tcw)
+    {
+        auto currentTrackingState = mSLAM_->GetTrackingState();
+        auto orbLoopClosing = mSLAM_->GetLoopClosing();
+        if (orbLoopClosing->mergeDetected())
         {
-            // track the frame.
-            Tcw = mSLAM_->TrackRGBD(cvRGB->image, cvD->image, typeConversions_->stampToSec(msgRGB->header.stamp), vImuMeas);
-            auto currentTrackingState = mSLAM_->GetTrackingState();
-            auto orbLoopClosing = mSLAM_->GetLoopClosing();
-            if (orbLoopClosing->mergeDetected())
+            if (!merging_)
+            {
+                merging_ = true;
+                mergeInProgress_ = true;
+                mergeStart_ = std::chrono::steady_clock::now();
+                auto reference = mapReferencePoses_.find(orbAtlas_->GetCurrentMap());
+                hasMergeReference_ = reference != mapReferencePoses_.end();
+                if (hasMergeReference_)
+                    mergeReference_ = reference->second;
+            }
+            // without the reference of the map the merge started in, there is no frame to keep the pose in.
+            if (mergeHandling_ == MergeHandling::PAUSE || !hasMergeReference_ || currentTrackingState != 2 || !hasTracked_)
             {
                 // do not publish any values during map merging. This is because the reference poses change.
                 std::cout << "Waiting for merge to finish." << endl;
                 return false;
             }
-            if (currentTrackingState == 2)
+            // the reference poses are not recalculated, the pose stays in the frame from before the merge.
+            const double now = std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+            setLatestTrackedPose(mergeCorrection_.apply(typeConversions_->transformPoseWithReference<Eigen::Affine3d>(mergeReference_, Tcw), now));
+            return true;
+        }
+        if (merging_)
+        {
+            merging_ = false;
+            mergeInProgress_ = false;
+            mergeLatency_->record(std::chrono::steady_clock::now() - mergeStart_);
+            ++mapMerges_;
+            mergeCorrectionPending_ = hasTracked_;
+        }
+        // 3 is recently lost (relocalizing in the current map), 4 lost (a new map is started).
+        const bool lost = currentTrackingState == 3 || currentTrackingState == 4;
+        if (lost && !lostEpisode_)
+        {
+            lostEpisode_ = true;
+            lostSince_ = std::chrono::steady_clock::now();
+            lostSinceNs_ = std::chrono::duration_cast<std::chrono::nanoseconds>(lostSince_.time_since_epoch()).count();
+            mapsWhenLost_ = mSLAM_->GetAtlas()->GetAllMaps().size();
+            std::cerr << "ORB-SLAM failed: Tracking LOST." << endl;
+        }
+        if (lost)
+        {
+            applyPoseHint();
+            // the next tracked pose also has the relocalization in it, it is not a merge correction.
+            mergeCorrectionPending_ = false;
+        }
+        lastTrackingState_ = currentTrackingState;
+        trackedMapPoints_ = 0;
+        if (currentTrackingState == 2)
+        {
+            const auto trackedMapPoints = mSLAM_->GetTrackedMapPoints();
+            trackedMapPoints_ = static_cast<int>(std::count_if(trackedMapPoints.begin(), trackedMapPoints.end(), [](ORB_SLAM3::MapPoint *pMP)
+                                                               { return pMP != nullptr; }));
+            calculateReferencePoses();
+            // a relocalization away from the pose hint is not published, the lost episode goes on.
+            if (lostEpisode_ && rejectRelocalization(Tcw))
+                return false;
+            if (!correctTrackedPose(Tcw))
+                return false;
             {
-                calculateReferencePoses();
-                correctTrackedPose(Tcw);
-                hasTracked_ = true;
-                return true;
+                std::lock_guard<std::mutex> lock(trackedCameraMutex_);
+                latestCameraCenter_ = Tcw.inverse().translation();
             }
-            else
+            // LOST, then OK again: the camera may be anywhere in the Atlas now.
+            if (lostEpisode_)
+                finishLostEpisode();
+            hasTracked_ = true;
+            return true;
+        }
+        switch (currentTrackingState)
+        {
+        case 0:
+            std::cerr << "ORB-SLAM failed: No images yet." << endl;
+            break;
+        case 1:
+            std::cerr << "ORB-SLAM failed: Not initialized." << endl;
+            break;
+        }
+        return false;
+    }
+
+    void ORBSLAM3Interface::setMergeHandling(MergeHandling handling, double blendWindow)
+    {
+        mergeHandling_ = handling;
+        mergeBlendWindow_ = std::max(0.0, blendWindow);
+    }
+
+    void ORBSLAM3Interface::setWorkerPool(std::shared_ptr<WorkerPool> pool)
+    {
+        std::atomic_store(&workerPool_, pool);
+    }
+
+    std::shared_ptr<WorkerPool> ORBSLAM3Interface::workerPool()
+    {
+        auto pool = std::atomic_load(&workerPool_);
+        if (!pool)
+        {
+            pool = WorkerPool::shared(0);
+            std::atomic_store(&workerPool_, pool);
+        }
+        return pool;
+    }
+
+    bool ORBSLAM3Interface::applyThreadLayout(const ThreadLayout &layout, std::string &message)
+    {
+        bool applied = true;
+        for (const auto &thread : orbThreads_)
+        {
+            const std::vector<int> &cpus = thread.first == "orb_local_map"   ? layout.localMapping
+                                           : thread.first == "orb_loop_close" ? layout.loopClosing
+                                                                              : layout.viewer;
+            if (cpus.empty())
+                continue;
+            if (!setThreadAffinity(thread.second, cpus))
             {
-                switch (currentTrackingState)
-                {
-                case 0:
-                    std::cerr << "ORB-SLAM failed: No images yet." << endl;
-                    break;
-                case 1:
-                    std::cerr << "ORB-SLAM failed: Not initialized." << endl;
-                    break;
-                case 3:
-                    std::cerr << "ORB-SLAM failed: Tracking LOST." << endl;
-                    break;
-                }
-                return false;
+                message += "Could not pin " + thread.first + " to CPUs " + formatCpuSet(cpus) + ". ";
+                applied = false;
             }
         }
-        return false;
+        if (orbThreads_.empty() && !(layout.localMapping.empty() && layout.loopClosing.empty() && layout.viewer.empty()))
+        {
+            message += "The ORB_SLAM3 threads were not found. ";
+            applied = false;
+        }
+        return applied;
+    }
+
+    void ORBSLAM3Interface::setPoseHint(const Eigen::Affine3d &pose, float radius, double maxAge)
+    {
+        std::lock_guard<std::mutex> lock(poseHintMutex_);
+        hasPoseHint_ = true;
+        poseHintPosition_ = pose.translation();
+        poseHintRadius_ = radius;
+        poseHintMaxAge_ = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(maxAge));
+        poseHintExpiry_ = std::chrono::steady_clock::now() + poseHintMaxAge_;
+    }
+
+    void ORBSLAM3Interface::applyPoseHint()
+    {
+        Eigen::Vector3d position;
+        float radius;
+        {
+            std::lock_guard<std::mutex> lock(poseHintMutex_);
+            if (!hasPoseHint_)
+                return;
+            hasPoseHint_ = false;
+            if (std::chrono::steady_clock::now() > poseHintExpiry_)
+                return;
+            position = poseHintPosition_;
+            radius = poseHintRadius_;
+            // the relocalizations of the episode are held to the hint for as long again.
+            appliedHintExpiry_ = std::chrono::steady_clock::now() + poseHintMaxAge_;
+        }
+        // the keyframes of every map near the hint, found with the spatial index of each map.
+        auto snapshot = currentSnapshot();
+        std::vector<ORB_SLAM3::KeyFrame *> candidates, nearKFs;
+        for (const auto &reference : snapshot->referencePoses)
+        {
+            const Eigen::Vector3d inMap = reference.second.inverse() * position;
+            const Eigen::Vector3f center = typeConversions_->se3ROSToORB(Eigen::Affine3f(Eigen::Translation3f(inMap.cast<float>()))).inverse().translation();
+            nearKFs.clear();
+            keyFramesNearPosition(reference.first, center, radius, nearKFs);
+            for (auto pKF : nearKFs)
+            {
+                if (!pKF->isBad() && (pKF->GetCameraCenter() - center).norm() <= radius)
+                    candidates.push_back(pKF);
+            }
+        }
+        hintApplied_ = true;
+        rejectingRelocalization_ = false;
+        appliedHintPosition_ = position;
+        appliedHintRadius_ = radius;
+        hintCandidates_ = candidates.size();
+        if (candidates.empty())
+            std::cerr << "No keyframe within " << radius << " m of the pose hint." << endl;
+#ifdef ORB_SLAM3_HAS_RELOCALIZATION_CANDIDATES
+        mSLAM_->SetRelocalizationCandidates(candidates);
+        if (!candidates.empty())
+            std::cout << "Pose hint: " << candidates.size() << " relocalization candidates within " << radius << " m." << endl;
+#else
+        // stock ORB_SLAM3 relocalizes against the whole keyframe database whatever the hint.
+        if (!candidates.empty())
+            std::cout << "Pose hint: " << candidates.size() << " keyframes within " << radius << " m. ORB_SLAM3 searches the whole"
+                      << " keyframe database (no ORB_SLAM3_HAS_RELOCALIZATION_CANDIDATES), relocalizations outside the radius are rejected." << endl;
+#endif
+    }
+
+    bool ORBSLAM3Interface::rejectRelocalization(const Sophus::SE3f &Tcw)
+    {
+        // a new map has no relation to the hint, and once the hint expires ORB_SLAM3 has the last word.
+        if (!hintApplied_ || mSLAM_->GetAtlas()->GetAllMaps().size() > mapsWhenLost_ || std::chrono::steady_clock::now() > appliedHintExpiry_)
+            return false;
+        auto reference = mapReferencePoses_.find(orbAtlas_->GetCurrentMap());
+        if (reference == mapReferencePoses_.end())
+            return false;
+        const Eigen::Affine3d pose = typeConversions_->transformPoseWithReference<Eigen::Affine3d>(reference->second, Tcw);
+        const double distance = (pose.translation() - appliedHintPosition_).norm();
+        if (distance <= appliedHintRadius_)
+            return false;
+        ++hintRejections_;
+        if (!rejectingRelocalization_)
+        {
+            rejectingRelocalization_ = true;
+            std::cerr << "Relocalized " << distance << " m away from the pose hint, the pose is withheld until it is within "
+                      << appliedHintRadius_ << " m or the hint expires." << endl;
+        }
+        return true;
     }
 
-    bool ORBSLAM3Interface::trackRGBD(const sensor_msgs::msg::Image::SharedPtr msgRGB, const sensor_msgs::msg::Image::SharedPtr msgD, Sophus::SE3f &Tcw)
+    void ORBSLAM3Interface::finishLostEpisode()
+    {
+        lostEpisode_ = false;
+        lostSinceNs_ = 0;
+        relocalized_ = true;
+        const auto lostFor = std::chrono::steady_clock::now() - lostSince_;
+        recoveryLatency_->record(lostFor);
+        const double lostSeconds = std::chrono::duration<double>(lostFor).count();
+        // ORB_SLAM3 gave up relocalizing and tracks in a new map.
+        const bool newMap = mSLAM_->GetAtlas()->GetAllMaps().size() > mapsWhenLost_;
+        if (newMap)
+        {
+            ++mapsCreatedWhileLost_;
+            std::cout << "Tracking resumed in a new map after " << lostSeconds << " s." << endl;
+        }
+        else
+        {
+            ++relocalizations_;
+            std::cout << "Relocalized after " << lostSeconds << " s." << endl;
+        }
+        if (!hintApplied_)
+            return;
+        hintApplied_ = false;
+        hintCandidates_ = 0;
+#ifdef ORB_SLAM3_HAS_RELOCALIZATION_CANDIDATES
+        mSLAM_->SetRelocalizationCandidates(std::vector<ORB_SLAM3::KeyFrame *>());
+#endif
+        if (newMap)
+            return;
+        ++hintedRelocalizations_;
+        const double distance = (latestTrackedPose_.translation() - appliedHintPosition_).norm();
+        if (distance > appliedHintRadius_)
+        {
+            ++hintMismatches_;
+            std::cerr << "Relocalized " << distance << " m away from the pose hint." << endl;
+        }
+    }
+
+    bool ORBSLAM3Interface::trackRGBDi(const sensor_msgs::msg::Image::ConstSharedPtr msgRGB, const sensor_msgs::msg::Image::ConstSharedPtr msgD, Sophus::SE3f &Tcw,
+                                      const std::shared_ptr<PreparedFrame> &prepared)
     {
         orbAtlas_ = mSLAM_->GetAtlas();
         cv_bridge::CvImageConstPtr cvRGB;
         cv_bridge::CvImageConstPtr cvD;
-        // Copy the ros rgb image message to cv::Mat.
-        try
+        if (!shareImages(msgRGB, "RGB", msgD, "D", cvRGB, cvD))
+            return false;
+        cv::Mat imRGB = cvRGB->image;
+        cv::Mat imD = cvD->image;
+        takePreparedImages(prepared, imRGB, imD);
+        const int64_t stampRGB = toNanoseconds(msgRGB->header.stamp.sec, msgRGB->header.stamp.nanosec);
+        const int64_t stampD = toNanoseconds(msgD->header.stamp.sec, msgD->header.stamp.nanosec);
+        if (!takeImuMeasurements(std::min(stampRGB, stampD)))
+            return false;
         {
-            cvRGB = cv_bridge::toCvShare(msgRGB);
+            std::lock_guard<std::mutex> trackLock(trackCallMutex_);
+            ScopedTimer timer(*trackLatency_);
+            // track the frame.
+            Tcw = mSLAM_->TrackRGBD(imRGB, imD, stampRGB * 1e-9, vImuMeas_);
         }
-        catch (cv_bridge::Exception &e)
+        return processTrackingResult(Tcw);
+    }
+
+    bool ORBSLAM3Interface::trackRGBD(const sensor_msgs::msg::Image::ConstSharedPtr msgRGB, const sensor_msgs::msg::Image::ConstSharedPtr msgD, Sophus::SE3f &Tcw,
+                                      const std::shared_ptr<PreparedFrame> &prepared)
+    {
+        orbAtlas_ = mSLAM_->GetAtlas();
+        cv_bridge::CvImageConstPtr cvRGB;
+        cv_bridge::CvImageConstPtr cvD;
+        if (!shareImages(msgRGB, "RGB", msgD, "D", cvRGB, cvD))
+            return false;
+        cv::Mat imRGB = cvRGB->image;
+        cv::Mat imD = cvD->image;
+        takePreparedImages(prepared, imRGB, imD);
         {
-            std::cerr << "cv_bridge exception RGB!" << endl;
+            std::lock_guard<std::mutex> trackLock(trackCallMutex_);
+            ScopedTimer timer(*trackLatency_);
+            // track the frame.
+            Tcw = mSLAM_->TrackRGBD(imRGB, imD, typeConversions_->stampToSec(msgRGB->header.stamp));
+        }
+        return processTrackingResult(Tcw);
+    }
+
+    bool ORBSLAM3Interface::trackStereo(const sensor_msgs::msg::Image::ConstSharedPtr msgLeft, const sensor_msgs::msg::Image::ConstSharedPtr msgRight, Sophus::SE3f &Tcw,
+                                      const std::shared_ptr<PreparedFrame> &prepared)
+    {
+        orbAtlas_ = mSLAM_->GetAtlas();
+        cv_bridge::CvImageConstPtr cvLeft;
+        cv_bridge::CvImageConstPtr cvRight;
+        if (!shareImages(msgLeft, "Left", msgRight, "Right", cvLeft, cvRight))
             return false;
+        cv::Mat imLeft = cvLeft->image;
+        cv::Mat imRight = cvRight->image;
+        takePreparedImages(prepared, imLeft, imRight);
+        {
+            std::lock_guard<std::mutex> trackLock(trackCallMutex_);
+            ScopedTimer timer(*trackLatency_);
+            Tcw = mSLAM_->TrackStereo(imLeft, imRight, typeConversions_->stampToSec(msgLeft->header.stamp));
         }
+        return processTrackingResult(Tcw);
+    }
 
-        // Copy the ros depth image message to cv::Mat.
-        try
+    bool ORBSLAM3Interface::trackStereoi(const sensor_msgs::msg::Image::ConstSharedPtr msgLeft, const sensor_msgs::msg::Image::ConstSharedPtr msgRight, Sophus::SE3f &Tcw,
+                                      const std::shared_ptr<PreparedFrame> &prepared)
+    {
+        orbAtlas_ = mSLAM_->GetAtlas();
+        cv_bridge::CvImageConstPtr cvLeft;
+        cv_bridge::CvImageConstPtr cvRight;
+        if (!shareImages(msgLeft, "Left", msgRight, "Right", cvLeft, cvRight))
+            return false;
+        cv::Mat imLeft = cvLeft->image;
+        cv::Mat imRight = cvRight->image;
+        takePreparedImages(prepared, imLeft, imRight);
+        const int64_t stampLeft = toNanoseconds(msgLeft->header.stamp.sec, msgLeft->header.stamp.nanosec);
+        const int64_t stampRight = toNanoseconds(msgRight->header.stamp.sec, msgRight->header.stamp.nanosec);
+        if (!takeImuMeasurements(std::min(stampLeft, stampRight)))
+            return false;
         {
-            cvD = cv_bridge::toCvShare(msgD);
+            std::lock_guard<std::mutex> trackLock(trackCallMutex_);
+            ScopedTimer timer(*trackLatency_);
+            Tcw = mSLAM_->TrackStereo(imLeft, imRight, stampLeft * 1e-9, vImuMeas_);
         }
-        catch (cv_bridge::Exception &e)
+        return processTrackingResult(Tcw);
+    }
+
+    bool ORBSLAM3Interface::trackMonocular(const sensor_msgs::msg::Image::ConstSharedPtr msgImage, Sophus::SE3f &Tcw,
+                                      const std::shared_ptr<PreparedFrame> &prepared)
+    {
+        orbAtlas_ = mSLAM_->GetAtlas();
+        cv_bridge::CvImageConstPtr cvImage;
+        cv_bridge::CvImageConstPtr unused;
+        if (!shareImages(msgImage, "Image", nullptr, "", cvImage, unused))
+            return false;
+        cv::Mat image = cvImage->image;
+        cv::Mat noImage;
+        takePreparedImages(prepared, image, noImage);
         {
-            std::cerr << "cv_bridge exception D!" << endl;
+            std::lock_guard<std::mutex> trackLock(trackCallMutex_);
+            ScopedTimer timer(*trackLatency_);
+            Tcw = mSLAM_->TrackMonocular(image, typeConversions_->stampToSec(msgImage->header.stamp));
+        }
+        return processTrackingResult(Tcw);
+    }
+
+    bool ORBSLAM3Interface::trackMonoculari(const sensor_msgs::msg::Image::ConstSharedPtr msgImage, Sophus::SE3f &Tcw,
+                                      const std::shared_ptr<PreparedFrame> &prepared)
+    {
+        orbAtlas_ = mSLAM_->GetAtlas();
+        cv_bridge::CvImageConstPtr cvImage;
+        cv_bridge::CvImageConstPtr unused;
+        if (!shareImages(msgImage, "Image", nullptr, "", cvImage, unused))
             return false;
+        cv::Mat image = cvImage->image;
+        cv::Mat noImage;
+        takePreparedImages(prepared, image, noImage);
+        const int64_t stamp = toNanoseconds(msgImage->header.stamp.sec, msgImage->header.stamp.nanosec);
+        if (!takeImuMeasurements(stamp))
+            return false;
+        {
+            std::lock_guard<std::mutex> trackLock(trackCallMutex_);
+            ScopedTimer timer(*trackLatency_);
+            Tcw = mSLAM_->TrackMonocular(image, stamp * 1e-9, vImuMeas_);
         }
-        // track the frame.
-        Tcw = mSLAM_->TrackRGBD(cvRGB->image, cvD->image, typeConversions_->stampToSec(msgRGB->header.stamp));
-        auto currentTrackingState = mSLAM_->GetTrackingState();
+        return processTrackingResult(Tcw);
+    }
+
+    bool ORBSLAM3Interface::saveMap(const std::string &path, std::string &message, uint64_t &rawBytes, uint64_t &compressedBytes)
+    {
+        std::lock_guard<std::mutex> lock(mapPersistenceMutex_);
         auto orbLoopClosing = mSLAM_->GetLoopClosing();
-        if (orbLoopClosing->mergeDetected())
+        if (orbLoopClosing->mergeDetected() || orbLoopClosing->isRunningGBA())
         {
-            // do not publish any values during map merging. This is because the reference poses change.
-            std::cout << "Waiting for merge to finish." << endl;
+            message = "A map merge or global bundle adjustment is running, try again later.";
             return false;
         }
-        if (currentTrackingState == 2)
+        const std::string vocabularyName = strVocFile_.substr(strVocFile_.find_last_of("/\\") + 1);
+        const std::string checksum = vocabularyChecksum(strVocFile_);
+        if (checksum.empty())
         {
-            calculateReferencePoses();
-            correctTrackedPose(Tcw);
-            std::vector<ORB_SLAM3::MapPoint *> tempMapPoints;
-            auto tempTwc = Tcw.inverse();
-            // mapPointsVisibleFromPose(tempTwc, tempMapPoints, 1000, 5.0, 2.0);
-            hasTracked_ = true;
-            return true;
+            message = "Could not read the vocabulary " + strVocFile_;
+            return false;
         }
-        else
+        std::ofstream file(path, std::ios::binary);
+        if (!file)
+        {
+            message = "Could not open " + path;
+            return false;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        std::stringstream snapshot;
+        try
         {
-            switch (currentTrackingState)
+            // snapshot: no track call runs and no map is updated while the Atlas is serialized, tracking just
+            // waits for the lock. The maps are locked in id order, as the tracker locks its map after trackCallMutex_.
+            std::lock_guard<std::mutex> trackLock(trackCallMutex_);
+            ORB_SLAM3::Atlas *atlas = mSLAM_->GetAtlas();
+            std::vector<ORB_SLAM3::Map *> maps = atlas->GetAllMaps();
+            std::sort(maps.begin(), maps.end(), [](ORB_SLAM3::Map *a, ORB_SLAM3::Map *b)
+                      { return a->GetId() < b->GetId(); });
+            std::vector<std::unique_lock<std::mutex>> mapLocks;
+            mapLocks.reserve(maps.size());
+            for (ORB_SLAM3::Map *pMap : maps)
+                mapLocks.emplace_back(pMap->mMutexMapUpdate);
+            boost::archive::binary_oarchive archive(snapshot);
+            atlas->PreSave();
+            archive << vocabularyName;
+            archive << checksum;
+            archive << atlas;
+        }
+        catch (const std::exception &e)
+        {
+            message = std::string("Serialization failed: ") + e.what();
+            return false;
+        }
+        metrics_->gauge("map_snapshot_seconds", "Time tracking waited for the last Atlas snapshot.").set(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+
+        // the slow part, compressing and writing, runs on the snapshot with the system live again.
+        bool saved = false;
+        {
+            CompressedChunkWriter writer(file);
             {
-            case 0:
-                std::cerr << "ORB-SLAM failed: No images yet." << endl;
+                std::ostream stream(&writer);
+                stream << snapshot.rdbuf();
+            }
+            saved = writer.finish();
+            rawBytes = writer.rawBytes();
+            compressedBytes = writer.compressedBytes();
+        }
+        if (!saved)
+        {
+            message = "Could not write " + path;
+            return false;
+        }
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        metrics_->gauge("map_save_seconds", "Duration of the last Atlas save.").set(seconds);
+        std::ostringstream result;
+        result << "Saved the Atlas to " << path << " in " << seconds << " s, " << rawBytes << " bytes compressed to " << compressedBytes << ".";
+        message = result.str();
+        std::cout << message << endl;
+        return true;
+    }
+
+    bool ORBSLAM3Interface::setOutputCache(const OutputCacheLimits &limits)
+    {
+        std::lock_guard<std::mutex> lock(residencyMutex_);
+        outputCacheLimits_ = limits;
+        if (limits.keyFrames == 0 && limits.mapPoints == 0)
+        {
+            outputCache_ = false;
+            keyFrameStore_.reset();
+            return true;
+        }
+        keyFrameStore_ = std::make_unique<MappedKeyFrameStore>(limits.storePath);
+        if (!keyFrameStore_->open())
+        {
+            keyFrameStore_.reset();
+            return false;
+        }
+        std::cout << "Output cache: " << limits.keyFrames << " keyframes, " << limits.mapPoints
+                  << " map points read live, the others from " << limits.storePath << endl;
+        outputCache_ = true;
+        return true;
+    }
+
+    bool ORBSLAM3Interface::updateResidency()
+    {
+        if (!outputCache_ || !hasTracked_)
+            return false;
+        ScopedTimer timer(*residencyLatency_);
+        Eigen::Vector3f cameraCenter;
+        {
+            std::lock_guard<std::mutex> lock(trackedCameraMutex_);
+            cameraCenter = latestCameraCenter_;
+        }
+        ORB_SLAM3::Map *currentMap = orbAtlas_->GetCurrentMap();
+        const bool relocalized = relocalized_.exchange(false);
+        auto snapshot = currentSnapshot();
+        const KeyFrameTable &keyFrames = *snapshot->keyFrames;
+        bool staleStore;
+        {
+            std::lock_guard<std::mutex> lock(residencyMutex_);
+            staleStore = !staleStoreMaps_.empty() || !optimizedStoreMaps_.empty();
+        }
+        // nothing to page while the camera stays within a voxel and the map does not change.
+        if (!relocalized && !staleStore && currentMap == residencyMap_ && snapshot->version == residencySnapshotVersion_ &&
+            (cameraCenter - residencyCenter_).norm() < spatialIndexVoxelSize_)
+            return false;
+        residencyCenter_ = cameraCenter;
+        residencyMap_ = currentMap;
+        residencySnapshotVersion_ = snapshot->version;
+
+        // the live keyframes are the ones of the current map nearest to the camera. The query grows
+        // until it covers the keyframe limit, it never has to walk the whole Atlas.
+        const size_t keyFrameLimit = outputCacheLimits_.keyFrames > 0 ? outputCacheLimits_.keyFrames : std::numeric_limits<size_t>::max();
+        const size_t numKFsInMap = currentMap->KeyFramesInMap();
+        std::vector<ORB_SLAM3::KeyFrame *> nearby;
+        float radius = 4.0f * spatialIndexVoxelSize_;
+        for (int i = 0; i < 16; i++)
+        {
+            nearby.clear();
+            keyFramesNearPosition(currentMap, cameraCenter, radius, nearby);
+            if (nearby.size() >= keyFrameLimit || nearby.size() >= numKFsInMap)
                 break;
-            case 1:
-                std::cerr << "ORB-SLAM failed: Not initialized." << endl;
+            radius *= 2.0f;
+        }
+        std::vector<std::pair<float, ORB_SLAM3::KeyFrame *>> candidates;
+        candidates.reserve(nearby.size());
+        for (ORB_SLAM3::KeyFrame *pKF : nearby)
+        {
+            if (!pKF->isBad())
+                candidates.emplace_back((pKF->GetCameraCenter() - cameraCenter).squaredNorm(), pKF);
+        }
+        std::sort(candidates.begin(), candidates.end(), [](const std::pair<float, ORB_SLAM3::KeyFrame *> &a, const std::pair<float, ORB_SLAM3::KeyFrame *> &b)
+                  { return a.first < b.first; });
+        std::unordered_set<long unsigned int> resident;
+        size_t residentMapPoints = 0;
+        for (const auto &candidate : candidates)
+        {
+            if (resident.size() >= keyFrameLimit)
                 break;
-            case 3:
-                std::cerr << "ORB-SLAM failed: Tracking LOST." << endl;
+            const size_t numPoints = candidate.second->GetMapPoints().size();
+            if (outputCacheLimits_.mapPoints > 0 && !resident.empty() && residentMapPoints + numPoints > outputCacheLimits_.mapPoints)
                 break;
+            resident.insert(candidate.second->mnId);
+            residentMapPoints += numPoints;
+        }
+
+        std::lock_guard<std::mutex> residencyLock(residencyMutex_);
+        residentMapPoints_ = residentMapPoints;
+        // a local bundle adjustment moves the keyframes covisible with the newest one, which is live, and their
+        // map points. The cached neighbours of the live keyframes of the optimized map are the ones it can reach.
+        std::unordered_set<long unsigned int> optimized;
+        for (const auto &candidate : candidates)
+        {
+            if (resident.count(candidate.second->mnId) == 0 || optimizedStoreMaps_.count(candidate.second->GetMap()) == 0)
+                continue;
+            for (ORB_SLAM3::KeyFrame *pNeighbour : candidate.second->GetVectorCovisibleKeyFrames())
+            {
+                if (pNeighbour != nullptr && evictedKFs_.count(pNeighbour->mnId) > 0)
+                    optimized.insert(pNeighbour->mnId);
             }
+        }
+        optimizedStoreMaps_.clear();
+        uint64_t pagedIn = 0, pagedOut = 0;
+        // page in what is within the limits again, and drop what is stale or gone. A keyframe moved by a merge
+        // or culled is no longer in the keyframe table or not in the map it was stored with.
+        for (auto it = evictedKFs_.begin(); it != evictedKFs_.end();)
+        {
+            const bool exists = keyFrames.count(it->first) > 0;
+            if (exists && resident.count(it->first) == 0 && staleStoreMaps_.count(it->second) == 0 && optimized.count(it->first) == 0)
+            {
+                ++it;
+                continue;
+            }
+            keyFrameStore_->erase(it->first);
+            it = evictedKFs_.erase(it);
+            if (exists)
+                ++pagedIn;
+        }
+        staleStoreMaps_.clear();
+        // page out everything else, stale keyframes with their new pose. Only the keyframes that were not cached yet are read from ORB_SLAM3.
+        for (const auto &kf : keyFrames)
+        {
+            if (resident.count(kf.first) > 0 || evictedKFs_.count(kf.first) > 0)
+                continue;
+            if (evictKeyFrame(kf.second))
+                ++pagedOut;
+        }
+        keyFramesPagedIn_ += pagedIn;
+        keyFramesPagedOut_ += pagedOut;
+        return pagedIn > 0 || pagedOut > 0;
+    }
+
+    bool ORBSLAM3Interface::evictKeyFrame(ORB_SLAM3::KeyFrame *pKF)
+    {
+        if (pKF->isBad())
+            return false;
+        const Eigen::Affine3d pose = typeConversions_->se3ToAffine(pKF->GetPose());
+        const Eigen::Quaterniond orientation(pose.rotation());
+        StoredKeyFrame stored{};
+        stored.id = pKF->mnId;
+        stored.stamp = pKF->mTimeStamp;
+        stored.position[0] = pose.translation().x();
+        stored.position[1] = pose.translation().y();
+        stored.position[2] = pose.translation().z();
+        stored.orientation[0] = orientation.x();
+        stored.orientation[1] = orientation.y();
+        stored.orientation[2] = orientation.z();
+        stored.orientation[3] = orientation.w();
+
+        evictionPoints_.clear();
+        for (ORB_SLAM3::MapPoint *pMP : pKF->GetMapPoints())
+        {
+            if (pMP == nullptr || pMP->isBad())
+                continue;
+            StoredMapPoint point{};
+            point.id = pMP->mnId;
+            const Eigen::Vector3f position = typeConversions_->vector3fORBToROS(pMP->GetWorldPos());
+            point.position[0] = position.x();
+            point.position[1] = position.y();
+            point.position[2] = position.z();
+            point.flags = pMP->GetReferenceKeyFrame() == pKF ? StoredMapPoint::kReferenceKeyFrame : 0;
+            evictionPoints_.push_back(point);
+        }
+        if (!keyFrameStore_->put(stored, evictionPoints_))
             return false;
+        evictedKFs_[stored.id] = pKF->GetMap();
+        return true;
+    }
+
+    void ORBSLAM3Interface::getCachedMapPoints(sensor_msgs::msg::PointCloud2 &mapPointCloud, const MapSnapshot &snapshot)
+    {
+        std::unordered_map<ORB_SLAM3::Map *, Eigen::Affine3f> referencePoses;
+        for (const auto &reference : snapshot.referencePoses)
+            referencePoses[reference.first] = reference.second.cast<float>();
+        std::vector<ORB_SLAM3::KeyFrame *> residentKFs;
+        std::lock_guard<std::mutex> residencyLock(residencyMutex_);
+        const KeyFrameTable &keyFrames = *snapshot.keyFrames;
+        residentKFs.reserve(keyFrames.size() > evictedKFs_.size() ? keyFrames.size() - evictedKFs_.size() : 0);
+        for (const auto &kf : keyFrames)
+        {
+            if (evictedKFs_.count(kf.first) == 0)
+                residentKFs.push_back(kf.second);
+        }
+
+        // the map points of the resident keyframes, each once.
+        std::unordered_set<ORB_SLAM3::MapPoint *> residentPoints;
+        std::unordered_set<long unsigned int> residentPointIds;
+        std::vector<std::pair<ORB_SLAM3::MapPoint *, const Eigen::Affine3f *>> livePoints;
+        for (ORB_SLAM3::KeyFrame *pKF : residentKFs)
+        {
+            auto reference = referencePoses.find(pKF->GetMap());
+            if (reference == referencePoses.end())
+                continue;
+            for (ORB_SLAM3::MapPoint *pMP : pKF->GetMapPoints())
+            {
+                if (pMP == nullptr || pMP->isBad() || !residentPoints.insert(pMP).second)
+                    continue;
+                residentPointIds.insert(pMP->mnId);
+                livePoints.emplace_back(pMP, &reference->second);
+            }
+        }
+
+        typeConversions_->initXYZCloud(mapPointCloud, livePoints.size() + keyFrameStore_->numPoints());
+        float *out = reinterpret_cast<float *>(mapPointCloud.data.data());
+        size_t written = 0;
+        for (const auto &livePoint : livePoints)
+        {
+            const Eigen::Vector3f mapPointWorld = *livePoint.second * typeConversions_->vector3fORBToROS(livePoint.first->GetWorldPos());
+            out[3 * written] = mapPointWorld.x();
+            out[3 * written + 1] = mapPointWorld.y();
+            out[3 * written + 2] = mapPointWorld.z();
+            ++written;
+        }
+        // each evicted map point is emitted by its reference keyframe only, unless a resident keyframe already did.
+        for (const auto &evicted : evictedKFs_)
+        {
+            auto reference = referencePoses.find(evicted.second);
+            const StoredMapPoint *storedPoints;
+            const StoredKeyFrame *stored = keyFrameStore_->find(evicted.first, &storedPoints);
+            if (reference == referencePoses.end() || stored == nullptr)
+                continue;
+            for (uint32_t i = 0; i < stored->numPoints; i++)
+            {
+                const StoredMapPoint &point = storedPoints[i];
+                if (!(point.flags & StoredMapPoint::kReferenceKeyFrame) || residentPointIds.count(point.id) > 0)
+                    continue;
+                const Eigen::Vector3f mapPointWorld = reference->second * Eigen::Vector3f(point.position[0], point.position[1], point.position[2]);
+                out[3 * written] = mapPointWorld.x();
+                out[3 * written + 1] = mapPointWorld.y();
+                out[3 * written + 2] = mapPointWorld.z();
+                ++written;
+            }
         }
+        mapPointCloud.width = written;
+        mapPointCloud.row_step = mapPointCloud.point_step * mapPointCloud.width;
+        mapPointCloud.data.resize(mapPointCloud.row_step * mapPointCloud.height);
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,156 @@
+/**
+ * @file overload_controller.cpp
+ * @brief Adapts the tracked frame rate to the tracking latency and the motion of the robot.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#include "orb_slam3_ros2_wrapper/overload_controller.hpp"
+
+#include <cmath>
+
+namespace ORB_SLAM3_Wrapper
+{
+    OverloadController::OverloadController(const OverloadControllerConfig &config)
+        : config_(config)
+    {
+        // the first frame is always tracked.
+        framesSinceTracked_ = config_.maxFrameSkip + 1;
+    }
+
+    bool OverloadController::admitFrame(double stamp)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (hasFrameStamp_)
+        {
+            const double period = stamp - lastFrameStamp_;
+            // gaps in the stream (and out of order frames) say nothing about the camera rate.
+            if (period > 0.0 && period < 1.0)
+                cameraPeriod_ = cameraPeriod_ > 0.0 ? cameraPeriod_ + config_.smoothing * (period - cameraPeriod_) : period;
+        }
+        lastFrameStamp_ = stamp;
+        hasFrameStamp_ = true;
+
+        if (framesSinceTracked_ < frameSkip_)
+        {
+            ++framesSinceTracked_;
+            return false;
+        }
+        framesSinceTracked_ = 0;
+        return true;
+    }
+
+    void OverloadController::recordTrack(double latency, bool tracked, int trackedMapPoints, double now)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        trackLatency_ = hasTrackLatency_ ? trackLatency_ + config_.smoothing * (latency - trackLatency_) : latency;
+        hasTrackLatency_ = true;
+        ++framesSinceChange_;
+
+        if (!tracked || trackedMapPoints < config_.minTrackedMapPoints)
+        {
+            frameSkip_ = 0;
+            decision_ = Decision::TRACKING_QUALITY;
+            return;
+        }
+        bool motionKnown;
+        if (!isSlow(now, motionKnown))
+        {
+            frameSkip_ = 0;
+            decision_ = motionKnown ? Decision::FAST_MOTION : Decision::NO_MOTION_ESTIMATE;
+            return;
+        }
+        if (cameraPeriod_ > 0.0 && framesSinceChange_ >= config_.holdFrames)
+        {
+            const double trackedPeriod = cameraPeriod_ * (frameSkip_ + 1);
+            if (trackLatency_ > config_.maxUtilization * trackedPeriod && frameSkip_ < config_.maxFrameSkip)
+            {
+                ++frameSkip_;
+                framesSinceChange_ = 0;
+            }
+            else if (frameSkip_ > 0 && trackLatency_ < config_.restoreUtilization * cameraPeriod_ * frameSkip_)
+            {
+                --frameSkip_;
+                framesSinceChange_ = 0;
+            }
+        }
+        decision_ = frameSkip_ > 0 ? Decision::SKIPPING : Decision::FULL_RATE;
+    }
+
+    void OverloadController::recordOdometry(double linearSpeed, double angularSpeed, double now)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        linearSpeed_ = std::abs(linearSpeed);
+        odometryAngularSpeed_ = std::abs(angularSpeed);
+        odometryStamp_ = now;
+    }
+
+    void OverloadController::recordAngularRate(double angularSpeed, double now)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        gyroAngularSpeed_ = std::abs(angularSpeed);
+        gyroStamp_ = now;
+    }
+
+    bool OverloadController::isSlow(double now, bool &motionKnown) const
+    {
+        const bool odometryFresh = odometryStamp_ >= 0.0 && now - odometryStamp_ <= config_.motionTimeout;
+        const bool gyroFresh = gyroStamp_ >= 0.0 && now - gyroStamp_ <= config_.motionTimeout;
+        motionKnown = odometryFresh || gyroFresh;
+        if (!motionKnown)
+            return false;
+        if (odometryFresh && (linearSpeed_ > config_.slowLinearSpeed || odometryAngularSpeed_ > config_.slowAngularSpeed))
+            return false;
+        if (gyroFresh && gyroAngularSpeed_ > config_.slowAngularSpeed)
+            return false;
+        return true;
+    }
+
+    OverloadController::Decision OverloadController::decision() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return decision_;
+    }
+
+    const char *OverloadController::decisionName(Decision decision)
+    {
+        switch (decision)
+        {
+        case Decision::SKIPPING:
+            return "skipping frames";
+        case Decision::FAST_MOTION:
+            return "full rate, fast motion";
+        case Decision::NO_MOTION_ESTIMATE:
+            return "full rate, no motion estimate";
+        case Decision::TRACKING_QUALITY:
+            return "full rate, tracking quality";
+        default:
+            return "full rate";
+        }
+    }
+
+    int OverloadController::frameSkip() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return frameSkip_;
+    }
+
+    double OverloadController::headroom() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (cameraPeriod_ <= 0.0)
+            return 1.0;
+        return 1.0 - trackLatency_ / (cameraPeriod_ * (frameSkip_ + 1));
+    }
+
+    double OverloadController::cameraPeriod() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return cameraPeriod_;
+    }
+
+    double OverloadController::trackLatency() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return trackLatency_;
+    }
+}
@@ -0,0 +1,165 @@
+/**
+ * @file packed_points.cpp
+ * @brief Packing of x, y, z points into slam_msgs/PackedPoints, float32 or quantized, optionally zstd compressed.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#include "orb_slam3_ros2_wrapper/packed_points.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#include <zstd.h>
+
+namespace ORB_SLAM3_Wrapper
+{
+    namespace
+    {
+        using PackedPoints = slam_msgs::msg::PackedPoints;
+
+        size_t pointSize(uint8_t encoding)
+        {
+            switch (encoding)
+            {
+            case PackedPoints::ENCODING_FLOAT32:
+                return 3 * sizeof(float);
+            case PackedPoints::ENCODING_UINT16:
+                return 3 * sizeof(uint16_t);
+            }
+            return 0;
+        }
+
+        // false if the points do not fit in the quantization steps.
+        bool quantize(const float *xyz, size_t count, double resolution, PackedPoints &packed, std::vector<uint8_t> &raw)
+        {
+            if (!(resolution > 0.0))
+                return false;
+            double lower[3], upper[3];
+            for (int axis = 0; axis < 3; axis++)
+            {
+                lower[axis] = std::numeric_limits<double>::max();
+                upper[axis] = std::numeric_limits<double>::lowest();
+            }
+            for (size_t i = 0; i < count; i++)
+            {
+                for (int axis = 0; axis < 3; axis++)
+                {
+                    lower[axis] = std::min<double>(lower[axis], xyz[3 * i + axis]);
+                    upper[axis] = std::max<double>(upper[axis], xyz[3 * i + axis]);
+                }
+            }
+            for (int axis = 0; axis < 3; axis++)
+            {
+                // also false for non finite points.
+                if (count > 0 && !((upper[axis] - lower[axis]) / resolution <= 65535.0))
+                    return false;
+                if (count == 0)
+                    lower[axis] = 0.0;
+            }
+            packed.origin.x = lower[0];
+            packed.origin.y = lower[1];
+            packed.origin.z = lower[2];
+            packed.resolution = resolution;
+            raw.resize(count * 3 * sizeof(uint16_t));
+            uint16_t *out = reinterpret_cast<uint16_t *>(raw.data());
+            for (size_t i = 0; i < 3 * count; i++)
+            {
+                const double steps = std::round((xyz[i] - lower[i % 3]) / resolution);
+                out[i] = static_cast<uint16_t>(std::min(65535.0, steps));
+            }
+            return true;
+        }
+    }
+
+    bool packPoints(const float *xyz, size_t count, const PointPacking &packing, PackedPoints &packed)
+    {
+        if (pointSize(packing.encoding) == 0)
+            return false;
+        if (packing.compression != PackedPoints::COMPRESSION_NONE && packing.compression != PackedPoints::COMPRESSION_ZSTD)
+            return false;
+        packed.count = static_cast<uint32_t>(count);
+        packed.resolution = 0.0;
+        packed.origin = geometry_msgs::msg::Point();
+        packed.compression = packing.compression;
+        // uncompressed, the points are written straight into the message.
+        std::vector<uint8_t> scratch;
+        std::vector<uint8_t> &raw = packing.compression == PackedPoints::COMPRESSION_NONE ? packed.data : scratch;
+        packed.encoding = PackedPoints::ENCODING_UINT16;
+        if (packing.encoding != PackedPoints::ENCODING_UINT16 || !quantize(xyz, count, packing.resolution, packed, raw))
+        {
+            packed.encoding = PackedPoints::ENCODING_FLOAT32;
+            packed.resolution = 0.0;
+            packed.origin = geometry_msgs::msg::Point();
+            raw.resize(count * 3 * sizeof(float));
+            if (count > 0)
+                std::memcpy(raw.data(), xyz, raw.size());
+        }
+        packed.raw_size = static_cast<uint32_t>(raw.size());
+        if (packing.compression == PackedPoints::COMPRESSION_NONE)
+            return true;
+        packed.data.resize(ZSTD_compressBound(raw.size()));
+        const size_t compressedSize = ZSTD_compress(packed.data.data(), packed.data.size(), raw.data(), raw.size(), packing.compressionLevel);
+        if (ZSTD_isError(compressedSize))
+        {
+            packed.data.clear();
+            return false;
+        }
+        packed.data.resize(compressedSize);
+        return true;
+    }
+
+    bool unpackPoints(const PackedPoints &packed, std::vector<float> &xyz, std::string &message)
+    {
+        const size_t size = pointSize(packed.encoding);
+        if (size == 0)
+        {
+            message = "Unknown encoding " + std::to_string(packed.encoding) + ".";
+            return false;
+        }
+        const size_t rawSize = static_cast<size_t>(packed.count) * size;
+        if (packed.raw_size != rawSize)
+        {
+            message = "The raw size does not match the point count.";
+            return false;
+        }
+        std::vector<uint8_t> scratch;
+        const uint8_t *raw = packed.data.data();
+        if (packed.compression == PackedPoints::COMPRESSION_ZSTD)
+        {
+            scratch.resize(rawSize);
+            if (ZSTD_decompress(scratch.data(), scratch.size(), packed.data.data(), packed.data.size()) != rawSize)
+            {
+                message = "The points do not decompress to their raw size.";
+                return false;
+            }
+            raw = scratch.data();
+        }
+        else if (packed.compression != PackedPoints::COMPRESSION_NONE)
+        {
+            message = "Unknown compression " + std::to_string(packed.compression) + ".";
+            return false;
+        }
+        else if (packed.data.size() != rawSize)
+        {
+            message = "The data size does not match the point count.";
+            return false;
+        }
+        xyz.resize(3 * static_cast<size_t>(packed.count));
+        if (packed.encoding == PackedPoints::ENCODING_FLOAT32)
+        {
+            if (rawSize > 0)
+                std::memcpy(xyz.data(), raw, rawSize);
+            return true;
+        }
+        const double origin[3] = {packed.origin.x, packed.origin.y, packed.origin.z};
+        for (size_t i = 0; i < xyz.size(); i++)
+        {
+            uint16_t steps;
+            std::memcpy(&steps, raw + i * sizeof(uint16_t), sizeof(uint16_t));
+            xyz[i] = static_cast<float>(origin[i % 3] + steps * packed.resolution);
+        }
+        return true;
+    }
+}
@@ -0,0 +1,212 @@
+/**
+ * @file pose_predictor.cpp
+ * @brief Propagates the last tracked pose with odometry or the gyroscope between camera frames.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#include "orb_slam3_ros2_wrapper/pose_predictor.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace ORB_SLAM3_Wrapper
+{
+    namespace
+    {
+        /**
+         * @brief The fraction of the motion, past 1 it is extrapolated.
+         */
+        Eigen::Affine3d scaleMotion(const Eigen::Affine3d &motion, double fraction)
+        {
+            Eigen::AngleAxisd rotation(Eigen::Matrix3d(motion.linear()));
+            Eigen::Affine3d scaled = Eigen::Affine3d::Identity();
+            scaled.linear() = Eigen::AngleAxisd(rotation.angle() * fraction, rotation.axis()).toRotationMatrix();
+            scaled.translation() = motion.translation() * fraction;
+            return scaled;
+        }
+
+        Eigen::Quaterniond rotationFromVector(const Eigen::Vector3d &rotationVector)
+        {
+            const double angle = rotationVector.norm();
+            if (angle < 1e-12)
+                return Eigen::Quaterniond::Identity();
+            return Eigen::Quaterniond(Eigen::AngleAxisd(angle, rotationVector / angle));
+        }
+    }
+
+    PosePredictor::PosePredictor(const PosePredictorConfig &config)
+        : config_(config)
+    {
+    }
+
+    void PosePredictor::addOdometry(double stamp, const Eigen::Affine3d &odomToBase)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        // out of order samples would break the interpolation.
+        if (!odometry_.empty() && stamp <= odometry_.back().stamp)
+            return;
+        odometry_.push_back({stamp, odomToBase});
+        while (odometry_.size() > config_.bufferSize)
+            odometry_.pop_front();
+    }
+
+    void PosePredictor::addAngularVelocity(double stamp, const Eigen::Vector3d &angularVelocity)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!gyro_.empty() && stamp <= gyro_.back().stamp)
+            return;
+        gyro_.push_back({stamp, angularVelocity});
+        while (gyro_.size() > config_.bufferSize)
+            gyro_.pop_front();
+    }
+
+    bool PosePredictor::correct(double stamp, const Eigen::Affine3d &mapToBase, PredictionError &error)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        bool predicted = false;
+        const bool newer = hasTracked_ && stamp > trackedStamp_;
+        Eigen::Affine3d prediction;
+        if (newer && predictLocked(stamp, prediction))
+        {
+            error.translation = (prediction.translation() - mapToBase.translation()).norm();
+            error.rotation = Eigen::AngleAxisd(Eigen::Matrix3d(prediction.linear().transpose() * mapToBase.linear())).angle();
+            error.horizon = stamp - trackedStamp_;
+            stats_.count++;
+            stats_.last = error;
+            sumSquaredTranslation_ += error.translation * error.translation;
+            sumSquaredRotation_ += error.rotation * error.rotation;
+            stats_.rmsTranslation = std::sqrt(sumSquaredTranslation_ / stats_.count);
+            stats_.rmsRotation = std::sqrt(sumSquaredRotation_ / stats_.count);
+            predicted = true;
+        }
+        // frames further apart than the horizon say nothing about the current velocity.
+        hasVelocity_ = newer && stamp - trackedStamp_ <= config_.maxHorizon;
+        if (hasVelocity_)
+        {
+            velocityDelta_ = trackedPose_.inverse() * mapToBase;
+            velocityPeriod_ = stamp - trackedStamp_;
+        }
+        trackedPose_ = mapToBase;
+        trackedStamp_ = stamp;
+        hasTracked_ = true;
+
+        Eigen::Affine3d odomToBase;
+        hasMapToOdom_ = odometryAt(stamp, odomToBase);
+        if (hasMapToOdom_)
+            mapToOdom_ = mapToBase * odomToBase.inverse();
+        return predicted;
+    }
+
+    bool PosePredictor::predict(double stamp, Eigen::Affine3d &mapToBase) const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return predictLocked(stamp, mapToBase);
+    }
+
+    bool PosePredictor::mapToOdom(Eigen::Affine3d &mapToOdom) const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!hasTracked_ || !hasMapToOdom_)
+            return false;
+        mapToOdom = mapToOdom_;
+        return true;
+    }
+
+    void PosePredictor::reset()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        hasTracked_ = false;
+        hasMapToOdom_ = false;
+        hasVelocity_ = false;
+    }
+
+    PredictionStats PosePredictor::stats() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return stats_;
+    }
+
+    bool PosePredictor::predictLocked(double stamp, Eigen::Affine3d &mapToBase) const
+    {
+        if (!hasTracked_)
+            return false;
+        Eigen::Affine3d odomAtStamp;
+        if (hasMapToOdom_ && odometryAt(stamp, odomAtStamp))
+        {
+            mapToBase = mapToOdom_ * odomAtStamp;
+            return true;
+        }
+
+        const double elapsed = stamp - trackedStamp_;
+        if (elapsed > config_.maxHorizon)
+            return false;
+        if (elapsed <= 0.0)
+        {
+            mapToBase = trackedPose_;
+            return true;
+        }
+        Eigen::Affine3d motion = hasVelocity_ ? scaleMotion(velocityDelta_, elapsed / velocityPeriod_) : Eigen::Affine3d::Identity();
+        Eigen::Quaterniond rotation;
+        if (integrateGyro(trackedStamp_, stamp, rotation))
+            motion.linear() = rotation.toRotationMatrix();
+        mapToBase = trackedPose_ * motion;
+        return true;
+    }
+
+    bool PosePredictor::odometryAt(double stamp, Eigen::Affine3d &odomToBase) const
+    {
+        if (odometry_.empty() || stamp < odometry_.front().stamp)
+            return false;
+        auto next = std::lower_bound(odometry_.begin(), odometry_.end(), stamp,
+                                     [](const OdometrySample &sample, double value)
+                                     { return sample.stamp < value; });
+        if (next != odometry_.end())
+        {
+            if (next->stamp == stamp || next == odometry_.begin())
+            {
+                odomToBase = next->pose;
+                return true;
+            }
+            const auto &previous = *(next - 1);
+            odomToBase = previous.pose * scaleMotion(previous.pose.inverse() * next->pose,
+                                                     (stamp - previous.stamp) / (next->stamp - previous.stamp));
+            return true;
+        }
+
+        // past the newest sample the last odometry velocity is held.
+        const auto &newest = odometry_.back();
+        if (stamp - newest.stamp > config_.maxHorizon)
+            return false;
+        odomToBase = newest.pose;
+        if (odometry_.size() < 2)
+            return true;
+        const auto &previous = odometry_[odometry_.size() - 2];
+        const double period = newest.stamp - previous.stamp;
+        if (period <= config_.maxHorizon)
+            odomToBase = newest.pose * scaleMotion(previous.pose.inverse() * newest.pose, (stamp - newest.stamp) / period);
+        return true;
+    }
+
+    bool PosePredictor::integrateGyro(double from, double to, Eigen::Quaterniond &rotation) const
+    {
+        rotation.setIdentity();
+        if (gyro_.empty() || to - gyro_.back().stamp > config_.maxHorizon)
+            return false;
+        auto sample = std::upper_bound(gyro_.begin(), gyro_.end(), from,
+                                       [](double value, const GyroSample &gyro)
+                                       { return value < gyro.stamp; });
+        // each sample holds the rate since the previous one.
+        double time = from;
+        for (; sample != gyro_.end() && time < to; ++sample)
+        {
+            const double end = std::min(sample->stamp, to);
+            rotation = rotation * rotationFromVector(sample->angularVelocity * (end - time));
+            time = end;
+        }
+        // past the newest sample the rate is held.
+        if (time < to)
+            rotation = rotation * rotationFromVector(gyro_.back().angularVelocity * (to - time));
+        rotation.normalize();
+        return true;
+    }
+}
@@ -0,0 +1,169 @@
+/**
+ * @file fleet-descriptor-stream.cpp
+ * @brief Implementation of the FleetDescriptorStream class.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+#include "fleet-descriptor-stream.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include <tf2_eigen/tf2_eigen.hpp>
+
+namespace ORB_SLAM3_Wrapper
+{
+    namespace
+    {
+        double steadySeconds()
+        {
+            return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+    }
+
+    std::unique_ptr<FleetDescriptorStream> FleetDescriptorStream::fromParameters(rclcpp::Node &node,
+                                                                                 std::function<std::shared_ptr<ORBSLAM3Interface>()> currentInterface,
+                                                                                 const std::atomic<bool> &isTracked,
+                                                                                 const std::string &globalFrame,
+                                                                                 std::shared_ptr<MetricsRegistry> metrics,
+                                                                                 double deltaTranslationThreshold,
+                                                                                 double deltaRotationThreshold,
+                                                                                 int snapshotInterval)
+    {
+        bool fleetDescriptorStream;
+        double bandwidth;
+        int maxPoints, publishFrequency;
+        node.declare_parameter("fleet_descriptor_stream", rclcpp::ParameterValue(false));
+        node.get_parameter("fleet_descriptor_stream", fleetDescriptorStream);
+        node.declare_parameter("fleet_descriptor_bandwidth", rclcpp::ParameterValue(100000.0));
+        node.get_parameter("fleet_descriptor_bandwidth", bandwidth);
+        node.declare_parameter("fleet_descriptor_max_points", rclcpp::ParameterValue(300));
+        node.get_parameter("fleet_descriptor_max_points", maxPoints);
+        node.declare_parameter("fleet_descriptor_publish_frequency", rclcpp::ParameterValue(1000));
+        node.get_parameter("fleet_descriptor_publish_frequency", publishFrequency);
+        if (!fleetDescriptorStream)
+            return nullptr;
+        // the pose deltas use the map data thresholds, the descriptors are only sent once per keyframe.
+        auto poseEncoder = std::make_unique<MapDataDeltaEncoder>(deltaTranslationThreshold, deltaRotationThreshold, snapshotInterval);
+        return std::make_unique<FleetDescriptorStream>(node, std::move(currentInterface), isTracked, globalFrame, std::move(metrics),
+                                                       std::move(poseEncoder), bandwidth, maxPoints, publishFrequency);
+    }
+
+    FleetDescriptorStream::FleetDescriptorStream(rclcpp::Node &node,
+                                                 std::function<std::shared_ptr<ORBSLAM3Interface>()> currentInterface,
+                                                 const std::atomic<bool> &isTracked,
+                                                 const std::string &globalFrame,
+                                                 std::shared_ptr<MetricsRegistry> metrics,
+                                                 std::unique_ptr<MapDataDeltaEncoder> poseEncoder,
+                                                 double bandwidth,
+                                                 int maxPoints,
+                                                 int publishFrequency)
+        : node_(node), currentInterface_(std::move(currentInterface)), isTracked_(isTracked), globalFrame_(globalFrame),
+          metrics_(std::move(metrics)), fleetPoseEncoder_(std::move(poseEncoder)), fleetMaxPoints_(maxPoints)
+    {
+        // two seconds of burst.
+        fleetBudget_ = std::make_unique<BandwidthBudget>(bandwidth, 2.0 * bandwidth);
+        fleetCallbackGroup_ = node_.create_callback_group(rclcpp::CallbackGroupType::MutuallyExclusive);
+        keyFrameDescriptorsPub_ = node_.create_publisher<slam_msgs::msg::KeyFrameDescriptors>("keyframe_descriptors", rclcpp::QoS(10).reliable());
+        rclcpp::SubscriptionOptions fleetOptions;
+        fleetOptions.callback_group = fleetCallbackGroup_;
+        // latched by the server, a restarted robot gets its reference at once.
+        fleetReferenceSub_ = node_.create_subscription<geometry_msgs::msg::TransformStamped>("fleet_reference", rclcpp::QoS(1).reliable().transient_local(),
+                                                                                           std::bind(&FleetDescriptorStream::FleetReferenceCallback, this, std::placeholders::_1), fleetOptions);
+        fleetTimer_ = node_.create_wall_timer(std::chrono::milliseconds(std::max(1, publishFrequency)), std::bind(&FleetDescriptorStream::publishKeyFrameDescriptors, this), fleetCallbackGroup_);
+    }
+
+    FleetDescriptorStream::~FleetDescriptorStream()
+    {
+        fleetTimer_.reset();
+        fleetReferenceSub_.reset();
+    }
+
+    void FleetDescriptorStream::reset(ORBSLAM3Interface &loaded)
+    {
+        std::lock_guard<std::mutex> lock(fleetMutex_);
+        if (hasFleetReference_)
+            loaded.setFleetReference(fleetReference_);
+        fleetPoseEncoder_->requestSnapshot();
+        fleetPendingKeyFrames_.clear();
+        fleetQueuedKeyFrames_.clear();
+    }
+
+    void FleetDescriptorStream::publishKeyFrameDescriptors()
+    {
+        auto interface = currentInterface_();
+        if (!interface || !isTracked_)
+            return;
+        std::lock_guard<std::mutex> lock(fleetMutex_);
+        const double now = steadySeconds();
+        // the poses go out in the robot frame, so that the fleet corrections never feed back into the server.
+        slam_msgs::msg::MapGraph graph;
+        interface->getOptimizedPoseGraph(graph, false, true);
+        slam_msgs::msg::KeyFrameDescriptors msg;
+        const bool posesChanged = fleetPoseEncoder_->encode(graph, msg.poses);
+        if (posesChanged)
+        {
+            for (auto id : msg.poses.added_ids)
+            {
+                if (fleetQueuedKeyFrames_.insert(id).second)
+                    fleetPendingKeyFrames_.push_back(id);
+            }
+            for (auto id : msg.poses.removed_ids)
+                fleetQueuedKeyFrames_.erase(id);
+            // pose updates are small and cannot wait, the descriptors get what is left.
+            const size_t poseBytes = 64 * (msg.poses.added_ids.size() + msg.poses.moved_ids.size()) + 4 * msg.poses.removed_ids.size();
+            fleetBudget_->charge(poseBytes, now);
+            fleetBytesSent_ += poseBytes;
+        }
+
+        ORBSLAM3Interface::KeyFrameDescriptors keyFrame;
+        while (!fleetPendingKeyFrames_.empty())
+        {
+            if (!interface->getKeyFrameDescriptors(fleetPendingKeyFrames_.front(), static_cast<size_t>(std::max(0, fleetMaxPoints_)), keyFrame))
+            {
+                // culled before it was sent.
+                fleetPendingKeyFrames_.pop_front();
+                continue;
+            }
+            const size_t bytes = 72 + 8 * keyFrame.wordIds.size() + 4 * keyFrame.points.size() + keyFrame.descriptors.size();
+            if (!fleetBudget_->consume(bytes, now))
+                break;
+            fleetPendingKeyFrames_.pop_front();
+            msg.ids.push_back(keyFrame.id);
+            msg.keyframe_poses.push_back(tf2::toMsg(keyFrame.pose));
+            msg.word_counts.push_back(keyFrame.wordIds.size());
+            msg.word_ids.insert(msg.word_ids.end(), keyFrame.wordIds.begin(), keyFrame.wordIds.end());
+            msg.word_weights.insert(msg.word_weights.end(), keyFrame.wordWeights.begin(), keyFrame.wordWeights.end());
+            msg.point_counts.push_back(keyFrame.points.size() / 3);
+            msg.points.insert(msg.points.end(), keyFrame.points.begin(), keyFrame.points.end());
+            msg.descriptors.insert(msg.descriptors.end(), keyFrame.descriptors.begin(), keyFrame.descriptors.end());
+            fleetBytesSent_ += bytes;
+        }
+        metrics_->gauge("fleet_descriptor_bytes", "Bytes sent on keyframe_descriptors since start.").set(fleetBytesSent_);
+        metrics_->gauge("fleet_pending_keyframes", "Keyframes waiting for the bandwidth budget to send their descriptors.").set(fleetPendingKeyFrames_.size());
+
+        if (!posesChanged && msg.ids.empty())
+            return;
+        msg.header.frame_id = globalFrame_;
+        msg.header.stamp = node_.now();
+        msg.poses.header = msg.header;
+        keyFrameDescriptorsPub_->publish(msg);
+    }
+
+    void FleetDescriptorStream::FleetReferenceCallback(const geometry_msgs::msg::TransformStamped::SharedPtr msgReference)
+    {
+        const Eigen::Affine3d reference(tf2::transformToEigen(*msgReference).matrix());
+        {
+            std::lock_guard<std::mutex> lock(fleetMutex_);
+            fleetReference_ = reference;
+            hasFleetReference_ = true;
+            // a map being loaded gets the reference once it is built.
+            auto interface = currentInterface_();
+            if (interface)
+                interface->setFleetReference(reference);
+        }
+        const Eigen::Vector3d translation = reference.translation();
+        RCLCPP_INFO_STREAM(node_.get_logger(), "Fleet reference from " << msgReference->header.frame_id << ": x " << translation.x() << " y " << translation.y()
+                                                                      << " z " << translation.z() << " yaw " << std::atan2(reference.linear()(1, 0), reference.linear()(0, 0)));
+    }
+}
@@ -0,0 +1,104 @@
+/**
+ * @file fleet-descriptor-stream.hpp
+ * @brief Definition of the FleetDescriptorStream class, the link of a SLAM node to the fleet map server.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#ifndef FLEET_DESCRIPTOR_STREAM_HPP_
+#define FLEET_DESCRIPTOR_STREAM_HPP_
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+
+#include <rclcpp/rclcpp.hpp>
+#include <geometry_msgs/msg/transform_stamped.hpp>
+#include <slam_msgs/msg/key_frame_descriptors.hpp>
+
+#include "orb_slam3_ros2_wrapper/orb_slam3_interface.hpp"
+#include "orb_slam3_ros2_wrapper/map_data_delta.hpp"
+#include "orb_slam3_ros2_wrapper/instrumentation.hpp"
+#include "orb_slam3_ros2_wrapper/fleet_map.hpp"
+
+namespace ORB_SLAM3_Wrapper
+{
+    /**
+     * @brief Publishes the keyframe pose delta and, within the bandwidth budget, the descriptors of the new
+     * keyframes on keyframe_descriptors, and applies the reference the server publishes on fleet_reference.
+     * @note Parameters: fleet_descriptor_stream, fleet_descriptor_bandwidth, fleet_descriptor_max_points and
+     * fleet_descriptor_publish_frequency.
+     */
+    class FleetDescriptorStream
+    {
+    public:
+        /**
+         * @brief Declares the parameters and starts the stream if fleet_descriptor_stream is set.
+         * @param deltaTranslationThreshold, deltaRotationThreshold, snapshotInterval Those of the map data, for the pose deltas.
+         * @return Null when disabled.
+         */
+        static std::unique_ptr<FleetDescriptorStream> fromParameters(rclcpp::Node &node,
+                                                                     std::function<std::shared_ptr<ORBSLAM3Interface>()> currentInterface,
+                                                                     const std::atomic<bool> &isTracked,
+                                                                     const std::string &globalFrame,
+                                                                     std::shared_ptr<MetricsRegistry> metrics,
+                                                                     double deltaTranslationThreshold,
+                                                                     double deltaRotationThreshold,
+                                                                     int snapshotInterval);
+
+        /**
+         * @param currentInterface The interface in use, null while a map is being loaded.
+         * @param bandwidth Bytes/s, with bursts up to twice this.
+         * @param maxPoints Map points sent per keyframe, 0 for all.
+         * @param publishFrequency Period (ms) of the publish.
+         */
+        FleetDescriptorStream(rclcpp::Node &node,
+                              std::function<std::shared_ptr<ORBSLAM3Interface>()> currentInterface,
+                              const std::atomic<bool> &isTracked,
+                              const std::string &globalFrame,
+                              std::shared_ptr<MetricsRegistry> metrics,
+                              std::unique_ptr<MapDataDeltaEncoder> poseEncoder,
+                              double bandwidth,
+                              int maxPoints,
+                              int publishFrequency);
+        ~FleetDescriptorStream();
+
+        /**
+         * @brief Places a loaded map in the fleet frame as the previous one and sends it to the server again.
+         */
+        void reset(ORBSLAM3Interface &loaded);
+
+    private:
+        void publishKeyFrameDescriptors();
+
+        /**
+         * @brief Applies the reference of the robot frame in the fleet frame pushed by the fleet map server.
+         */
+        void FleetReferenceCallback(const geometry_msgs::msg::TransformStamped::SharedPtr msgReference);
+
+        rclcpp::Node &node_;
+        std::function<std::shared_ptr<ORBSLAM3Interface>()> currentInterface_;
+        const std::atomic<bool> &isTracked_;
+        std::string globalFrame_;
+        std::shared_ptr<MetricsRegistry> metrics_;
+        rclcpp::Publisher<slam_msgs::msg::KeyFrameDescriptors>::SharedPtr keyFrameDescriptorsPub_;
+        rclcpp::Subscription<geometry_msgs::msg::TransformStamped>::SharedPtr fleetReferenceSub_;
+        rclcpp::TimerBase::SharedPtr fleetTimer_;
+        rclcpp::CallbackGroup::SharedPtr fleetCallbackGroup_;
+        std::unique_ptr<MapDataDeltaEncoder> fleetPoseEncoder_;
+        std::unique_ptr<BandwidthBudget> fleetBudget_;
+        // keyframes whose descriptors wait for the budget, oldest first.
+        std::deque<int32_t> fleetPendingKeyFrames_;
+        std::unordered_set<int32_t> fleetQueuedKeyFrames_;
+        int fleetMaxPoints_;
+        uint64_t fleetBytesSent_ = 0;
+        // the last reference received, applied again to the interface of a loaded map.
+        bool hasFleetReference_ = false;
+        Eigen::Affine3d fleetReference_ = Eigen::Affine3d::Identity();
+        std::mutex fleetMutex_;
+    };
+}
+#endif
@@ -0,0 +1,162 @@
+/**
+ * @file map-persistence.cpp
+ * @brief Implementation of the MapPersistence class.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+#include "map-persistence.hpp"
+
+#include <chrono>
+#include <sstream>
+#include <thread>
+
+#include "orb_slam3_ros2_wrapper/map_archive.hpp"
+
+namespace ORB_SLAM3_Wrapper
+{
+    MapPersistence::MapPersistence(rclcpp::Node &node, const std::string &settingsFile, Systems systems)
+        : node_(node), settingsFile_(settingsFile), systems_(std::move(systems))
+    {
+        mapPersistenceCallbackGroup_ = node_.create_callback_group(rclcpp::CallbackGroupType::MutuallyExclusive);
+        saveMapService_ = node_.create_service<slam_msgs::srv::SaveMap>("save_map", std::bind(&MapPersistence::saveMapServer, this,
+                                                                                              std::placeholders::_1, std::placeholders::_2, std::placeholders::_3),
+                                                                        rmw_qos_profile_services_default, mapPersistenceCallbackGroup_);
+        loadMapService_ = node_.create_service<slam_msgs::srv::LoadMap>("load_map", std::bind(&MapPersistence::loadMapServer, this,
+                                                                                              std::placeholders::_1, std::placeholders::_2, std::placeholders::_3),
+                                                                        rmw_qos_profile_services_default, mapPersistenceCallbackGroup_);
+    }
+
+    void MapPersistence::saveMapServer(std::shared_ptr<rmw_request_id_t> request_header,
+                                       std::shared_ptr<slam_msgs::srv::SaveMap::Request> request,
+                                       std::shared_ptr<slam_msgs::srv::SaveMap::Response> response)
+    {
+        RCLCPP_INFO_STREAM(node_.get_logger(), "SaveMap service called: " << request->path);
+        auto interface = systems_.current();
+        if (!interface)
+        {
+            response->success = false;
+            response->message = "A map is being loaded.";
+            return;
+        }
+        response->success = interface->saveMap(request->path, response->message, response->raw_bytes, response->compressed_bytes);
+        if (response->success)
+            RCLCPP_INFO_STREAM(node_.get_logger(), response->message);
+        else
+            RCLCPP_ERROR_STREAM(node_.get_logger(), "SaveMap failed: " << response->message);
+    }
+
+    void MapPersistence::loadMapServer(std::shared_ptr<rmw_request_id_t> request_header,
+                                       std::shared_ptr<slam_msgs::srv::LoadMap::Request> request,
+                                       std::shared_ptr<slam_msgs::srv::LoadMap::Response> response)
+    {
+        RCLCPP_INFO_STREAM(node_.get_logger(), "LoadMap service called: " << request->path);
+        auto start = std::chrono::steady_clock::now();
+        response->success = false;
+        // ORB_SLAM3 loads an Atlas at construction only, from the .osa file named in the settings. Both files
+        // are removed when the service returns, whatever the outcome.
+        TemporaryFile osa(".osa");
+        TemporaryFile settings("_settings.yaml");
+        if (!osa.valid() || !settings.valid())
+        {
+            response->message = "Could not create the temporary files in /tmp.";
+            RCLCPP_ERROR_STREAM(node_.get_logger(), "LoadMap failed: " << response->message);
+            return;
+        }
+        // the current system is left as it is until the archive is known to be readable.
+        if (!decompressMapArchive(request->path, osa.path(), response->message))
+        {
+            RCLCPP_ERROR_STREAM(node_.get_logger(), "LoadMap failed: " << response->message);
+            return;
+        }
+        const std::string atlasBase = osa.path().substr(0, osa.path().size() - std::string(".osa").size());
+        if (!writeSettingsLoadingAtlas(settingsFile_, settings.path(), atlasBase))
+        {
+            response->message = "Could not write the settings " + settings.path();
+            RCLCPP_ERROR_STREAM(node_.get_logger(), "LoadMap failed: " << response->message);
+            return;
+        }
+
+        std::shared_ptr<ORBSLAM3Interface> loaded;
+        if (ORBSLAM3Interface::supportsMultipleSystems())
+        {
+            // the new system is built behind the live one, which keeps tracking until the swap.
+            try
+            {
+                loaded = systems_.make(settings.path());
+            }
+            catch (const std::exception &e)
+            {
+                response->message = std::string("Could not build the system with the loaded map: ") + e.what();
+                RCLCPP_ERROR_STREAM(node_.get_logger(), "LoadMap failed: " << response->message);
+                return;
+            }
+            releaseInterface(systems_.install(loaded));
+        }
+        else if (!swapInterface(settings.path(), loaded, response->message))
+        {
+            RCLCPP_ERROR_STREAM(node_.get_logger(), "LoadMap failed: " << response->message);
+            return;
+        }
+
+        std::ostringstream message;
+        message << "Loaded " << request->path << " in " << std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() << " s.";
+        response->message = message.str();
+        response->success = true;
+        RCLCPP_INFO_STREAM(node_.get_logger(), response->message);
+    }
+
+    bool MapPersistence::swapInterface(const std::string &settingsFile, std::shared_ptr<ORBSLAM3Interface> &loaded, std::string &message)
+    {
+        // tracking stops here: with no interface the callbacks return and the pipeline drops its frames. The
+        // previous system is shut down in this thread once the last callback using it has returned.
+        auto previous = systems_.exchange(nullptr);
+        if (!waitForRelease(previous))
+        {
+            systems_.exchange(previous);
+            message = "The current system is still in use after 5 s, the map was not loaded.";
+            return false;
+        }
+        // without per-system state in ORB_SLAM3 the two systems cannot coexist.
+        previous.reset();
+        try
+        {
+            loaded = systems_.make(settingsFile);
+        }
+        catch (const std::exception &e)
+        {
+            message = std::string("Could not build the system with the loaded map: ") + e.what();
+        }
+        if (loaded)
+        {
+            systems_.install(loaded);
+            return true;
+        }
+        // the previous map is gone, the node keeps running with an empty one.
+        try
+        {
+            systems_.install(systems_.make(settingsFile_));
+            message += " Started over with an empty map.";
+        }
+        catch (const std::exception &e)
+        {
+            message += std::string(" Could not start over with an empty map either: ") + e.what();
+        }
+        return false;
+    }
+
+    bool MapPersistence::waitForRelease(const std::shared_ptr<ORBSLAM3Interface> &interface)
+    {
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (interface.use_count() > 1 && std::chrono::steady_clock::now() < deadline)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        return interface.use_count() <= 1;
+    }
+
+    void MapPersistence::releaseInterface(std::shared_ptr<ORBSLAM3Interface> previous)
+    {
+        // shut the previous system down here rather than in the callback that drops the last reference,
+        // unless it is still held after the timeout.
+        if (previous && !waitForRelease(previous))
+            RCLCPP_WARN_STREAM(node_.get_logger(), "The previous system is still in use after 5 s, the last callback using it shuts it down.");
+        previous.reset();
+    }
+}
@@ -0,0 +1,85 @@
+/**
+ * @file map-persistence.hpp
+ * @brief Definition of the MapPersistence class, the save_map and load_map services of a SLAM node.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#ifndef MAP_PERSISTENCE_HPP_
+#define MAP_PERSISTENCE_HPP_
+
+#include <functional>
+#include <memory>
+#include <string>
+
+#include <rclcpp/rclcpp.hpp>
+#include <slam_msgs/srv/save_map.hpp>
+#include <slam_msgs/srv/load_map.hpp>
+
+#include "orb_slam3_ros2_wrapper/orb_slam3_interface.hpp"
+
+namespace ORB_SLAM3_Wrapper
+{
+    /**
+     * @brief Writes the Atlas to a compressed map archive and replaces the system with one built from an archive.
+     * @note The services block their own callback group only. The node owns the interface, it is reached through Systems.
+     */
+    class MapPersistence
+    {
+    public:
+        struct Systems
+        {
+            // the interface in use, null while a map is being loaded.
+            std::function<std::shared_ptr<ORBSLAM3Interface>()> current;
+            // builds an interface from a settings file with the options of the node.
+            std::function<std::shared_ptr<ORBSLAM3Interface>(const std::string &settingsFile)> make;
+            // resets the per-map state of the node and makes the interface the current one, returns the previous one.
+            std::function<std::shared_ptr<ORBSLAM3Interface>(const std::shared_ptr<ORBSLAM3Interface> &)> install;
+            // makes the interface (or none) the current one as it is, returns the previous one.
+            std::function<std::shared_ptr<ORBSLAM3Interface>(const std::shared_ptr<ORBSLAM3Interface> &)> exchange;
+        };
+
+        /**
+         * @param settingsFile The settings of the node, a loaded map is read with a copy naming its Atlas.
+         */
+        MapPersistence(rclcpp::Node &node, const std::string &settingsFile, Systems systems);
+
+    private:
+        void saveMapServer(std::shared_ptr<rmw_request_id_t> request_header,
+                           std::shared_ptr<slam_msgs::srv::SaveMap::Request> request,
+                           std::shared_ptr<slam_msgs::srv::SaveMap::Response> response);
+
+        /**
+         * @brief Builds a system with the archived Atlas behind the live one and swaps them, or replaces the live
+         * one without per-system state (see swapInterface).
+         */
+        void loadMapServer(std::shared_ptr<rmw_request_id_t> request_header,
+                           std::shared_ptr<slam_msgs::srv::LoadMap::Request> request,
+                           std::shared_ptr<slam_msgs::srv::LoadMap::Response> response);
+
+        /**
+         * @brief Stops tracking, shuts the current system down once the callbacks have released it and builds
+         * the new one. Stock ORB_SLAM3 cannot run two systems in a process.
+         * @return False if the map was not loaded. The previous system is kept if it could not be released,
+         * otherwise the node starts over with an empty map.
+         */
+        bool swapInterface(const std::string &settingsFile, std::shared_ptr<ORBSLAM3Interface> &loaded, std::string &message);
+
+        /**
+         * @brief Waits up to 5 s for the callbacks to drop their references to the interface.
+         */
+        bool waitForRelease(const std::shared_ptr<ORBSLAM3Interface> &interface);
+
+        /**
+         * @brief Shuts a replaced interface down once the callbacks have released it.
+         */
+        void releaseInterface(std::shared_ptr<ORBSLAM3Interface> previous);
+
+        rclcpp::Node &node_;
+        std::string settingsFile_;
+        Systems systems_;
+        rclcpp::CallbackGroup::SharedPtr mapPersistenceCallbackGroup_;
+        rclcpp::Service<slam_msgs::srv::SaveMap>::SharedPtr saveMapService_;
+        rclcpp::Service<slam_msgs::srv::LoadMap>::SharedPtr loadMapService_;
+    };
+}
+#endif
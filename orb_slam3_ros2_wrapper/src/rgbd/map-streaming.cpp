@@ -0,0 +1,102 @@
+/**
+ * @file map-streaming.cpp
+ * @brief Implementation of the MapStreaming class.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+#include "map-streaming.hpp"
+
+#include <algorithm>
+
+namespace ORB_SLAM3_Wrapper
+{
+    MapStreaming::MapStreaming(rclcpp::Node &node,
+                               std::function<std::shared_ptr<ORBSLAM3Interface>()> currentInterface,
+                               const std::string &globalFrame,
+                               MetricsRegistry &metrics)
+        : node_(node), currentInterface_(std::move(currentInterface)), globalFrame_(globalFrame)
+    {
+        int mapStreamChunkPeriod;
+        node_.declare_parameter("map_page_size", rclcpp::ParameterValue(200));
+        node_.get_parameter("map_page_size", mapPageSize_);
+        node_.declare_parameter("map_stream_chunk_period", rclcpp::ParameterValue(20));
+        node_.get_parameter("map_stream_chunk_period", mapStreamChunkPeriod);
+        getMapPageServiceLatency_ = &metrics.histogram("get_map_page_service", "orb_slam3_get_map_page service calls.");
+
+        mapPageCallbackGroup_ = node_.create_callback_group(rclcpp::CallbackGroupType::MutuallyExclusive);
+        getMapPageService_ = node_.create_service<slam_msgs::srv::GetMapPage>("orb_slam3_get_map_page", std::bind(&MapStreaming::getMapPageServer, this,
+                                                                                                                  std::placeholders::_1, std::placeholders::_2, std::placeholders::_3),
+                                                                              rmw_qos_profile_services_default, mapPageCallbackGroup_);
+        mapStreamService_ = node_.create_service<std_srvs::srv::Trigger>("orb_slam3_stream_map", std::bind(&MapStreaming::mapStreamServer, this,
+                                                                                                           std::placeholders::_1, std::placeholders::_2, std::placeholders::_3),
+                                                                         rmw_qos_profile_services_default, mapPageCallbackGroup_);
+        mapChunkPub_ = node_.create_publisher<slam_msgs::msg::MapChunk>("map_chunks", rclcpp::QoS(10).reliable());
+        // one chunk per tick while a pass is running.
+        mapStreamTimer_ = node_.create_wall_timer(std::chrono::milliseconds(std::max(1, mapStreamChunkPeriod)), std::bind(&MapStreaming::publishMapChunk, this), mapPageCallbackGroup_);
+        mapStreamTimer_->cancel();
+    }
+
+    void MapStreaming::getMapPageServer(std::shared_ptr<rmw_request_id_t> request_header,
+                                        std::shared_ptr<slam_msgs::srv::GetMapPage::Request> request,
+                                        std::shared_ptr<slam_msgs::srv::GetMapPage::Response> response)
+    {
+        auto interface = currentInterface_();
+        if (!interface)
+        {
+            RCLCPP_WARN(node_.get_logger(), "GetMapPage service called while a map is being loaded, the response is empty.");
+            return;
+        }
+        ScopedTimer timer(*getMapPageServiceLatency_);
+        ORBSLAM3Interface::MapPage page;
+        const size_t maxKeyFrames = request->max_keyframes > 0 ? request->max_keyframes : static_cast<size_t>(std::max(1, mapPageSize_));
+        interface->getMapPage(request->cursor, maxKeyFrames, request->include_points, request->max_points, page);
+        response->total_keyframes = page.totalKeyFrames;
+        response->next_cursor = page.nextCursor;
+        response->done = page.done;
+        response->poses_id = std::move(page.ids);
+        response->poses = std::move(page.poses);
+        response->point_counts = std::move(page.pointCounts);
+        response->points = std::move(page.points);
+    }
+
+    void MapStreaming::mapStreamServer(std::shared_ptr<rmw_request_id_t> request_header,
+                                       std::shared_ptr<std_srvs::srv::Trigger::Request> request,
+                                       std::shared_ptr<std_srvs::srv::Trigger::Response> response)
+    {
+        const bool restarted = !mapStreamTimer_->is_canceled();
+        ++mapStreamId_;
+        mapStreamChunkIndex_ = 0;
+        mapStreamCursor_ = 0;
+        mapStreamTimer_->reset();
+        response->success = true;
+        response->message = (restarted ? "Restarted the map stream, stream_id " : "Streaming the map on map_chunks, stream_id ") + std::to_string(mapStreamId_) + ".";
+        RCLCPP_INFO_STREAM(node_.get_logger(), response->message);
+    }
+
+    void MapStreaming::publishMapChunk()
+    {
+        auto interface = currentInterface_();
+        // the stream goes on once the map is loaded.
+        if (!interface)
+            return;
+        ORBSLAM3Interface::MapPage page;
+        interface->getMapPage(mapStreamCursor_, static_cast<size_t>(std::max(1, mapPageSize_)), true, 0, page);
+        slam_msgs::msg::MapChunk chunk;
+        chunk.header.frame_id = globalFrame_;
+        chunk.header.stamp = node_.now();
+        chunk.stream_id = mapStreamId_;
+        chunk.chunk_index = mapStreamChunkIndex_++;
+        chunk.total_keyframes = page.totalKeyFrames;
+        chunk.last = page.done;
+        chunk.poses_id = std::move(page.ids);
+        chunk.poses = std::move(page.poses);
+        chunk.point_counts = std::move(page.pointCounts);
+        chunk.points = std::move(page.points);
+        mapChunkPub_->publish(chunk);
+        mapStreamCursor_ = page.nextCursor;
+        if (page.done)
+        {
+            mapStreamTimer_->cancel();
+            RCLCPP_INFO_STREAM(node_.get_logger(), "Map stream " << mapStreamId_ << " done in " << mapStreamChunkIndex_ << " chunks.");
+        }
+    }
+}
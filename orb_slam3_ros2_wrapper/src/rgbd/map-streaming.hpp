@@ -0,0 +1,73 @@
+/**
+ * @file map-streaming.hpp
+ * @brief Definition of the MapStreaming class, paged access to the map of a SLAM node.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#ifndef MAP_STREAMING_HPP_
+#define MAP_STREAMING_HPP_
+
+#include <functional>
+#include <memory>
+#include <string>
+
+#include <rclcpp/rclcpp.hpp>
+#include <slam_msgs/msg/map_chunk.hpp>
+#include <slam_msgs/srv/get_map_page.hpp>
+#include <std_srvs/srv/trigger.hpp>
+
+#include "orb_slam3_ros2_wrapper/orb_slam3_interface.hpp"
+#include "orb_slam3_ros2_wrapper/instrumentation.hpp"
+
+namespace ORB_SLAM3_Wrapper
+{
+    /**
+     * @brief The orb_slam3_get_map_page service and the orb_slam3_stream_map service, which sends the whole map
+     * on map_chunks one page per tick.
+     * @note Parameters: map_page_size (keyframes per page) and map_stream_chunk_period (ms). The page service
+     * and the stream share a callback group, away from the map data timers.
+     */
+    class MapStreaming
+    {
+    public:
+        /**
+         * @param currentInterface The interface in use, null while a map is being loaded.
+         */
+        MapStreaming(rclcpp::Node &node,
+                     std::function<std::shared_ptr<ORBSLAM3Interface>()> currentInterface,
+                     const std::string &globalFrame,
+                     MetricsRegistry &metrics);
+
+    private:
+        void getMapPageServer(std::shared_ptr<rmw_request_id_t> request_header,
+                              std::shared_ptr<slam_msgs::srv::GetMapPage::Request> request,
+                              std::shared_ptr<slam_msgs::srv::GetMapPage::Response> response);
+
+        /**
+         * @brief Starts (or restarts) a pass over the map on map_chunks.
+         */
+        void mapStreamServer(std::shared_ptr<rmw_request_id_t> request_header,
+                             std::shared_ptr<std_srvs::srv::Trigger::Request> request,
+                             std::shared_ptr<std_srvs::srv::Trigger::Response> response);
+
+        /**
+         * @brief Publishes the next chunk of the running pass.
+         */
+        void publishMapChunk();
+
+        rclcpp::Node &node_;
+        std::function<std::shared_ptr<ORBSLAM3Interface>()> currentInterface_;
+        std::string globalFrame_;
+        int mapPageSize_;
+        uint32_t mapStreamId_ = 0;
+        uint32_t mapStreamChunkIndex_ = 0;
+        uint64_t mapStreamCursor_ = 0;
+        LatencyHistogram *getMapPageServiceLatency_;
+        rclcpp::CallbackGroup::SharedPtr mapPageCallbackGroup_;
+        rclcpp::Service<slam_msgs::srv::GetMapPage>::SharedPtr getMapPageService_;
+        rclcpp::Service<std_srvs::srv::Trigger>::SharedPtr mapStreamService_;
+        rclcpp::Publisher<slam_msgs::msg::MapChunk>::SharedPtr mapChunkPub_;
+        rclcpp::TimerBase::SharedPtr mapStreamTimer_;
+    };
+}
+#endif
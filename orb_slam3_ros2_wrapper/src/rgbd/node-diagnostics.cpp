@@ -0,0 +1,98 @@
+/**
+ * @file node-diagnostics.cpp
+ * @brief Implementation of the NodeDiagnostics class.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+#include "node-diagnostics.hpp"
+
+namespace ORB_SLAM3_Wrapper
+{
+    NodeDiagnostics::NodeDiagnostics(rclcpp::Node &node, std::shared_ptr<MetricsRegistry> metrics, Hooks hooks)
+        : node_(node), metrics_(std::move(metrics)), hooks_(std::move(hooks))
+    {
+        node_.declare_parameter("diagnostics_publish_frequency", rclcpp::ParameterValue(1000));
+        node_.get_parameter("diagnostics_publish_frequency", publishFrequency_);
+        node_.declare_parameter("prometheus_port", rclcpp::ParameterValue(0));
+        node_.get_parameter("prometheus_port", prometheusPort_);
+
+        if (publishFrequency_ > 0)
+            diagnosticsPub_ = node_.create_publisher<diagnostic_msgs::msg::DiagnosticArray>("/diagnostics", 10);
+        if (publishFrequency_ > 0 || prometheusPort_ > 0)
+        {
+            // the gauges are refreshed by this timer, also when only the Prometheus endpoint is enabled.
+            diagnosticsCallbackGroup_ = node_.create_callback_group(rclcpp::CallbackGroupType::MutuallyExclusive);
+            diagnosticsTimer_ = node_.create_wall_timer(std::chrono::milliseconds(publishFrequency_ > 0 ? publishFrequency_ : 1000),
+                                                        std::bind(&NodeDiagnostics::publishDiagnostics, this), diagnosticsCallbackGroup_);
+        }
+        if (prometheusPort_ > 0)
+        {
+            prometheusExporter_ = std::make_unique<PrometheusExporter>(metrics_, prometheusPort_);
+            if (prometheusExporter_->start())
+                RCLCPP_INFO_STREAM(node_.get_logger(), "Prometheus metrics served on port " << prometheusPort_);
+            else
+            {
+                RCLCPP_ERROR_STREAM(node_.get_logger(), "Could not serve Prometheus metrics on port " << prometheusPort_);
+                prometheusExporter_.reset();
+            }
+        }
+    }
+
+    NodeDiagnostics::~NodeDiagnostics()
+    {
+        prometheusExporter_.reset();
+        diagnosticsTimer_.reset();
+    }
+
+    void NodeDiagnostics::publishDiagnostics()
+    {
+        if (hooks_.updateGauges)
+            hooks_.updateGauges();
+        if (!diagnosticsPub_)
+            return;
+        auto samples = metrics_->collect(windows_);
+
+        diagnostic_msgs::msg::DiagnosticStatus status;
+        status.name = std::string(node_.get_name()) + ": ORB-SLAM3";
+        status.hardware_id = node_.get_fully_qualified_name();
+        status.level = diagnostic_msgs::msg::DiagnosticStatus::OK;
+        if (hooks_.trackingMessage)
+            status.message = hooks_.trackingMessage();
+        auto addValue = [&status](const std::string &key, double value)
+        {
+            diagnostic_msgs::msg::KeyValue keyValue;
+            keyValue.key = key;
+            keyValue.value = std::to_string(value);
+            status.values.push_back(keyValue);
+        };
+        for (const auto &sample : samples)
+        {
+            if (sample.isLatency)
+            {
+                addValue(sample.name + " p50 (ms)", sample.p50Seconds * 1e3);
+                addValue(sample.name + " p99 (ms)", sample.p99Seconds * 1e3);
+                addValue(sample.name + " max (ms)", sample.maxSeconds * 1e3);
+                addValue(sample.name + " count", sample.windowCount);
+            }
+            else
+            {
+                addValue(sample.name, sample.value);
+                // tracking state 3 is LOST.
+                if (sample.name == "tracking_state" && sample.value == 3)
+                {
+                    status.level = diagnostic_msgs::msg::DiagnosticStatus::WARN;
+                    status.message = "Tracking lost";
+                }
+            }
+        }
+
+        std::vector<diagnostic_msgs::msg::DiagnosticStatus> statuses;
+        if (hooks_.extend)
+            hooks_.extend(status, statuses);
+
+        diagnostic_msgs::msg::DiagnosticArray diagnostics;
+        diagnostics.header.stamp = node_.now();
+        diagnostics.status.push_back(status);
+        diagnostics.status.insert(diagnostics.status.end(), statuses.begin(), statuses.end());
+        diagnosticsPub_->publish(diagnostics);
+    }
+}
@@ -0,0 +1,59 @@
+/**
+ * @file node-diagnostics.hpp
+ * @brief Definition of the NodeDiagnostics class, the /diagnostics and Prometheus export of a SLAM node.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#ifndef NODE_DIAGNOSTICS_HPP_
+#define NODE_DIAGNOSTICS_HPP_
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <rclcpp/rclcpp.hpp>
+#include <diagnostic_msgs/msg/diagnostic_array.hpp>
+
+#include "orb_slam3_ros2_wrapper/instrumentation.hpp"
+
+namespace ORB_SLAM3_Wrapper
+{
+    /**
+     * @brief Publishes the latency histograms (p50 / p99 since the last publish) and gauges of a registry on
+     * /diagnostics and serves them to Prometheus.
+     * @note Parameters: diagnostics_publish_frequency (ms, 0 disables /diagnostics) and prometheus_port (0 disables the endpoint).
+     */
+    class NodeDiagnostics
+    {
+    public:
+        struct Hooks
+        {
+            // refreshes the gauges owned by the node before every collection.
+            std::function<void()> updateGauges;
+            // message of the ORB-SLAM3 status, replaced while tracking is lost.
+            std::function<std::string()> trackingMessage;
+            // adds to the ORB-SLAM3 status and appends the statuses of the node after it.
+            std::function<void(diagnostic_msgs::msg::DiagnosticStatus &, std::vector<diagnostic_msgs::msg::DiagnosticStatus> &)> extend;
+        };
+
+        NodeDiagnostics(rclcpp::Node &node, std::shared_ptr<MetricsRegistry> metrics, Hooks hooks);
+        ~NodeDiagnostics();
+
+    private:
+        void publishDiagnostics();
+
+        rclcpp::Node &node_;
+        std::shared_ptr<MetricsRegistry> metrics_;
+        Hooks hooks_;
+        int publishFrequency_;
+        int prometheusPort_;
+        std::unique_ptr<PrometheusExporter> prometheusExporter_;
+        std::map<std::string, HistogramSnapshot> windows_;
+        rclcpp::Publisher<diagnostic_msgs::msg::DiagnosticArray>::SharedPtr diagnosticsPub_;
+        rclcpp::TimerBase::SharedPtr diagnosticsTimer_;
+        rclcpp::CallbackGroup::SharedPtr diagnosticsCallbackGroup_;
+    };
+}
+#endif
@@ -0,0 +1,235 @@
+/**
+ * @file occupancy-mapping.cpp
+ * @brief Implementation of the OccupancyMapping class.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+#include "occupancy-mapping.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace ORB_SLAM3_Wrapper
+{
+    std::unique_ptr<OccupancyMapping> OccupancyMapping::fromParameters(rclcpp::Node &node,
+                                                                       ORB_SLAM3::System::eSensor sensor,
+                                                                       std::function<std::shared_ptr<ORBSLAM3Interface>()> currentInterface,
+                                                                       const std::atomic<bool> &isTracked,
+                                                                       const std::string &globalFrame,
+                                                                       double deltaTranslationThreshold,
+                                                                       double deltaRotationThreshold)
+    {
+        bool occupancyMapping;
+        int queueSize;
+        Options options;
+        node.declare_parameter("occupancy_mapping", rclcpp::ParameterValue(false));
+        node.get_parameter("occupancy_mapping", occupancyMapping);
+        node.declare_parameter("occupancy_resolution", rclcpp::ParameterValue(static_cast<double>(options.map.resolution)));
+        options.map.resolution = static_cast<float>(node.get_parameter("occupancy_resolution").as_double());
+        node.declare_parameter("occupancy_max_range", rclcpp::ParameterValue(static_cast<double>(options.map.maxRange)));
+        options.map.maxRange = static_cast<float>(node.get_parameter("occupancy_max_range").as_double());
+        node.declare_parameter("occupancy_min_height", rclcpp::ParameterValue(static_cast<double>(options.map.minHeight)));
+        options.map.minHeight = static_cast<float>(node.get_parameter("occupancy_min_height").as_double());
+        node.declare_parameter("occupancy_max_height", rclcpp::ParameterValue(static_cast<double>(options.map.maxHeight)));
+        options.map.maxHeight = static_cast<float>(node.get_parameter("occupancy_max_height").as_double());
+        node.declare_parameter("occupancy_depth_stride", rclcpp::ParameterValue(options.depthStride));
+        node.get_parameter("occupancy_depth_stride", options.depthStride);
+        node.declare_parameter("occupancy_depth_retention", rclcpp::ParameterValue(options.depthRetention));
+        node.get_parameter("occupancy_depth_retention", options.depthRetention);
+        node.declare_parameter("occupancy_queue_size", rclcpp::ParameterValue(static_cast<int>(options.queueSize)));
+        node.get_parameter("occupancy_queue_size", queueSize);
+        node.declare_parameter("occupancy_publish_frequency", rclcpp::ParameterValue(options.publishFrequency));
+        node.get_parameter("occupancy_publish_frequency", options.publishFrequency);
+        options.queueSize = static_cast<size_t>(std::max(1, queueSize));
+        options.deltaTranslationThreshold = deltaTranslationThreshold;
+        options.deltaRotationThreshold = deltaRotationThreshold;
+        if (!occupancyMapping)
+            return nullptr;
+        if (sensor != ORB_SLAM3::System::RGBD && sensor != ORB_SLAM3::System::IMU_RGBD)
+        {
+            RCLCPP_WARN(node.get_logger(), "occupancy_mapping needs a depth image, it is disabled for this sensor.");
+            return nullptr;
+        }
+        return std::make_unique<OccupancyMapping>(node, std::move(currentInterface), isTracked, globalFrame, options);
+    }
+
+    OccupancyMapping::OccupancyMapping(rclcpp::Node &node,
+                                       std::function<std::shared_ptr<ORBSLAM3Interface>()> currentInterface,
+                                       const std::atomic<bool> &isTracked,
+                                       const std::string &globalFrame,
+                                       const Options &options)
+        : node_(node), currentInterface_(std::move(currentInterface)), isTracked_(isTracked), globalFrame_(globalFrame),
+          occupancyDepthRetention_(options.depthRetention), occupancyDepthStride_(options.depthStride)
+    {
+        occupancyMapper_ = std::make_unique<OccupancyMapper>(options.map, options.queueSize);
+        // the keyframes that moved are integrated again past the map data thresholds, and only there.
+        occupancyEncoder_ = std::make_unique<MapDataDeltaEncoder>(options.deltaTranslationThreshold, options.deltaRotationThreshold, 0);
+        occupancyGridPub_ = node_.create_publisher<nav_msgs::msg::OccupancyGrid>("occupancy_grid", rclcpp::QoS(1).reliable().transient_local());
+        occupiedVoxelsPub_ = node_.create_publisher<sensor_msgs::msg::PointCloud2>("occupied_voxels", 10);
+        occupancyCallbackGroup_ = node_.create_callback_group(rclcpp::CallbackGroupType::MutuallyExclusive);
+        // new keyframes are picked up well within the depth retention.
+        occupancyUpdateTimer_ = node_.create_wall_timer(std::chrono::milliseconds(100), std::bind(&OccupancyMapping::updateOccupancyMap, this), occupancyCallbackGroup_);
+        occupancyPublishTimer_ = node_.create_wall_timer(std::chrono::milliseconds(std::max(1, options.publishFrequency)), std::bind(&OccupancyMapping::publishOccupancyMap, this), occupancyCallbackGroup_);
+        RCLCPP_INFO_STREAM(node_.get_logger(), "Occupancy mapping at " << options.map.resolution << " m.");
+    }
+
+    OccupancyMapping::~OccupancyMapping()
+    {
+        occupancyUpdateTimer_.reset();
+        occupancyPublishTimer_.reset();
+        occupancyMapper_.reset();
+    }
+
+    void OccupancyMapping::recordDepth(const sensor_msgs::msg::Image::ConstSharedPtr &msgImage, const sensor_msgs::msg::Image::ConstSharedPtr &msgDepth)
+    {
+        if (!msgDepth)
+            return;
+        // keyed by the stamp of the tracked image, the stamp of the keyframe.
+        const double stamp = typeConversion_.stampToSec(msgImage->header.stamp);
+        std::lock_guard<std::mutex> lock(recentDepthMutex_);
+        recentDepth_.emplace_back(stamp, msgDepth);
+        while (!recentDepth_.empty() && recentDepth_.front().first < stamp - occupancyDepthRetention_)
+            recentDepth_.pop_front();
+    }
+
+    void OccupancyMapping::reset()
+    {
+        // the loaded map has no depth to rebuild the occupancy map from, it starts over with the new keyframes.
+        std::lock_guard<std::mutex> lock(occupancyMutex_);
+        occupancyMapper_->clear();
+        occupancyEncoder_->requestSnapshot();
+        occupancyMapVersion_ = std::numeric_limits<uint64_t>::max();
+        lastOccupancyVersion_ = std::numeric_limits<uint64_t>::max();
+    }
+
+    void OccupancyMapping::updateMetrics(MetricsRegistry &metrics) const
+    {
+        const OccupancyMapperStats stats = occupancyMapper_->stats();
+        metrics.gauge("occupancy_keyframes_integrated", "Keyframes fused into the occupancy map since start.").set(stats.integrated);
+        metrics.gauge("occupancy_keyframes_reintegrated", "Keyframes fused again into the occupancy map after they moved.").set(stats.reintegrated);
+        metrics.gauge("occupancy_keyframes_dropped", "New keyframes dropped by the full occupancy queue since start.").set(stats.dropped);
+        metrics.gauge("occupancy_keyframes_without_depth", "New keyframes without a depth image left to fuse.").set(occupancyKeyFramesWithoutDepth_);
+        metrics.gauge("occupancy_pending", "Keyframes waiting for the occupancy mapper.").set(stats.pending);
+    }
+
+    bool OccupancyMapping::depthScan(const sensor_msgs::msg::Image &depth, std::vector<Eigen::Vector3f> &points) const
+    {
+        const auto &f = occupancyFrustum_;
+        const uint32_t stride = static_cast<uint32_t>(std::max(1, occupancyDepthStride_));
+        if (depth.encoding == "16UC1" || depth.encoding == "mono16")
+        {
+            // millimeters, REP 118.
+            depthToPoints(reinterpret_cast<const uint16_t *>(depth.data.data()), depth.width, depth.height, depth.step / sizeof(uint16_t),
+                          0.001f, f.fx, f.fy, f.cx, f.cy, stride, points);
+            return true;
+        }
+        if (depth.encoding == "32FC1")
+        {
+            depthToPoints(reinterpret_cast<const float *>(depth.data.data()), depth.width, depth.height, depth.step / sizeof(float),
+                          1.0f, f.fx, f.fy, f.cx, f.cy, stride, points);
+            return true;
+        }
+        return false;
+    }
+
+    void OccupancyMapping::updateOccupancyMap()
+    {
+        std::lock_guard<std::mutex> lock(occupancyMutex_);
+        auto interface = currentInterface_();
+        if (!interface || !isTracked_)
+            return;
+        if (!hasOccupancyFrustum_)
+        {
+            hasOccupancyFrustum_ = interface->getPinholeFrustum(occupancyFrustum_);
+            if (!hasOccupancyFrustum_)
+            {
+                RCLCPP_WARN_THROTTLE(node_.get_logger(), *node_.get_clock(), 10000, "The occupancy map needs a pinhole camera calibration.");
+                return;
+            }
+        }
+        // the poses only change with the map version.
+        const uint64_t mapVersion = interface->mapVersion();
+        if (mapVersion == occupancyMapVersion_)
+            return;
+        occupancyMapVersion_ = mapVersion;
+        interface->getOptimizedPoseGraph(occupancyGraph_, false);
+        slam_msgs::msg::MapDataDelta &delta = occupancyDelta_;
+        if (!occupancyEncoder_->encode(occupancyGraph_, delta))
+            return;
+
+        for (size_t i = 0; i < delta.added_ids.size(); i++)
+        {
+            const double stamp = typeConversion_.stampToSec(delta.added_poses[i].header.stamp);
+            sensor_msgs::msg::Image::ConstSharedPtr depth;
+            {
+                std::lock_guard<std::mutex> depthLock(recentDepthMutex_);
+                for (auto it = recentDepth_.rbegin(); it != recentDepth_.rend(); ++it)
+                {
+                    // the keyframe stamp went through a double and back.
+                    if (std::abs(it->first - stamp) < 1e-4)
+                    {
+                        depth = it->second;
+                        break;
+                    }
+                }
+            }
+            std::vector<Eigen::Vector3f> points;
+            if (!depth)
+            {
+                // keyframes of a loaded map, or whose depth aged out before they were created.
+                ++occupancyKeyFramesWithoutDepth_;
+                continue;
+            }
+            if (!depthScan(*depth, points))
+            {
+                RCLCPP_WARN_STREAM_THROTTLE(node_.get_logger(), *node_.get_clock(), 10000, "Unsupported depth encoding " << depth->encoding << " for the occupancy map.");
+                continue;
+            }
+            Eigen::Affine3d pose;
+            tf2::fromMsg(delta.added_poses[i].pose, pose);
+            occupancyMapper_->addKeyFrame(delta.added_ids[i], pose.cast<float>(), std::move(points));
+        }
+        for (size_t i = 0; i < delta.moved_ids.size(); i++)
+        {
+            Eigen::Affine3d pose;
+            tf2::fromMsg(delta.moved_poses[i].pose, pose);
+            occupancyMapper_->moveKeyFrame(delta.moved_ids[i], pose.cast<float>());
+        }
+        for (auto id : delta.removed_ids)
+            occupancyMapper_->removeKeyFrame(id);
+    }
+
+    void OccupancyMapping::publishOccupancyMap()
+    {
+        const uint64_t version = occupancyMapper_->version();
+        if (version == lastOccupancyVersion_)
+            return;
+        lastOccupancyVersion_ = version;
+        const rclcpp::Time now = node_.now();
+
+        OccupancyGrid grid;
+        occupancyMapper_->grid(grid);
+        nav_msgs::msg::OccupancyGrid gridMsg;
+        gridMsg.header.frame_id = globalFrame_;
+        gridMsg.header.stamp = now;
+        gridMsg.info.map_load_time = now;
+        gridMsg.info.resolution = grid.resolution;
+        gridMsg.info.width = grid.width;
+        gridMsg.info.height = grid.height;
+        gridMsg.info.origin.position.x = grid.originX * grid.resolution;
+        gridMsg.info.origin.position.y = grid.originY * grid.resolution;
+        gridMsg.info.origin.orientation.w = 1.0;
+        gridMsg.data = std::move(grid.data);
+        occupancyGridPub_->publish(gridMsg);
+
+        if (occupiedVoxelsPub_->get_subscription_count() == 0)
+            return;
+        std::vector<Eigen::Vector3f> centers;
+        occupancyMapper_->occupiedVoxels(centers);
+        if (centers.empty())
+            return;
+        auto cloud = typeConversion_.MapPointsToPCL(centers);
+        cloud.header.frame_id = globalFrame_;
+        cloud.header.stamp = now;
+        occupiedVoxelsPub_->publish(cloud);
+    }
+}
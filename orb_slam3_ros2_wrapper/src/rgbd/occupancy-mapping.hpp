@@ -0,0 +1,139 @@
+/**
+ * @file occupancy-mapping.hpp
+ * @brief Definition of the OccupancyMapping class, the occupancy grid and voxel map of a SLAM node.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#ifndef OCCUPANCY_MAPPING_HPP_
+#define OCCUPANCY_MAPPING_HPP_
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <rclcpp/rclcpp.hpp>
+#include <sensor_msgs/msg/image.hpp>
+#include <sensor_msgs/msg/point_cloud2.hpp>
+#include <nav_msgs/msg/occupancy_grid.hpp>
+#include <slam_msgs/msg/map_data_delta.hpp>
+
+#include "orb_slam3_ros2_wrapper/orb_slam3_interface.hpp"
+#include "orb_slam3_ros2_wrapper/type_conversion.hpp"
+#include "orb_slam3_ros2_wrapper/map_data_delta.hpp"
+#include "orb_slam3_ros2_wrapper/instrumentation.hpp"
+#include "orb_slam3_ros2_wrapper/occupancy_map.hpp"
+
+namespace ORB_SLAM3_Wrapper
+{
+    /**
+     * @brief Fuses the depth image of every keyframe into an OccupancyMapper and publishes occupancy_grid and occupied_voxels.
+     * @note Keyframes carry no depth, so the depth images of the recent frames are kept, with the stamp of the
+     * color image, until their keyframe shows up. Parameters: occupancy_mapping, occupancy_resolution,
+     * occupancy_max_range, occupancy_min_height, occupancy_max_height, occupancy_depth_stride,
+     * occupancy_depth_retention, occupancy_queue_size and occupancy_publish_frequency.
+     */
+    class OccupancyMapping
+    {
+    public:
+        struct Options
+        {
+            OccupancyMapConfig map;
+            size_t queueSize = 16;
+            // ms between two publishes.
+            int publishFrequency = 1000;
+            // s a depth image is kept waiting for its keyframe.
+            double depthRetention = 2.0;
+            int depthStride = 4;
+            // the keyframes that moved past them are integrated again.
+            double deltaTranslationThreshold = 0.05;
+            double deltaRotationThreshold = 0.02;
+        };
+
+        /**
+         * @brief Declares the parameters and builds the mapping if occupancy_mapping is set.
+         * @param deltaTranslationThreshold, deltaRotationThreshold Those of the map data.
+         * @return Null when disabled or for a sensor without depth.
+         */
+        static std::unique_ptr<OccupancyMapping> fromParameters(rclcpp::Node &node,
+                                                                ORB_SLAM3::System::eSensor sensor,
+                                                                std::function<std::shared_ptr<ORBSLAM3Interface>()> currentInterface,
+                                                                const std::atomic<bool> &isTracked,
+                                                                const std::string &globalFrame,
+                                                                double deltaTranslationThreshold,
+                                                                double deltaRotationThreshold);
+
+        /**
+         * @param currentInterface The interface in use, null while a map is being loaded.
+         * @param isTracked Nothing is fused before the first tracked frame.
+         */
+        OccupancyMapping(rclcpp::Node &node,
+                         std::function<std::shared_ptr<ORBSLAM3Interface>()> currentInterface,
+                         const std::atomic<bool> &isTracked,
+                         const std::string &globalFrame,
+                         const Options &options);
+        ~OccupancyMapping();
+
+        /**
+         * @brief Keeps the depth image of a frame, call it before the frame is tracked: its keyframe can reach
+         * the map before the track call returns.
+         */
+        void recordDepth(const sensor_msgs::msg::Image::ConstSharedPtr &msgImage, const sensor_msgs::msg::Image::ConstSharedPtr &msgDepth);
+
+        /**
+         * @brief Starts over for a loaded map, which has no depth to rebuild the occupancy map from.
+         */
+        void reset();
+
+        void updateMetrics(MetricsRegistry &metrics) const;
+
+    private:
+        /**
+         * @brief Hands the keyframes added, moved or removed since the last call to the occupancy mapper.
+         */
+        void updateOccupancyMap();
+
+        /**
+         * @brief Publishes occupancy_grid and occupied_voxels if the occupancy map changed.
+         */
+        void publishOccupancyMap();
+
+        /**
+         * @brief Scan of a depth image in the camera frame, with the axes of the keyframe poses.
+         * @return False for an unsupported encoding.
+         */
+        bool depthScan(const sensor_msgs::msg::Image &depth, std::vector<Eigen::Vector3f> &points) const;
+
+        rclcpp::Node &node_;
+        std::function<std::shared_ptr<ORBSLAM3Interface>()> currentInterface_;
+        const std::atomic<bool> &isTracked_;
+        std::string globalFrame_;
+        WrapperTypeConversions typeConversion_;
+        std::unique_ptr<OccupancyMapper> occupancyMapper_;
+        std::unique_ptr<MapDataDeltaEncoder> occupancyEncoder_;
+        rclcpp::Publisher<nav_msgs::msg::OccupancyGrid>::SharedPtr occupancyGridPub_;
+        rclcpp::Publisher<sensor_msgs::msg::PointCloud2>::SharedPtr occupiedVoxelsPub_;
+        rclcpp::TimerBase::SharedPtr occupancyUpdateTimer_;
+        rclcpp::TimerBase::SharedPtr occupancyPublishTimer_;
+        rclcpp::CallbackGroup::SharedPtr occupancyCallbackGroup_;
+        // held by the updates, so that load_map never clears the mapper in the middle of one.
+        std::mutex occupancyMutex_;
+        // map version of the last update.
+        uint64_t occupancyMapVersion_ = std::numeric_limits<uint64_t>::max();
+        slam_msgs::msg::MapGraph occupancyGraph_;
+        slam_msgs::msg::MapDataDelta occupancyDelta_;
+        std::mutex recentDepthMutex_;
+        std::deque<std::pair<double, sensor_msgs::msg::Image::ConstSharedPtr>> recentDepth_;
+        double occupancyDepthRetention_;
+        int occupancyDepthStride_;
+        bool hasOccupancyFrustum_ = false;
+        PinholeFrustum occupancyFrustum_;
+        std::atomic<uint64_t> lastOccupancyVersion_{std::numeric_limits<uint64_t>::max()};
+        std::atomic<uint64_t> occupancyKeyFramesWithoutDepth_{0};
+    };
+}
+#endif
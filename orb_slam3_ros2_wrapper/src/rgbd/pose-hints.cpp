@@ -0,0 +1,58 @@
+/**
+ * @file pose-hints.cpp
+ * @brief Implementation of the PoseHints class.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+#include "pose-hints.hpp"
+
+#include <tf2_eigen/tf2_eigen.hpp>
+#include <tf2_geometry_msgs/tf2_geometry_msgs.hpp>
+
+namespace ORB_SLAM3_Wrapper
+{
+    PoseHints::PoseHints(rclcpp::Node &node,
+                         std::function<std::shared_ptr<ORBSLAM3Interface>()> currentInterface,
+                         std::shared_ptr<tf2_ros::Buffer> tfBuffer,
+                         const std::string &globalFrame,
+                         rclcpp::CallbackGroup::SharedPtr callbackGroup)
+        : node_(node), currentInterface_(std::move(currentInterface)), tfBuffer_(std::move(tfBuffer)), globalFrame_(globalFrame)
+    {
+        node_.declare_parameter("relocalization_hint_radius", rclcpp::ParameterValue(3.0));
+        node_.get_parameter("relocalization_hint_radius", relocalizationHintRadius_);
+        node_.declare_parameter("relocalization_hint_timeout", rclcpp::ParameterValue(10.0));
+        node_.get_parameter("relocalization_hint_timeout", relocalizationHintTimeout_);
+        // initialpose is where RViz and the Nav2 tools publish.
+        node_.declare_parameter("initial_pose_topic_name", rclcpp::ParameterValue(std::string("initialpose")));
+        rclcpp::SubscriptionOptions options;
+        options.callback_group = callbackGroup;
+        initialPoseSub_ = node_.create_subscription<geometry_msgs::msg::PoseWithCovarianceStamped>(node_.get_parameter("initial_pose_topic_name").as_string(), 1,
+                                                                                                   std::bind(&PoseHints::initialPoseCallback, this, std::placeholders::_1), options);
+    }
+
+    void PoseHints::initialPoseCallback(const geometry_msgs::msg::PoseWithCovarianceStamped::SharedPtr msgPose)
+    {
+        Eigen::Affine3d pose;
+        tf2::fromMsg(msgPose->pose.pose, pose);
+        if (!msgPose->header.frame_id.empty() && msgPose->header.frame_id != globalFrame_)
+        {
+            try
+            {
+                const auto transform = tfBuffer_->lookupTransform(globalFrame_, msgPose->header.frame_id, tf2::TimePointZero);
+                pose = Eigen::Affine3d(tf2::transformToEigen(transform).matrix()) * pose;
+            }
+            catch (const tf2::TransformException &e)
+            {
+                RCLCPP_WARN_STREAM(node_.get_logger(), "Pose hint in " << msgPose->header.frame_id << " ignored: " << e.what());
+                return;
+            }
+        }
+        RCLCPP_INFO_STREAM(node_.get_logger(), "Pose hint at " << pose.translation().transpose() << " in " << globalFrame_ << ".");
+        auto interface = currentInterface_();
+        if (!interface)
+        {
+            RCLCPP_WARN(node_.get_logger(), "Pose hint ignored, a map is being loaded.");
+            return;
+        }
+        interface->setPoseHint(pose, static_cast<float>(relocalizationHintRadius_), relocalizationHintTimeout_);
+    }
+}
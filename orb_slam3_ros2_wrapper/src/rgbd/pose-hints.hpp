@@ -0,0 +1,53 @@
+/**
+ * @file pose-hints.hpp
+ * @brief Definition of the PoseHints class, relocalization hints of a SLAM node.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#ifndef POSE_HINTS_HPP_
+#define POSE_HINTS_HPP_
+
+#include <functional>
+#include <memory>
+#include <string>
+
+#include <rclcpp/rclcpp.hpp>
+#include <geometry_msgs/msg/pose_with_covariance_stamped.hpp>
+#include <tf2_ros/buffer.h>
+
+#include "orb_slam3_ros2_wrapper/orb_slam3_interface.hpp"
+
+namespace ORB_SLAM3_Wrapper
+{
+    /**
+     * @brief Hands the poses published on initial_pose_topic_name (AMCL, odometry or an operator with the
+     * RViz 2D Pose Estimate) to the interface as relocalization hints, see ORBSLAM3Interface::setPoseHint.
+     * @note Parameters: relocalization_hint_radius (m), relocalization_hint_timeout (s) and initial_pose_topic_name.
+     */
+    class PoseHints
+    {
+    public:
+        /**
+         * @param currentInterface The interface in use, null while a map is being loaded.
+         * @param tfBuffer Transforms a hint given in another frame into globalFrame.
+         * @param callbackGroup The TF lookup of a hint must not delay the sensors, so not theirs.
+         */
+        PoseHints(rclcpp::Node &node,
+                  std::function<std::shared_ptr<ORBSLAM3Interface>()> currentInterface,
+                  std::shared_ptr<tf2_ros::Buffer> tfBuffer,
+                  const std::string &globalFrame,
+                  rclcpp::CallbackGroup::SharedPtr callbackGroup);
+
+    private:
+        void initialPoseCallback(const geometry_msgs::msg::PoseWithCovarianceStamped::SharedPtr msgPose);
+
+        rclcpp::Node &node_;
+        std::function<std::shared_ptr<ORBSLAM3Interface>()> currentInterface_;
+        std::shared_ptr<tf2_ros::Buffer> tfBuffer_;
+        std::string globalFrame_;
+        double relocalizationHintRadius_;
+        double relocalizationHintTimeout_;
+        rclcpp::Subscription<geometry_msgs::msg::PoseWithCovarianceStamped>::SharedPtr initialPoseSub_;
+    };
+}
+#endif
@@ -5,29 +5,138 @@
  */
 #include "rgbd-slam-node.hpp"
 
+#include <cmath>
+#include <cstdio>
+
 #include <opencv2/core/core.hpp>
 
 namespace ORB_SLAM3_Wrapper
 {
+    namespace
+    {
+        double steadySeconds()
+        {
+            return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+    }
+
     RgbdSlamNode::RgbdSlamNode(const std::string &strVocFile,
                                const std::string &strSettingsFile,
-                               ORB_SLAM3::System::eSensor sensor)
-        : Node("ORB_SLAM3_RGBD_ROS2")
+                               ORB_SLAM3::System::eSensor sensor,
+                               const rclcpp::NodeOptions &options)
+        : Node(nodeNameForSensor(sensor), options)
+    {
+        initialize(strVocFile, strSettingsFile, sensor);
+    }
+
+    RgbdSlamNode::RgbdSlamNode(const rclcpp::NodeOptions &options)
+        : Node("ORB_SLAM3_ROS2", options)
+    {
+        // As a component the vocabulary and settings cannot come from argv.
+        this->declare_parameter("vocabulary_file_path", rclcpp::ParameterValue(std::string("")));
+        this->declare_parameter("settings_file_path", rclcpp::ParameterValue(std::string("")));
+        auto strVocFile = this->get_parameter("vocabulary_file_path").as_string();
+        auto strSettingsFile = this->get_parameter("settings_file_path").as_string();
+        if (strVocFile.empty() || strSettingsFile.empty())
+        {
+            throw std::runtime_error("vocabulary_file_path and settings_file_path must be set to load RgbdSlamNode as a component.");
+        }
+        this->declare_parameter("sensor_type", rclcpp::ParameterValue(std::string("rgbd")));
+        auto sensorType = this->get_parameter("sensor_type").as_string();
+        ORB_SLAM3::System::eSensor sensor;
+        if (!sensorFromString(sensorType, sensor))
+        {
+            throw std::runtime_error("Unknown sensor_type " + sensorType + ".");
+        }
+        initialize(strVocFile, strSettingsFile, sensor);
+    }
+
+    bool RgbdSlamNode::sensorFromString(const std::string &sensorType, ORB_SLAM3::System::eSensor &sensor)
+    {
+        static const std::map<std::string, ORB_SLAM3::System::eSensor> sensors = {
+            {"rgbd", ORB_SLAM3::System::RGBD},
+            {"rgbd_inertial", ORB_SLAM3::System::IMU_RGBD},
+            {"stereo", ORB_SLAM3::System::STEREO},
+            {"stereo_inertial", ORB_SLAM3::System::IMU_STEREO},
+            {"mono", ORB_SLAM3::System::MONOCULAR},
+            {"mono_inertial", ORB_SLAM3::System::IMU_MONOCULAR}};
+        auto it = sensors.find(sensorType);
+        if (it == sensors.end())
+            return false;
+        sensor = it->second;
+        return true;
+    }
+
+    std::string RgbdSlamNode::nodeNameForSensor(ORB_SLAM3::System::eSensor sensor)
     {
+        switch (sensor)
+        {
+        case ORB_SLAM3::System::STEREO:
+        case ORB_SLAM3::System::IMU_STEREO:
+            return "ORB_SLAM3_STEREO_ROS2";
+        case ORB_SLAM3::System::MONOCULAR:
+        case ORB_SLAM3::System::IMU_MONOCULAR:
+            return "ORB_SLAM3_MONO_ROS2";
+        default:
+            return "ORB_SLAM3_RGBD_ROS2";
+        }
+    }
+
+    void RgbdSlamNode::initialize(const std::string &strVocFile,
+                                  const std::string &strSettingsFile,
+                                  ORB_SLAM3::System::eSensor sensor)
+    {
+        sensor_ = sensor;
+        // Instrumentation, the node and interface metrics share one registry that outlives the interface (see load_map).
+        metrics_ = std::make_shared<MetricsRegistry>();
         // Declare parameters (topic names)
         this->declare_parameter("rgb_image_topic_name", rclcpp::ParameterValue("camera/image_raw"));
         this->declare_parameter("depth_image_topic_name", rclcpp::ParameterValue("depth/image_raw"));
+        this->declare_parameter("left_image_topic_name", rclcpp::ParameterValue("camera/left/image_raw"));
+        this->declare_parameter("right_image_topic_name", rclcpp::ParameterValue("camera/right/image_raw"));
         this->declare_parameter("imu_topic_name", rclcpp::ParameterValue("imu"));
         this->declare_parameter("odom_topic_name", rclcpp::ParameterValue("odom"));
 
+        // Callback groups: a service call never delays the images (tracked in their callback without
+        // tracking_pipeline) nor the IMU.
+        sensorCallbackGroup_ = this->create_callback_group(rclcpp::CallbackGroupType::MutuallyExclusive);
+        imuCallbackGroup_ = this->create_callback_group(rclcpp::CallbackGroupType::MutuallyExclusive);
+        servicesCallbackGroup_ = this->create_callback_group(rclcpp::CallbackGroupType::MutuallyExclusive);
+        rclcpp::SubscriptionOptions sensorOptions;
+        sensorOptions.callback_group = sensorCallbackGroup_;
+        rclcpp::SubscriptionOptions imuOptions;
+        imuOptions.callback_group = imuCallbackGroup_;
+
         // ROS Subscribers
-        rgbSub_ = std::make_shared<message_filters::Subscriber<sensor_msgs::msg::Image>>(this, this->get_parameter("rgb_image_topic_name").as_string());
-        depthSub_ = std::make_shared<message_filters::Subscriber<sensor_msgs::msg::Image>>(this, this->get_parameter("depth_image_topic_name").as_string());
-        syncApproximate_ = std::make_shared<message_filters::Synchronizer<approximate_sync_policy>>(approximate_sync_policy(10), *rgbSub_, *depthSub_);
-        syncApproximate_->registerCallback(&RgbdSlamNode::RGBDCallback, this);
+        std::string firstImageTopic, secondImageTopic;
+        switch (sensor_)
+        {
+        case ORB_SLAM3::System::RGBD:
+        case ORB_SLAM3::System::IMU_RGBD:
+            firstImageTopic = this->get_parameter("rgb_image_topic_name").as_string();
+            secondImageTopic = this->get_parameter("depth_image_topic_name").as_string();
+            break;
+        case ORB_SLAM3::System::STEREO:
+        case ORB_SLAM3::System::IMU_STEREO:
+            firstImageTopic = this->get_parameter("left_image_topic_name").as_string();
+            secondImageTopic = this->get_parameter("right_image_topic_name").as_string();
+            break;
+        default:
+            break;
+        }
+        if (!secondImageTopic.empty())
+        {
+            firstImageSub_ = std::make_shared<message_filters::Subscriber<sensor_msgs::msg::Image>>(this, firstImageTopic, rmw_qos_profile_default, sensorOptions);
+            secondImageSub_ = std::make_shared<message_filters::Subscriber<sensor_msgs::msg::Image>>(this, secondImageTopic, rmw_qos_profile_default, sensorOptions);
+            syncApproximate_ = std::make_shared<message_filters::Synchronizer<approximate_sync_policy>>(approximate_sync_policy(10), *firstImageSub_, *secondImageSub_);
+            syncApproximate_->registerCallback(&RgbdSlamNode::ImagesCallback, this);
+        }
+        else
+            monoSub_ = this->create_subscription<sensor_msgs::msg::Image>(this->get_parameter("rgb_image_topic_name").as_string(), 10, std::bind(&RgbdSlamNode::MonoCallback, this, std::placeholders::_1), sensorOptions);
 
-        imuSub_ = this->create_subscription<sensor_msgs::msg::Imu>(this->get_parameter("imu_topic_name").as_string(), 1000, std::bind(&RgbdSlamNode::ImuCallback, this, std::placeholders::_1));
-        odomSub_ = this->create_subscription<nav_msgs::msg::Odometry>(this->get_parameter("odom_topic_name").as_string(), 1000, std::bind(&RgbdSlamNode::OdomCallback, this, std::placeholders::_1));
+        if (sensor_ == ORB_SLAM3::System::IMU_RGBD || sensor_ == ORB_SLAM3::System::IMU_STEREO || sensor_ == ORB_SLAM3::System::IMU_MONOCULAR)
+            imuSub_ = this->create_subscription<sensor_msgs::msg::Imu>(this->get_parameter("imu_topic_name").as_string(), 1000, std::bind(&RgbdSlamNode::ImuCallback, this, std::placeholders::_1), imuOptions);
+        odomSub_ = this->create_subscription<nav_msgs::msg::Odometry>(this->get_parameter("odom_topic_name").as_string(), 1000, std::bind(&RgbdSlamNode::OdomCallback, this, std::placeholders::_1), sensorOptions);
         // ROS Publishers
         mapDataPub_ = this->create_publisher<slam_msgs::msg::MapData>("map_data", 10);
         mapPointsPub_ = this->create_publisher<sensor_msgs::msg::PointCloud2>("map_points", 10);
@@ -35,17 +144,26 @@ namespace ORB_SLAM3_Wrapper
         visibleLandmarksPose_ = this->create_publisher<geometry_msgs::msg::PoseStamped>("visible_landmarks_pose", 10);
 // Services 
         getMapDataService_ = this->create_service<slam_msgs::srv::GetMap>("orb_slam3_get_map_data", std::bind(&RgbdSlamNode::getMapServer, this,
-                                                                                                              std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+                                                                                                              std::placeholders::_1, std::placeholders::_2, std::placeholders::_3),
+                                                                          rmw_qos_profile_services_default, servicesCallbackGroup_);
+        // the map data with its points packed, see PackedMapData.
+        this->declare_parameter("packed_points_resolution", rclcpp::ParameterValue(0.001));
+        this->get_parameter("packed_points_resolution", packedPointsResolution_);
+        this->declare_parameter("packed_points_compression_level", rclcpp::ParameterValue(3));
+        this->get_parameter("packed_points_compression_level", packedPointsCompressionLevel_);
+        getPackedMapDataService_ = this->create_service<slam_msgs::srv::GetPackedMap>("orb_slam3_get_map_data_packed", std::bind(&RgbdSlamNode::getPackedMapServer, this,
+                                                                                                                               std::placeholders::_1, std::placeholders::_2, std::placeholders::_3),
+                                                                                      rmw_qos_profile_services_default, servicesCallbackGroup_);
         getMapPointsService_ = this->create_service<slam_msgs::srv::GetLandmarksInView>("orb_slam3_get_landmarks_in_view", std::bind(&RgbdSlamNode::getMapPointsInViewServer, this,
-                                                                                                              std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+                                                                                                              std::placeholders::_1, std::placeholders::_2, std::placeholders::_3),
+                                                                                        rmw_qos_profile_services_default, servicesCallbackGroup_);
         // TF
         tfBroadcaster_ = std::make_shared<tf2_ros::TransformBroadcaster>(this);
         tfBuffer_ = std::make_shared<tf2_ros::Buffer>(this->get_clock());
         tfListener_ = std::make_shared<tf2_ros::TransformListener>(*tfBuffer_);
 
-        bool bUseViewer;
         this->declare_parameter("visualization", rclcpp::ParameterValue(true));
-        this->get_parameter("visualization", bUseViewer);
+        this->get_parameter("visualization", bUseViewer_);
 
         this->declare_parameter("ros_visualization", rclcpp::ParameterValue(false));
         this->get_parameter("ros_visualization", rosViz_);
@@ -77,29 +195,252 @@ namespace ORB_SLAM3_Wrapper
         this->declare_parameter("landmark_publish_frequency", rclcpp::ParameterValue(1000));
         this->get_parameter("landmark_publish_frequency", landmark_publish_frequency_);
 
+        std::string mapDataPublishMode;
+        this->declare_parameter("map_data_publish_mode", rclcpp::ParameterValue(std::string("full")));
+        this->get_parameter("map_data_publish_mode", mapDataPublishMode);
+        publishMapDataDelta_ = mapDataPublishMode == "delta";
+        if (!publishMapDataDelta_ && mapDataPublishMode != "full")
+            RCLCPP_WARN_STREAM(this->get_logger(), "Unknown map_data_publish_mode " << mapDataPublishMode << ", using full.");
+
+        double deltaTranslationThreshold, deltaRotationThreshold;
+        int snapshotInterval;
+        this->declare_parameter("map_data_delta_translation_threshold", rclcpp::ParameterValue(0.05));
+        this->get_parameter("map_data_delta_translation_threshold", deltaTranslationThreshold);
+        this->declare_parameter("map_data_delta_rotation_threshold", rclcpp::ParameterValue(0.02));
+        this->get_parameter("map_data_delta_rotation_threshold", deltaRotationThreshold);
+        this->declare_parameter("map_data_snapshot_interval", rclcpp::ParameterValue(30));
+        this->get_parameter("map_data_snapshot_interval", snapshotInterval);
+        if (publishMapDataDelta_)
+        {
+            mapDataDeltaEncoder_ = std::make_unique<MapDataDeltaEncoder>(deltaTranslationThreshold, deltaRotationThreshold, snapshotInterval);
+            mapDataDeltaPub_ = this->create_publisher<slam_msgs::msg::MapDataDelta>("map_data_delta", rclcpp::QoS(10).reliable());
+            mapDataSnapshotService_ = this->create_service<std_srvs::srv::Trigger>("map_data_request_snapshot", std::bind(&RgbdSlamNode::mapDataSnapshotServer, this,
+                                                                                                                       std::placeholders::_1, std::placeholders::_2, std::placeholders::_3),
+                                                                                   rmw_qos_profile_services_default, servicesCallbackGroup_);
+        }
+
+        bool mapEvents;
+        this->declare_parameter("map_events", rclcpp::ParameterValue(false));
+        this->get_parameter("map_events", mapEvents);
+        this->declare_parameter("map_event_queue_size", rclcpp::ParameterValue(1024));
+        this->get_parameter("map_event_queue_size", mapEventQueueSize_);
+        if (mapEvents)
+            mapEventsPub_ = this->create_publisher<slam_msgs::msg::MapEvents>("map_events", rclcpp::QoS(100).reliable());
+
+        // Fleet map server stream, see FleetDescriptorStream.
+        fleet_ = FleetDescriptorStream::fromParameters(*this, std::bind(&RgbdSlamNode::currentInterface, this), isTracked_, global_frame_, metrics_,
+                                                       deltaTranslationThreshold, deltaRotationThreshold, snapshotInterval);
+
+        this->declare_parameter("tracking_pipeline", rclcpp::ParameterValue(false));
+        this->get_parameter("tracking_pipeline", trackingPipeline_);
+
+        this->declare_parameter("frame_queue_size", rclcpp::ParameterValue(4));
+        this->get_parameter("frame_queue_size", frameQueueSize_);
+
+        std::string frameDropPolicy;
+        this->declare_parameter("frame_drop_policy", rclcpp::ParameterValue(std::string("newest")));
+        this->get_parameter("frame_drop_policy", frameDropPolicy);
+        if (frameDropPolicy == "fifo")
+            frameDropPolicy_ = FrameDropPolicy::FIFO;
+        else
+        {
+            if (frameDropPolicy != "newest")
+                RCLCPP_WARN_STREAM(this->get_logger(), "Unknown frame_drop_policy " << frameDropPolicy << ", using newest.");
+            frameDropPolicy_ = FrameDropPolicy::NEWEST_WINS;
+        }
+
+        std::string featureBackend, featureBackendMessage;
+        this->declare_parameter("feature_backend", rclcpp::ParameterValue(std::string("orb")));
+        this->get_parameter("feature_backend", featureBackend);
+        featureBackend_ = makeFeatureBackend(featureBackend, featureBackendName_, featureBackendMessage);
+        if (!featureBackendMessage.empty())
+            RCLCPP_WARN_STREAM(this->get_logger(), featureBackendMessage);
+        RCLCPP_INFO_STREAM(this->get_logger(), "Feature backend: " << featureBackendName_);
+
+        bool overloadControl;
+        OverloadControllerConfig overloadConfig;
+        this->declare_parameter("overload_control", rclcpp::ParameterValue(false));
+        this->get_parameter("overload_control", overloadControl);
+        this->declare_parameter("overload_max_utilization", rclcpp::ParameterValue(overloadConfig.maxUtilization));
+        this->get_parameter("overload_max_utilization", overloadConfig.maxUtilization);
+        this->declare_parameter("overload_restore_utilization", rclcpp::ParameterValue(overloadConfig.restoreUtilization));
+        this->get_parameter("overload_restore_utilization", overloadConfig.restoreUtilization);
+        this->declare_parameter("overload_max_frame_skip", rclcpp::ParameterValue(overloadConfig.maxFrameSkip));
+        this->get_parameter("overload_max_frame_skip", overloadConfig.maxFrameSkip);
+        this->declare_parameter("overload_slow_linear_speed", rclcpp::ParameterValue(overloadConfig.slowLinearSpeed));
+        this->get_parameter("overload_slow_linear_speed", overloadConfig.slowLinearSpeed);
+        this->declare_parameter("overload_slow_angular_speed", rclcpp::ParameterValue(overloadConfig.slowAngularSpeed));
+        this->get_parameter("overload_slow_angular_speed", overloadConfig.slowAngularSpeed);
+        this->declare_parameter("overload_min_tracked_map_points", rclcpp::ParameterValue(overloadConfig.minTrackedMapPoints));
+        this->get_parameter("overload_min_tracked_map_points", overloadConfig.minTrackedMapPoints);
+        if (overloadControl)
+            overloadController_ = std::make_unique<OverloadController>(overloadConfig);
+
+        bool tfPrediction;
+        double tfPublishRate;
+        PosePredictorConfig predictorConfig;
+        this->declare_parameter("tf_prediction", rclcpp::ParameterValue(false));
+        this->get_parameter("tf_prediction", tfPrediction);
+        this->declare_parameter("tf_publish_rate", rclcpp::ParameterValue(50.0));
+        this->get_parameter("tf_publish_rate", tfPublishRate);
+        this->declare_parameter("tf_prediction_horizon", rclcpp::ParameterValue(predictorConfig.maxHorizon));
+        this->get_parameter("tf_prediction_horizon", predictorConfig.maxHorizon);
+        if (tfPrediction && publish_tf_)
+        {
+            // the tracked frames only correct the predictor, the timer publishes the transform stamped with the current time.
+            posePredictor_ = std::make_unique<PosePredictor>(predictorConfig);
+            tfPredictionCallbackGroup_ = this->create_callback_group(rclcpp::CallbackGroupType::MutuallyExclusive);
+            tfPredictionTimer_ = this->create_wall_timer(std::chrono::microseconds(static_cast<int64_t>(1e6 / std::max(tfPublishRate, 1.0))),
+                                                         std::bind(&RgbdSlamNode::publishPredictedTF, this), tfPredictionCallbackGroup_);
+            RCLCPP_INFO_STREAM(this->get_logger(), "Predicted TF published at " << std::max(tfPublishRate, 1.0) << " Hz.");
+        }
+
+        // Occupancy mapping, see OccupancyMapping.
+        occupancy_ = OccupancyMapping::fromParameters(*this, sensor_, std::bind(&RgbdSlamNode::currentInterface, this), isTracked_, global_frame_,
+                                                      deltaTranslationThreshold, deltaRotationThreshold);
+
+        int liveKeyFrames, liveMapPoints;
+        this->declare_parameter("output_cache_live_keyframes", rclcpp::ParameterValue(0));
+        this->get_parameter("output_cache_live_keyframes", liveKeyFrames);
+        this->declare_parameter("output_cache_live_map_points", rclcpp::ParameterValue(0));
+        this->get_parameter("output_cache_live_map_points", liveMapPoints);
+        this->declare_parameter("output_cache_path", rclcpp::ParameterValue(std::string("")));
+        this->get_parameter("output_cache_path", outputCachePath_);
+        outputCacheLimits_.keyFrames = static_cast<size_t>(std::max(0, liveKeyFrames));
+        outputCacheLimits_.mapPoints = static_cast<size_t>(std::max(0, liveMapPoints));
+        if (outputCachePath_.empty())
+        {
+            std::string nodeName = this->get_fully_qualified_name();
+            std::replace(nodeName.begin(), nodeName.end(), '/', '_');
+            outputCachePath_ = "/tmp/orb_slam3_wrapper" + nodeName + "_keyframes";
+        }
+
         // Timers
         mapDataCallbackGroup_ = this->create_callback_group(rclcpp::CallbackGroupType::MutuallyExclusive);
         mapDataTimer_ = this->create_wall_timer(std::chrono::milliseconds(map_data_publish_frequency_), std::bind(&RgbdSlamNode::publishMapData, this), mapDataCallbackGroup_);
         if (rosViz_)
         {
             mapPointsCallbackGroup_ = this->create_callback_group(rclcpp::CallbackGroupType::MutuallyExclusive);
-            mapPointsTimer_ = this->create_wall_timer(std::chrono::milliseconds(landmark_publish_frequency_), std::bind(&RgbdSlamNode::publishMapPointCloud, this), mapDataCallbackGroup_);
+            mapPointsTimer_ = this->create_wall_timer(std::chrono::milliseconds(landmark_publish_frequency_), std::bind(&RgbdSlamNode::publishMapPointCloud, this), mapPointsCallbackGroup_);
         }
 
-        interface_ = std::make_shared<ORB_SLAM3_Wrapper::ORBSLAM3Interface>(strVocFile, strSettingsFile,
-                                                                            sensor, bUseViewer, rosViz_, robot_x_,
-                                                                            robot_y_, global_frame_, odom_frame_id_, robot_base_frame_id_);
+        // Paged map access.
+        mapStreaming_ = std::make_unique<MapStreaming>(*this, std::bind(&RgbdSlamNode::currentInterface, this), global_frame_, *metrics_);
+
+        // Relocalization hint, the TF lookup of a hint must not delay the IMU.
+        poseHints_ = std::make_unique<PoseHints>(*this, std::bind(&RgbdSlamNode::currentInterface, this), tfBuffer_, global_frame_, servicesCallbackGroup_);
+
+        // Threads and CPU affinity, empty CPU sets leave the threads where the scheduler puts them.
+        this->declare_parameter("tracking_cpus", rclcpp::ParameterValue(std::string("")));
+        this->get_parameter("tracking_cpus", trackingCpus_);
+        this->declare_parameter("tracking_priority", rclcpp::ParameterValue(0));
+        this->get_parameter("tracking_priority", trackingPriority_);
+        if ((!trackingCpus_.empty() || trackingPriority_ != 0) && !trackingPipeline_)
+            RCLCPP_WARN(this->get_logger(), "tracking_cpus and tracking_priority need tracking_pipeline, ignoring them.");
+        std::string localMappingCpus, loopClosingCpus, viewerCpus;
+        this->declare_parameter("local_mapping_cpus", rclcpp::ParameterValue(std::string("")));
+        this->get_parameter("local_mapping_cpus", localMappingCpus);
+        this->declare_parameter("loop_closing_cpus", rclcpp::ParameterValue(std::string("")));
+        this->get_parameter("loop_closing_cpus", loopClosingCpus);
+        this->declare_parameter("viewer_cpus", rclcpp::ParameterValue(std::string("")));
+        this->get_parameter("viewer_cpus", viewerCpus);
+        if (!parseCpuSet(localMappingCpus, threadLayout_.localMapping))
+            RCLCPP_WARN_STREAM(this->get_logger(), "Malformed local_mapping_cpus " << localMappingCpus << ", ignoring it.");
+        if (!parseCpuSet(loopClosingCpus, threadLayout_.loopClosing))
+            RCLCPP_WARN_STREAM(this->get_logger(), "Malformed loop_closing_cpus " << loopClosingCpus << ", ignoring it.");
+        if (!parseCpuSet(viewerCpus, threadLayout_.viewer))
+            RCLCPP_WARN_STREAM(this->get_logger(), "Malformed viewer_cpus " << viewerCpus << ", ignoring it.");
+        this->declare_parameter("executor_threads", rclcpp::ParameterValue(0));
+        this->get_parameter("executor_threads", executorThreads_);
+        this->declare_parameter("executor_cpus", rclcpp::ParameterValue(std::string("")));
+        this->get_parameter("executor_cpus", executorCpus_);
+        int queryThreads;
+        this->declare_parameter("query_threads", rclcpp::ParameterValue(0));
+        this->get_parameter("query_threads", queryThreads);
+        // shared by the nodes of the process, the first one sets its size.
+        workerPool_ = WorkerPool::shared(static_cast<size_t>(std::max(0, queryThreads)));
+
+        // Map merges.
+        std::string mergeHandling;
+        this->declare_parameter("merge_handling", rclcpp::ParameterValue("pause"));
+        this->get_parameter("merge_handling", mergeHandling);
+        if (!mergeHandlingFromString(mergeHandling, mergeHandling_))
+            RCLCPP_WARN_STREAM(this->get_logger(), "Unknown merge_handling " << mergeHandling << ", pausing the tracked pose during merges.");
+        this->declare_parameter("merge_blend_window", rclcpp::ParameterValue(1.0));
+        this->get_parameter("merge_blend_window", mergeBlendWindow_);
+
+        // Landmarks in view, the defaults of both services.
+        this->declare_parameter("landmarks_in_view_max_landmarks", rclcpp::ParameterValue(1000));
+        this->get_parameter("landmarks_in_view_max_landmarks", landmarksInViewMaxLandmarks_);
+        this->declare_parameter("landmarks_in_view_max_distance", rclcpp::ParameterValue(5.0));
+        this->get_parameter("landmarks_in_view_max_distance", landmarksInViewMaxDistance_);
+        this->declare_parameter("landmarks_in_view_max_angle", rclcpp::ParameterValue(2.0));
+        this->get_parameter("landmarks_in_view_max_angle", landmarksInViewMaxAngle_);
+        landmarksCallbackGroup_ = this->create_callback_group(rclcpp::CallbackGroupType::MutuallyExclusive);
+        getLandmarksInViewBatchService_ = this->create_service<slam_msgs::srv::GetLandmarksInViewBatch>("orb_slam3_get_landmarks_in_view_batch", std::bind(&RgbdSlamNode::getLandmarksInViewBatchServer, this,
+                                                                                                                                                           std::placeholders::_1, std::placeholders::_2, std::placeholders::_3),
+                                                                                                         rmw_qos_profile_services_default, landmarksCallbackGroup_);
+
+        // Map persistence.
+        strVocFile_ = strVocFile;
+        MapPersistence::Systems systems;
+        systems.current = std::bind(&RgbdSlamNode::currentInterface, this);
+        systems.make = std::bind(&RgbdSlamNode::makeInterface, this, std::placeholders::_1);
+        systems.install = std::bind(&RgbdSlamNode::installInterface, this, std::placeholders::_1);
+        systems.exchange = [this](const std::shared_ptr<ORBSLAM3Interface> &interface)
+        {
+            isTracked_ = false;
+            return std::atomic_exchange(&interface_, interface);
+        };
+        mapPersistence_ = std::make_unique<MapPersistence>(*this, strSettingsFile, systems);
+
+        interface_ = makeInterface(strSettingsFile);
 
         frequency_tracker_count_ = 0;
         frequency_tracker_clock_ = std::chrono::high_resolution_clock::now();
 
+        tfPublishLatency_ = &metrics_->histogram("tf_publish", "Broadcast of the tracked transform.");
+        mapDataPublishLatency_ = &metrics_->histogram("map_data_publish", "Build and publish of the map data.");
+        mapPointsPublishLatency_ = &metrics_->histogram("map_points_publish", "Build and publish of the map point cloud.");
+        getMapServiceLatency_ = &metrics_->histogram("get_map_service", "orb_slam3_get_map_data service calls.");
+        getPackedMapServiceLatency_ = &metrics_->histogram("get_map_packed_service", "orb_slam3_get_map_data_packed service calls.");
+        landmarksInViewServiceLatency_ = &metrics_->histogram("landmarks_in_view_service", "orb_slam3_get_landmarks_in_view service calls.");
+        landmarksInViewBatchServiceLatency_ = &metrics_->histogram("landmarks_in_view_batch_service", "orb_slam3_get_landmarks_in_view_batch service calls.");
+        framePrepareLatency_ = &metrics_->histogram("frame_prepare", "Submission of a frame to the feature backend.");
+        lastNodeMetricsUpdate_ = std::chrono::steady_clock::now();
+        NodeDiagnostics::Hooks diagnosticsHooks;
+        diagnosticsHooks.updateGauges = std::bind(&RgbdSlamNode::updateNodeMetrics, this);
+        diagnosticsHooks.trackingMessage = [this]()
+        { return std::string(isTracked_ ? "Tracking" : "Not tracking yet"); };
+        diagnosticsHooks.extend = std::bind(&RgbdSlamNode::extendDiagnostics, this, std::placeholders::_1, std::placeholders::_2);
+        diagnostics_ = std::make_unique<NodeDiagnostics>(*this, metrics_, diagnosticsHooks);
+
+        if (trackingPipeline_)
+            startPipeline();
+        if (mapEventsPub_)
+        {
+            mapEventsRunning_ = true;
+            mapEventsThread_ = std::thread(&RgbdSlamNode::mapEventsLoop, this);
+        }
+
         RCLCPP_INFO(this->get_logger(), "CONSTRUCTOR END!");
     }
 
     RgbdSlamNode::~RgbdSlamNode()
     {
-        rgbSub_.reset();
-        depthSub_.reset();
+        stopPipeline();
+        mapEventsRunning_ = false;
+        mapEventsCondition_.notify_all();
+        if (mapEventsThread_.joinable())
+            mapEventsThread_.join();
+        diagnostics_.reset();
+        tfPredictionTimer_.reset();
+        occupancy_.reset();
+        fleet_.reset();
+        syncApproximate_.reset();
+        firstImageSub_.reset();
+        secondImageSub_.reset();
+        monoSub_.reset();
         imuSub_.reset();
         odomSub_.reset();
         interface_.reset();
@@ -108,133 +449,765 @@ namespace ORB_SLAM3_Wrapper
 
     void RgbdSlamNode::ImuCallback(const sensor_msgs::msg::Imu::SharedPtr msgIMU)
     {
+        auto interface = currentInterface();
+        if (!interface)
+            return;
         RCLCPP_DEBUG_STREAM(this->get_logger(), "ImuCallback");
+        if (overloadController_)
+        {
+            const auto &w = msgIMU->angular_velocity;
+            overloadController_->recordAngularRate(std::sqrt(w.x * w.x + w.y * w.y + w.z * w.z), steadySeconds());
+        }
+        if (posePredictor_)
+        {
+            // the gyroscope is rotated once into the base frame, the IMU is assumed rigidly mounted.
+            if (!hasImuToBase_)
+            {
+                try
+                {
+                    imuToBase_ = Eigen::Quaterniond(tf2::transformToEigen(tfBuffer_->lookupTransform(robot_base_frame_id_, msgIMU->header.frame_id, tf2::TimePointZero)).rotation());
+                    hasImuToBase_ = true;
+                }
+                catch (const tf2::TransformException &e)
+                {
+                    RCLCPP_WARN_STREAM_THROTTLE(this->get_logger(), *this->get_clock(), 4000, "No transform from the IMU to the base yet, the predicted TF does not use the IMU: " << e.what());
+                }
+            }
+            if (hasImuToBase_)
+            {
+                const auto &w = msgIMU->angular_velocity;
+                posePredictor_->addAngularVelocity(typeConversion_.stampToSec(msgIMU->header.stamp), imuToBase_ * Eigen::Vector3d(w.x, w.y, w.z));
+            }
+        }
         // push value to imu buffer.
-        interface_->handleIMU(msgIMU);
+        interface->handleIMU(msgIMU);
     }
 
     void RgbdSlamNode::OdomCallback(const nav_msgs::msg::Odometry::SharedPtr msgOdom)
     {
+        auto interface = currentInterface();
+        if (!interface)
+            return;
+        if (overloadController_)
+        {
+            const auto &v = msgOdom->twist.twist.linear;
+            const auto &w = msgOdom->twist.twist.angular;
+            overloadController_->recordOdometry(std::sqrt(v.x * v.x + v.y * v.y + v.z * v.z),
+                                                std::sqrt(w.x * w.x + w.y * w.y + w.z * w.z), steadySeconds());
+        }
         if (!no_odometry_mode_ && publish_tf_)
         {
             RCLCPP_DEBUG_STREAM(this->get_logger(), "OdomCallback");
-            interface_->getMapToOdomTF(msgOdom, tfMapOdom_);
+            if (posePredictor_)
+            {
+                Eigen::Affine3d odomToBase;
+                tf2::fromMsg(msgOdom->pose.pose, odomToBase);
+                posePredictor_->addOdometry(typeConversion_.stampToSec(msgOdom->header.stamp), odomToBase);
+            }
+            else
+            {
+                geometry_msgs::msg::TransformStamped tf;
+                interface->getMapToOdomTF(msgOdom, tf);
+                std::lock_guard<std::mutex> lock(tfMapOdomMutex_);
+                tfMapOdom_ = tf;
+            }
         }
         else
             RCLCPP_WARN_THROTTLE(this->get_logger(), *this->get_clock(), 4000, "Odometry msg recorded but no odometry mode is true, set to false to use this odometry");
     }
 
-    void RgbdSlamNode::RGBDCallback(const sensor_msgs::msg::Image::SharedPtr msgRGB, const sensor_msgs::msg::Image::SharedPtr msgD)
+    void RgbdSlamNode::MonoCallback(const sensor_msgs::msg::Image::ConstSharedPtr msgImage)
+    {
+        ImagesCallback(msgImage, nullptr);
+    }
+
+    void RgbdSlamNode::ImagesCallback(const sensor_msgs::msg::Image::ConstSharedPtr msgImage, const sensor_msgs::msg::Image::ConstSharedPtr msgSecondImage)
+    {
+        // no system while load_map swaps them, the frame is dropped.
+        if (!std::atomic_load(&interface_))
+            return;
+        // skipped before the frame costs anything, so the synchronizer queue drains.
+        if (overloadController_ && !overloadController_->admitFrame(typeConversion_.stampToSec(msgImage->header.stamp)))
+        {
+            ++framesSkipped_;
+            return;
+        }
+        if (trackingPipeline_)
+        {
+            // receive stage: only enqueue. The image subscriptions (and their synchronizer) sit in the mutually
+            // exclusive sensorCallbackGroup_ next to odometry, which never enqueues, so there is a single producer.
+            ++framesReceived_;
+            // with fifo a full queue rejects the frame before it is prepared. With newest the frame always
+            // goes in, replacing the one the tracking thread has not taken yet.
+            if (frameDropPolicy_ == FrameDropPolicy::FIFO && frameQueue_->size() >= frameQueue_->capacity())
+            {
+                ++framesDropped_;
+                return;
+            }
+            CameraFrame frame;
+            frame.image = msgImage;
+            frame.secondImage = msgSecondImage;
+            frame.prepared = prepareFrame(msgImage, msgSecondImage);
+            if (frameDropPolicy_ == FrameDropPolicy::NEWEST_WINS)
+            {
+                if (latestFrame_->put(std::move(frame)))
+                    ++framesDropped_;
+            }
+            else if (!frameQueue_->push(std::move(frame)))
+                ++framesDropped_;
+            size_t depth = pendingFrames();
+            if (depth > maxFrameQueueDepth_)
+                maxFrameQueueDepth_ = depth;
+            frameWakeCondition_.notify_one();
+            return;
+        }
+        TrackedFrame trackedFrame;
+        if (trackFrame(msgImage, msgSecondImage, prepareFrame(msgImage, msgSecondImage), trackedFrame) && trackedFrame.hasTransform)
+        {
+            ScopedTimer timer(*tfPublishLatency_);
+            tfBroadcaster_->sendTransform(trackedFrame.tf);
+        }
+    }
+
+    std::shared_ptr<PreparedFrame> RgbdSlamNode::prepareFrame(const sensor_msgs::msg::Image::ConstSharedPtr &msgImage,
+                                                              const sensor_msgs::msg::Image::ConstSharedPtr &msgSecondImage)
     {
+        if (!featureBackend_)
+            return nullptr;
+        const int firstCode = grayConversionCode(msgImage->encoding);
+        const int secondCode = msgSecondImage ? grayConversionCode(msgSecondImage->encoding) : -1;
+        if (firstCode < 0 && secondCode < 0)
+            return nullptr;
+        ScopedTimer timer(*framePrepareLatency_);
+        try
+        {
+            auto cvFirst = cv_bridge::toCvShare(msgImage);
+            cv_bridge::CvImageConstPtr cvSecond;
+            if (secondCode >= 0)
+                cvSecond = cv_bridge::toCvShare(msgSecondImage);
+            return featureBackend_->prepare(cvFirst->image, firstCode, cvSecond ? cvSecond->image : cv::Mat(), secondCode);
+        }
+        catch (cv_bridge::Exception &e)
+        {
+            // the track call reports the malformed image.
+            return nullptr;
+        }
+        catch (cv::Exception &e)
+        {
+            RCLCPP_WARN_STREAM_THROTTLE(this->get_logger(), *this->get_clock(), 4000, "Feature backend " << featureBackendName_ << " failed: " << e.what());
+            return nullptr;
+        }
+    }
+
+    bool RgbdSlamNode::trackFrame(const sensor_msgs::msg::Image::ConstSharedPtr msgImage,
+                                  const sensor_msgs::msg::Image::ConstSharedPtr msgSecondImage,
+                                  const std::shared_ptr<PreparedFrame> &prepared,
+                                  TrackedFrame &trackedFrame)
+    {
+        auto interface = currentInterface();
+        if (!interface)
+            return false;
         Sophus::SE3f Tcw;
-        if (interface_->trackRGBD(msgRGB, msgD, Tcw))
+        bool tracked;
+        // before the track call, the keyframe of the frame can reach the map before it returns.
+        if (occupancy_)
+            occupancy_->recordDepth(msgImage, msgSecondImage);
+        const double trackStart = steadySeconds();
+        switch (sensor_)
+        {
+        case ORB_SLAM3::System::IMU_RGBD:
+            tracked = interface->trackRGBDi(msgImage, msgSecondImage, Tcw, prepared);
+            break;
+        case ORB_SLAM3::System::STEREO:
+            tracked = interface->trackStereo(msgImage, msgSecondImage, Tcw, prepared);
+            break;
+        case ORB_SLAM3::System::IMU_STEREO:
+            tracked = interface->trackStereoi(msgImage, msgSecondImage, Tcw, prepared);
+            break;
+        case ORB_SLAM3::System::MONOCULAR:
+            tracked = interface->trackMonocular(msgImage, Tcw, prepared);
+            break;
+        case ORB_SLAM3::System::IMU_MONOCULAR:
+            tracked = interface->trackMonoculari(msgImage, Tcw, prepared);
+            break;
+        default:
+            tracked = interface->trackRGBD(msgImage, msgSecondImage, Tcw, prepared);
+            break;
+        }
+        if (overloadController_)
+        {
+            const double now = steadySeconds();
+            overloadController_->recordTrack(now - trackStart, tracked, interface->getTrackedMapPoints(), now);
+        }
+        if (tracked)
         {
             isTracked_ = true;
-            if (publish_tf_)
+            if (posePredictor_)
             {
+                PredictionError error;
+                if (posePredictor_->correct(typeConversion_.stampToSec(msgImage->header.stamp), interface->getLatestTrackedPose(), error))
+                {
+                    RCLCPP_DEBUG_STREAM(this->get_logger(), "TF prediction error over " << error.horizon << " s: " << error.translation
+                                                                << " m " << error.rotation << " rad");
+                }
+            }
+            else if (publish_tf_)
+            {
+                // the tracking thread builds its own transform, only map -> odom comes from the odometry callback.
                 if (no_odometry_mode_)
-                    interface_->getDirectMapToRobotTF(msgRGB->header, tfMapOdom_);
-                tfBroadcaster_->sendTransform(tfMapOdom_);
+                    interface->getDirectMapToRobotTF(msgImage->header, trackedFrame.tf);
+                else
+                {
+                    std::lock_guard<std::mutex> lock(tfMapOdomMutex_);
+                    trackedFrame.tf = tfMapOdom_;
+                }
+                trackedFrame.hasTransform = true;
             }
             ++frequency_tracker_count_;
+            ++trackedFramesTotal_;
             // publishMapPointCloud();
             // std::thread(&RgbdSlamNode::publishMapPointCloud, this).detach();
+            return true;
         }
+        return false;
     }
 
-    void RgbdSlamNode::publishMapPointCloud()
+    void RgbdSlamNode::startPipeline()
+    {
+        frameQueue_ = std::make_unique<SPSCRingBuffer<CameraFrame>>(std::max(frameQueueSize_, 1));
+        latestFrame_ = std::make_unique<LatestValueSlot<CameraFrame>>();
+        publishQueue_ = std::make_unique<SPSCRingBuffer<TrackedFrame>>(std::max(frameQueueSize_, 1));
+        pipelineRunning_ = true;
+        trackingThread_ = std::thread(&RgbdSlamNode::trackingLoop, this);
+        publishThread_ = std::thread(&RgbdSlamNode::publishLoop, this);
+        RCLCPP_INFO_STREAM(this->get_logger(), "Tracking pipeline started. Queue size: " << (frameDropPolicy_ == FrameDropPolicy::FIFO ? frameQueue_->capacity() : 1)
+                                                   << " Drop policy: " << (frameDropPolicy_ == FrameDropPolicy::FIFO ? "fifo" : "newest"));
+    }
+
+    size_t RgbdSlamNode::pendingFrames() const
+    {
+        if (frameDropPolicy_ == FrameDropPolicy::NEWEST_WINS)
+            return latestFrame_->empty() ? 0 : 1;
+        return frameQueue_->size();
+    }
+
+    void RgbdSlamNode::stopPipeline()
+    {
+        if (!pipelineRunning_)
+            return;
+        pipelineRunning_ = false;
+        frameWakeCondition_.notify_all();
+        publishWakeCondition_.notify_all();
+        if (trackingThread_.joinable())
+            trackingThread_.join();
+        if (publishThread_.joinable())
+            publishThread_.join();
+    }
+
+    void RgbdSlamNode::trackingLoop()
     {
-        if (isTracked_)
+        const int tid = currentThreadId();
+        trackingThreadId_ = tid;
+        std::vector<int> cpus;
+        if (!trackingCpus_.empty())
+        {
+            if (!parseCpuSet(trackingCpus_, cpus))
+                RCLCPP_WARN_STREAM(this->get_logger(), "Malformed tracking_cpus " << trackingCpus_ << ", ignoring it.");
+            else if (!setCurrentThreadAffinity(cpus))
+                RCLCPP_WARN_STREAM(this->get_logger(), "Could not pin the tracking thread to CPUs " << trackingCpus_);
+        }
+        if (trackingPriority_ != 0 && !setThreadPriority(tid, trackingPriority_))
+            RCLCPP_WARN_STREAM(this->get_logger(), "Could not set the tracking thread priority to " << trackingPriority_
+                                                       << ", SCHED_FIFO needs CAP_SYS_NICE or an rtprio limit.");
+        setThreadName(tid, "orb_tracking");
+        while (pipelineRunning_)
         {
-            // Using high resolution clock to measure time
-            auto start = std::chrono::high_resolution_clock::now();
+            CameraFrame frame;
+            bool hasFrame;
+            if (frameDropPolicy_ == FrameDropPolicy::NEWEST_WINS)
+                hasFrame = latestFrame_->take(frame);
+            else
+                hasFrame = frameQueue_->pop(frame);
 
-            sensor_msgs::msg::PointCloud2 mapPCL;
+            if (!hasFrame)
+            {
+                // the timeout bounds the latency of a missed notification.
+                std::unique_lock<std::mutex> lock(frameWakeMutex_);
+                frameWakeCondition_.wait_for(lock, std::chrono::milliseconds(10), [this]()
+                                             { return !pipelineRunning_ || pendingFrames() > 0; });
+                continue;
+            }
 
-            auto t1 = std::chrono::high_resolution_clock::now();
-            auto time_create_mapPCL = std::chrono::duration_cast<std::chrono::duration<double>>(t1 - start).count();
-            RCLCPP_DEBUG_STREAM(this->get_logger(), "Time to create mapPCL object: " << time_create_mapPCL << " seconds");
+            TrackedFrame trackedFrame;
+            if (trackFrame(frame.image, frame.secondImage, frame.prepared, trackedFrame) && trackedFrame.hasTransform)
+            {
+                // if the publisher is behind, the transform is superseded by the next tracked frame anyway.
+                publishQueue_->push(std::move(trackedFrame));
+                publishWakeCondition_.notify_one();
+            }
+        }
+    }
 
-            interface_->getCurrentMapPoints(mapPCL);
+    void RgbdSlamNode::publishLoop()
+    {
+        while (pipelineRunning_)
+        {
+            TrackedFrame trackedFrame;
+            if (!publishQueue_->pop(trackedFrame))
+            {
+                std::unique_lock<std::mutex> lock(publishWakeMutex_);
+                publishWakeCondition_.wait_for(lock, std::chrono::milliseconds(10), [this]()
+                                               { return !pipelineRunning_ || !publishQueue_->empty(); });
+                continue;
+            }
+            ScopedTimer timer(*tfPublishLatency_);
+            tfBroadcaster_->sendTransform(trackedFrame.tf);
+        }
+    }
 
-            if (mapPCL.data.size() == 0)
+    void RgbdSlamNode::publishPredictedTF()
+    {
+        const rclcpp::Time now = this->now();
+        const double stamp = now.seconds();
+        geometry_msgs::msg::TransformStamped tf;
+        Eigen::Affine3d transform;
+        if (no_odometry_mode_)
+        {
+            // nothing past the horizon, consumers see the transform age out while tracking is lost.
+            if (!posePredictor_->predict(stamp, transform))
                 return;
+            tf.child_frame_id = robot_base_frame_id_;
+        }
+        else
+        {
+            // the odometry moves the base between the frames, map -> odom only changes with them.
+            if (!posePredictor_->mapToOdom(transform))
+                return;
+            tf.child_frame_id = odom_frame_id_;
+        }
+        ScopedTimer timer(*tfPublishLatency_);
+        tf.header.stamp = now;
+        tf.header.frame_id = global_frame_;
+        tf.transform = tf2::eigenToTransform(transform).transform;
+        tfBroadcaster_->sendTransform(tf);
+    }
 
-            auto t2 = std::chrono::high_resolution_clock::now();
-            auto time_get_map_points = std::chrono::duration_cast<std::chrono::duration<double>>(t2 - t1).count();
-            RCLCPP_DEBUG_STREAM(this->get_logger(), "Time to get current map points: " << time_get_map_points << " seconds");
-
-            mapPointsPub_->publish(mapPCL);
-            auto t3 = std::chrono::high_resolution_clock::now();
-            auto time_publish_map_points = std::chrono::duration_cast<std::chrono::duration<double>>(t3 - t2).count();
-            RCLCPP_DEBUG_STREAM(this->get_logger(), "Time to publish map points: " << time_publish_map_points << " seconds");
-            RCLCPP_DEBUG_STREAM(this->get_logger(), "=======================");
+    void RgbdSlamNode::publishMapPointCloud()
+    {
+        auto interface = currentInterface();
+        if (interface && isTracked_)
+        {
+            // the cloud is only rebuilt when the map changed.
+            if (mapEventsPub_)
+            {
+                const uint64_t version = interface->mapVersion();
+                if (version == lastMapPointsVersion_)
+                    return;
+                lastMapPointsVersion_ = version;
+            }
+            ScopedTimer timer(*mapPointsPublishLatency_);
+            interface->getCurrentMapPoints(mapPointsScratch_);
 
-            // Calculate the time taken for each line
+            if (mapPointsScratch_.data.size() == 0)
+                return;
 
-            // Print the time taken for each line
+            mapPointsPub_->publish(mapPointsScratch_);
         }
     }
 
     void RgbdSlamNode::publishMapData()
     {
-        if (isTracked_)
+        auto interface = currentInterface();
+        if (interface && isTracked_)
         {
-            auto start = std::chrono::high_resolution_clock::now();
+            ScopedTimer timer(*mapDataPublishLatency_);
             RCLCPP_DEBUG_STREAM(this->get_logger(), "Publishing map data");
             RCLCPP_INFO_STREAM(this->get_logger(), "Current ORB-SLAM3 tracking frequency: " << frequency_tracker_count_ / std::chrono::duration_cast<std::chrono::duration<double>>(std::chrono::high_resolution_clock::now() - frequency_tracker_clock_).count() << " frames / sec");
             frequency_tracker_clock_ = std::chrono::high_resolution_clock::now();
             frequency_tracker_count_ = 0;
+            auto ingestionStats = interface->getIngestionStats();
+            if (ingestionStats.frames > 0)
+            {
+                RCLCPP_DEBUG_STREAM(this->get_logger(), "Image bytes per frame shared: " << ingestionStats.bytesShared / ingestionStats.frames
+                                                            << " copied: " << ingestionStats.bytesCopied / ingestionStats.frames);
+            }
+            if (trackingPipeline_)
+            {
+                RCLCPP_DEBUG_STREAM(this->get_logger(), "Frame queue depth: " << pendingFrames() << " (max " << maxFrameQueueDepth_.exchange(0)
+                                                           << ") received: " << framesReceived_ << " dropped: " << framesDropped_);
+            }
+            // the keyframes far from the robot go to the output cache before the map data is built. Without the cache,
+            // or while the camera stays within a voxel of an unchanged map, it returns at once.
+            interface->updateResidency();
+            if (mapEventsPub_)
+            {
+                const uint64_t version = interface->mapVersion();
+                if (version == lastMapDataVersion_)
+                    return;
+                lastMapDataVersion_ = version;
+            }
             // publish the map data (current active keyframes etc)
-            slam_msgs::msg::MapData mapDataMsg;
-            interface_->mapDataToMsg(mapDataMsg, true, false);
-            mapDataPub_->publish(mapDataMsg);
-            auto t1 = std::chrono::high_resolution_clock::now();
-            auto time_publishMapData = std::chrono::duration_cast<std::chrono::duration<double>>(t1 - start).count();
-            RCLCPP_DEBUG_STREAM(this->get_logger(), "Time to create mapdata: " << time_publishMapData << " seconds");
-            RCLCPP_INFO_STREAM(this->get_logger(), "*************************");
+            interface->mapDataToMsg(mapDataScratch_, true, false);
+            if (publishMapDataDelta_)
+            {
+                // only the keyframes added, removed or moved since the last publish go on the wire.
+                if (mapDataDeltaEncoder_->encode(mapDataScratch_.graph, mapDataDeltaScratch_))
+                {
+                    mapDataDeltaScratch_.header.frame_id = global_frame_;
+                    mapDataDeltaScratch_.header.stamp = this->now();
+                    mapDataDeltaPub_->publish(mapDataDeltaScratch_);
+                }
+            }
+            else
+                mapDataPub_->publish(mapDataScratch_);
+            RCLCPP_DEBUG_STREAM(this->get_logger(), "*************************");
         }
     }
 
+    void RgbdSlamNode::mapEventsLoop()
+    {
+        while (mapEventsRunning_)
+        {
+            // one reference per pass, load_map waits for it to be released.
+            auto interface = currentInterface();
+            MapEventQueue *queue = interface ? interface->mapEvents() : nullptr;
+            if (!queue)
+            {
+                // load_map is swapping the systems, the next one gets its queue from applyMapEvents.
+                interface.reset();
+                std::unique_lock<std::mutex> lock(mapEventsMutex_);
+                mapEventsCondition_.wait_for(lock, std::chrono::milliseconds(100), [this]()
+                                             { return !mapEventsRunning_; });
+                continue;
+            }
+            slam_msgs::msg::MapEvents msg;
+            MapEvent event;
+            while (queue->pop(event))
+            {
+                // one message per run of consecutive events, so that a gap is visible to the subscribers.
+                if (!msg.events.empty() && event.sequence != msg.first_sequence + msg.events.size())
+                {
+                    publishMapEvents(msg);
+                    msg.events.clear();
+                }
+                if (msg.events.empty())
+                    msg.first_sequence = event.sequence;
+                slam_msgs::msg::MapEvent eventMsg;
+                eventMsg.type = static_cast<uint8_t>(event.type);
+                eventMsg.map_id = event.mapId;
+                eventMsg.keyframe_id = event.keyFrameId;
+                msg.events.push_back(eventMsg);
+            }
+            if (!msg.events.empty())
+            {
+                publishMapEvents(msg);
+                continue;
+            }
+            // the timeout bounds the latency of a missed notification.
+            std::unique_lock<std::mutex> lock(mapEventsMutex_);
+            mapEventsCondition_.wait_for(lock, std::chrono::milliseconds(100), [this, queue]()
+                                         { return !mapEventsRunning_ || queue->size() > 0; });
+        }
+    }
+
+    void RgbdSlamNode::publishMapEvents(slam_msgs::msg::MapEvents &msg)
+    {
+        msg.header.frame_id = global_frame_;
+        msg.header.stamp = this->now();
+        mapEventsPub_->publish(msg);
+        mapEventsPublished_ += msg.events.size();
+    }
+
+    void RgbdSlamNode::applyMapEvents(ORBSLAM3Interface &interface)
+    {
+        if (!mapEventsPub_)
+            return;
+        interface.enableMapEvents(static_cast<size_t>(std::max(1, mapEventQueueSize_)), [this]()
+                                  { mapEventsCondition_.notify_one(); });
+    }
+
+    void RgbdSlamNode::applyThreadLayout(ORBSLAM3Interface &interface)
+    {
+        interface.setWorkerPool(workerPool_);
+        std::string message;
+        if (!interface.applyThreadLayout(threadLayout_, message))
+            RCLCPP_WARN_STREAM(this->get_logger(), message);
+        for (const auto &thread : interface.orbThreads())
+            RCLCPP_INFO_STREAM(this->get_logger(), thread.first << " (" << thread.second << "): " << describeThread(thread.second));
+    }
+
+    std::shared_ptr<rclcpp::executors::MultiThreadedExecutor> RgbdSlamNode::makeExecutor()
+    {
+        std::vector<int> cpus;
+        if (!executorCpus_.empty())
+        {
+            if (!parseCpuSet(executorCpus_, cpus))
+                RCLCPP_WARN_STREAM(this->get_logger(), "Malformed executor_cpus " << executorCpus_ << ", ignoring it.");
+            else if (!setCurrentThreadAffinity(cpus))
+                RCLCPP_WARN_STREAM(this->get_logger(), "Could not pin the executor to CPUs " << executorCpus_);
+        }
+        const size_t threads = executorThreads_ > 0 ? static_cast<size_t>(executorThreads_) : 0;
+        RCLCPP_INFO_STREAM(this->get_logger(), "Executor threads: " << (threads > 0 ? std::to_string(threads) : std::string("one per core"))
+                                                                    << (cpus.empty() ? std::string() : ", CPUs " + formatCpuSet(cpus)));
+        return std::make_shared<rclcpp::executors::MultiThreadedExecutor>(rclcpp::ExecutorOptions(), threads);
+    }
+
+    void RgbdSlamNode::updateNodeMetrics()
+    {
+        auto interface = currentInterface();
+        auto now = std::chrono::steady_clock::now();
+        const double elapsed = std::chrono::duration<double>(now - lastNodeMetricsUpdate_).count();
+        const uint64_t trackedFrames = trackedFramesTotal_;
+        if (elapsed > 0.0)
+            metrics_->gauge("tracking_rate", "Tracked frames per second.").set((trackedFrames - lastTrackedFramesTotal_) / elapsed);
+        lastTrackedFramesTotal_ = trackedFrames;
+        lastNodeMetricsUpdate_ = now;
+        metrics_->gauge("frames_tracked", "Frames tracked since start.").set(trackedFrames);
+        if (trackingPipeline_)
+        {
+            metrics_->gauge("frame_queue_depth", "Frames waiting to be tracked.").set(pendingFrames());
+            metrics_->gauge("publish_queue_depth", "Tracked transforms waiting to be published.").set(publishQueue_->size());
+            metrics_->gauge("frames_received", "Frames received since start.").set(framesReceived_);
+            metrics_->gauge("frames_dropped", "Frames dropped by the frame queue since start.").set(framesDropped_);
+        }
+        if (overloadController_)
+        {
+            metrics_->gauge("overload_headroom", "1 - track latency / tracked frame period, negative when tracking falls behind.").set(overloadController_->headroom());
+            metrics_->gauge("overload_frame_skip", "Camera frames skipped per tracked frame.").set(overloadController_->frameSkip());
+            metrics_->gauge("overload_decision", "0 full rate, 1 skipping, 2 fast motion, 3 no motion estimate, 4 tracking quality.").set(static_cast<int>(overloadController_->decision()));
+            metrics_->gauge("frames_skipped_overload", "Frames skipped by the overload controller since start.").set(framesSkipped_);
+        }
+        if (mapEventsPub_)
+        {
+            metrics_->gauge("map_events_published", "Map events published on map_events since start.").set(mapEventsPublished_);
+            if (auto *queue = interface ? interface->mapEvents() : nullptr)
+                metrics_->gauge("map_events_dropped", "Map events dropped by the full event queue of the current map.").set(queue->dropped());
+        }
+        if (occupancy_)
+            occupancy_->updateMetrics(*metrics_);
+        if (posePredictor_)
+        {
+            const PredictionStats stats = posePredictor_->stats();
+            metrics_->gauge("tf_prediction_error_translation", "Distance (m) between the predicted and the tracked pose of the last tracked frame.").set(stats.last.translation);
+            metrics_->gauge("tf_prediction_error_rotation", "Angle (rad) between the predicted and the tracked pose of the last tracked frame.").set(stats.last.rotation);
+            metrics_->gauge("tf_prediction_rms_translation", "RMS of the translation prediction error since start (m).").set(stats.rmsTranslation);
+            metrics_->gauge("tf_prediction_rms_rotation", "RMS of the rotation prediction error since start (rad).").set(stats.rmsRotation);
+            metrics_->gauge("tf_predictions_checked", "Tracked frames compared with their predicted pose since start.").set(stats.count);
+        }
+        if (interface)
+            interface->updateMapMetrics();
+    }
+
+    void RgbdSlamNode::extendDiagnostics(diagnostic_msgs::msg::DiagnosticStatus &status, std::vector<diagnostic_msgs::msg::DiagnosticStatus> &statuses)
+    {
+        if (overloadController_)
+        {
+            diagnostic_msgs::msg::KeyValue keyValue;
+            keyValue.key = "overload decision";
+            keyValue.value = OverloadController::decisionName(overloadController_->decision());
+            status.values.push_back(keyValue);
+            const int frameSkip = overloadController_->frameSkip();
+            if (frameSkip > 0 && status.level == diagnostic_msgs::msg::DiagnosticStatus::OK)
+                status.message += ", overloaded: tracking 1 in " + std::to_string(frameSkip + 1) + " frames";
+        }
+
+        // the thread layout as the kernel has it, to check the pinning took.
+        diagnostic_msgs::msg::DiagnosticStatus threads;
+        threads.name = std::string(this->get_name()) + ": threads";
+        threads.hardware_id = status.hardware_id;
+        threads.level = diagnostic_msgs::msg::DiagnosticStatus::OK;
+        threads.message = "Thread layout";
+        auto addThread = [&threads](const std::string &key, const std::string &value)
+        {
+            diagnostic_msgs::msg::KeyValue keyValue;
+            keyValue.key = key;
+            keyValue.value = value;
+            threads.values.push_back(keyValue);
+        };
+        const int trackingThreadId = trackingThreadId_;
+        if (trackingThreadId > 0)
+            addThread("orb_tracking", describeThread(trackingThreadId));
+        auto interface = currentInterface();
+        for (const auto &thread : interface ? interface->orbThreads() : std::vector<std::pair<std::string, int>>())
+            addThread(thread.first, describeThread(thread.second));
+        addThread("executor", (executorThreads_ > 0 ? std::to_string(executorThreads_) : std::string("one per core")) + " threads" +
+                                  (executorCpus_.empty() ? std::string() : ", cpus " + executorCpus_));
+
+        statuses.push_back(threads);
+    }
+
     void RgbdSlamNode::getMapServer(std::shared_ptr<rmw_request_id_t> request_header,
                                     std::shared_ptr<slam_msgs::srv::GetMap::Request> request,
                                     std::shared_ptr<slam_msgs::srv::GetMap::Response> response)
     {
+        auto interface = currentInterface();
+        if (!interface)
+        {
+            RCLCPP_WARN(this->get_logger(), "GetMap service called while a map is being loaded, the response is empty.");
+            return;
+        }
         RCLCPP_INFO(this->get_logger(), "GetMap2 service called.");
-        slam_msgs::msg::MapData mapDataMsg;
-        interface_->mapDataToMsg(mapDataMsg, false, request->tracked_points, request->kf_id_for_landmarks);
-        response->data = mapDataMsg;
+        ScopedTimer timer(*getMapServiceLatency_);
+        // built straight into the response.
+        interface->mapDataToMsg(response->data, false, request->tracked_points, request->kf_id_for_landmarks);
+    }
+
+    void RgbdSlamNode::getPackedMapServer(std::shared_ptr<rmw_request_id_t> request_header,
+                                          std::shared_ptr<slam_msgs::srv::GetPackedMap::Request> request,
+                                          std::shared_ptr<slam_msgs::srv::GetPackedMap::Response> response)
+    {
+        auto interface = currentInterface();
+        if (!interface)
+        {
+            response->success = false;
+            response->message = "A map is being loaded.";
+            return;
+        }
+        ScopedTimer timer(*getPackedMapServiceLatency_);
+        slam_msgs::msg::MapData mapData;
+        interface->mapDataToMsg(mapData, false, request->tracked_points, request->kf_id_for_landmarks);
+        PointPacking packing;
+        packing.encoding = request->encoding;
+        packing.compression = request->compression;
+        packing.resolution = request->resolution > 0.0 ? request->resolution : packedPointsResolution_;
+        packing.compressionLevel = packedPointsCompressionLevel_;
+        response->success = interface->getTypeConversionPtr()->mapDataToPacked(mapData, packing, response->data);
+        if (!response->success)
+            response->message = "Unknown encoding or compression, or the compression failed.";
+        else
+            RCLCPP_DEBUG_STREAM(this->get_logger(), "Packed map data: " << response->data.points.count << " points in "
+                                                                        << response->data.points.data.size() << " bytes.");
+    }
+
+    void RgbdSlamNode::mapDataSnapshotServer(std::shared_ptr<rmw_request_id_t> request_header,
+                                             std::shared_ptr<std_srvs::srv::Trigger::Request> request,
+                                             std::shared_ptr<std_srvs::srv::Trigger::Response> response)
+    {
+        RCLCPP_INFO(this->get_logger(), "MapData snapshot requested.");
+        mapDataDeltaEncoder_->requestSnapshot();
+        response->success = true;
+        response->message = "The next map_data_delta message is a snapshot.";
     }
 
     void RgbdSlamNode::getMapPointsInViewServer(std::shared_ptr<rmw_request_id_t> request_header,
                         std::shared_ptr<slam_msgs::srv::GetLandmarksInView::Request> request,
                         std::shared_ptr<slam_msgs::srv::GetLandmarksInView::Response> response)
     {
+        auto interface = currentInterface();
+        if (!interface)
+        {
+            RCLCPP_WARN(this->get_logger(), "GetMapPointsInView service called while a map is being loaded, the response is empty.");
+            return;
+        }
         RCLCPP_INFO(this->get_logger(), "GetMapPointsInView service called.");
+        ScopedTimer timer(*landmarksInViewServiceLatency_);
         std::vector<slam_msgs::msg::MapPoint> landmarks;
         std::vector<ORB_SLAM3::MapPoint*> points;
-        interface_->mapPointsVisibleFromPose(request->pose, points, 1000, 5.0, 2.0);
+        interface->mapPointsVisibleFromPose(request->pose, points, landmarksInViewMaxLandmarks_,
+                                            landmarksInViewMaxDistance_, landmarksInViewMaxAngle_);
+        RCLCPP_DEBUG_STREAM(this->get_logger(), "Visible map points: " << points.size() << " from (" << request->pose.position.x << ", "
+                                                    << request->pose.position.y << ", " << request->pose.position.z << ")");
         // Populate the pose of the points vector into the ros message
+        landmarks.reserve(points.size());
         for (const auto& point : points) {
             slam_msgs::msg::MapPoint landmark;
             Eigen::Vector3f landmark_position = point->GetWorldPos();
-            auto position = interface_->getTypeConversionPtr()->vector3fORBToROS(landmark_position);
+            auto position = interface->getTypeConversionPtr()->vector3fORBToROS(landmark_position);
             landmark.position.x = position.x();
             landmark.position.y = position.y();
             landmark.position.z = position.z();
             landmarks.push_back(landmark);
         }
-        response->map_points = landmarks;
-        auto cloud = interface_->getTypeConversionPtr()->MapPointsToPCL(points);
-        visibleLandmarksPub_->publish(cloud);
-        
-        // Convert the pose in request to PoseStamped and publish
-        geometry_msgs::msg::PoseStamped pose_stamped;
-        pose_stamped.header.stamp = this->now();
-        pose_stamped.header.frame_id = "map"; // Assuming the frame is "map", adjust if needed
-        pose_stamped.pose = request->pose;
-        
-        // Publish the PoseStamped
-        visibleLandmarksPose_->publish(pose_stamped);
+        response->map_points = std::move(landmarks);
+        // the debug cloud and pose are only built for someone listening.
+        if (visibleLandmarksPub_->get_subscription_count() > 0)
+            visibleLandmarksPub_->publish(interface->getTypeConversionPtr()->MapPointsToPCL(points));
+        if (visibleLandmarksPose_->get_subscription_count() > 0)
+        {
+            geometry_msgs::msg::PoseStamped pose_stamped;
+            pose_stamped.header.stamp = this->now();
+            pose_stamped.header.frame_id = global_frame_;
+            pose_stamped.pose = request->pose;
+            visibleLandmarksPose_->publish(pose_stamped);
+        }
+    }
+
+    void RgbdSlamNode::getLandmarksInViewBatchServer(std::shared_ptr<rmw_request_id_t> request_header,
+                                                     std::shared_ptr<slam_msgs::srv::GetLandmarksInViewBatch::Request> request,
+                                                     std::shared_ptr<slam_msgs::srv::GetLandmarksInViewBatch::Response> response)
+    {
+        auto interface = currentInterface();
+        if (!interface)
+        {
+            response->success = false;
+            response->message = "A map is being loaded.";
+            return;
+        }
+        ScopedTimer timer(*landmarksInViewBatchServiceLatency_);
+        std::vector<Eigen::Affine3d> poses;
+        poses.reserve(request->poses.size());
+        for (const auto &pose : request->poses)
+        {
+            Eigen::Affine3d cameraPose;
+            tf2::fromMsg(pose, cameraPose);
+            poses.push_back(cameraPose);
+        }
+        const float maxDistance = request->max_distance > 0.0f ? request->max_distance : static_cast<float>(landmarksInViewMaxDistance_);
+        const float maxAngle = request->max_angle > 0.0f ? request->max_angle : static_cast<float>(landmarksInViewMaxAngle_);
+        ORBSLAM3Interface::LandmarksInView landmarks;
+        response->success = interface->landmarksInViewBatch(poses, request->camera_index, request->max_landmarks,
+                                                            maxDistance, maxAngle, landmarks, response->message);
+        if (!response->success)
+        {
+            RCLCPP_WARN_STREAM(this->get_logger(), "GetLandmarksInViewBatch: " << response->message);
+            return;
+        }
+        response->points = std::move(landmarks.points);
+        response->index_counts = std::move(landmarks.indexCounts);
+        response->indices = std::move(landmarks.indices);
+    }
+
+    void RgbdSlamNode::applyOutputCache(ORBSLAM3Interface &interface)
+    {
+        if (outputCacheLimits_.keyFrames == 0 && outputCacheLimits_.mapPoints == 0)
+            return;
+        // the previous interface keeps its store until it is destroyed, so the paths must differ.
+        auto limits = outputCacheLimits_;
+        limits.storePath = outputCachePath_ + "_" + std::to_string(interfaceGeneration_++) + ".bin";
+        if (!interface.setOutputCache(limits))
+            RCLCPP_ERROR_STREAM(this->get_logger(), "Could not open the output cache " << limits.storePath << ", reading every keyframe live.");
+    }
+
+    std::shared_ptr<ORBSLAM3Interface> RgbdSlamNode::makeInterface(const std::string &settingsFile)
+    {
+        auto interface = std::make_shared<ORB_SLAM3_Wrapper::ORBSLAM3Interface>(strVocFile_, settingsFile,
+                                                                                sensor_, bUseViewer_, rosViz_, robot_x_,
+                                                                                robot_y_, global_frame_, odom_frame_id_, robot_base_frame_id_, metrics_);
+        applyOutputCache(*interface);
+        applyMapEvents(*interface);
+        applyThreadLayout(*interface);
+        interface->setMergeHandling(mergeHandling_, mergeBlendWindow_);
+        return interface;
+    }
+
+    std::shared_ptr<ORBSLAM3Interface> RgbdSlamNode::installInterface(const std::shared_ptr<ORBSLAM3Interface> &loaded)
+    {
+        // the loaded map has its own frame until the robot relocalizes in it.
+        if (posePredictor_)
+            posePredictor_->reset();
+        // the versions of the loaded map start over, publish it whatever its version.
+        lastMapDataVersion_ = std::numeric_limits<uint64_t>::max();
+        lastMapPointsVersion_ = std::numeric_limits<uint64_t>::max();
+        if (occupancy_)
+            occupancy_->reset();
+        if (fleet_)
+            fleet_->reset(*loaded);
+        // the next frame relocalizes in the loaded Atlas.
+        isTracked_ = false;
+        return std::atomic_exchange(&interface_, loaded);
     }
 }
+
+#include "rclcpp_components/register_node_macro.hpp"
+
+RCLCPP_COMPONENTS_REGISTER_NODE(ORB_SLAM3_Wrapper::RgbdSlamNode)
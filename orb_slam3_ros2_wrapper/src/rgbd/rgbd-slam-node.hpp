@@ -11,6 +11,11 @@
 #include <algorithm>
 #include <fstream>
 #include <chrono>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <limits>
 
 #include <rclcpp/rclcpp.hpp>
 #include <sensor_msgs/msg/image.hpp>
@@ -30,30 +35,142 @@
 #include <message_filters/sync_policies/approximate_time.h>
 
 #include <slam_msgs/msg/map_data.hpp>
+#include <slam_msgs/msg/map_data_delta.hpp>
+#include <slam_msgs/msg/map_events.hpp>
 #include <slam_msgs/srv/get_map.hpp>
 #include <slam_msgs/srv/get_landmarks_in_view.hpp>
+#include <slam_msgs/srv/get_landmarks_in_view_batch.hpp>
+#include <slam_msgs/srv/get_packed_map.hpp>
+#include <std_srvs/srv/trigger.hpp>
 
 #include "orb_slam3_ros2_wrapper/type_conversion.hpp"
 #include "orb_slam3_ros2_wrapper/orb_slam3_interface.hpp"
+#include "orb_slam3_ros2_wrapper/spsc_ring_buffer.hpp"
+#include "orb_slam3_ros2_wrapper/latest_value_slot.hpp"
+#include "orb_slam3_ros2_wrapper/map_data_delta.hpp"
+#include "orb_slam3_ros2_wrapper/instrumentation.hpp"
+#include "orb_slam3_ros2_wrapper/map_archive.hpp"
+#include "orb_slam3_ros2_wrapper/feature_backend.hpp"
+#include "orb_slam3_ros2_wrapper/overload_controller.hpp"
+#include "orb_slam3_ros2_wrapper/pose_predictor.hpp"
+
+#include "node-diagnostics.hpp"
+#include "map-streaming.hpp"
+#include "map-persistence.hpp"
+#include "pose-hints.hpp"
+#include "occupancy-mapping.hpp"
+#include "fleet-descriptor-stream.hpp"
 
 namespace ORB_SLAM3_Wrapper
 {
+    /**
+     * @brief ROS 2 node around ORB_SLAM3 for the RGB-D, stereo and monocular sensors, with or without IMU.
+     * @note The class keeps its historical name, it is the registered component.
+     */
     class RgbdSlamNode : public rclcpp::Node
     {
     public:
         RgbdSlamNode(const std::string &strVocFile,
                      const std::string &strSettingsFile,
-                     ORB_SLAM3::System::eSensor sensor);
+                     ORB_SLAM3::System::eSensor sensor,
+                     const rclcpp::NodeOptions &options = rclcpp::NodeOptions());
+
+        /**
+         * @brief Component constructor. The vocabulary, settings and sensor are read from the
+         * vocabulary_file_path, settings_file_path and sensor_type parameters.
+         * @note Load it in the same container as the camera driver with use_intra_process_comms
+         * to hand the images over without serialization.
+         */
+        explicit RgbdSlamNode(const rclcpp::NodeOptions &options);
         ~RgbdSlamNode();
 
+        /**
+         * @brief Parses a sensor_type parameter value (rgbd, rgbd_inertial, stereo, stereo_inertial, mono, mono_inertial).
+         * @return False if the value is unknown.
+         */
+        static bool sensorFromString(const std::string &sensorType, ORB_SLAM3::System::eSensor &sensor);
+
+        static std::string nodeNameForSensor(ORB_SLAM3::System::eSensor sensor);
+
+        /**
+         * @brief Executor with executor_threads threads (one per core if 0), started on the executor_cpus CPU set.
+         * @note The executor threads are created by spin, on the calling thread: it is left pinned to
+         * executor_cpus so that they inherit the set. A component container uses its own executor instead.
+         */
+        std::shared_ptr<rclcpp::executors::MultiThreadedExecutor> makeExecutor();
+
     private:
+        void initialize(const std::string &strVocFile,
+                        const std::string &strSettingsFile,
+                        ORB_SLAM3::System::eSensor sensor);
+
         typedef message_filters::sync_policies::ApproximateTime<sensor_msgs::msg::Image, sensor_msgs::msg::Image> approximate_sync_policy;
 
+        /**
+         * @brief A frame waiting to be tracked. The second image is the depth (RGB-D),
+         * the right image (stereo) or null (monocular).
+         */
+        struct CameraFrame
+        {
+            sensor_msgs::msg::Image::ConstSharedPtr image;
+            sensor_msgs::msg::Image::ConstSharedPtr secondImage;
+            // gray images of the feature backend, converted while the previous frame is tracked.
+            std::shared_ptr<PreparedFrame> prepared;
+        };
+
+        /**
+         * @brief Output of the tracking stage waiting to be published.
+         */
+        struct TrackedFrame
+        {
+            bool hasTransform = false;
+            geometry_msgs::msg::TransformStamped tf;
+        };
+
+        enum class FrameDropPolicy
+        {
+            NEWEST_WINS,
+            FIFO
+        };
+
         // ROS 2 Callbacks.
+        // The images are taken as ConstSharedPtr, message_filters deep copies the message for a non-const callback argument.
         void ImuCallback(const sensor_msgs::msg::Imu::SharedPtr msgIMU);
         void OdomCallback(const nav_msgs::msg::Odometry::SharedPtr msgOdom);
-        void RGBDCallback(const sensor_msgs::msg::Image::SharedPtr msgRGB,
-                          const sensor_msgs::msg::Image::SharedPtr msgD);
+        void ImagesCallback(const sensor_msgs::msg::Image::ConstSharedPtr msgImage,
+                            const sensor_msgs::msg::Image::ConstSharedPtr msgSecondImage);
+        void MonoCallback(const sensor_msgs::msg::Image::ConstSharedPtr msgImage);
+
+        /**
+         * @brief Tracks a frame with the track function of the sensor and fills the transform to be published.
+         * @param msgSecondImage Depth, right image or null, see CameraFrame.
+         * @param prepared From prepareFrame, may be null.
+         * @return True if the frame was tracked.
+         */
+        bool trackFrame(const sensor_msgs::msg::Image::ConstSharedPtr msgImage,
+                        const sensor_msgs::msg::Image::ConstSharedPtr msgSecondImage,
+                        const std::shared_ptr<PreparedFrame> &prepared,
+                        TrackedFrame &trackedFrame);
+
+        /**
+         * @brief Starts the conversion of the frame on the feature backend.
+         * @return Null without a feature backend or if the images are already gray.
+         */
+        std::shared_ptr<PreparedFrame> prepareFrame(const sensor_msgs::msg::Image::ConstSharedPtr &msgImage,
+                                                    const sensor_msgs::msg::Image::ConstSharedPtr &msgSecondImage);
+
+        /**
+         * @brief Pipeline mode stages. The receive stage is ImagesCallback, which only enqueues.
+         */
+        void startPipeline();
+        void stopPipeline();
+
+        /**
+         * @brief Frames waiting to be tracked, in the queue of the drop policy.
+         */
+        size_t pendingFrames() const;
+        void trackingLoop();
+        void publishLoop();
 
         /**
          * @brief Publishes map data. (Keyframes and all poses in the current active map.)
@@ -64,6 +181,38 @@ namespace ORB_SLAM3_Wrapper
 
         void publishMapPointCloud();
 
+        /**
+         * @brief Publishes the map events of the interface on map_events as they come, see ORBSLAM3Interface::enableMapEvents.
+         */
+        void mapEventsLoop();
+        void publishMapEvents(slam_msgs::msg::MapEvents &msg);
+
+        /**
+         * @brief Enables the map events of a new interface if map_events is set.
+         */
+        void applyMapEvents(ORBSLAM3Interface &interface);
+
+        /**
+         * @brief Pins the ORB_SLAM3 threads of a new interface to the local_mapping_cpus, loop_closing_cpus and viewer_cpus sets,
+         * and hands it the query worker pool.
+         */
+        void applyThreadLayout(ORBSLAM3Interface &interface);
+
+        /**
+         * @brief Publishes map -> odom, or map -> base in no odometry mode, from the pose predictor stamped with the current time.
+         */
+        void publishPredictedTF();
+
+        /**
+         * @brief Adds the overload decision to the ORB-SLAM3 status and the thread layout status, see NodeDiagnostics.
+         */
+        void extendDiagnostics(diagnostic_msgs::msg::DiagnosticStatus &status, std::vector<diagnostic_msgs::msg::DiagnosticStatus> &statuses);
+
+        /**
+         * @brief Refreshes the gauges owned by the node (queue depths, tracking rate).
+         */
+        void updateNodeMetrics();
+
         /**
          * @brief Callback function for GetMap service.
          * @param request_header Request header.
@@ -74,20 +223,76 @@ namespace ORB_SLAM3_Wrapper
                           std::shared_ptr<slam_msgs::srv::GetMap::Request> request,
                           std::shared_ptr<slam_msgs::srv::GetMap::Response> response);
 
+        /**
+         * @brief orb_slam3_get_map_data with the points of the keyframes packed, see WrapperTypeConversions::mapDataToPacked.
+         */
+        void getPackedMapServer(std::shared_ptr<rmw_request_id_t> request_header,
+                                std::shared_ptr<slam_msgs::srv::GetPackedMap::Request> request,
+                                std::shared_ptr<slam_msgs::srv::GetPackedMap::Response> response);
+
+        /**
+         * @brief Callback function for the map data snapshot service. The next MapDataDelta is a full snapshot.
+         */
+        void mapDataSnapshotServer(std::shared_ptr<rmw_request_id_t> request_header,
+                                   std::shared_ptr<std_srvs::srv::Trigger::Request> request,
+                                   std::shared_ptr<std_srvs::srv::Trigger::Response> response);
+
         void getMapPointsInViewServer(std::shared_ptr<rmw_request_id_t> request_header,
                           std::shared_ptr<slam_msgs::srv::GetLandmarksInView::Request> request,
                           std::shared_ptr<slam_msgs::srv::GetLandmarksInView::Response> response);
+
+        /**
+         * @brief Callback function for the orb_slam3_get_landmarks_in_view_batch service. The points visible from
+         * each pose of the request, in one deduplicated table.
+         */
+        void getLandmarksInViewBatchServer(std::shared_ptr<rmw_request_id_t> request_header,
+                                           std::shared_ptr<slam_msgs::srv::GetLandmarksInViewBatch::Request> request,
+                                           std::shared_ptr<slam_msgs::srv::GetLandmarksInViewBatch::Response> response);
+
+        /**
+         * @brief Enables the output-side keyframe cache of a new interface if a limit is set.
+         */
+        void applyOutputCache(ORBSLAM3Interface &interface);
+
+        /**
+         * @brief Builds an interface from the settings file with the options of the node.
+         */
+        std::shared_ptr<ORBSLAM3Interface> makeInterface(const std::string &settingsFile);
+
+        /**
+         * @brief Resets the per-map state of the node and makes the interface the current one.
+         * @return The previous interface.
+         */
+        std::shared_ptr<ORBSLAM3Interface> installInterface(const std::shared_ptr<ORBSLAM3Interface> &loaded);
+
+        /**
+         * @brief The interface in use. load_map replaces it, so take one reference per callback. Null while
+         * load_map swaps the systems.
+         */
+        std::shared_ptr<ORBSLAM3Interface> currentInterface() const
+        {
+            return std::atomic_load(&interface_);
+        }
         /**
          * Member variables
          */
-        // RGBD Sensor specifics
-        std::shared_ptr<message_filters::Subscriber<sensor_msgs::msg::Image>> rgbSub_;
-        std::shared_ptr<message_filters::Subscriber<sensor_msgs::msg::Image>> depthSub_;
+        // Sensor specifics. rgb / depth for RGB-D, left / right for stereo.
+        ORB_SLAM3::System::eSensor sensor_;
+        std::shared_ptr<message_filters::Subscriber<sensor_msgs::msg::Image>> firstImageSub_;
+        std::shared_ptr<message_filters::Subscriber<sensor_msgs::msg::Image>> secondImageSub_;
         std::shared_ptr<message_filters::Synchronizer<approximate_sync_policy>> syncApproximate_;
+        rclcpp::Subscription<sensor_msgs::msg::Image>::SharedPtr monoSub_;
         rclcpp::Subscription<sensor_msgs::msg::Imu>::SharedPtr imuSub_;
+        // The images (with the odometry, which reads the tracked pose), the IMU and the map services each have their own callback group.
+        rclcpp::CallbackGroup::SharedPtr sensorCallbackGroup_;
+        rclcpp::CallbackGroup::SharedPtr imuCallbackGroup_;
+        rclcpp::CallbackGroup::SharedPtr servicesCallbackGroup_;
         // ROS Publishers and Subscribers
         rclcpp::Subscription<nav_msgs::msg::Odometry>::SharedPtr odomSub_;
+        MergeHandling mergeHandling_ = MergeHandling::PAUSE;
+        double mergeBlendWindow_;
         rclcpp::Publisher<slam_msgs::msg::MapData>::SharedPtr mapDataPub_;
+        rclcpp::Publisher<slam_msgs::msg::MapDataDelta>::SharedPtr mapDataDeltaPub_;
         rclcpp::Publisher<sensor_msgs::msg::PointCloud2>::SharedPtr mapPointsPub_;
         rclcpp::Publisher<sensor_msgs::msg::PointCloud2>::SharedPtr visibleLandmarksPub_;
         rclcpp::Publisher<geometry_msgs::msg::PoseStamped>::SharedPtr visibleLandmarksPose_;
@@ -97,29 +302,129 @@ namespace ORB_SLAM3_Wrapper
         std::shared_ptr<tf2_ros::Buffer> tfBuffer_;
         // ROS Services
         rclcpp::Service<slam_msgs::srv::GetMap>::SharedPtr getMapDataService_;
+        rclcpp::Service<slam_msgs::srv::GetPackedMap>::SharedPtr getPackedMapDataService_;
+        double packedPointsResolution_;
+        int packedPointsCompressionLevel_;
         rclcpp::Service<slam_msgs::srv::GetLandmarksInView>::SharedPtr getMapPointsService_;
+        rclcpp::Service<std_srvs::srv::Trigger>::SharedPtr mapDataSnapshotService_;
+        // Landmarks in view, the batch service has its own callback group for the planners calling it in a loop.
+        rclcpp::Service<slam_msgs::srv::GetLandmarksInViewBatch>::SharedPtr getLandmarksInViewBatchService_;
+        rclcpp::CallbackGroup::SharedPtr landmarksCallbackGroup_;
+        int landmarksInViewMaxLandmarks_;
+        double landmarksInViewMaxDistance_;
+        double landmarksInViewMaxAngle_;
         // ROS Timers
         rclcpp::TimerBase::SharedPtr mapDataTimer_;
         rclcpp::CallbackGroup::SharedPtr mapDataCallbackGroup_;
         rclcpp::TimerBase::SharedPtr mapPointsTimer_;
         rclcpp::CallbackGroup::SharedPtr mapPointsCallbackGroup_;
+        // messages reused by the timers from tick to tick, each only touched from the callback group of its timer.
+        slam_msgs::msg::MapData mapDataScratch_;
+        slam_msgs::msg::MapDataDelta mapDataDeltaScratch_;
+        sensor_msgs::msg::PointCloud2 mapPointsScratch_;
         // ROS Params
         std::string robot_base_frame_id_;
         std::string odom_frame_id_;
         std::string global_frame_;
         double robot_x_, robot_y_;
         bool rosViz_;
-        bool isTracked_ = false;
+        bool bUseViewer_;
+        std::string strVocFile_;
+        std::atomic<bool> isTracked_{false};
         bool no_odometry_mode_;
         bool publish_tf_;
         double frequency_tracker_count_ = 0;
         int map_data_publish_frequency_;
         int landmark_publish_frequency_;
+        bool publishMapDataDelta_;
+        std::unique_ptr<MapDataDeltaEncoder> mapDataDeltaEncoder_;
+        // Map events. When enabled, the map data and the cloud are only rebuilt if the map version changed.
+        rclcpp::Publisher<slam_msgs::msg::MapEvents>::SharedPtr mapEventsPub_;
+        int mapEventQueueSize_;
+        std::thread mapEventsThread_;
+        std::atomic<bool> mapEventsRunning_{false};
+        std::mutex mapEventsMutex_;
+        std::condition_variable mapEventsCondition_;
+        std::atomic<uint64_t> mapEventsPublished_{0};
+        std::atomic<uint64_t> lastMapDataVersion_{std::numeric_limits<uint64_t>::max()};
+        std::atomic<uint64_t> lastMapPointsVersion_{std::numeric_limits<uint64_t>::max()};
+        // output-side keyframe cache. Every interface gets its own store file (see load_map).
+        ORBSLAM3Interface::OutputCacheLimits outputCacheLimits_;
+        std::string outputCachePath_;
+        int interfaceGeneration_ = 0;
         std::chrono::_V2::system_clock::time_point frequency_tracker_clock_;
 
+        // Instrumentation
+        std::shared_ptr<MetricsRegistry> metrics_;
+        LatencyHistogram *tfPublishLatency_;
+        LatencyHistogram *mapDataPublishLatency_;
+        LatencyHistogram *mapPointsPublishLatency_;
+        LatencyHistogram *getMapServiceLatency_;
+        LatencyHistogram *getPackedMapServiceLatency_;
+        LatencyHistogram *landmarksInViewServiceLatency_;
+        LatencyHistogram *landmarksInViewBatchServiceLatency_;
+        LatencyHistogram *framePrepareLatency_;
+        std::atomic<uint64_t> trackedFramesTotal_{0};
+        uint64_t lastTrackedFramesTotal_ = 0;
+        std::chrono::steady_clock::time_point lastNodeMetricsUpdate_;
+
+        // Feature backend, declared before the frame queue so that it outlives the queued frames.
+        std::string featureBackendName_;
+        std::unique_ptr<FeatureBackend> featureBackend_;
+
+        // TF prediction, null when disabled. The tracked frames correct the predictor, the timer publishes.
+        std::unique_ptr<PosePredictor> posePredictor_;
+        rclcpp::TimerBase::SharedPtr tfPredictionTimer_;
+        rclcpp::CallbackGroup::SharedPtr tfPredictionCallbackGroup_;
+        bool hasImuToBase_ = false;
+        Eigen::Quaterniond imuToBase_ = Eigen::Quaterniond::Identity();
+
+        // Overload control, null when disabled.
+        std::unique_ptr<OverloadController> overloadController_;
+        std::atomic<uint64_t> framesSkipped_{0};
+
+        // Frame pipeline
+        bool trackingPipeline_;
+        int frameQueueSize_;
+        FrameDropPolicy frameDropPolicy_;
+        // fifo policy.
+        std::unique_ptr<SPSCRingBuffer<CameraFrame>> frameQueue_;
+        // newest policy, the producer replaces the frame not taken yet.
+        std::unique_ptr<LatestValueSlot<CameraFrame>> latestFrame_;
+        std::unique_ptr<SPSCRingBuffer<TrackedFrame>> publishQueue_;
+        std::thread trackingThread_;
+        std::thread publishThread_;
+        std::atomic<bool> pipelineRunning_{false};
+        std::mutex frameWakeMutex_;
+        std::condition_variable frameWakeCondition_;
+        std::mutex publishWakeMutex_;
+        std::condition_variable publishWakeCondition_;
+        // Threads and CPU affinity.
+        std::string trackingCpus_;
+        int trackingPriority_;
+        std::atomic<int> trackingThreadId_{0};
+        ORBSLAM3Interface::ThreadLayout threadLayout_;
+        int executorThreads_;
+        std::string executorCpus_;
+        std::shared_ptr<WorkerPool> workerPool_;
+        std::atomic<uint64_t> framesReceived_{0};
+        std::atomic<uint64_t> framesDropped_{0};
+        std::atomic<size_t> maxFrameQueueDepth_{0};
+
         ORB_SLAM3_Wrapper::WrapperTypeConversions typeConversion_;
         std::shared_ptr<ORB_SLAM3_Wrapper::ORBSLAM3Interface> interface_;
+        // map -> odom of the odometry callback, taken by the tracked frames.
         geometry_msgs::msg::TransformStamped tfMapOdom_;
+        std::mutex tfMapOdomMutex_;
+
+        // Features with their own parameters, services and callback groups, see their headers.
+        std::unique_ptr<NodeDiagnostics> diagnostics_;
+        std::unique_ptr<MapStreaming> mapStreaming_;
+        std::unique_ptr<PoseHints> poseHints_;
+        std::unique_ptr<MapPersistence> mapPersistence_;
+        // null when disabled.
+        std::unique_ptr<OccupancyMapping> occupancy_;
+        std::unique_ptr<FleetDescriptorStream> fleet_;
     };
 }
 #endif
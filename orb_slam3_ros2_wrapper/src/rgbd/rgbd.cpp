@@ -16,10 +16,11 @@ int main(int argc, char **argv)
 
     rclcpp::init(argc, argv);
 
-    auto node = std::make_shared<ORB_SLAM3_Wrapper::RgbdSlamNode>(argv[1], argv[2], ORB_SLAM3::System::RGBD);
+    auto options = rclcpp::NodeOptions().use_intra_process_comms(true);
+    auto node = std::make_shared<ORB_SLAM3_Wrapper::RgbdSlamNode>(argv[1], argv[2], ORB_SLAM3::System::RGBD, options);
     std::cout << "============================ " << std::endl;
 
-    auto executor = std::make_shared<rclcpp::executors::MultiThreadedExecutor>();
+    auto executor = node->makeExecutor();
     executor->add_node(node);
     executor->spin();
     rclcpp::shutdown();
@@ -0,0 +1,29 @@
+#include <iostream>
+#include <algorithm>
+#include <fstream>
+#include <chrono>
+
+#include "rclcpp/rclcpp.hpp"
+#include "../rgbd/rgbd-slam-node.hpp"
+
+int main(int argc, char **argv)
+{
+    if(argc < 3)
+    {
+        std::cerr << "\nUsage: ros2 run orbslam stereo_inertial path_to_vocabulary path_to_settings" << std::endl;
+        return 1;
+    }
+
+    rclcpp::init(argc, argv);
+
+    auto options = rclcpp::NodeOptions().use_intra_process_comms(true);
+    auto node = std::make_shared<ORB_SLAM3_Wrapper::RgbdSlamNode>(argv[1], argv[2], ORB_SLAM3::System::IMU_STEREO, options);
+    std::cout << "============================ " << std::endl;
+
+    auto executor = node->makeExecutor();
+    executor->add_node(node);
+    executor->spin();
+    rclcpp::shutdown();
+
+    return 0;
+}
@@ -0,0 +1,232 @@
+/**
+ * @file thread_config.cpp
+ * @brief CPU set parsing, thread affinity and scheduling helpers.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#include "orb_slam3_ros2_wrapper/thread_config.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace ORB_SLAM3_Wrapper
+{
+    namespace
+    {
+        bool parseCpu(const std::string &text, int &cpu)
+        {
+            if (text.empty() || text.find_first_not_of("0123456789") != std::string::npos)
+                return false;
+            cpu = std::atoi(text.c_str());
+            return cpu < CPU_SETSIZE;
+        }
+    }
+
+    bool parseCpuSet(const std::string &spec, std::vector<int> &cpus)
+    {
+        cpus.clear();
+        std::stringstream stream(spec);
+        std::string range;
+        while (std::getline(stream, range, ','))
+        {
+            range.erase(std::remove(range.begin(), range.end(), ' '), range.end());
+            const size_t dash = range.find('-');
+            int first, last;
+            if (dash == std::string::npos)
+            {
+                if (!parseCpu(range, first))
+                    return false;
+                last = first;
+            }
+            else if (!parseCpu(range.substr(0, dash), first) || !parseCpu(range.substr(dash + 1), last) || last < first)
+                return false;
+            for (int cpu = first; cpu <= last; cpu++)
+                cpus.push_back(cpu);
+        }
+        std::sort(cpus.begin(), cpus.end());
+        cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+        return !cpus.empty();
+    }
+
+    std::string formatCpuSet(const std::vector<int> &cpus)
+    {
+        std::ostringstream out;
+        for (size_t i = 0; i < cpus.size();)
+        {
+            size_t j = i;
+            while (j + 1 < cpus.size() && cpus[j + 1] == cpus[j] + 1)
+                j++;
+            if (i > 0)
+                out << ",";
+            out << cpus[i];
+            if (j > i)
+                out << "-" << cpus[j];
+            i = j + 1;
+        }
+        return out.str();
+    }
+
+    bool getCurrentThreadAffinity(std::vector<int> &cpus)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if (pthread_getaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+            return false;
+        cpus.clear();
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+        {
+            if (CPU_ISSET(cpu, &set))
+                cpus.push_back(cpu);
+        }
+        return true;
+    }
+
+    bool setCurrentThreadAffinity(const std::vector<int> &cpus)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int cpu : cpus)
+            CPU_SET(cpu, &set);
+        return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+    }
+
+    int currentThreadId()
+    {
+        return static_cast<int>(syscall(SYS_gettid));
+    }
+
+    std::vector<int> processThreadIds()
+    {
+        std::vector<int> tids;
+        DIR *directory = opendir("/proc/self/task");
+        if (!directory)
+            return tids;
+        while (dirent *entry = readdir(directory))
+        {
+            // skips . and ..
+            const std::string name = entry->d_name;
+            if (!name.empty() && name.find_first_not_of("0123456789") == std::string::npos)
+                tids.push_back(std::atoi(name.c_str()));
+        }
+        closedir(directory);
+        std::sort(tids.begin(), tids.end());
+        return tids;
+    }
+
+    bool getThreadAffinity(int tid, std::vector<int> &cpus)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if (sched_getaffinity(tid, sizeof(set), &set) != 0)
+            return false;
+        cpus.clear();
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+        {
+            if (CPU_ISSET(cpu, &set))
+                cpus.push_back(cpu);
+        }
+        return true;
+    }
+
+    bool setThreadAffinity(int tid, const std::vector<int> &cpus)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int cpu : cpus)
+            CPU_SET(cpu, &set);
+        return sched_setaffinity(tid, sizeof(set), &set) == 0;
+    }
+
+    bool setThreadPriority(int tid, int priority)
+    {
+        sched_param param{};
+        param.sched_priority = std::max(0, std::min(priority, 99));
+        return sched_setscheduler(tid, priority > 0 ? SCHED_FIFO : SCHED_OTHER, &param) == 0;
+    }
+
+    bool getThreadPriority(int tid, int &priority, bool &realtime)
+    {
+        const int policy = sched_getscheduler(tid);
+        sched_param param{};
+        if (policy < 0 || sched_getparam(tid, &param) != 0)
+            return false;
+        realtime = policy == SCHED_FIFO || policy == SCHED_RR;
+        priority = realtime ? param.sched_priority : 0;
+        return true;
+    }
+
+    bool setThreadName(int tid, const std::string &name)
+    {
+        std::ofstream comm("/proc/self/task/" + std::to_string(tid) + "/comm");
+        comm << name.substr(0, 15);
+        comm.close();
+        return !comm.fail();
+    }
+
+    std::string getThreadName(int tid)
+    {
+        std::ifstream comm("/proc/self/task/" + std::to_string(tid) + "/comm");
+        std::string name;
+        std::getline(comm, name);
+        return name;
+    }
+
+    std::string describeThread(int tid)
+    {
+        std::vector<int> cpus;
+        int priority;
+        bool realtime;
+        if (!getThreadAffinity(tid, cpus) || !getThreadPriority(tid, priority, realtime))
+            return "unknown";
+        std::string description = "cpus " + formatCpuSet(cpus);
+        if (realtime)
+            description += ", realtime priority " + std::to_string(priority);
+        return description;
+    }
+
+    ScopedThreadAffinity::ScopedThreadAffinity(const std::vector<int> &cpus)
+    {
+        if (cpus.empty() || !getCurrentThreadAffinity(previous_))
+            return;
+        applied_ = setCurrentThreadAffinity(cpus);
+    }
+
+    ScopedThreadAffinity::~ScopedThreadAffinity()
+    {
+        if (applied_)
+            setCurrentThreadAffinity(previous_);
+    }
+
+    ScopedThreadCreationTracker::ScopedThreadCreationTracker()
+        : tid_(currentThreadId()), previousName_(getThreadName(tid_))
+    {
+        static std::atomic<unsigned> trackers{0};
+        marker_ = "orb_spawn_" + std::to_string(trackers++ % 100000);
+        setThreadName(tid_, marker_);
+    }
+
+    ScopedThreadCreationTracker::~ScopedThreadCreationTracker()
+    {
+        setThreadName(tid_, previousName_);
+    }
+
+    std::vector<int> ScopedThreadCreationTracker::created() const
+    {
+        std::vector<int> tids;
+        for (int tid : processThreadIds())
+        {
+            if (tid != tid_ && getThreadName(tid) == marker_)
+                tids.push_back(tid);
+        }
+        return tids;
+    }
+}
@@ -0,0 +1,80 @@
+/**
+ * @file allocation_counter.cpp
+ * @brief Global operator new / delete replacements counting the allocations of each thread.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+#include "allocation_counter.hpp"
+
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+    thread_local uint64_t threadAllocations = 0;
+}
+
+namespace ORB_SLAM3_Wrapper
+{
+    uint64_t threadAllocationCount()
+    {
+        return threadAllocations;
+    }
+}
+
+void *operator new(std::size_t size)
+{
+    ++threadAllocations;
+    if (size == 0)
+        size = 1;
+    while (true)
+    {
+        if (void *p = std::malloc(size))
+            return p;
+        std::new_handler handler = std::get_new_handler();
+        if (handler == nullptr)
+            throw std::bad_alloc();
+        handler();
+    }
+}
+
+void *operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept
+{
+    try
+    {
+        return operator new(size);
+    }
+    catch (...)
+    {
+        return nullptr;
+    }
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept
+{
+    return operator new(size, std::nothrow);
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void *p, std::size_t) noexcept
+{
+    std::free(p);
+}
@@ -0,0 +1,38 @@
+/**
+ * @file allocation_counter.hpp
+ * @brief Counts the heap allocations of the calling thread, for the benchmark tools.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#ifndef ORB_WRAPPER_ALLOCATION_COUNTER_HPP_
+#define ORB_WRAPPER_ALLOCATION_COUNTER_HPP_
+
+#include <cstdint>
+
+namespace ORB_SLAM3_Wrapper
+{
+    /**
+     * @brief operator new calls made by the calling thread so far.
+     * @note Defined by allocation_counter.cpp, which replaces the global operator new. Only link it into tools.
+     */
+    uint64_t threadAllocationCount();
+
+    /**
+     * @brief Allocations of the calling thread since construction. The threads it starts are not counted.
+     */
+    class AllocationScope
+    {
+    public:
+        AllocationScope() : start_(threadAllocationCount()) {}
+
+        uint64_t count() const
+        {
+            return threadAllocationCount() - start_;
+        }
+
+    private:
+        uint64_t start_;
+    };
+}
+
+#endif
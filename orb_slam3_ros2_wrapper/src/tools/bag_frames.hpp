@@ -0,0 +1,114 @@
+/**
+ * @file bag_frames.hpp
+ * @brief Reads the camera frames of a recorded bag into memory for the benchmark tools.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#ifndef ORB_WRAPPER_BAG_FRAMES_HPP_
+#define ORB_WRAPPER_BAG_FRAMES_HPP_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <rclcpp/serialization.hpp>
+#include <rclcpp/serialized_message.hpp>
+#include <rosbag2_cpp/reader.hpp>
+#include <rosbag2_storage/storage_filter.hpp>
+#include <sensor_msgs/msg/image.hpp>
+
+namespace ORB_SLAM3_Wrapper
+{
+    /**
+     * @brief A frame of the bag. The second image is the depth or right image, null for a monocular sequence.
+     */
+    struct BagFrame
+    {
+        sensor_msgs::msg::Image::ConstSharedPtr image;
+        sensor_msgs::msg::Image::ConstSharedPtr secondImage;
+    };
+
+    inline int64_t bagStampNs(const sensor_msgs::msg::Image &image)
+    {
+        return static_cast<int64_t>(image.header.stamp.sec) * 1000000000LL + image.header.stamp.nanosec;
+    }
+
+    /**
+     * @brief Reads the images of the topics and pairs every first image with the closest second image,
+     * like the approximate time synchronizer of the node.
+     * @param secondTopic Empty for a monocular sequence.
+     * @param maxFrames 0 reads the whole bag.
+     * @param maxPairingGapNs First images without a second image this close are skipped.
+     * @throw std::runtime_error if the bag cannot be opened.
+     */
+    inline std::vector<BagFrame> readBagFrames(const std::string &bagPath, const std::string &firstTopic,
+                                               const std::string &secondTopic, size_t maxFrames = 0,
+                                               int64_t maxPairingGapNs = 20000000)
+    {
+        rosbag2_cpp::Reader reader;
+        reader.open(bagPath);
+        rosbag2_storage::StorageFilter filter;
+        filter.topics.push_back(firstTopic);
+        if (!secondTopic.empty())
+            filter.topics.push_back(secondTopic);
+        reader.set_filter(filter);
+
+        rclcpp::Serialization<sensor_msgs::msg::Image> serialization;
+        std::vector<sensor_msgs::msg::Image::ConstSharedPtr> firstImages;
+        std::vector<sensor_msgs::msg::Image::ConstSharedPtr> secondImages;
+        while (reader.has_next())
+        {
+            auto bagMessage = reader.read_next();
+            rclcpp::SerializedMessage serialized(*bagMessage->serialized_data);
+            auto image = std::make_shared<sensor_msgs::msg::Image>();
+            serialization.deserialize_message(&serialized, image.get());
+            if (bagMessage->topic_name == firstTopic)
+            {
+                firstImages.push_back(image);
+                // the second images of the last first image may still be ahead in the bag.
+                if (maxFrames > 0 && firstImages.size() > maxFrames + 1)
+                    break;
+            }
+            else
+                secondImages.push_back(image);
+        }
+
+        auto byStamp = [](const sensor_msgs::msg::Image::ConstSharedPtr &a, const sensor_msgs::msg::Image::ConstSharedPtr &b)
+        {
+            return bagStampNs(*a) < bagStampNs(*b);
+        };
+        std::sort(firstImages.begin(), firstImages.end(), byStamp);
+        std::sort(secondImages.begin(), secondImages.end(), byStamp);
+
+        std::vector<BagFrame> frames;
+        frames.reserve(firstImages.size());
+        for (const auto &image : firstImages)
+        {
+            if (maxFrames > 0 && frames.size() == maxFrames)
+                break;
+            BagFrame frame;
+            frame.image = image;
+            if (!secondTopic.empty())
+            {
+                const int64_t stamp = bagStampNs(*image);
+                auto it = std::lower_bound(secondImages.begin(), secondImages.end(), image, byStamp);
+                sensor_msgs::msg::Image::ConstSharedPtr closest;
+                if (it != secondImages.end())
+                    closest = *it;
+                if (it != secondImages.begin() &&
+                    (!closest || std::llabs(bagStampNs(**(it - 1)) - stamp) < std::llabs(bagStampNs(*closest) - stamp)))
+                    closest = *(it - 1);
+                if (!closest || std::llabs(bagStampNs(*closest) - stamp) > maxPairingGapNs)
+                    continue;
+                frame.secondImage = closest;
+            }
+            frames.push_back(frame);
+        }
+        return frames;
+    }
+}
+
+#endif
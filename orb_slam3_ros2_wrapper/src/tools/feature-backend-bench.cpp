@@ -0,0 +1,145 @@
+/**
+ * @file feature-backend-bench.cpp
+ * @brief Replays a recorded bag through the feature backends and reports the per-stage latency and the frame rate.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cstdlib>
+#include <map>
+#include <memory>
+
+#include <cv_bridge/cv_bridge.h>
+
+#include "orb_slam3_ros2_wrapper/feature_backend.hpp"
+#include "orb_slam3_ros2_wrapper/instrumentation.hpp"
+#include "orb_slam3_ros2_wrapper/orb_slam3_interface.hpp"
+#include "bag_frames.hpp"
+
+namespace
+{
+    using namespace ORB_SLAM3_Wrapper;
+
+    std::shared_ptr<PreparedFrame> prepare(FeatureBackend *backend, const BagFrame &frame, LatencyHistogram &latency)
+    {
+        if (backend == nullptr)
+            return nullptr;
+        const int firstCode = grayConversionCode(frame.image->encoding);
+        const int secondCode = frame.secondImage ? grayConversionCode(frame.secondImage->encoding) : -1;
+        if (firstCode < 0 && secondCode < 0)
+            return nullptr;
+        ScopedTimer timer(latency);
+        auto cvFirst = cv_bridge::toCvShare(frame.image);
+        cv_bridge::CvImageConstPtr cvSecond;
+        if (secondCode >= 0)
+            cvSecond = cv_bridge::toCvShare(frame.secondImage);
+        return backend->prepare(cvFirst->image, firstCode, cvSecond ? cvSecond->image : cv::Mat(), secondCode);
+    }
+
+    void printStage(const std::string &name, const LatencyHistogram &histogram)
+    {
+        const auto snapshot = histogram.snapshot();
+        if (snapshot.count == 0)
+            return;
+        std::cout << "  " << std::left << std::setw(22) << name << std::right << std::fixed << std::setprecision(3)
+                  << " mean " << std::setw(8) << 1e-6 * snapshot.sumNs / snapshot.count << " ms"
+                  << "  p50 " << std::setw(8) << 1e-6 * snapshot.quantileNs(0.5) << " ms"
+                  << "  p99 " << std::setw(8) << 1e-6 * snapshot.quantileNs(0.99) << " ms"
+                  << "  (" << snapshot.count << ")" << std::endl;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        std::cerr << "\nUsage: ros2 run orb_slam3_ros2_wrapper orb_slam3_feature_bench path_to_bag first_image_topic [second_image_topic] [path_to_vocabulary path_to_settings]"
+                  << "\n  second_image_topic is the depth topic, \"\" for a monocular sequence."
+                  << "\n  Without a vocabulary and settings only the conversion stages are measured."
+                  << "\n  ORB_WRAPPER_BENCH_MAX_FRAMES limits the number of replayed frames." << std::endl;
+        return 1;
+    }
+    const std::string bagPath = argv[1];
+    const std::string firstTopic = argv[2];
+    const std::string secondTopic = argc > 3 ? argv[3] : "";
+    const bool track = argc > 5;
+    const char *maxFramesEnv = std::getenv("ORB_WRAPPER_BENCH_MAX_FRAMES");
+    const size_t maxFrames = maxFramesEnv != nullptr ? std::strtoul(maxFramesEnv, nullptr, 10) : 0;
+
+    std::vector<ORB_SLAM3_Wrapper::BagFrame> frames;
+    try
+    {
+        frames = ORB_SLAM3_Wrapper::readBagFrames(bagPath, firstTopic, secondTopic, maxFrames);
+    }
+    catch (std::exception &e)
+    {
+        std::cerr << "Could not read " << bagPath << ": " << e.what() << std::endl;
+        return 1;
+    }
+    if (frames.empty())
+    {
+        std::cerr << "No frames on " << firstTopic << (secondTopic.empty() ? "" : " / " + secondTopic) << " in " << bagPath << std::endl;
+        return 1;
+    }
+    std::cout << frames.size() << " frames read from " << bagPath << std::endl;
+
+    for (const std::string requested : {"orb", "cpu"})
+    {
+        std::string backendName, message;
+        auto backend = ORB_SLAM3_Wrapper::makeFeatureBackend(requested, backendName, message);
+        if (backendName != requested)
+        {
+            std::cout << requested << ": skipped. " << message << std::endl;
+            continue;
+        }
+
+        auto metrics = std::make_shared<ORB_SLAM3_Wrapper::MetricsRegistry>();
+        auto &prepareLatency = metrics->histogram("frame_prepare");
+        auto &waitLatency = metrics->histogram("prepared_frame_wait");
+        std::unique_ptr<ORB_SLAM3_Wrapper::ORBSLAM3Interface> interface;
+        if (track)
+        {
+            interface = std::make_unique<ORB_SLAM3_Wrapper::ORBSLAM3Interface>(argv[4], argv[5],
+                                                                               secondTopic.empty() ? ORB_SLAM3::System::MONOCULAR : ORB_SLAM3::System::RGBD,
+                                                                               false, false, 0.0, 0.0, "map", "odom", "base_link", metrics);
+        }
+
+        // as in pipeline mode, the next frame is submitted before the current one is tracked.
+        size_t trackedFrames = 0;
+        auto start = std::chrono::steady_clock::now();
+        auto next = prepare(backend.get(), frames[0], prepareLatency);
+        for (size_t i = 0; i < frames.size(); i++)
+        {
+            auto prepared = std::move(next);
+            if (i + 1 < frames.size())
+                next = prepare(backend.get(), frames[i + 1], prepareLatency);
+            if (interface)
+            {
+                Sophus::SE3f Tcw;
+                bool tracked = secondTopic.empty() ? interface->trackMonocular(frames[i].image, Tcw, prepared)
+                                                   : interface->trackRGBD(frames[i].image, frames[i].secondImage, Tcw, prepared);
+                if (tracked)
+                    ++trackedFrames;
+            }
+            else if (prepared)
+            {
+                ORB_SLAM3_Wrapper::ScopedTimer timer(waitLatency);
+                cv::Mat first, second;
+                prepared->wait(first, second);
+            }
+        }
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::cout << backendName << ": " << std::fixed << std::setprecision(1) << frames.size() / seconds << " fps";
+        if (interface)
+            std::cout << ", " << trackedFrames << " / " << frames.size() << " frames tracked";
+        std::cout << std::endl;
+        printStage("cv_bridge", metrics->histogram("cv_bridge"));
+        printStage("frame_prepare", prepareLatency);
+        printStage("prepared_frame_wait", waitLatency);
+        printStage("track_rgbd", metrics->histogram("track_rgbd"));
+        interface.reset();
+    }
+    return 0;
+}
@@ -0,0 +1,48 @@
+/**
+ * @file vocabulary-converter.cpp
+ * @brief Converts the ORB_SLAM3 text vocabulary to the binary format of BinaryVocabulary.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+#include <iostream>
+#include <chrono>
+
+#include "orb_slam3_ros2_wrapper/binary_vocabulary.hpp"
+
+int main(int argc, char **argv)
+{
+    if(argc < 3)
+    {
+        std::cerr << "\nUsage: ros2 run orb_slam3_ros2_wrapper orb_vocabulary_converter path_to_ORBvoc.txt path_to_ORBvoc.bin" << std::endl;
+        return 1;
+    }
+
+    ORB_SLAM3_Wrapper::BinaryVocabulary vocabulary;
+    auto start = std::chrono::steady_clock::now();
+    if (!vocabulary.loadFromTextFile(argv[1]))
+    {
+        std::cerr << "Could not load the text vocabulary " << argv[1] << std::endl;
+        return 1;
+    }
+    std::cout << "Text vocabulary loaded in " << std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() << " s" << std::endl;
+
+    if (!vocabulary.saveToBinaryFile(argv[2]))
+    {
+        std::cerr << "Could not write " << argv[2] << std::endl;
+        return 1;
+    }
+
+    // check the result loads back to the same tree.
+    ORB_SLAM3_Wrapper::BinaryVocabulary binary;
+    start = std::chrono::steady_clock::now();
+    if (!binary.loadFromBinaryFile(argv[2]) || binary.size() != vocabulary.size())
+    {
+        std::cerr << "The written binary vocabulary does not load back." << std::endl;
+        return 1;
+    }
+    std::cout << "Binary vocabulary loaded in " << std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() << " s, "
+              << binary.size() << " words." << std::endl;
+#ifndef ORB_SLAM3_HAS_SHARED_VOCABULARY
+    std::cout << "This wrapper is built without ORB_SLAM3_HAS_SHARED_VOCABULARY, it keeps loading the text vocabulary." << std::endl;
+#endif
+    return 0;
+}
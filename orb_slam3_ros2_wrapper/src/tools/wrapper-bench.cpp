@@ -0,0 +1,483 @@
+/**
+ * @file wrapper-bench.cpp
+ * @brief Replays a recorded RGB-D (or monocular) bag through ORBSLAM3Interface without DDS and writes
+ * the tracking rate, the per-stage latencies, the peak RSS and the cost of the map queries (time, heap
+ * allocations and serialized size) as JSON.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <chrono>
+#include <thread>
+#include <map>
+#include <memory>
+
+#include <sys/resource.h>
+
+#include <cv_bridge/cv_bridge.h>
+#include <rclcpp/serialization.hpp>
+#include <rclcpp/serialized_message.hpp>
+
+#include "orb_slam3_ros2_wrapper/feature_backend.hpp"
+#include "orb_slam3_ros2_wrapper/instrumentation.hpp"
+#include "orb_slam3_ros2_wrapper/orb_slam3_interface.hpp"
+#include "allocation_counter.hpp"
+#include "bag_frames.hpp"
+
+namespace
+{
+    using namespace ORB_SLAM3_Wrapper;
+
+    struct BenchOptions
+    {
+        std::string vocabulary;
+        std::string settings;
+        std::string bag;
+        std::string firstTopic;
+        std::string secondTopic;
+        std::vector<std::string> rates{"max"};
+        std::string featureBackend = "orb";
+        std::string output;
+        size_t maxFrames = 0;
+        // the map queries are measured every this many frames.
+        size_t sampleEvery = 50;
+        // the replay thread tracks, as the tracking thread of the node.
+        std::string trackingCpus;
+        int trackingPriority = 0;
+        std::string localMappingCpus;
+        std::string loopClosingCpus;
+    };
+
+    /**
+     * @brief Cost of the map queries at one map size.
+     */
+    struct MapSample
+    {
+        size_t frame;
+        double keyFrames;
+        double mapPoints;
+        double mapDataToMsgMs;
+        double currentMapPointsMs;
+        double visibleMapPointsMs;
+        size_t visibleMapPoints;
+        // heap allocations of each build, into the messages kept from the previous sample as the node timers do,
+        // and into a new message.
+        uint64_t mapDataToMsgAllocations;
+        uint64_t mapDataToMsgFreshAllocations;
+        uint64_t currentMapPointsAllocations;
+        uint64_t visibleMapPointsAllocations;
+        // serialized size of the map data with its points, as MapData and as PackedMapData in float32 and in
+        // 1 mm steps, both zstd compressed.
+        size_t mapDataBytes;
+        size_t packedMapDataBytes;
+        size_t quantizedMapDataBytes;
+        double packMapDataMs;
+    };
+
+    /**
+     * @brief Messages reused from sample to sample.
+     */
+    struct MapQueryScratch
+    {
+        slam_msgs::msg::MapData mapData;
+        slam_msgs::msg::PackedMapData packedMapData;
+        sensor_msgs::msg::PointCloud2 cloud;
+    };
+
+    struct RunResult
+    {
+        std::string rate;
+        size_t framesReplayed = 0;
+        size_t framesTracked = 0;
+        size_t framesLate = 0;
+        double seconds = 0.0;
+        long peakRssKb = 0;
+        std::shared_ptr<MetricsRegistry> metrics;
+        std::vector<MapSample> mapSamples;
+        // thread name and describeThread, read once the layout is applied.
+        std::vector<std::pair<std::string, std::string>> threads;
+    };
+
+    // the interface stages, then the ones of the bench.
+    const char *const kStages[] = {"cv_bridge", "frame_prepare", "prepared_frame_wait", "track_rgbd", "calculate_reference_poses",
+                                   "frame", "frame_lateness", "map_data_to_msg", "map_points_cloud", "visible_map_points",
+                                   "tracking_recovery"};
+
+    long peakRssKb()
+    {
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return usage.ru_maxrss;
+    }
+
+    double msSince(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    std::string jsonString(const std::string &value)
+    {
+        std::ostringstream out;
+        out << '"';
+        for (char c : value)
+        {
+            if (c == '"' || c == '\\')
+                out << '\\' << c;
+            else if (static_cast<unsigned char>(c) < 0x20)
+                out << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c) << std::dec << std::setfill(' ');
+            else
+                out << c;
+        }
+        out << '"';
+        return out.str();
+    }
+
+    template <typename T>
+    size_t serializedSize(const T &msg)
+    {
+        rclcpp::Serialization<T> serialization;
+        rclcpp::SerializedMessage serialized;
+        serialization.serialize_message(&msg, &serialized);
+        return serialized.size();
+    }
+
+    std::shared_ptr<PreparedFrame> prepare(FeatureBackend *backend, const BagFrame &frame, LatencyHistogram &latency)
+    {
+        if (backend == nullptr)
+            return nullptr;
+        const int firstCode = grayConversionCode(frame.image->encoding);
+        const int secondCode = frame.secondImage ? grayConversionCode(frame.secondImage->encoding) : -1;
+        if (firstCode < 0 && secondCode < 0)
+            return nullptr;
+        ScopedTimer timer(latency);
+        auto cvFirst = cv_bridge::toCvShare(frame.image);
+        cv_bridge::CvImageConstPtr cvSecond;
+        if (secondCode >= 0)
+            cvSecond = cv_bridge::toCvShare(frame.secondImage);
+        return backend->prepare(cvFirst->image, firstCode, cvSecond ? cvSecond->image : cv::Mat(), secondCode);
+    }
+
+    MapSample sampleMapQueries(ORBSLAM3Interface &interface, size_t frame, const std_msgs::msg::Header &header, MapQueryScratch &scratch)
+    {
+        MapSample sample;
+        sample.frame = frame;
+        interface.updateMapMetrics();
+
+        auto start = std::chrono::steady_clock::now();
+        {
+            AllocationScope allocations;
+            interface.mapDataToMsg(scratch.mapData, false, true);
+            sample.mapDataToMsgAllocations = allocations.count();
+        }
+        sample.mapDataToMsgMs = msSince(start);
+        {
+            slam_msgs::msg::MapData mapData;
+            AllocationScope allocations;
+            interface.mapDataToMsg(mapData, false, true);
+            sample.mapDataToMsgFreshAllocations = allocations.count();
+        }
+        sample.mapDataBytes = serializedSize(scratch.mapData);
+        PointPacking packing;
+        packing.compression = slam_msgs::msg::PackedPoints::COMPRESSION_ZSTD;
+        start = std::chrono::steady_clock::now();
+        interface.getTypeConversionPtr()->mapDataToPacked(scratch.mapData, packing, scratch.packedMapData);
+        sample.packMapDataMs = msSince(start);
+        sample.packedMapDataBytes = serializedSize(scratch.packedMapData);
+        packing.encoding = slam_msgs::msg::PackedPoints::ENCODING_UINT16;
+        interface.getTypeConversionPtr()->mapDataToPacked(scratch.mapData, packing, scratch.packedMapData);
+        sample.quantizedMapDataBytes = serializedSize(scratch.packedMapData);
+
+        start = std::chrono::steady_clock::now();
+        {
+            AllocationScope allocations;
+            interface.getCurrentMapPoints(scratch.cloud);
+            sample.currentMapPointsAllocations = allocations.count();
+        }
+        sample.currentMapPointsMs = msSince(start);
+
+        // the query of the landmarks in view service, from the pose of the robot.
+        geometry_msgs::msg::TransformStamped tf;
+        interface.getDirectMapToRobotTF(header, tf);
+        geometry_msgs::msg::Pose pose;
+        pose.position.x = tf.transform.translation.x;
+        pose.position.y = tf.transform.translation.y;
+        pose.position.z = tf.transform.translation.z;
+        pose.orientation = tf.transform.rotation;
+        std::vector<ORB_SLAM3::MapPoint *> points;
+        start = std::chrono::steady_clock::now();
+        {
+            AllocationScope allocations;
+            interface.mapPointsVisibleFromPose(pose, points, 1000, 5.0, 2.0);
+            sample.visibleMapPointsAllocations = allocations.count();
+        }
+        sample.visibleMapPointsMs = msSince(start);
+        sample.visibleMapPoints = points.size();
+        return sample;
+    }
+
+    RunResult replay(const BenchOptions &options, const std::vector<BagFrame> &frames, const std::string &rate)
+    {
+        RunResult result;
+        result.rate = rate;
+        result.metrics = std::make_shared<MetricsRegistry>();
+        auto &frameLatency = result.metrics->histogram("frame", "Frame, from the track call to the tracked pose.");
+        auto &latenessLatency = result.metrics->histogram("frame_lateness", "Real-time rate only, delay of the track call after the frame was due.");
+        auto &prepareLatency = result.metrics->histogram("frame_prepare");
+
+        std::string backendName, message;
+        auto backend = makeFeatureBackend(options.featureBackend, backendName, message);
+        if (!message.empty())
+            std::cerr << message << std::endl;
+        const bool mono = options.secondTopic.empty();
+        ORBSLAM3Interface interface(options.vocabulary, options.settings, mono ? ORB_SLAM3::System::MONOCULAR : ORB_SLAM3::System::RGBD,
+                                    false, false, 0.0, 0.0, "map", "odom", "base_link", result.metrics);
+
+        // pinned after the system is built, so that its threads do not inherit the tracking set.
+        ORBSLAM3Interface::ThreadLayout layout;
+        if ((!options.localMappingCpus.empty() && !parseCpuSet(options.localMappingCpus, layout.localMapping)) ||
+            (!options.loopClosingCpus.empty() && !parseCpuSet(options.loopClosingCpus, layout.loopClosing)))
+            std::cerr << "Ignoring a malformed CPU set." << std::endl;
+        message.clear();
+        if (!interface.applyThreadLayout(layout, message))
+            std::cerr << message << std::endl;
+        std::vector<int> trackingCpus;
+        if (!options.trackingCpus.empty() && !parseCpuSet(options.trackingCpus, trackingCpus))
+            std::cerr << "Ignoring the malformed CPU set " << options.trackingCpus << std::endl;
+        // restored at the end of the run, before the next system is built.
+        ScopedThreadAffinity trackingAffinity(trackingCpus);
+        if (!trackingCpus.empty() && !trackingAffinity.applied())
+            std::cerr << "Could not pin the replay thread to CPUs " << options.trackingCpus << std::endl;
+        const int tid = currentThreadId();
+        if (options.trackingPriority != 0 && !setThreadPriority(tid, options.trackingPriority))
+            std::cerr << "Could not set the replay thread priority to " << options.trackingPriority << std::endl;
+        result.threads.emplace_back("orb_tracking", describeThread(tid));
+        for (const auto &thread : interface.orbThreads())
+            result.threads.emplace_back(thread.first, describeThread(thread.second));
+
+        const bool realTime = rate == "realtime";
+        const int64_t firstStampNs = bagStampNs(*frames.front().image);
+        auto start = std::chrono::steady_clock::now();
+        // as in pipeline mode, the next frame is submitted before the current one is tracked.
+        auto next = prepare(backend.get(), frames.front(), prepareLatency);
+        MapQueryScratch scratch;
+        for (size_t i = 0; i < frames.size(); i++)
+        {
+            const BagFrame &frame = frames[i];
+            if (realTime)
+            {
+                const auto due = start + std::chrono::nanoseconds(bagStampNs(*frame.image) - firstStampNs);
+                const auto now = std::chrono::steady_clock::now();
+                if (now < due)
+                    std::this_thread::sleep_until(due);
+                else
+                {
+                    latenessLatency.record(now - due);
+                    // a frame tracked more than a millisecond after it was due counts as late.
+                    if (now - due > std::chrono::milliseconds(1))
+                        ++result.framesLate;
+                }
+            }
+            auto prepared = std::move(next);
+            if (i + 1 < frames.size())
+                next = prepare(backend.get(), frames[i + 1], prepareLatency);
+
+            Sophus::SE3f Tcw;
+            bool tracked;
+            {
+                ScopedTimer timer(frameLatency);
+                tracked = mono ? interface.trackMonocular(frame.image, Tcw, prepared)
+                               : interface.trackRGBD(frame.image, frame.secondImage, Tcw, prepared);
+            }
+            ++result.framesReplayed;
+            if (tracked)
+                ++result.framesTracked;
+            if (tracked && options.sampleEvery > 0 && result.framesTracked % options.sampleEvery == 0)
+            {
+                // the queries are not part of the replay time.
+                auto sampleStart = std::chrono::steady_clock::now();
+                auto sample = sampleMapQueries(interface, i, frame.image->header, scratch);
+                sample.keyFrames = result.metrics->gauge("keyframes").get();
+                sample.mapPoints = result.metrics->gauge("map_points").get();
+                result.mapSamples.push_back(sample);
+                start += std::chrono::steady_clock::now() - sampleStart;
+            }
+        }
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        result.peakRssKb = peakRssKb();
+        if (options.trackingPriority != 0)
+            setThreadPriority(tid, 0);
+        return result;
+    }
+
+    void writeJson(std::ostream &out, const BenchOptions &options, size_t numFrames, const std::vector<RunResult> &runs)
+    {
+        out << std::fixed << std::setprecision(4);
+        out << "{\n  \"bag\": " << jsonString(options.bag)
+            << ",\n  \"first_topic\": " << jsonString(options.firstTopic)
+            << ",\n  \"second_topic\": " << jsonString(options.secondTopic)
+            << ",\n  \"feature_backend\": " << jsonString(options.featureBackend)
+            << ",\n  \"frames\": " << numFrames
+            << ",\n  \"runs\": [";
+        for (size_t r = 0; r < runs.size(); r++)
+        {
+            const RunResult &run = runs[r];
+            out << (r > 0 ? "," : "") << "\n    {\n      \"rate\": " << jsonString(run.rate)
+                << ",\n      \"frames_replayed\": " << run.framesReplayed
+                << ",\n      \"frames_tracked\": " << run.framesTracked
+                << ",\n      \"frames_late\": " << run.framesLate
+                << ",\n      \"seconds\": " << run.seconds
+                << ",\n      \"fps\": " << (run.seconds > 0.0 ? run.framesReplayed / run.seconds : 0.0)
+                << ",\n      \"peak_rss_kb\": " << run.peakRssKb
+                << ",\n      \"threads\": {";
+            for (size_t t = 0; t < run.threads.size(); t++)
+                out << (t > 0 ? ", " : "") << jsonString(run.threads[t].first) << ": " << jsonString(run.threads[t].second);
+            out << "},\n      \"stages\": {";
+            bool first = true;
+            for (const char *stage : kStages)
+            {
+                const auto snapshot = run.metrics->histogram(stage).snapshot();
+                if (snapshot.count == 0)
+                    continue;
+                out << (first ? "" : ",") << "\n        " << jsonString(stage) << ": {\"count\": " << snapshot.count
+                    << ", \"mean_ms\": " << 1e-6 * snapshot.sumNs / snapshot.count
+                    << ", \"p50_ms\": " << 1e-6 * snapshot.quantileNs(0.5)
+                    << ", \"p90_ms\": " << 1e-6 * snapshot.quantileNs(0.9)
+                    << ", \"p99_ms\": " << 1e-6 * snapshot.quantileNs(0.99)
+                    << ", \"max_ms\": " << 1e-6 * snapshot.maxNs() << "}";
+                first = false;
+            }
+            out << "\n      },\n      \"map_queries\": [";
+            for (size_t s = 0; s < run.mapSamples.size(); s++)
+            {
+                const MapSample &sample = run.mapSamples[s];
+                out << (s > 0 ? "," : "") << "\n        {\"frame\": " << sample.frame
+                    << ", \"keyframes\": " << static_cast<uint64_t>(sample.keyFrames)
+                    << ", \"map_points\": " << static_cast<uint64_t>(sample.mapPoints)
+                    << ", \"map_data_to_msg_ms\": " << sample.mapDataToMsgMs
+                    << ", \"get_current_map_points_ms\": " << sample.currentMapPointsMs
+                    << ", \"map_points_visible_from_pose_ms\": " << sample.visibleMapPointsMs
+                    << ", \"visible_map_points\": " << sample.visibleMapPoints
+                    << ", \"map_data_to_msg_allocations\": " << sample.mapDataToMsgAllocations
+                    << ", \"map_data_to_msg_fresh_allocations\": " << sample.mapDataToMsgFreshAllocations
+                    << ", \"get_current_map_points_allocations\": " << sample.currentMapPointsAllocations
+                    << ", \"map_points_visible_from_pose_allocations\": " << sample.visibleMapPointsAllocations
+                    << ", \"map_data_bytes\": " << sample.mapDataBytes
+                    << ", \"packed_map_data_bytes\": " << sample.packedMapDataBytes
+                    << ", \"quantized_map_data_bytes\": " << sample.quantizedMapDataBytes
+                    << ", \"pack_map_data_ms\": " << sample.packMapDataMs << "}";
+            }
+            out << "\n      ]\n    }";
+        }
+        out << "\n  ]\n}\n";
+    }
+
+    bool parseOptions(int argc, char **argv, BenchOptions &options)
+    {
+        if (argc < 5)
+            return false;
+        options.vocabulary = argv[1];
+        options.settings = argv[2];
+        options.bag = argv[3];
+        options.firstTopic = argv[4];
+        int i = 5;
+        if (i < argc && std::string(argv[i]).compare(0, 2, "--") != 0)
+            options.secondTopic = argv[i++];
+        for (; i + 1 < argc; i += 2)
+        {
+            const std::string key = argv[i];
+            const std::string value = argv[i + 1];
+            if (key == "--rate")
+            {
+                if (value == "both")
+                    options.rates = {"max", "realtime"};
+                else if (value == "max" || value == "realtime")
+                    options.rates = {value};
+                else
+                    return false;
+            }
+            else if (key == "--feature-backend")
+                options.featureBackend = value;
+            else if (key == "--output")
+                options.output = value;
+            else if (key == "--max-frames")
+                options.maxFrames = std::stoul(value);
+            else if (key == "--sample-every")
+                options.sampleEvery = std::stoul(value);
+            else if (key == "--tracking-cpus")
+                options.trackingCpus = value;
+            else if (key == "--tracking-priority")
+                options.trackingPriority = std::stoi(value);
+            else if (key == "--local-mapping-cpus")
+                options.localMappingCpus = value;
+            else if (key == "--loop-closing-cpus")
+                options.loopClosingCpus = value;
+            else
+                return false;
+        }
+        return i == argc;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    BenchOptions options;
+    bool parsed;
+    try
+    {
+        parsed = parseOptions(argc, argv, options);
+    }
+    catch (std::exception &e)
+    {
+        parsed = false;
+    }
+    if (!parsed)
+    {
+        std::cerr << "\nUsage: ros2 run orb_slam3_ros2_wrapper orb_slam3_wrapper_bench path_to_vocabulary path_to_settings path_to_bag rgb_topic [depth_topic]"
+                  << "\n  [--rate max|realtime|both] [--feature-backend orb|cpu] [--max-frames N] [--sample-every N] [--output results.json]"
+                  << "\n  [--tracking-cpus 2-3] [--tracking-priority 0-99] [--local-mapping-cpus 4-5] [--loop-closing-cpus 6]"
+                  << "\n  Without a depth topic the sequence is tracked as monocular. The JSON goes to stdout without --output." << std::endl;
+        return 1;
+    }
+
+    std::vector<ORB_SLAM3_Wrapper::BagFrame> frames;
+    try
+    {
+        frames = ORB_SLAM3_Wrapper::readBagFrames(options.bag, options.firstTopic, options.secondTopic, options.maxFrames);
+    }
+    catch (std::exception &e)
+    {
+        std::cerr << "Could not read " << options.bag << ": " << e.what() << std::endl;
+        return 1;
+    }
+    if (frames.empty())
+    {
+        std::cerr << "No frames on " << options.firstTopic << " in " << options.bag << std::endl;
+        return 1;
+    }
+    std::cerr << frames.size() << " frames read from " << options.bag << std::endl;
+
+    // the peak RSS of a run includes the runs before it, run one rate per process to compare them.
+    std::vector<RunResult> runs;
+    for (const auto &rate : options.rates)
+    {
+        runs.push_back(replay(options, frames, rate));
+        std::cerr << rate << ": " << runs.back().framesTracked << " / " << runs.back().framesReplayed << " frames tracked in "
+                  << runs.back().seconds << " s" << std::endl;
+    }
+
+    if (options.output.empty())
+        writeJson(std::cout, options, frames.size(), runs);
+    else
+    {
+        std::ofstream file(options.output);
+        if (!file)
+        {
+            std::cerr << "Could not write " << options.output << std::endl;
+            return 1;
+        }
+        writeJson(file, options, frames.size(), runs);
+    }
+    return 0;
+}
@@ -6,12 +6,13 @@
 
 #include "orb_slam3_ros2_wrapper/type_conversion.hpp"
 #include "sophus/se3.hpp"
+#include "KeyFrame.h"
 
 namespace ORB_SLAM3_Wrapper
 {
     double WrapperTypeConversions::stampToSec(builtin_interfaces::msg::Time stamp)
     {
-        double seconds = stamp.sec + (stamp.nanosec * pow(10, -9));
+        double seconds = stamp.sec + (stamp.nanosec * 1e-9);
         return seconds;
     }
 
@@ -19,7 +20,7 @@ namespace ORB_SLAM3_Wrapper
     {
         builtin_interfaces::msg::Time stamp;
         stamp.sec = static_cast<int32_t>(std::floor(seconds));
-        stamp.nanosec = static_cast<uint32_t>((seconds - stamp.sec) * pow(10, 9));
+        stamp.nanosec = static_cast<uint32_t>((seconds - stamp.sec) * 1e9);
         return stamp;
     }
 
@@ -44,86 +45,41 @@ namespace ORB_SLAM3_Wrapper
 
     Eigen::Affine3f WrapperTypeConversions::se3ORBToROS(const Sophus::SE3f &s)
     {
-        Eigen::Matrix3f tfCameraRotation = s.rotationMatrix();
-        Eigen::Vector3f tfCameraTranslation = s.translation();
-
-        Eigen::Matrix3f tfORBToROS;
-        tfORBToROS << 0, 0, 1,
-            -1, 0, 0,
-            0, -1, 0;
-
-        // Transform from orb coordinate system to ros coordinate system on camera coordinates
-        Eigen::Matrix3f tfCameraRotationTemp = tfORBToROS * tfCameraRotation;
-        Eigen::Vector3f tfCameraTranslationTemp = tfORBToROS * tfCameraTranslation;
-
-        // Inverse matrix (Tcw -> Twc, converts to map frame of ROS coordinates)
-        Eigen::Matrix3f tfCameraRotationInv = tfCameraRotationTemp.transpose();
-        Eigen::Vector3f tfCameraTranslationInv = -(tfCameraRotationInv * tfCameraTranslationTemp);
-
-        // Transform from orb coordinate system to ros coordinate system on map coordinates
-        tfCameraRotation = tfORBToROS * tfCameraRotationInv;
-        tfCameraTranslation = tfORBToROS * tfCameraTranslationInv;
-
-        Eigen::Affine3f affineMatrix = Eigen::Affine3f::Identity();
-        affineMatrix.rotate(tfCameraRotation);
-        affineMatrix.translation() = tfCameraTranslation;
-
-        return affineMatrix;
+        // Inverse (Tcw -> Twc) and change of axes on both the camera and the map side.
+        return orbTcwToROSTwc<float>(s.rotationMatrix(), s.translation());
     }
 
     Sophus::SE3f WrapperTypeConversions::se3ROSToORB(const Eigen::Affine3f &affineMatrix)
     {
-        // Extract rotation and translation from the affine matrix
-        Eigen::Matrix3f tfCameraRotation = affineMatrix.rotation();
-        Eigen::Vector3f tfCameraTranslation = affineMatrix.translation();
-
-        // Define the transformation matrix from ROS to ORB coordinate system
-        Eigen::Matrix3f tfROSToORB;
-        tfROSToORB << 0, -1, 0,
-                    0,  0, -1,
-                    1,  0,  0;
-
-        // Transform from ROS coordinate system to ORB coordinate system on map coordinates
-        Eigen::Matrix3f tfCameraRotationTemp = tfROSToORB * tfCameraRotation;
-        Eigen::Vector3f tfCameraTranslationTemp = tfROSToORB * tfCameraTranslation;
-
-        // Inverse matrix (Twc -> Tcw, converts to camera frame of ORB coordinates)
-        Eigen::Matrix3f tfCameraRotationInv = tfCameraRotationTemp.transpose();
-        Eigen::Vector3f tfCameraTranslationInv = -(tfCameraRotationInv * tfCameraTranslationTemp);
-
-        // Transform from ROS coordinate system to ORB coordinate system on camera coordinates
-        tfCameraRotation = tfROSToORB * tfCameraRotationInv;
-        tfCameraTranslation = tfROSToORB * tfCameraTranslationInv;
-
-        // Create and return the Sophus::SE3f object
+        Eigen::Matrix3f tfCameraRotation;
+        Eigen::Vector3f tfCameraTranslation;
+        rosTwcToORBTcw(affineMatrix, tfCameraRotation, tfCameraTranslation);
         return Sophus::SE3f(tfCameraRotation, tfCameraTranslation);
     }
 
     Eigen::Vector3f WrapperTypeConversions::vector3fORBToROS(const Eigen::Vector3f &s)
     {
-        Eigen::Matrix3f tfCameraRotation = Eigen::Matrix3f::Identity();
-        Eigen::Vector3f tfCameraTranslation = s;
-
-        // Coordinate transformation matrix from orb coordinate system to ros coordinate system
-        Eigen::Matrix3f tfORBToROS;
-        tfORBToROS << 0, 0, 1,
-            -1, 0, 0,
-            0, -1, 0;
-
-        // Transform from orb coordinate system to ros coordinate system on camera coordinates
-        Eigen::Matrix3f tfCameraRotationTemp = tfORBToROS * tfCameraRotation;
-        Eigen::Vector3f tfCameraTranslationTemp = tfORBToROS * tfCameraTranslation;
-
-        tfCameraRotation = tfCameraRotationTemp;
-        tfCameraTranslation = tfCameraTranslationTemp;
+        return ORBToROSPermutation::apply(s);
+    }
 
-        return tfCameraTranslation;
+    void WrapperTypeConversions::vector3fORBToROS(const std::vector<Eigen::Vector3f> &points, std::vector<Eigen::Vector3f> &rosPoints)
+    {
+        rosPoints.resize(points.size());
+        if (points.empty())
+            return;
+        ORBToROSPermutation::applyBatch(points.data()->data(), rosPoints.data()->data(), points.size());
     }
 
     Eigen::Affine3d WrapperTypeConversions::se3ToAffine(const Sophus::SE3f &s)
     {
-        Eigen::Affine3d affineTf = se3ORBToROS(s).cast<double>();
-        return affineTf;
+        return orbTcwToROSTwc<double>(s.rotationMatrix(), s.translation());
+    }
+
+    void WrapperTypeConversions::se3ToAffine(const std::vector<Sophus::SE3f> &poses, std::vector<Eigen::Affine3d> &affines)
+    {
+        affines.resize(poses.size());
+        for (size_t i = 0; i < poses.size(); i++)
+            affines[i] = orbTcwToROSTwc<double>(poses[i].rotationMatrix(), poses[i].translation());
     }
 
     Eigen::Affine3f WrapperTypeConversions::poseToAffine(const geometry_msgs::msg::Pose &pose)
@@ -142,106 +98,143 @@ namespace ORB_SLAM3_Wrapper
 
     geometry_msgs::msg::Pose WrapperTypeConversions::se3ToPoseMsg(const Sophus::SE3f &s)
     {
-        Eigen::Affine3d poseTransform = se3ORBToROS(s).cast<double>();
+        Eigen::Affine3d poseTransform = se3ToAffine(s);
         geometry_msgs::msg::Pose pose = tf2::toMsg(poseTransform);
         return pose;
     }
 
-    sensor_msgs::msg::PointCloud2 WrapperTypeConversions::MapPointsToPCL(std::vector<Eigen::Vector3f>& mapPoints)
+    void WrapperTypeConversions::initXYZCloud(sensor_msgs::msg::PointCloud2 &cloud, size_t numPoints)
     {
-        const int numChannels = 3; // x y z
+        initMapPointCloud(cloud, numPoints, CHANNEL_XYZ);
+    }
 
+    sensor_msgs::msg::PointCloud2 WrapperTypeConversions::MapPointsToPCL(std::vector<Eigen::Vector3f>& mapPoints)
+    {
         if (mapPoints.size() == 0)
         {
             std::cout << "Map point vector is empty!" << std::endl;
         }
 
         sensor_msgs::msg::PointCloud2 cloud;
+        initXYZCloud(cloud, mapPoints.size());
+        writeCloudXYZ<IdentityPermutation>(cloud, mapPoints.data(), mapPoints.size());
+        return cloud;
+    }
 
-        // cloud.header.stamp = current_frame_time;
-        cloud.header.frame_id = "map";
-        cloud.height = 1;
-        cloud.width = mapPoints.size();
-        cloud.is_bigendian = false;
-        cloud.is_dense = true;
-        cloud.point_step = numChannels * sizeof(float);
-        cloud.row_step = cloud.point_step * cloud.width;
-        cloud.fields.resize(numChannels);
-
-        std::string channel_id[] = {"x", "y", "z"};
 
-        for (int i = 0; i < numChannels; i++)
+    sensor_msgs::msg::PointCloud2 WrapperTypeConversions::MapPointsToPCL(std::vector<ORB_SLAM3::MapPoint*>& mapPoints, uint32_t channels)
+    {
+        if (mapPoints.size() == 0)
         {
-            cloud.fields[i].name = channel_id[i];
-            cloud.fields[i].offset = i * sizeof(float);
-            cloud.fields[i].count = 1;
-            cloud.fields[i].datatype = sensor_msgs::msg::PointField::FLOAT32;
+            std::cout << "Map point vector is empty!" << std::endl;
         }
 
-        cloud.data.resize(cloud.row_step * cloud.height);
+        std::vector<Eigen::Vector3f> positions;
+        positions.reserve(mapPoints.size());
+        for (auto &mapPoint : mapPoints)
+            positions.push_back(mapPoint->GetWorldPos());
 
-        unsigned char *cloud_data_ptr = &(cloud.data[0]);
-
-        for (unsigned int i = 0; i < cloud.width; i++)
+        sensor_msgs::msg::PointCloud2 cloud;
+        initMapPointCloud(cloud, positions.size(), channels);
+        writeCloudXYZ<ORBToROSPermutation>(cloud, positions.data(), positions.size());
+        if (channels != CHANNEL_XYZ)
         {
-            Eigen::Vector3f point_translation = mapPoints[i];
-
-            float data_array[numChannels] = {
-                point_translation.x(), point_translation.y(), point_translation.z()};
-
-            memcpy(cloud_data_ptr + (i * cloud.point_step), data_array,
-                    numChannels * sizeof(float));
+            std::vector<MapPointChannelValues> values(mapPoints.size());
+            for (size_t i = 0; i < mapPoints.size(); i++)
+            {
+                values[i].observations = static_cast<uint32_t>(mapPoints[i]->Observations());
+                values[i].foundRatio = mapPoints[i]->GetFoundRatio();
+                values[i].keyFrameId = static_cast<uint32_t>(mapPoints[i]->mnFirstKFid);
+                if (channels & CHANNEL_DESCRIPTOR_HASH)
+                {
+                    cv::Mat descriptor = mapPoints[i]->GetDescriptor();
+                    if (!descriptor.empty() && descriptor.isContinuous())
+                        values[i].descriptorHash = descriptorHash(descriptor.ptr<uint8_t>(), descriptor.total() * descriptor.elemSize());
+                }
+            }
+            writeCloudChannels(cloud, values.data(), values.size(), channels);
         }
         return cloud;
     }
 
-
-    sensor_msgs::msg::PointCloud2 WrapperTypeConversions::MapPointsToPCL(std::vector<ORB_SLAM3::MapPoint*>& mapPoints)
+    bool WrapperTypeConversions::mapDataToPacked(const slam_msgs::msg::MapData &mapData, const PointPacking &packing, slam_msgs::msg::PackedMapData &packed)
     {
-        const int numChannels = 3; // x y z
-
-        if (mapPoints.size() == 0)
+        packed.header = mapData.header;
+        packed.graph = mapData.graph;
+        packed.node_ids.resize(mapData.nodes.size());
+        packed.point_counts.resize(mapData.nodes.size());
+        size_t numPoints = 0;
+        for (const auto &node : mapData.nodes)
+            numPoints += node.word_pts.size();
+        std::vector<float> xyz;
+        xyz.reserve(3 * numPoints);
+        for (size_t i = 0; i < mapData.nodes.size(); i++)
         {
-            std::cout << "Map point vector is empty!" << std::endl;
+            const auto &node = mapData.nodes[i];
+            packed.node_ids[i] = node.id;
+            packed.point_counts[i] = static_cast<uint32_t>(node.word_pts.size());
+            for (const auto &point : node.word_pts)
+            {
+                xyz.push_back(static_cast<float>(point.x));
+                xyz.push_back(static_cast<float>(point.y));
+                xyz.push_back(static_cast<float>(point.z));
+            }
         }
+        return packPoints(xyz.data(), numPoints, packing, packed.points);
+    }
 
-        sensor_msgs::msg::PointCloud2 cloud;
-
-        // cloud.header.stamp = current_frame_time;
-        cloud.header.frame_id = "map";
-        cloud.height = 1;
-        cloud.width = mapPoints.size();
-        cloud.is_bigendian = false;
-        cloud.is_dense = true;
-        cloud.point_step = numChannels * sizeof(float);
-        cloud.row_step = cloud.point_step * cloud.width;
-        cloud.fields.resize(numChannels);
-
-        std::string channel_id[] = {"x", "y", "z"};
-
-        for (int i = 0; i < numChannels; i++)
+    bool WrapperTypeConversions::packedToMapData(const slam_msgs::msg::PackedMapData &packed, slam_msgs::msg::MapData &mapData, std::string &message)
+    {
+        if (packed.node_ids.size() != packed.point_counts.size())
         {
-            cloud.fields[i].name = channel_id[i];
-            cloud.fields[i].offset = i * sizeof(float);
-            cloud.fields[i].count = 1;
-            cloud.fields[i].datatype = sensor_msgs::msg::PointField::FLOAT32;
+            message = "node_ids and point_counts differ in size.";
+            return false;
         }
-
-        cloud.data.resize(cloud.row_step * cloud.height);
-
-        unsigned char *cloud_data_ptr = &(cloud.data[0]);
-
-        for (unsigned int i = 0; i < cloud.width; i++)
+        std::vector<float> xyz;
+        if (!unpackPoints(packed.points, xyz, message))
+            return false;
+        size_t numPoints = 0;
+        for (auto count : packed.point_counts)
+            numPoints += count;
+        if (3 * numPoints != xyz.size())
         {
-            Eigen::Vector3f point_translation = vector3fORBToROS(mapPoints[i]->GetWorldPos());
-
-            float data_array[numChannels] = {
-                point_translation.x(), point_translation.y(), point_translation.z()};
+            message = "The point counts do not add up to the packed points.";
+            return false;
+        }
+        mapData.header = packed.header;
+        mapData.graph = packed.graph;
+        mapData.nodes.resize(packed.node_ids.size());
+        const float *point = xyz.data();
+        for (size_t i = 0; i < packed.node_ids.size(); i++)
+        {
+            auto &node = mapData.nodes[i];
+            node.id = packed.node_ids[i];
+            node.word_pts.resize(packed.point_counts[i]);
+            for (auto &wordPoint : node.word_pts)
+            {
+                wordPoint.x = point[0];
+                wordPoint.y = point[1];
+                wordPoint.z = point[2];
+                point += 3;
+            }
+        }
+        return true;
+    }
 
-            memcpy(cloud_data_ptr + (i * cloud.point_step), data_array,
-                    numChannels * sizeof(float));
+    bool WrapperTypeConversions::mapPointsToPacked(const std::vector<ORB_SLAM3::MapPoint*> &mapPoints, const PointPacking &packing, slam_msgs::msg::PackedMapPoints &packed)
+    {
+        std::vector<Eigen::Vector3f> positions(mapPoints.size());
+        packed.observer_counts.resize(mapPoints.size());
+        packed.observer_ids.clear();
+        for (size_t i = 0; i < mapPoints.size(); i++)
+        {
+            positions[i] = ORBToROSPermutation::apply(mapPoints[i]->GetWorldPos());
+            const auto observations = mapPoints[i]->GetObservations();
+            packed.observer_counts[i] = static_cast<uint32_t>(observations.size());
+            for (const auto &observation : observations)
+                packed.observer_ids.push_back(static_cast<int32_t>(observation.first->mnId));
         }
-        return cloud;
+        return packPoints(positions.empty() ? nullptr : positions.data()->data(), positions.size(), packing, packed.positions);
     }
 
     template <>
@@ -0,0 +1,141 @@
+/**
+ * @file visibility_kernel.cpp
+ * @brief Batched map point visibility tests on a structure-of-arrays snapshot.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#include "orb_slam3_ros2_wrapper/visibility_kernel.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace ORB_SLAM3_Wrapper
+{
+    void MapPointSoA::clear()
+    {
+        x.clear();
+        y.clear();
+        z.clear();
+        nx.clear();
+        ny.clear();
+        nz.clear();
+        minDistance.clear();
+        maxDistance.clear();
+    }
+
+    void MapPointSoA::reserve(size_t numPoints)
+    {
+        x.reserve(numPoints);
+        y.reserve(numPoints);
+        z.reserve(numPoints);
+        nx.reserve(numPoints);
+        ny.reserve(numPoints);
+        nz.reserve(numPoints);
+        minDistance.reserve(numPoints);
+        maxDistance.reserve(numPoints);
+    }
+
+    void MapPointSoA::push_back(const Eigen::Vector3f &position, const Eigen::Vector3f &normal, float minDist, float maxDist)
+    {
+        x.push_back(position.x());
+        y.push_back(position.y());
+        z.push_back(position.z());
+        nx.push_back(normal.x());
+        ny.push_back(normal.y());
+        nz.push_back(normal.z());
+        minDistance.push_back(minDist);
+        maxDistance.push_back(maxDist);
+    }
+
+    void computeVisibilityScalar(const MapPointSoA &points, const PinholeFrustum &frustum,
+                                 const VisibilityQuery &query, std::vector<uint8_t> &visible)
+    {
+        const size_t numPoints = points.size();
+        visible.resize(numPoints);
+        const Eigen::Matrix3f &R = query.Rcw;
+        const Eigen::Vector3f &t = query.tcw;
+        for (size_t i = 0; i < numPoints; i++)
+        {
+            visible[i] = 0;
+            // 3D in camera coordinates
+            const float xc = R(0, 0) * points.x[i] + R(0, 1) * points.y[i] + R(0, 2) * points.z[i] + t(0);
+            const float yc = R(1, 0) * points.x[i] + R(1, 1) * points.y[i] + R(1, 2) * points.z[i] + t(1);
+            const float zc = R(2, 0) * points.x[i] + R(2, 1) * points.y[i] + R(2, 2) * points.z[i] + t(2);
+            // Check positive depth
+            if (zc < 0.0f)
+                continue;
+            const float invz = 1.0f / zc;
+            const float u = frustum.fx * xc * invz + frustum.cx;
+            const float v = frustum.fy * yc * invz + frustum.cy;
+            if (u < frustum.minX || u > frustum.maxX || v < frustum.minY || v > frustum.maxY)
+                continue;
+            // Check distance is in the scale invariance region of the MapPoint
+            const float dx = points.x[i] - query.Ow(0);
+            const float dy = points.y[i] - query.Ow(1);
+            const float dz = points.z[i] - query.Ow(2);
+            const float dist = std::sqrt(dx * dx + dy * dy + dz * dz);
+            if (dist < points.minDistance[i] || dist > points.maxDistance[i])
+                continue;
+            // Check viewing angle. (PO.dot(Pn) / dist < limit) without the division.
+            const float viewDot = dx * points.nx[i] + dy * points.ny[i] + dz * points.nz[i];
+            if (viewDot < query.viewingCosLimit * dist)
+                continue;
+            visible[i] = 1;
+        }
+    }
+
+#ifdef ORB_WRAPPER_SCALAR_VISIBILITY
+    void computeVisibility(const MapPointSoA &points, const PinholeFrustum &frustum,
+                           const VisibilityQuery &query, std::vector<uint8_t> &visible)
+    {
+        computeVisibilityScalar(points, frustum, query, visible);
+    }
+#else
+    void computeVisibility(const MapPointSoA &points, const PinholeFrustum &frustum,
+                           const VisibilityQuery &query, std::vector<uint8_t> &visible)
+    {
+        // blocks are small enough for the temporaries to live on the stack and in L1.
+        constexpr Eigen::Index kBlockSize = 256;
+        typedef Eigen::Array<float, Eigen::Dynamic, 1, 0, kBlockSize, 1> BlockArray;
+        typedef Eigen::Array<uint8_t, Eigen::Dynamic, 1, 0, kBlockSize, 1> BlockMask;
+        typedef Eigen::Map<const Eigen::ArrayXf> ConstColumn;
+
+        const Eigen::Index numPoints = static_cast<Eigen::Index>(points.size());
+        visible.resize(points.size());
+        const Eigen::Matrix3f &R = query.Rcw;
+        const Eigen::Vector3f &t = query.tcw;
+
+        for (Eigen::Index start = 0; start < numPoints; start += kBlockSize)
+        {
+            const Eigen::Index len = std::min(kBlockSize, numPoints - start);
+            const ConstColumn X(points.x.data() + start, len);
+            const ConstColumn Y(points.y.data() + start, len);
+            const ConstColumn Z(points.z.data() + start, len);
+
+            const BlockArray xc = R(0, 0) * X + R(0, 1) * Y + R(0, 2) * Z + t(0);
+            const BlockArray yc = R(1, 0) * X + R(1, 1) * Y + R(1, 2) * Z + t(1);
+            const BlockArray zc = R(2, 0) * X + R(2, 1) * Y + R(2, 2) * Z + t(2);
+            const BlockArray invz = zc.inverse();
+            const BlockArray u = frustum.fx * xc * invz + frustum.cx;
+            const BlockArray v = frustum.fy * yc * invz + frustum.cy;
+
+            const BlockArray dx = X - query.Ow(0);
+            const BlockArray dy = Y - query.Ow(1);
+            const BlockArray dz = Z - query.Ow(2);
+            const BlockArray dist = (dx * dx + dy * dy + dz * dz).sqrt();
+            const BlockArray viewDot = dx * ConstColumn(points.nx.data() + start, len) +
+                                       dy * ConstColumn(points.ny.data() + start, len) +
+                                       dz * ConstColumn(points.nz.data() + start, len);
+
+            const BlockMask mask = ((zc >= 0.0f) &&
+                                    (u >= frustum.minX) && (u <= frustum.maxX) &&
+                                    (v >= frustum.minY) && (v <= frustum.maxY) &&
+                                    (dist >= ConstColumn(points.minDistance.data() + start, len)) &&
+                                    (dist <= ConstColumn(points.maxDistance.data() + start, len)) &&
+                                    (viewDot >= query.viewingCosLimit * dist))
+                                       .cast<uint8_t>();
+            Eigen::Map<Eigen::Array<uint8_t, Eigen::Dynamic, 1>>(visible.data() + start, len) = mask;
+        }
+    }
+#endif
+}
@@ -0,0 +1,48 @@
+/**
+ * @file vocabulary_cache.cpp
+ * @brief Process wide cache of loaded ORB vocabularies.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#include "orb_slam3_ros2_wrapper/vocabulary_cache.hpp"
+
+#include <chrono>
+#include <iostream>
+
+#include "orb_slam3_ros2_wrapper/binary_vocabulary.hpp"
+
+namespace ORB_SLAM3_Wrapper
+{
+    std::mutex VocabularyCache::mutex_;
+    std::map<std::string, std::weak_ptr<ORB_SLAM3::ORBVocabulary>> VocabularyCache::vocabularies_;
+
+    std::shared_ptr<ORB_SLAM3::ORBVocabulary> VocabularyCache::get(const std::string &path, double *loadSeconds)
+    {
+        // held while loading so that robots starting together wait for the first load instead of repeating it.
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (loadSeconds)
+            *loadSeconds = 0.0;
+        auto shared = vocabularies_[path].lock();
+        if (shared)
+        {
+            std::cout << "Sharing the already loaded vocabulary " << path << std::endl;
+            return shared;
+        }
+        auto vocabulary = std::make_shared<BinaryVocabulary>();
+        std::cout << "Loading the vocabulary " << path << std::endl;
+        auto start = std::chrono::steady_clock::now();
+        const bool loaded = vocabulary->loadFromFile(path);
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (loadSeconds)
+            *loadSeconds = seconds;
+        if (!loaded)
+        {
+            std::cerr << "Could not load the vocabulary " << path << std::endl;
+            vocabularies_.erase(path);
+            return nullptr;
+        }
+        std::cout << "Vocabulary loaded in " << seconds << " s" << std::endl;
+        vocabularies_[path] = vocabulary;
+        return vocabulary;
+    }
+}
@@ -0,0 +1,115 @@
+/**
+ * @file worker_pool.cpp
+ * @brief Persistent worker threads for the parallel map queries.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#include "orb_slam3_ros2_wrapper/worker_pool.hpp"
+
+#include <algorithm>
+
+namespace ORB_SLAM3_Wrapper
+{
+    std::mutex WorkerPool::sharedMutex_;
+    std::weak_ptr<WorkerPool> WorkerPool::shared_;
+
+    WorkerPool::WorkerPool(size_t numWorkers)
+    {
+        workers_.reserve(numWorkers);
+        for (size_t i = 0; i < numWorkers; i++)
+            workers_.emplace_back(&WorkerPool::workerLoop, this);
+    }
+
+    WorkerPool::~WorkerPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            running_ = false;
+        }
+        condition_.notify_all();
+        for (auto &worker : workers_)
+            worker.join();
+    }
+
+    void WorkerPool::runTasks(Job &job)
+    {
+        for (size_t i = job.next++; i < job.numTasks; i = job.next++)
+        {
+            (*job.task)(i);
+            if (--job.remaining == 0)
+            {
+                // taken so that the caller cannot miss the notification between its check and its wait.
+                std::lock_guard<std::mutex> lock(job.mutex);
+                job.done.notify_all();
+            }
+        }
+    }
+
+    void WorkerPool::parallelFor(size_t numTasks, const std::function<void(size_t)> &task)
+    {
+        if (numTasks == 0)
+            return;
+        if (workers_.empty() || numTasks == 1)
+        {
+            for (size_t i = 0; i < numTasks; i++)
+                task(i);
+            return;
+        }
+        auto job = std::make_shared<Job>();
+        job->task = &task;
+        job->numTasks = numTasks;
+        job->remaining = numTasks;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            jobs_.push_back(job);
+        }
+        condition_.notify_all();
+        runTasks(*job);
+        {
+            // every task is started, the workers need not look at the job anymore.
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = std::find(jobs_.begin(), jobs_.end(), job);
+            if (it != jobs_.end())
+                jobs_.erase(it);
+        }
+        std::unique_lock<std::mutex> lock(job->mutex);
+        job->done.wait(lock, [&job]()
+                       { return job->remaining == 0; });
+    }
+
+    void WorkerPool::workerLoop()
+    {
+        while (true)
+        {
+            std::shared_ptr<Job> job;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                condition_.wait(lock, [this]()
+                                { return !running_ || !jobs_.empty(); });
+                if (!running_)
+                    return;
+                job = jobs_.front();
+                // the job stays queued for the other workers until it has no task left to start.
+                if (job->next >= job->numTasks)
+                {
+                    jobs_.pop_front();
+                    continue;
+                }
+            }
+            runTasks(*job);
+        }
+    }
+
+    std::shared_ptr<WorkerPool> WorkerPool::shared(size_t numThreads)
+    {
+        std::lock_guard<std::mutex> lock(sharedMutex_);
+        auto pool = shared_.lock();
+        if (pool)
+            return pool;
+        if (numThreads == 0)
+            numThreads = std::max(1u, std::thread::hardware_concurrency());
+        pool = std::make_shared<WorkerPool>(numThreads - 1);
+        shared_ = pool;
+        return pool;
+    }
+}
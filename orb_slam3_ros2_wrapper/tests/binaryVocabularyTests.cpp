@@ -0,0 +1,79 @@
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <random>
+#include <vector>
+#include <opencv2/core/core.hpp>
+#include "orb_slam3_ros2_wrapper/binary_vocabulary.hpp"
+
+using ORB_SLAM3_Wrapper::BinaryVocabulary;
+
+namespace
+{
+    cv::Mat randomDescriptor(std::mt19937 &rng)
+    {
+        cv::Mat descriptor(1, DBoW2::FORB::L, CV_8U);
+        std::uniform_int_distribution<int> byte(0, 255);
+        for (int i = 0; i < DBoW2::FORB::L; i++)
+            descriptor.at<uint8_t>(0, i) = static_cast<uint8_t>(byte(rng));
+        return descriptor;
+    }
+}
+
+TEST(BinaryVocabularyTest, RoundTripMatchesTextVocabulary) {
+    std::mt19937 rng(7);
+    std::vector<std::vector<cv::Mat>> features(20);
+    for (auto &image : features)
+    {
+        for (int i = 0; i < 50; i++)
+            image.push_back(randomDescriptor(rng));
+    }
+    BinaryVocabulary created;
+    created.create(features, 4, 3);
+    const std::string textPath = "/tmp/orb_wrapper_test_voc.txt";
+    const std::string binaryPath = "/tmp/orb_wrapper_test_voc.bin";
+    created.saveToTextFile(textPath);
+    ASSERT_TRUE(created.saveToBinaryFile(binaryPath));
+
+    // the extension picks the loader.
+    BinaryVocabulary text, binary;
+    ASSERT_TRUE(text.loadFromFile(textPath));
+    ASSERT_TRUE(binary.loadFromFile(binaryPath));
+    ASSERT_EQ(binary.size(), text.size());
+    ASSERT_EQ(binary.getBranchingFactor(), text.getBranchingFactor());
+    ASSERT_EQ(binary.getDepthLevels(), text.getDepthLevels());
+    ASSERT_EQ(binary.getScoringType(), text.getScoringType());
+
+    // same words and weights for unseen descriptors.
+    for (int i = 0; i < 100; i++)
+    {
+        std::vector<cv::Mat> image = {randomDescriptor(rng), randomDescriptor(rng)};
+        DBoW2::BowVector textBow, binaryBow;
+        DBoW2::FeatureVector textFeatures, binaryFeatures;
+        text.transform(image, textBow, textFeatures, 1);
+        binary.transform(image, binaryBow, binaryFeatures, 1);
+        ASSERT_EQ(textBow, binaryBow);
+        ASSERT_EQ(textFeatures, binaryFeatures);
+    }
+    std::remove(textPath.c_str());
+    std::remove(binaryPath.c_str());
+}
+
+TEST(BinaryVocabularyTest, RejectsOtherFiles) {
+    const std::string path = "/tmp/orb_wrapper_test_not_voc.bin";
+    FILE *file = std::fopen(path.c_str(), "wb");
+    ASSERT_NE(file, nullptr);
+    std::fputs("not a vocabulary", file);
+    std::fclose(file);
+    BinaryVocabulary vocabulary;
+    ASSERT_FALSE(vocabulary.loadFromBinaryFile(path));
+    ASSERT_FALSE(vocabulary.loadFromBinaryFile("/tmp/does_not_exist.bin"));
+    ASSERT_TRUE(BinaryVocabulary::isBinaryVocabularyPath("ORBvoc.bin"));
+    ASSERT_FALSE(BinaryVocabulary::isBinaryVocabularyPath("ORBvoc.txt"));
+    std::remove(path.c_str());
+}
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,65 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <opencv2/imgproc/imgproc.hpp>
+#include "orb_slam3_ros2_wrapper/feature_backend.hpp"
+
+using ORB_SLAM3_Wrapper::FeatureBackend;
+using ORB_SLAM3_Wrapper::grayConversionCode;
+using ORB_SLAM3_Wrapper::makeFeatureBackend;
+
+TEST(FeatureBackendTest, GrayConversionCodes) {
+    ASSERT_EQ(grayConversionCode("rgb8"), cv::COLOR_RGB2GRAY);
+    ASSERT_EQ(grayConversionCode("bgr8"), cv::COLOR_BGR2GRAY);
+    ASSERT_EQ(grayConversionCode("bgra8"), cv::COLOR_BGRA2GRAY);
+    // one channel images go to ORB_SLAM3 as they are.
+    ASSERT_EQ(grayConversionCode("mono8"), -1);
+    ASSERT_EQ(grayConversionCode("16UC1"), -1);
+    ASSERT_EQ(grayConversionCode("32FC1"), -1);
+}
+
+TEST(FeatureBackendTest, SelectionAndFallback) {
+    std::string resolved, message;
+    ASSERT_FALSE(makeFeatureBackend("orb", resolved, message));
+    ASSERT_EQ(resolved, "orb");
+    ASSERT_TRUE(message.empty());
+
+    auto cpu = makeFeatureBackend("cpu", resolved, message);
+    ASSERT_TRUE(cpu);
+    ASSERT_EQ(resolved, "cpu");
+    ASSERT_STREQ(cpu->name(), "cpu");
+
+    ASSERT_FALSE(makeFeatureBackend("fpga", resolved, message));
+    ASSERT_EQ(resolved, "orb");
+    ASSERT_FALSE(message.empty());
+}
+
+TEST(FeatureBackendTest, CpuBackendConvertsColorImagesOnly) {
+    std::string resolved, message;
+    auto backend = makeFeatureBackend("cpu", resolved, message);
+    ASSERT_TRUE(backend);
+
+    cv::Mat rgb(4, 6, CV_8UC3, cv::Scalar(200, 100, 50));
+    cv::Mat depth(4, 6, CV_16UC1, cv::Scalar(1000));
+    auto prepared = backend->prepare(rgb, grayConversionCode("rgb8"), depth, grayConversionCode("16UC1"));
+    ASSERT_TRUE(prepared);
+
+    cv::Mat first = rgb;
+    cv::Mat second = depth;
+    prepared->wait(first, second);
+    cv::Mat expected;
+    cv::cvtColor(rgb, expected, cv::COLOR_RGB2GRAY);
+    ASSERT_EQ(first.type(), CV_8UC1);
+    ASSERT_EQ(cv::countNonZero(first != expected), 0);
+    // the depth image is untouched.
+    ASSERT_EQ(second.data, depth.data);
+
+    // nothing to convert.
+    cv::Mat mono(4, 6, CV_8UC1, cv::Scalar(7));
+    ASSERT_FALSE(backend->prepare(mono, -1, cv::Mat(), -1));
+}
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
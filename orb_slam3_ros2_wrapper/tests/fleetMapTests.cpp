@@ -0,0 +1,192 @@
+#include <gtest/gtest.h>
+#include <random>
+#include "orb_slam3_ros2_wrapper/fleet_map.hpp"
+
+using namespace ORB_SLAM3_Wrapper;
+
+namespace
+{
+    OrbDescriptor randomDescriptor(std::mt19937 &random)
+    {
+        OrbDescriptor descriptor;
+        for (auto &byte : descriptor)
+            byte = static_cast<uint8_t>(random() & 0xff);
+        return descriptor;
+    }
+
+    /**
+     * @brief A keyframe seeing the given points (keyframe frame), with its words.
+     */
+    std::shared_ptr<FleetKeyFrame> makeKeyFrame(int robot, int32_t id, const std::vector<uint32_t> &words,
+                                                const std::vector<Eigen::Vector3f> &points,
+                                                const std::vector<OrbDescriptor> &descriptors)
+    {
+        auto keyFrame = std::make_shared<FleetKeyFrame>();
+        keyFrame->robot = robot;
+        keyFrame->id = id;
+        for (auto word : words)
+            keyFrame->words.emplace_back(word, 1.0f);
+        normalizeBowVector(keyFrame->words);
+        keyFrame->points = points;
+        keyFrame->descriptors = descriptors;
+        return keyFrame;
+    }
+
+    Eigen::Affine3d makePose(double x, double y, double yaw)
+    {
+        return Eigen::Affine3d(Eigen::Translation3d(x, y, 0.0) * Eigen::AngleAxisd(yaw, Eigen::Vector3d::UnitZ()));
+    }
+}
+
+TEST(FleetMapTest, BandwidthBudget) {
+    // 1000 bytes/s, 500 bytes of burst.
+    BandwidthBudget budget(1000.0, 500.0);
+    ASSERT_TRUE(budget.consume(400, 0.0));
+    ASSERT_FALSE(budget.consume(400, 0.0));
+    ASSERT_TRUE(budget.consume(400, 0.3));
+    // a message larger than the burst waits for a full bucket, then goes into debt.
+    ASSERT_FALSE(budget.consume(2000, 0.5));
+    ASSERT_TRUE(budget.consume(2000, 1.0));
+    ASSERT_LT(budget.available(1.0), 0.0);
+    ASSERT_FALSE(budget.consume(100, 2.0));
+    ASSERT_TRUE(budget.consume(100, 2.7));
+
+    BandwidthBudget unlimited(0.0, 0.0);
+    ASSERT_TRUE(unlimited.consume(1 << 30, 0.0));
+}
+
+TEST(FleetMapTest, BowScoreAndDatabaseQuery) {
+    std::vector<std::pair<uint32_t, float>> words = {{7, 2.0f}, {3, 1.0f}, {7, 1.0f}};
+    normalizeBowVector(words);
+    ASSERT_EQ(words.size(), 2u);
+    ASSERT_EQ(words[0].first, 3u);
+    ASSERT_FLOAT_EQ(words[0].second, 0.25f);
+    ASSERT_FLOAT_EQ(words[1].second, 0.75f);
+    ASSERT_FLOAT_EQ(bowL1Score(words, words), 1.0f);
+
+    FleetKeyFrameDatabase database;
+    database.add(makeKeyFrame(0, 1, {1, 2, 3, 4}, {}, {}), Eigen::Affine3d::Identity());
+    database.add(makeKeyFrame(1, 1, {1, 2, 3, 9}, {}, {}), Eigen::Affine3d::Identity());
+    database.add(makeKeyFrame(1, 2, {1, 8, 9, 10}, {}, {}), Eigen::Affine3d::Identity());
+    database.add(makeKeyFrame(2, 1, {20, 21}, {}, {}), Eigen::Affine3d::Identity());
+    ASSERT_EQ(database.size(), 4u);
+    ASSERT_EQ(database.size(1), 2u);
+
+    // the keyframes of the querying robot are never candidates.
+    auto query = makeKeyFrame(0, 2, {1, 2, 3, 4}, {}, {});
+    std::vector<FleetKeyFrameDatabase::Candidate> candidates;
+    database.query(*query, 0.0f, 0, candidates);
+    ASSERT_EQ(candidates.size(), 2u);
+    ASSERT_EQ(candidates[0].keyFrame->robot, 1);
+    ASSERT_EQ(candidates[0].keyFrame->id, 1);
+    ASSERT_FLOAT_EQ(candidates[0].score, 0.75f);
+    ASSERT_FLOAT_EQ(candidates[1].score, 0.25f);
+    ASSERT_FLOAT_EQ(candidates[0].score, bowL1Score(query->words, candidates[0].keyFrame->words));
+    database.query(*query, 0.5f, 0, candidates);
+    ASSERT_EQ(candidates.size(), 1u);
+
+    database.remove(1, 1);
+    database.query(*query, 0.5f, 0, candidates);
+    ASSERT_TRUE(candidates.empty());
+    database.retain(1, {});
+    ASSERT_EQ(database.size(1), 0u);
+    ASSERT_EQ(database.size(), 2u);
+    Eigen::Affine3d pose;
+    ASSERT_FALSE(database.pose(1, 2, pose));
+    ASSERT_TRUE(database.updatePose(2, 1, makePose(1.0, 2.0, 0.0)));
+    ASSERT_TRUE(database.pose(2, 1, pose));
+    ASSERT_NEAR(pose.translation().y(), 2.0, 1e-12);
+}
+
+TEST(FleetMapTest, MatchesAndAlignsOverlappingKeyFrames) {
+    std::mt19937 random(42);
+    std::uniform_real_distribution<float> coordinate(-3.0f, 3.0f);
+    // B sees the same scene from its own keyframe frame, plus outliers.
+    const Eigen::Affine3d bToA = makePose(0.5, -1.0, 0.4);
+    std::vector<Eigen::Vector3f> pointsA, pointsB;
+    std::vector<OrbDescriptor> descriptorsA, descriptorsB;
+    for (int i = 0; i < 80; i++)
+    {
+        Eigen::Vector3f point(coordinate(random), coordinate(random), coordinate(random) + 4.0f);
+        pointsA.push_back(point);
+        pointsB.push_back((bToA.inverse() * point.cast<double>()).cast<float>());
+        OrbDescriptor descriptor = randomDescriptor(random);
+        descriptorsA.push_back(descriptor);
+        // a few flipped bits.
+        descriptor[i % 32] ^= 0x5;
+        descriptorsB.push_back(descriptor);
+    }
+    for (int i = 0; i < 20; i++)
+    {
+        pointsB.push_back(Eigen::Vector3f(coordinate(random), coordinate(random), coordinate(random)));
+        descriptorsB.push_back(randomDescriptor(random));
+    }
+
+    std::vector<DescriptorMatch> matches;
+    matchDescriptors(descriptorsA, descriptorsB, 50, 0.8f, matches);
+    ASSERT_EQ(matches.size(), 80u);
+    for (const auto &match : matches)
+        ASSERT_EQ(match.query, match.train);
+
+    // 32 of the 80 matches are wrong.
+    std::vector<Eigen::Vector3f> source, target;
+    for (const auto &match : matches)
+    {
+        source.push_back(pointsB[match.train]);
+        target.push_back(pointsA[match.query]);
+    }
+    for (size_t i = 0; i < 16; i++)
+        std::swap(source[i], source[source.size() - 1 - i]);
+    RigidAlignment alignment;
+    ASSERT_TRUE(estimateRigidTransformRansac(source, target, 200, 0.05, 30, 1, alignment));
+    ASSERT_EQ(alignment.inliers.size(), 48u);
+    ASSERT_TRUE(alignment.transform.isApprox(bToA, 1e-5));
+    ASSERT_FALSE(estimateRigidTransformRansac(source, target, 200, 0.05, 60, 1, alignment));
+
+    // the robot frames follow from the keyframe poses.
+    FleetKeyFrameDatabase database;
+    const Eigen::Affine3d poseA = makePose(2.0, 1.0, 0.1);
+    const Eigen::Affine3d poseB = makePose(-4.0, 3.0, -0.7);
+    database.add(makeKeyFrame(0, 10, {1}, pointsA, descriptorsA), poseA);
+    database.add(makeKeyFrame(1, 20, {1}, pointsB, descriptorsB), poseB);
+    FleetAlignmentGraph graph;
+    FleetLoop loop;
+    loop.robotA = 1;
+    loop.keyFrameA = 20;
+    loop.robotB = 0;
+    loop.keyFrameB = 10;
+    loop.relative = bToA.inverse();
+    loop.inliers = 48;
+    ASSERT_TRUE(graph.addLoop(loop));
+    // a weaker loop of the same pair does not replace it.
+    loop.inliers = 10;
+    ASSERT_FALSE(graph.addLoop(loop));
+    ASSERT_EQ(graph.numLoops(), 1u);
+
+    std::vector<Eigen::Affine3d> references;
+    std::vector<bool> connected;
+    graph.solve(database, 0, 3, references, connected);
+    ASSERT_TRUE(connected[0]);
+    ASSERT_TRUE(connected[1]);
+    ASSERT_FALSE(connected[2]);
+    ASSERT_TRUE(references[0].isApprox(Eigen::Affine3d::Identity()));
+    // the keyframe of robot 1 lands where robot 0 sees it.
+    ASSERT_TRUE((references[1] * poseB).isApprox(poseA * bToA, 1e-9));
+
+    // robot 1 corrects its map: the reference follows.
+    const Eigen::Affine3d correctedB = makePose(-3.0, 3.5, -0.6);
+    ASSERT_TRUE(database.updatePose(1, 20, correctedB));
+    graph.solve(database, 0, 3, references, connected);
+    ASSERT_TRUE((references[1] * correctedB).isApprox(poseA * bToA, 1e-9));
+
+    // without the keyframe the robot is disconnected.
+    database.remove(1, 20);
+    graph.solve(database, 0, 3, references, connected);
+    ASSERT_FALSE(connected[1]);
+}
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,100 @@
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+#include "orb_slam3_ros2_wrapper/imu_ring_buffer.hpp"
+
+using ORB_SLAM3_Wrapper::ImuRingBuffer;
+using ORB_SLAM3_Wrapper::ImuSample;
+
+namespace
+{
+    ImuSample sample(int64_t stampNs)
+    {
+        ImuSample s{};
+        s.stampNs = stampNs;
+        s.acc[0] = static_cast<float>(stampNs);
+        return s;
+    }
+}
+
+TEST(ImuRingBufferTest, WindowExtraction) {
+    ImuRingBuffer ring(5);
+    // rounded up to a power of two.
+    ASSERT_EQ(ring.capacity(), 8u);
+    for (int64_t t = 10; t <= 80; t += 10)
+        ASSERT_TRUE(ring.push(sample(t)));
+    // full.
+    ASSERT_FALSE(ring.push(sample(90)));
+    ASSERT_EQ(ring.overflows(), 1u);
+
+    int64_t newest = 0;
+    ASSERT_TRUE(ring.newestStamp(newest));
+    ASSERT_EQ(newest, 80);
+
+    std::vector<ImuSample> window;
+    // the frame stamp itself is included.
+    ASSERT_EQ(ring.popUntil(30, window), 3u);
+    ASSERT_EQ(window.size(), 3u);
+    ASSERT_EQ(window.front().stampNs, 10);
+    ASSERT_EQ(window.back().stampNs, 30);
+    ASSERT_EQ(window.back().acc[0], 30.0f);
+
+    window.clear();
+    ASSERT_EQ(ring.popUntil(35, window), 0u);
+    ASSERT_EQ(ring.popUntil(45, window), 1u);
+    ASSERT_EQ(window.back().stampNs, 40);
+
+    // wraps around the end of the storage.
+    for (int64_t t = 90; t <= 120; t += 10)
+        ASSERT_TRUE(ring.push(sample(t)));
+    window.clear();
+    ASSERT_EQ(ring.popUntil(1000, window), 8u);
+    for (size_t i = 0; i < window.size(); i++)
+        ASSERT_EQ(window[i].stampNs, 50 + 10 * static_cast<int64_t>(i));
+    ASSERT_FALSE(ring.newestStamp(newest));
+}
+
+TEST(ImuRingBufferTest, RejectsOutOfOrderSamples) {
+    ImuRingBuffer ring(4);
+    ASSERT_TRUE(ring.push(sample(100)));
+    ASSERT_FALSE(ring.push(sample(50)));
+    ASSERT_TRUE(ring.push(sample(100)));
+    ASSERT_EQ(ring.outOfOrder(), 1u);
+    ASSERT_EQ(ring.size(), 2u);
+    ASSERT_EQ(ORB_SLAM3_Wrapper::toNanoseconds(3, 250), 3000000250LL);
+}
+
+TEST(ImuRingBufferTest, ProducerConsumerThreads) {
+    ImuRingBuffer ring(64);
+    const int64_t numSamples = 200000;
+    std::thread producer([&ring, numSamples]()
+                         {
+        for (int64_t t = 1; t <= numSamples; t++)
+        {
+            while (!ring.push(sample(t)))
+                std::this_thread::yield();
+        } });
+
+    std::vector<ImuSample> window;
+    window.reserve(ring.capacity());
+    int64_t expected = 1;
+    // frames every 50 samples.
+    for (int64_t frame = 50; frame <= numSamples; frame += 50)
+    {
+        int64_t newest = 0;
+        while (!ring.newestStamp(newest) || newest < frame)
+            std::this_thread::yield();
+        window.clear();
+        ring.popUntil(frame, window);
+        for (const auto &s : window)
+            ASSERT_EQ(s.stampNs, expected++);
+    }
+    producer.join();
+    ASSERT_EQ(expected, numSamples + 1);
+}
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
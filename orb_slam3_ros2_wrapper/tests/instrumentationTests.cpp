@@ -0,0 +1,102 @@
+#include <gtest/gtest.h>
+#include <cmath>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+#include "orb_slam3_ros2_wrapper/instrumentation.hpp"
+
+using ORB_SLAM3_Wrapper::HistogramSnapshot;
+using ORB_SLAM3_Wrapper::LatencyHistogram;
+
+TEST(InstrumentationTest, BucketsCoverValuesContiguously) {
+    size_t previous = 0;
+    for (uint64_t ns = 0; ns < (1u << 20); ns++)
+    {
+        const size_t index = LatencyHistogram::bucketIndex(ns);
+        ASSERT_TRUE(index == previous || index == previous + 1) << "ns " << ns;
+        ASSERT_LE(static_cast<double>(ns), LatencyHistogram::bucketUpperBound(index));
+        // the bucket value is within the relative resolution of the histogram.
+        ASSERT_LE(std::abs(LatencyHistogram::bucketValue(index) - ns), 0.07 * ns + 0.5) << "ns " << ns;
+        previous = index;
+    }
+    ASSERT_EQ(LatencyHistogram::bucketIndex(UINT64_MAX), LatencyHistogram::kNumBuckets - 1);
+}
+
+TEST(InstrumentationTest, QuantilesAndWindows) {
+    LatencyHistogram histogram;
+    // 1..1000 us.
+    for (uint64_t us = 1; us <= 1000; us++)
+        histogram.record(std::chrono::microseconds(us));
+    const HistogramSnapshot first = histogram.snapshot();
+    ASSERT_EQ(first.count, 1000u);
+    ASSERT_EQ(first.sumNs, 500500000u);
+    ASSERT_NEAR(first.quantileNs(0.5), 500e3, 0.07 * 500e3);
+    ASSERT_NEAR(first.quantileNs(0.99), 990e3, 0.07 * 990e3);
+    ASSERT_NEAR(first.maxNs(), 1000e3, 0.13 * 1000e3);
+
+    // only the values recorded after the first snapshot are in the window.
+    for (int i = 0; i < 10; i++)
+        histogram.record(std::chrono::milliseconds(50));
+    const HistogramSnapshot window = histogram.snapshot().since(first);
+    ASSERT_EQ(window.count, 10u);
+    ASSERT_NEAR(window.quantileNs(0.5), 50e6, 0.07 * 50e6);
+    ASSERT_EQ(HistogramSnapshot().quantileNs(0.5), 0.0);
+}
+
+TEST(InstrumentationTest, ConcurrentRecording) {
+    LatencyHistogram histogram;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++)
+        threads.emplace_back([&histogram, t]()
+                             {
+            for (uint64_t i = 0; i < 100000; i++)
+                histogram.record(i * (t + 1)); });
+    for (auto &thread : threads)
+        thread.join();
+    const auto snapshot = histogram.snapshot();
+    ASSERT_EQ(snapshot.count, 400000u);
+    uint64_t total = 0;
+    for (auto c : snapshot.counts)
+        total += c;
+    ASSERT_EQ(total, 400000u);
+}
+
+TEST(InstrumentationTest, RegistryCollectAndPrometheusText) {
+    ORB_SLAM3_Wrapper::MetricsRegistry registry;
+    auto &track = registry.histogram("track_rgbd", "ORB_SLAM3 TrackRGBD latency.");
+    // the same name returns the same metric.
+    ASSERT_EQ(&track, &registry.histogram("track_rgbd"));
+    {
+        ORB_SLAM3_Wrapper::ScopedTimer timer(track);
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    registry.gauge("keyframes").set(42);
+
+    std::map<std::string, HistogramSnapshot> windows;
+    auto samples = registry.collect(windows);
+    ASSERT_EQ(samples.size(), 2u);
+    ASSERT_TRUE(samples[0].isLatency);
+    ASSERT_EQ(samples[0].count, 1u);
+    ASSERT_EQ(samples[0].windowCount, 1u);
+    ASSERT_GE(samples[0].p50Seconds, 0.0018);
+    ASSERT_EQ(samples[1].value, 42.0);
+
+    // nothing new since the last collect.
+    samples = registry.collect(windows);
+    ASSERT_EQ(samples[0].count, 1u);
+    ASSERT_EQ(samples[0].windowCount, 0u);
+
+    const std::string text = ORB_SLAM3_Wrapper::formatPrometheus(samples, "orb");
+    ASSERT_NE(text.find("# HELP orb_track_rgbd_seconds ORB_SLAM3 TrackRGBD latency.\n"), std::string::npos);
+    ASSERT_NE(text.find("# TYPE orb_track_rgbd_seconds summary\n"), std::string::npos);
+    ASSERT_NE(text.find("orb_track_rgbd_seconds{quantile=\"0.99\"} "), std::string::npos);
+    ASSERT_NE(text.find("orb_track_rgbd_seconds_count 1\n"), std::string::npos);
+    ASSERT_NE(text.find("# TYPE orb_keyframes gauge\norb_keyframes 42\n"), std::string::npos);
+}
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
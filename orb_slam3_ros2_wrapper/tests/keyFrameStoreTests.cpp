@@ -0,0 +1,111 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include "orb_slam3_ros2_wrapper/keyframe_store.hpp"
+
+using ORB_SLAM3_Wrapper::MappedKeyFrameStore;
+using ORB_SLAM3_Wrapper::StoredKeyFrame;
+using ORB_SLAM3_Wrapper::StoredMapPoint;
+
+namespace
+{
+    std::string storePath(const std::string &name)
+    {
+        return "/tmp/keyFrameStoreTests_" + std::to_string(::getpid()) + "_" + name + ".bin";
+    }
+
+    StoredKeyFrame keyFrame(uint64_t id)
+    {
+        StoredKeyFrame kf{};
+        kf.id = id;
+        kf.stamp = 0.5 * id;
+        kf.position[0] = static_cast<double>(id);
+        kf.orientation[3] = 1.0;
+        return kf;
+    }
+
+    std::vector<StoredMapPoint> points(uint64_t firstId, size_t count)
+    {
+        std::vector<StoredMapPoint> mapPoints(count);
+        for (size_t i = 0; i < count; i++)
+        {
+            mapPoints[i].id = firstId + i;
+            mapPoints[i].position[0] = static_cast<float>(firstId + i);
+        }
+        return mapPoints;
+    }
+}
+
+TEST(KeyFrameStoreTest, PutGetReplaceErase) {
+    const std::string path = storePath("basic");
+    {
+        MappedKeyFrameStore store(path);
+        ASSERT_TRUE(store.open());
+        ASSERT_TRUE(store.put(keyFrame(3), points(100, 5)));
+        ASSERT_TRUE(store.put(keyFrame(4), points(200, 0)));
+        ASSERT_EQ(store.size(), 2u);
+        ASSERT_EQ(store.numPoints(), 5u);
+
+        StoredKeyFrame kf;
+        std::vector<StoredMapPoint> mapPoints;
+        ASSERT_TRUE(store.get(3, kf, &mapPoints));
+        ASSERT_EQ(kf.numPoints, 5u);
+        ASSERT_EQ(kf.position[0], 3.0);
+        ASSERT_EQ(mapPoints.size(), 5u);
+        ASSERT_EQ(mapPoints.back().id, 104u);
+        ASSERT_EQ(mapPoints.back().position[0], 104.0f);
+
+        // the replaced record is dead space until the next compaction.
+        const size_t liveBefore = store.liveBytes();
+        ASSERT_TRUE(store.put(keyFrame(3), points(300, 2)));
+        ASSERT_EQ(store.size(), 2u);
+        ASSERT_EQ(store.numPoints(), 2u);
+        ASSERT_EQ(store.liveBytes(), liveBefore - 3 * sizeof(StoredMapPoint));
+        const StoredMapPoint *stored;
+        ASSERT_NE(store.find(3, &stored), nullptr);
+        ASSERT_EQ(stored[1].id, 301u);
+
+        ASSERT_TRUE(store.erase(4));
+        ASSERT_FALSE(store.erase(4));
+        ASSERT_FALSE(store.get(4, kf));
+        ASSERT_EQ(store.size(), 1u);
+        ASSERT_EQ(access(path.c_str(), F_OK), 0);
+    }
+    // the file goes with the store.
+    ASSERT_NE(access(path.c_str(), F_OK), 0);
+}
+
+TEST(KeyFrameStoreTest, GrowsAndCompactsInPlace) {
+    MappedKeyFrameStore store(storePath("compact"));
+    ASSERT_TRUE(store.open(4096));
+    // a working set of 50 keyframes paged in and out many times.
+    for (int round = 0; round < 40; round++)
+    {
+        for (uint64_t id = 0; id < 50; id++)
+            ASSERT_TRUE(store.put(keyFrame(id), points(id * 1000 + round, 20)));
+    }
+    ASSERT_EQ(store.size(), 50u);
+    ASSERT_EQ(store.numPoints(), 50u * 20u);
+    // the dead records are reclaimed, the mapping stays in the order of the live set.
+    ASSERT_LE(store.mappedBytes(), 4 * store.liveBytes());
+    for (uint64_t id = 0; id < 50; id++)
+    {
+        StoredKeyFrame kf;
+        std::vector<StoredMapPoint> mapPoints;
+        ASSERT_TRUE(store.get(id, kf, &mapPoints));
+        ASSERT_EQ(kf.id, id);
+        ASSERT_EQ(kf.stamp, 0.5 * id);
+        ASSERT_EQ(mapPoints.size(), 20u);
+        ASSERT_EQ(mapPoints.front().id, id * 1000 + 39);
+    }
+    store.clear();
+    ASSERT_EQ(store.size(), 0u);
+    ASSERT_EQ(store.liveBytes(), 0u);
+}
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,48 @@
+#include <gtest/gtest.h>
+#include <thread>
+#include <memory>
+#include "orb_slam3_ros2_wrapper/latest_value_slot.hpp"
+
+TEST(LatestValueSlotTest, PutReplacesTheValueNotTaken) {
+    ORB_SLAM3_Wrapper::LatestValueSlot<std::shared_ptr<int>> slot;
+    ASSERT_TRUE(slot.empty());
+    auto first = std::make_shared<int>(1);
+    std::weak_ptr<int> firstRef = first;
+    ASSERT_FALSE(slot.put(std::move(first)));
+    // the newest frame wins, the older one is released by the producer.
+    ASSERT_TRUE(slot.put(std::make_shared<int>(2)));
+    ASSERT_TRUE(firstRef.expired());
+
+    std::shared_ptr<int> value;
+    ASSERT_TRUE(slot.take(value));
+    ASSERT_EQ(*value, 2);
+    ASSERT_TRUE(slot.empty());
+    ASSERT_FALSE(slot.take(value));
+    ASSERT_EQ(*value, 2);
+}
+
+TEST(LatestValueSlotTest, ConsumerSeesIncreasingValues) {
+    ORB_SLAM3_Wrapper::LatestValueSlot<int> slot;
+    const int numValues = 100000;
+    std::thread producer([&slot]()
+                         {
+        for (int i = 1; i <= numValues; i++)
+            slot.put(int(i)); });
+    int last = 0;
+    while (last < numValues)
+    {
+        int value;
+        if (!slot.take(value))
+            continue;
+        ASSERT_GT(value, last);
+        last = value;
+    }
+    producer.join();
+    ASSERT_TRUE(slot.empty());
+}
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
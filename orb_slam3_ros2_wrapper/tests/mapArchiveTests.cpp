@@ -0,0 +1,141 @@
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include "orb_slam3_ros2_wrapper/map_archive.hpp"
+
+using ORB_SLAM3_Wrapper::CompressedChunkReader;
+using ORB_SLAM3_Wrapper::CompressedChunkWriter;
+
+namespace
+{
+    std::string mapLikeBytes(size_t size)
+    {
+        // repetitive enough to compress, like serialized keyframes.
+        std::string bytes(size, '\0');
+        for (size_t i = 0; i < size; i++)
+            bytes[i] = static_cast<char>((i % 97) + (i / 4096) % 7);
+        return bytes;
+    }
+
+    std::string readAll(std::istream &archive, bool &valid, bool &complete)
+    {
+        CompressedChunkReader reader(archive);
+        std::istream stream(&reader);
+        std::ostringstream out;
+        char c;
+        while (stream.get(c))
+            out.put(c);
+        valid = reader.valid();
+        complete = reader.complete();
+        return out.str();
+    }
+}
+
+TEST(MapArchiveTest, ChunkedRoundTrip) {
+    const std::string payload = mapLikeBytes(300000);
+    std::stringstream archive;
+    {
+        CompressedChunkWriter writer(archive, 64 * 1024);
+        std::ostream stream(&writer);
+        // written in pieces that straddle the chunks.
+        for (size_t offset = 0; offset < payload.size(); offset += 1000)
+            stream.write(payload.data() + offset, std::min<size_t>(1000, payload.size() - offset));
+        ASSERT_TRUE(writer.finish());
+        ASSERT_EQ(writer.rawBytes(), payload.size());
+        ASSERT_LT(writer.compressedBytes(), payload.size() / 2);
+        ASSERT_EQ(writer.compressedBytes(), archive.str().size());
+    }
+    bool valid, complete;
+    ASSERT_EQ(readAll(archive, valid, complete), payload);
+    ASSERT_TRUE(valid);
+    ASSERT_TRUE(complete);
+}
+
+TEST(MapArchiveTest, DetectsCorruption) {
+    std::stringstream archive;
+    {
+        CompressedChunkWriter writer(archive, 4096);
+        std::ostream stream(&writer);
+        const std::string payload = mapLikeBytes(20000);
+        stream.write(payload.data(), payload.size());
+    }
+    const std::string bytes = archive.str();
+    bool valid, complete;
+
+    // truncated: the data read is a prefix and the end marker is missing.
+    std::stringstream truncated(bytes.substr(0, bytes.size() / 2));
+    readAll(truncated, valid, complete);
+    ASSERT_FALSE(valid);
+    ASSERT_FALSE(complete);
+
+    std::string flipped = bytes;
+    flipped[bytes.size() / 2] ^= 0x5a;
+    std::stringstream corrupt(flipped);
+    readAll(corrupt, valid, complete);
+    ASSERT_FALSE(valid);
+
+    std::stringstream notArchive("ORBvoc text");
+    readAll(notArchive, valid, complete);
+    ASSERT_FALSE(valid);
+}
+
+TEST(MapArchiveTest, SettingsOverrideAndFiles) {
+    const std::string settings = "/tmp/orb_wrapper_test_settings.yaml";
+    const std::string rewritten = "/tmp/orb_wrapper_test_settings_load.yaml";
+    {
+        std::ofstream out(settings);
+        out << "%YAML:1.0\nCamera.fx: 500.0\n  System.LoadAtlasFromFile: \"old\"\nSystem.SaveAtlasToFile: \"saved\"\n";
+    }
+    ASSERT_TRUE(ORB_SLAM3_Wrapper::writeSettingsLoadingAtlas(settings, rewritten, "/tmp/atlas"));
+    std::ifstream in(rewritten);
+    std::stringstream content;
+    content << in.rdbuf();
+    ASSERT_EQ(content.str(), "%YAML:1.0\nCamera.fx: 500.0\nSystem.SaveAtlasToFile: \"saved\"\nSystem.LoadAtlasFromFile: \"/tmp/atlas\"\n");
+
+    // md5 of the settings file content above.
+    ASSERT_EQ(ORB_SLAM3_Wrapper::vocabularyChecksum("/tmp/does_not_exist.txt"), "");
+    ASSERT_EQ(ORB_SLAM3_Wrapper::vocabularyChecksum(settings).size(), 32u);
+
+    const std::string archivePath = "/tmp/orb_wrapper_test_map.orbmap";
+    const std::string payload = mapLikeBytes(10000);
+    {
+        std::ofstream file(archivePath, std::ios::binary);
+        CompressedChunkWriter writer(file);
+        std::ostream stream(&writer);
+        stream.write(payload.data(), payload.size());
+    }
+    std::string message;
+    ASSERT_TRUE(ORB_SLAM3_Wrapper::decompressMapArchive(archivePath, "/tmp/orb_wrapper_test_map.osa", message)) << message;
+    std::ifstream osa("/tmp/orb_wrapper_test_map.osa", std::ios::binary);
+    std::stringstream osaContent;
+    osaContent << osa.rdbuf();
+    ASSERT_EQ(osaContent.str(), payload);
+    ASSERT_FALSE(ORB_SLAM3_Wrapper::decompressMapArchive(settings, "/tmp/orb_wrapper_test_map.osa", message));
+
+    std::remove(settings.c_str());
+    std::remove(rewritten.c_str());
+    std::remove(archivePath.c_str());
+    std::remove("/tmp/orb_wrapper_test_map.osa");
+}
+
+TEST(MapArchiveTest, TemporaryFilesAreUniqueAndRemoved) {
+    std::string firstPath;
+    {
+        ORB_SLAM3_Wrapper::TemporaryFile first(".osa");
+        ORB_SLAM3_Wrapper::TemporaryFile second(".osa");
+        ASSERT_TRUE(first.valid() && second.valid());
+        ASSERT_NE(first.path(), second.path());
+        ASSERT_EQ(first.path().substr(first.path().size() - 4), ".osa");
+        firstPath = first.path();
+        ASSERT_TRUE(std::ifstream(firstPath).good());
+    }
+    ASSERT_FALSE(std::ifstream(firstPath).good());
+}
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,115 @@
+#include <gtest/gtest.h>
+#include <map>
+#include "orb_slam3_ros2_wrapper/map_data_delta.hpp"
+
+namespace
+{
+    void addPose(slam_msgs::msg::MapGraph &graph, int32_t id, double x)
+    {
+        geometry_msgs::msg::PoseStamped pose;
+        pose.pose.position.x = x;
+        pose.pose.orientation.w = 1.0;
+        graph.poses_id.push_back(id);
+        graph.poses.push_back(pose);
+    }
+
+    // subscriber side: rebuild the graph from the stream.
+    void apply(const slam_msgs::msg::MapDataDelta &delta, std::map<int32_t, double> &graph)
+    {
+        if (delta.is_snapshot)
+            graph.clear();
+        for (size_t i = 0; i < delta.added_ids.size(); i++)
+            graph[delta.added_ids[i]] = delta.added_poses[i].pose.position.x;
+        for (size_t i = 0; i < delta.moved_ids.size(); i++)
+            graph[delta.moved_ids[i]] = delta.moved_poses[i].pose.position.x;
+        for (auto id : delta.removed_ids)
+            graph.erase(id);
+    }
+}
+
+TEST(MapDataDeltaTest, FirstMessageIsSnapshotThenOnlyChanges) {
+    ORB_SLAM3_Wrapper::MapDataDeltaEncoder encoder(0.05, 0.02, 0);
+    slam_msgs::msg::MapGraph graph;
+    addPose(graph, 0, 0.0);
+    addPose(graph, 1, 1.0);
+
+    slam_msgs::msg::MapDataDelta delta;
+    ASSERT_TRUE(encoder.encode(graph, delta));
+    ASSERT_TRUE(delta.is_snapshot);
+    ASSERT_EQ(delta.sequence, 1u);
+    ASSERT_EQ(delta.added_ids.size(), 2u);
+
+    // unchanged graph, nothing to publish.
+    ASSERT_FALSE(encoder.encode(graph, delta));
+
+    // below the threshold, still nothing.
+    graph.poses[1].pose.position.x = 1.01;
+    ASSERT_FALSE(encoder.encode(graph, delta));
+
+    graph.poses[1].pose.position.x = 1.2;
+    addPose(graph, 2, 2.0);
+    ASSERT_TRUE(encoder.encode(graph, delta));
+    ASSERT_FALSE(delta.is_snapshot);
+    ASSERT_EQ(delta.sequence, 2u);
+    ASSERT_EQ(delta.added_ids, std::vector<int32_t>({2}));
+    ASSERT_EQ(delta.moved_ids, std::vector<int32_t>({1}));
+    ASSERT_TRUE(delta.removed_ids.empty());
+
+    graph.poses_id.erase(graph.poses_id.begin());
+    graph.poses.erase(graph.poses.begin());
+    ASSERT_TRUE(encoder.encode(graph, delta));
+    ASSERT_EQ(delta.removed_ids, std::vector<int32_t>({0}));
+}
+
+TEST(MapDataDeltaTest, SmallMovesAccumulateAgainstTheSentPose) {
+    ORB_SLAM3_Wrapper::MapDataDeltaEncoder encoder(0.05, 0.02, 0);
+    slam_msgs::msg::MapGraph graph;
+    addPose(graph, 0, 0.0);
+    slam_msgs::msg::MapDataDelta delta;
+    ASSERT_TRUE(encoder.encode(graph, delta));
+    for (int i = 1; i <= 5; i++)
+    {
+        graph.poses[0].pose.position.x = 0.02 * i;
+        bool published = encoder.encode(graph, delta);
+        // 0.02, 0.04 stay below 0.05, 0.06 is sent, then 0.08 and 0.10 are again within 0.05 of it.
+        ASSERT_EQ(published, i == 3) << "step " << i;
+    }
+}
+
+TEST(MapDataDeltaTest, PeriodicAndRequestedSnapshots) {
+    ORB_SLAM3_Wrapper::MapDataDeltaEncoder encoder(0.05, 0.02, 2);
+    slam_msgs::msg::MapGraph graph;
+    addPose(graph, 0, 0.0);
+    std::map<int32_t, double> rebuilt;
+    slam_msgs::msg::MapDataDelta delta;
+
+    ASSERT_TRUE(encoder.encode(graph, delta));
+    apply(delta, rebuilt);
+    addPose(graph, 1, 1.0);
+    ASSERT_TRUE(encoder.encode(graph, delta));
+    ASSERT_FALSE(delta.is_snapshot);
+    apply(delta, rebuilt);
+    addPose(graph, 2, 2.0);
+    ASSERT_TRUE(encoder.encode(graph, delta));
+    ASSERT_FALSE(delta.is_snapshot);
+    apply(delta, rebuilt);
+    // two deltas sent, the next message is a snapshot even without changes.
+    ASSERT_TRUE(encoder.encode(graph, delta));
+    ASSERT_TRUE(delta.is_snapshot);
+    ASSERT_EQ(delta.added_ids.size(), 3u);
+    apply(delta, rebuilt);
+    ASSERT_EQ(rebuilt.size(), 3u);
+
+    encoder.requestSnapshot();
+    ASSERT_TRUE(encoder.encode(graph, delta));
+    ASSERT_TRUE(delta.is_snapshot);
+    ASSERT_EQ(delta.sequence, encoder.sequence());
+    apply(delta, rebuilt);
+    ASSERT_EQ(rebuilt, (std::map<int32_t, double>{{0, 0.0}, {1, 1.0}, {2, 2.0}}));
+}
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,68 @@
+#include <gtest/gtest.h>
+#include <thread>
+#include "orb_slam3_ros2_wrapper/map_events.hpp"
+
+using namespace ORB_SLAM3_Wrapper;
+
+TEST(MapEventQueueTest, DroppedEventsLeaveASequenceGap) {
+    MapEventQueue queue(2);
+    int notifications = 0;
+    queue.setNotifier([&notifications]()
+                      { ++notifications; });
+    queue.push(MapEventType::MAP_CREATED, 0);
+    queue.push(MapEventType::KEYFRAME_INSERTED, 0, 7);
+    // full, dropped.
+    queue.push(MapEventType::KEYFRAME_INSERTED, 0, 8);
+    queue.notify();
+    ASSERT_EQ(notifications, 1);
+    ASSERT_EQ(queue.produced(), 3u);
+    ASSERT_EQ(queue.dropped(), 1u);
+    ASSERT_EQ(queue.size(), 2u);
+
+    MapEvent event;
+    ASSERT_TRUE(queue.pop(event));
+    ASSERT_EQ(event.type, MapEventType::MAP_CREATED);
+    ASSERT_EQ(event.keyFrameId, -1);
+    ASSERT_EQ(event.sequence, 0u);
+    ASSERT_TRUE(queue.pop(event));
+    ASSERT_EQ(event.keyFrameId, 7);
+    ASSERT_EQ(event.sequence, 1u);
+    ASSERT_FALSE(queue.pop(event));
+
+    queue.push(MapEventType::LOOP_CLOSED, 0);
+    ASSERT_TRUE(queue.pop(event));
+    ASSERT_EQ(event.sequence, 3u);
+    ASSERT_STREQ(mapEventTypeName(event.type), "loop closed");
+}
+
+TEST(MapEventQueueTest, ConsumerOnAnotherThreadSeesEveryEventInOrder) {
+    MapEventQueue queue(64);
+    const int numEvents = 10000;
+    std::thread producer([&queue]()
+                         {
+        for (int i = 0; i < numEvents; i++)
+        {
+            // the producer never blocks, it waits here only to keep every event for the test.
+            while (queue.size() >= 64)
+                std::this_thread::yield();
+            queue.push(MapEventType::KEYFRAME_INSERTED, 1, i);
+        } });
+    int64_t expected = 0;
+    MapEvent event;
+    while (expected < numEvents)
+    {
+        if (!queue.pop(event))
+            continue;
+        ASSERT_EQ(event.keyFrameId, expected);
+        ASSERT_EQ(event.sequence, static_cast<uint64_t>(expected));
+        expected++;
+    }
+    producer.join();
+    ASSERT_EQ(queue.dropped(), 0u);
+}
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
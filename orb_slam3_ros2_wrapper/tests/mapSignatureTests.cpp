@@ -0,0 +1,115 @@
+#include <gtest/gtest.h>
+#include "orb_slam3_ros2_wrapper/map_signature.hpp"
+
+using namespace ORB_SLAM3_Wrapper;
+
+namespace
+{
+    struct FakeMap
+    {
+    };
+
+    typedef std::vector<std::pair<FakeMap *, MapSignature>> Signatures;
+
+    MapSignature signature(long unsigned int initKFid, long unsigned int maxKFid, long unsigned int numKFs, int changeIdx = 0, int bigChangeIdx = 0)
+    {
+        MapSignature s;
+        s.initKFid = initKFid;
+        s.maxKFid = maxKFid;
+        s.numKFs = numKFs;
+        s.changeIdx = changeIdx;
+        s.bigChangeIdx = bigChangeIdx;
+        return s;
+    }
+
+    // diffs and commits, as calculateReferencePoses does.
+    AtlasChanges<FakeMap> update(const Signatures &current, std::unordered_map<FakeMap *, MapSignature> &previous)
+    {
+        AtlasChanges<FakeMap> changes = diffMapSignatures(current, previous);
+        if (changes.atlasChanged)
+            previous = std::unordered_map<FakeMap *, MapSignature>(current.begin(), current.end());
+        return changes;
+    }
+}
+
+TEST(MapSignatureTest, SteadyStateSkipsTheUpdate) {
+    FakeMap first;
+    std::unordered_map<FakeMap *, MapSignature> previous;
+    // map creation.
+    auto changes = update({{&first, signature(0, 0, 1)}}, previous);
+    ASSERT_TRUE(changes.atlasChanged);
+    ASSERT_EQ(changes.created, std::vector<FakeMap *>{&first});
+    ASSERT_EQ(changes.changed, std::vector<FakeMap *>{&first});
+    ASSERT_TRUE(changes.removed.empty());
+
+    changes = update({{&first, signature(0, 0, 1)}}, previous);
+    ASSERT_FALSE(changes.atlasChanged);
+    ASSERT_TRUE(changes.changed.empty());
+    ASSERT_TRUE(changes.removed.empty());
+
+    // a new keyframe changes the set, not the corrections.
+    changes = update({{&first, signature(0, 4, 2)}}, previous);
+    ASSERT_TRUE(changes.atlasChanged);
+    ASSERT_EQ(changes.changed, std::vector<FakeMap *>{&first});
+    ASSERT_TRUE(changes.corrected.empty());
+    ASSERT_TRUE(changes.optimized.empty());
+
+    // a bundle adjustment only moves the poses.
+    changes = update({{&first, signature(0, 4, 2, 1)}}, previous);
+    ASSERT_TRUE(changes.atlasChanged);
+    ASSERT_TRUE(changes.changed.empty());
+    ASSERT_EQ(changes.optimized, std::vector<FakeMap *>{&first});
+
+    // so does a new origin keyframe.
+    MapSignature moved = signature(0, 4, 2, 1);
+    int origin;
+    moved.originKF = &origin;
+    changes = update({{&first, moved}}, previous);
+    ASSERT_TRUE(changes.atlasChanged);
+    ASSERT_TRUE(changes.changed.empty());
+    ASSERT_TRUE(changes.optimized.empty());
+}
+
+TEST(MapSignatureTest, LoopClosureCorrectsTheMap) {
+    FakeMap first;
+    std::unordered_map<FakeMap *, MapSignature> previous;
+    update({{&first, signature(0, 10, 8, 3, 0)}}, previous);
+    // GetLastBigChangeIdx moves, with the change index of the optimization.
+    auto changes = update({{&first, signature(0, 10, 8, 4, 1)}}, previous);
+    ASSERT_TRUE(changes.atlasChanged);
+    ASSERT_EQ(changes.corrected, std::vector<FakeMap *>{&first});
+    ASSERT_EQ(changes.changed, std::vector<FakeMap *>{&first});
+    ASSERT_TRUE(changes.optimized.empty());
+    ASSERT_FALSE(update({{&first, signature(0, 10, 8, 4, 1)}}, previous).atlasChanged);
+}
+
+TEST(MapSignatureTest, MergeAndReset) {
+    FakeMap first, second, third;
+    std::unordered_map<FakeMap *, MapSignature> previous;
+    update({{&first, signature(0, 10, 8)}}, previous);
+    // tracking lost, a new map.
+    auto changes = update({{&first, signature(0, 10, 8)}, {&second, signature(11, 20, 6)}}, previous);
+    ASSERT_TRUE(changes.atlasChanged);
+    ASSERT_EQ(changes.created, std::vector<FakeMap *>{&second});
+    ASSERT_EQ(changes.changed, std::vector<FakeMap *>{&second});
+
+    // the second map is merged into the first, which takes its keyframes.
+    changes = update({{&first, signature(0, 20, 14, 1, 1)}}, previous);
+    ASSERT_TRUE(changes.atlasChanged);
+    ASSERT_EQ(changes.removed, std::vector<FakeMap *>{&second});
+    ASSERT_EQ(changes.corrected, std::vector<FakeMap *>{&first});
+    ASSERT_EQ(changes.changed, std::vector<FakeMap *>{&first});
+
+    // a reset replaces the map by a new one, with as many maps as before.
+    changes = update({{&third, signature(21, 21, 1)}}, previous);
+    ASSERT_TRUE(changes.atlasChanged);
+    ASSERT_EQ(changes.removed, std::vector<FakeMap *>{&first});
+    ASSERT_EQ(changes.created, std::vector<FakeMap *>{&third});
+    ASSERT_TRUE(changes.corrected.empty());
+}
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,56 @@
+#include <gtest/gtest.h>
+#include "orb_slam3_ros2_wrapper/merge_correction.hpp"
+
+using namespace ORB_SLAM3_Wrapper;
+
+namespace
+{
+    Eigen::Affine3d makePose(double x, double y, double yaw)
+    {
+        return Eigen::Affine3d(Eigen::Translation3d(x, y, 0.0) * Eigen::AngleAxisd(yaw, Eigen::Vector3d::UnitZ()));
+    }
+}
+
+TEST(MergeCorrectionTest, BlendsFromThePreMergeFrame) {
+    const Eigen::Affine3d correction = makePose(1.0, -2.0, 0.4);
+    const Eigen::Affine3d preMerge = makePose(3.0, 1.0, 0.1);
+    const Eigen::Affine3d postMerge = correction * preMerge;
+    ASSERT_NEAR(MergeCorrection::translationMagnitude(correction), std::sqrt(5.0), 1e-9);
+    ASSERT_NEAR(MergeCorrection::rotationMagnitude(correction), 0.4, 1e-9);
+
+    MergeCorrection blend;
+    blend.start(correction, 2.0, 10.0);
+    ASSERT_TRUE(blend.active());
+    // no jump when the merge ends, the pose is still in the pre-merge frame.
+    ASSERT_TRUE(blend.apply(postMerge, 10.0).isApprox(preMerge, 1e-9));
+    const Eigen::Affine3d halfway = blend.apply(postMerge, 11.0);
+    ASSERT_FALSE(halfway.isApprox(preMerge, 1e-3));
+    ASSERT_FALSE(halfway.isApprox(postMerge, 1e-3));
+    // the rest of the correction is halfway between the two.
+    const Eigen::Affine3d left = postMerge * halfway.inverse();
+    ASSERT_NEAR(MergeCorrection::rotationMagnitude(left), 0.2, 1e-9);
+    ASSERT_TRUE(blend.apply(postMerge, 12.0).isApprox(postMerge, 1e-9));
+    ASSERT_FALSE(blend.active());
+}
+
+TEST(MergeCorrectionTest, NoWindowAppliesAtOnce) {
+    MergeCorrection correction;
+    const Eigen::Affine3d pose = makePose(1.0, 2.0, 0.3);
+    ASSERT_TRUE(correction.apply(pose, 0.0).isApprox(pose));
+    correction.start(makePose(0.5, 0.0, 0.0), 0.0, 1.0);
+    ASSERT_FALSE(correction.active());
+    ASSERT_TRUE(correction.apply(pose, 1.0).isApprox(pose));
+
+    MergeHandling handling;
+    ASSERT_TRUE(mergeHandlingFromString("blend", handling));
+    ASSERT_EQ(handling, MergeHandling::BLEND);
+    ASSERT_TRUE(mergeHandlingFromString("pause", handling));
+    ASSERT_EQ(handling, MergeHandling::PAUSE);
+    ASSERT_FALSE(mergeHandlingFromString("smooth", handling));
+}
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,150 @@
+#include <gtest/gtest.h>
+#include "orb_slam3_ros2_wrapper/occupancy_map.hpp"
+
+using namespace ORB_SLAM3_Wrapper;
+
+namespace
+{
+    // a wall ahead of the sensor, 1 m wide and 0.6 m high.
+    std::vector<Eigen::Vector3f> wallScan(float distance = 2.0f)
+    {
+        std::vector<Eigen::Vector3f> points;
+        for (float y = -0.5f; y <= 0.5f; y += 0.02f)
+        {
+            for (float z = -0.3f; z <= 0.3f; z += 0.02f)
+                points.emplace_back(distance, y, z);
+        }
+        return points;
+    }
+
+    int8_t cellAt(const OccupancyGrid &grid, float x, float y)
+    {
+        const int32_t cx = static_cast<int32_t>(std::floor(x / grid.resolution)) - grid.originX;
+        const int32_t cy = static_cast<int32_t>(std::floor(y / grid.resolution)) - grid.originY;
+        if (cx < 0 || cy < 0 || cx >= static_cast<int32_t>(grid.width) || cy >= static_cast<int32_t>(grid.height))
+            return -1;
+        return grid.data[cy * grid.width + cx];
+    }
+}
+
+TEST(OccupancyMapTest, RaysClearUpToTheHit) {
+    OccupancyMapConfig config;
+    config.resolution = 0.1f;
+    config.minHeight = -0.2f;
+    config.maxHeight = 0.2f;
+    OccupancyMap map(config);
+    const Eigen::Affine3f pose(Eigen::Translation3f(0.03f, 0.04f, 0.05f));
+    map.integrate(pose, wallScan(), 1);
+    ASSERT_EQ(map.version(), 1u);
+    ASSERT_EQ(map.voxelState(map.toIndex(Eigen::Vector3f(2.05f, 0.0f, 0.0f))), 1);
+    ASSERT_EQ(map.voxelState(map.toIndex(Eigen::Vector3f(1.0f, 0.0f, 0.0f))), 0);
+    ASSERT_EQ(map.voxelState(map.toIndex(Eigen::Vector3f(2.5f, 0.0f, 0.0f))), -1);
+    ASSERT_GT(map.numOccupied(), 0u);
+
+    OccupancyGrid grid;
+    map.grid(grid);
+    ASSERT_FLOAT_EQ(grid.resolution, 0.1f);
+    ASSERT_EQ(cellAt(grid, 2.05f, 0.0f), 100);
+    ASSERT_EQ(cellAt(grid, 1.0f, 0.0f), 0);
+    ASSERT_EQ(cellAt(grid, -1.0f, 0.0f), -1);
+
+    std::vector<Eigen::Vector3f> centers;
+    map.occupiedVoxels(centers);
+    ASSERT_EQ(centers.size(), map.numOccupied());
+    for (const auto &center : centers)
+        ASSERT_EQ(map.voxelState(map.toIndex(center)), 1);
+}
+
+TEST(OccupancyMapTest, RemovingAScanRestoresTheMap) {
+    OccupancyMapConfig config;
+    config.resolution = 0.1f;
+    config.maxRange = 1.5f;
+    OccupancyMap map(config);
+    const Eigen::Affine3f first(Eigen::AngleAxisf(0.3f, Eigen::Vector3f::UnitZ()));
+    const Eigen::Affine3f second(Eigen::Translation3f(0.5f, 0.2f, 0.0f));
+    // the first scan is cut by the range, nothing is occupied.
+    map.integrate(first, wallScan(), 1);
+    ASSERT_EQ(map.numOccupied(), 0u);
+    ASSERT_GT(map.numVoxels(), 0u);
+    const size_t voxelsOfFirst = map.numVoxels();
+    OccupancyGrid before;
+    map.grid(before);
+
+    map.integrate(second, wallScan(1.0f), 1);
+    ASSERT_GT(map.numOccupied(), 0u);
+    map.integrate(second, wallScan(1.0f), -1);
+    ASSERT_EQ(map.numOccupied(), 0u);
+    ASSERT_EQ(map.numVoxels(), voxelsOfFirst);
+    OccupancyGrid after;
+    map.grid(after);
+    // the grid keeps the columns it saw but the cells are back to their state.
+    for (float x = -1.0f; x < 3.0f; x += 0.1f)
+    {
+        for (float y = -1.0f; y < 1.0f; y += 0.1f)
+            ASSERT_EQ(cellAt(before, x + 0.05f, y + 0.05f), cellAt(after, x + 0.05f, y + 0.05f));
+    }
+    map.integrate(first, wallScan(), -1);
+    ASSERT_EQ(map.numVoxels(), 0u);
+}
+
+TEST(OccupancyMapTest, DepthImageToBodyAxes) {
+    // 4 x 2 image, 1 m everywhere but one invalid pixel.
+    const uint16_t depth[8] = {1000, 1000, 0, 1000,
+                               1000, 1000, 1000, 1000};
+    std::vector<Eigen::Vector3f> points;
+    depthToPoints(depth, 4, 2, 4, 0.001f, 2.0f, 2.0f, 1.0f, 1.0f, 1, points);
+    ASSERT_EQ(points.size(), 7u);
+    // the pixel left of and above the principal point is on the left (+y) and up (+z).
+    ASSERT_TRUE(points[0].isApprox(Eigen::Vector3f(1.0f, 0.5f, 0.5f)));
+    ASSERT_TRUE(points[6].isApprox(Eigen::Vector3f(1.0f, -1.0f, 0.0f)));
+    depthToPoints(depth, 4, 2, 4, 0.001f, 2.0f, 2.0f, 1.0f, 1.0f, 2, points);
+    ASSERT_EQ(points.size(), 1u);
+
+    std::vector<Eigen::Vector3f> cloud = {{0.01f, 0.01f, 0.01f}, {0.02f, 0.02f, 0.02f}, {0.11f, 0.0f, 0.0f}};
+    downsamplePoints(cloud, 0.1f);
+    ASSERT_EQ(cloud.size(), 2u);
+    ASSERT_TRUE(cloud[1].isApprox(Eigen::Vector3f(0.11f, 0.0f, 0.0f)));
+}
+
+TEST(OccupancyMapperTest, MovedKeyFramesAreIntegratedAgain) {
+    OccupancyMapConfig config;
+    config.resolution = 0.1f;
+    OccupancyMapper mapper(config, 2);
+    ASSERT_TRUE(mapper.addKeyFrame(1, Eigen::Affine3f::Identity(), wallScan()));
+    ASSERT_TRUE(mapper.addKeyFrame(2, Eigen::Affine3f(Eigen::Translation3f(0.0f, 2.0f, 0.0f)), wallScan()));
+    mapper.flush();
+    ASSERT_EQ(mapper.stats().integrated, 2u);
+
+    // a loop closure moves the second keyframe next to the first, the two moves may be coalesced.
+    mapper.moveKeyFrame(2, Eigen::Affine3f(Eigen::Translation3f(0.0f, 1.0f, 0.0f)));
+    mapper.moveKeyFrame(2, Eigen::Affine3f(Eigen::Translation3f(0.0f, 0.05f, 0.0f)));
+    mapper.moveKeyFrame(7, Eigen::Affine3f::Identity());
+    mapper.flush();
+    OccupancyMapperStats stats = mapper.stats();
+    ASSERT_GE(stats.reintegrated, 1u);
+    ASSERT_LE(stats.reintegrated, 2u);
+    OccupancyGrid grid;
+    mapper.grid(grid);
+    ASSERT_EQ(cellAt(grid, 2.05f, 1.95f), -1);
+    ASSERT_EQ(cellAt(grid, 2.05f, 0.05f), 100);
+
+    mapper.removeKeyFrame(1);
+    mapper.removeKeyFrame(2);
+    mapper.flush();
+    ASSERT_EQ(mapper.stats().removed, 2u);
+    std::vector<Eigen::Vector3f> centers;
+    mapper.occupiedVoxels(centers);
+    ASSERT_TRUE(centers.empty());
+
+    mapper.clear();
+    const uint64_t version = mapper.version();
+    mapper.addKeyFrame(3, Eigen::Affine3f::Identity(), wallScan());
+    mapper.flush();
+    ASSERT_GT(mapper.version(), version);
+}
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
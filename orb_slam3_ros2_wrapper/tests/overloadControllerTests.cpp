@@ -0,0 +1,112 @@
+#include <gtest/gtest.h>
+#include "orb_slam3_ros2_wrapper/overload_controller.hpp"
+
+using ORB_SLAM3_Wrapper::OverloadController;
+using ORB_SLAM3_Wrapper::OverloadControllerConfig;
+
+namespace
+{
+    const double kPeriod = 1.0 / 30.0;
+
+    /**
+     * @brief Feeds camera frames at 30 Hz, tracks the admitted ones with the given latency.
+     * @return Frames admitted.
+     */
+    int run(OverloadController &controller, double &stamp, int frames, double latency, bool tracked = true, int trackedMapPoints = 500)
+    {
+        int admitted = 0;
+        for (int i = 0; i < frames; i++)
+        {
+            stamp += kPeriod;
+            if (!controller.admitFrame(stamp))
+                continue;
+            ++admitted;
+            controller.recordTrack(latency, tracked, trackedMapPoints, stamp);
+        }
+        return admitted;
+    }
+}
+
+TEST(OverloadControllerTest, SkipsFramesUnderOverloadWhileSlow) {
+    OverloadControllerConfig config;
+    config.smoothing = 1.0;
+    config.holdFrames = 2;
+    OverloadController controller(config);
+    double stamp = 0.0;
+    controller.recordOdometry(0.05, 0.05, stamp);
+
+    // 50 ms per frame at 30 Hz: one frame in two fits (utilization 0.75).
+    for (int i = 0; i < 60; i++)
+    {
+        controller.recordOdometry(0.05, 0.05, stamp);
+        run(controller, stamp, 1, 0.05);
+    }
+    ASSERT_EQ(controller.frameSkip(), 1);
+    ASSERT_EQ(controller.decision(), OverloadController::Decision::SKIPPING);
+    ASSERT_NEAR(controller.cameraPeriod(), kPeriod, 1e-9);
+    ASSERT_NEAR(controller.headroom(), 1.0 - 0.05 / (2 * kPeriod), 1e-9);
+
+    // the latency drops, the full rate comes back.
+    for (int i = 0; i < 60; i++)
+    {
+        controller.recordOdometry(0.05, 0.05, stamp);
+        run(controller, stamp, 1, 0.01);
+    }
+    ASSERT_EQ(controller.frameSkip(), 0);
+    ASSERT_EQ(controller.decision(), OverloadController::Decision::FULL_RATE);
+}
+
+TEST(OverloadControllerTest, RestoresFullRateOnFastMotionAndTrackingLoss) {
+    OverloadControllerConfig config;
+    config.smoothing = 1.0;
+    config.holdFrames = 1;
+    OverloadController controller(config);
+    double stamp = 0.0;
+    for (int i = 0; i < 30; i++)
+    {
+        controller.recordAngularRate(0.01, stamp);
+        run(controller, stamp, 1, 0.2);
+    }
+    ASSERT_EQ(controller.frameSkip(), config.maxFrameSkip);
+    ASSERT_LT(controller.headroom(), 0.0);
+
+    // fast rotation: every frame is tracked again, overloaded or not.
+    controller.recordAngularRate(1.0, stamp);
+    // at most maxFrameSkip frames go before the first tracked one.
+    ASSERT_GE(run(controller, stamp, 2 * (config.maxFrameSkip + 1), 0.2), config.maxFrameSkip + 2);
+    ASSERT_EQ(controller.frameSkip(), 0);
+    ASSERT_EQ(controller.decision(), OverloadController::Decision::FAST_MOTION);
+    ASSERT_EQ(run(controller, stamp, 4, 0.2), 4);
+
+    // slow again, then the tracker loses its map points.
+    for (int i = 0; i < 30; i++)
+    {
+        controller.recordAngularRate(0.01, stamp);
+        run(controller, stamp, 1, 0.2);
+    }
+    ASSERT_GT(controller.frameSkip(), 0);
+    controller.recordAngularRate(0.01, stamp);
+    run(controller, stamp, config.maxFrameSkip + 1, 0.2, true, 20);
+    ASSERT_EQ(controller.frameSkip(), 0);
+    ASSERT_EQ(controller.decision(), OverloadController::Decision::TRACKING_QUALITY);
+}
+
+TEST(OverloadControllerTest, NeverSkipsWithoutMotionEstimate) {
+    OverloadControllerConfig config;
+    config.holdFrames = 1;
+    OverloadController controller(config);
+    double stamp = 0.0;
+    ASSERT_EQ(run(controller, stamp, 100, 0.2), 100);
+    ASSERT_EQ(controller.decision(), OverloadController::Decision::NO_MOTION_ESTIMATE);
+
+    // a stale motion sample is no estimate either.
+    controller.recordOdometry(0.0, 0.0, stamp - 10.0);
+    ASSERT_EQ(run(controller, stamp, 10, 0.2), 10);
+    ASSERT_STREQ(OverloadController::decisionName(controller.decision()), "full rate, no motion estimate");
+}
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,93 @@
+#include <gtest/gtest.h>
+#include <random>
+#include "orb_slam3_ros2_wrapper/packed_points.hpp"
+
+using namespace ORB_SLAM3_Wrapper;
+using slam_msgs::msg::PackedPoints;
+
+namespace
+{
+    std::vector<float> randomPoints(size_t count, float extent)
+    {
+        std::mt19937 rng(7);
+        std::uniform_real_distribution<float> position(-extent, extent);
+        std::vector<float> xyz(3 * count);
+        for (auto &value : xyz)
+            value = position(rng);
+        return xyz;
+    }
+}
+
+TEST(PackedPointsTest, Float32RoundTripIsExact) {
+    const std::vector<float> xyz = randomPoints(500, 20.0f);
+    for (uint8_t compression : {PackedPoints::COMPRESSION_NONE, PackedPoints::COMPRESSION_ZSTD})
+    {
+        PointPacking packing;
+        packing.compression = compression;
+        PackedPoints packed;
+        ASSERT_TRUE(packPoints(xyz.data(), 500, packing, packed));
+        ASSERT_EQ(packed.encoding, PackedPoints::ENCODING_FLOAT32);
+        ASSERT_EQ(packed.count, 500u);
+        ASSERT_EQ(packed.raw_size, 500u * 12u);
+        std::vector<float> unpacked;
+        std::string message;
+        ASSERT_TRUE(unpackPoints(packed, unpacked, message)) << message;
+        ASSERT_EQ(unpacked, xyz);
+    }
+}
+
+TEST(PackedPointsTest, QuantizedWithinHalfAStep) {
+    const std::vector<float> xyz = randomPoints(1000, 10.0f);
+    PointPacking packing;
+    packing.encoding = PackedPoints::ENCODING_UINT16;
+    packing.compression = PackedPoints::COMPRESSION_ZSTD;
+    packing.resolution = 0.001;
+    PackedPoints packed;
+    ASSERT_TRUE(packPoints(xyz.data(), 1000, packing, packed));
+    ASSERT_EQ(packed.encoding, PackedPoints::ENCODING_UINT16);
+    ASSERT_EQ(packed.raw_size, 1000u * 6u);
+    std::vector<float> unpacked;
+    std::string message;
+    ASSERT_TRUE(unpackPoints(packed, unpacked, message)) << message;
+    ASSERT_EQ(unpacked.size(), xyz.size());
+    for (size_t i = 0; i < xyz.size(); i++)
+        ASSERT_NEAR(unpacked[i], xyz[i], 0.0005 + 1e-5);
+
+    // 40 m at 0.5 mm does not fit in 16 bits, the points are sent as float32.
+    packing.resolution = 0.0005;
+    ASSERT_TRUE(packPoints(randomPoints(1000, 20.0f).data(), 1000, packing, packed));
+    ASSERT_EQ(packed.encoding, PackedPoints::ENCODING_FLOAT32);
+}
+
+TEST(PackedPointsTest, MalformedMessagesAreRejected) {
+    const std::vector<float> xyz = randomPoints(10, 1.0f);
+    PackedPoints packed;
+    ASSERT_TRUE(packPoints(xyz.data(), 10, PointPacking(), packed));
+    std::vector<float> unpacked;
+    std::string message;
+    PackedPoints truncated = packed;
+    truncated.data.pop_back();
+    ASSERT_FALSE(unpackPoints(truncated, unpacked, message));
+    PackedPoints wrongCount = packed;
+    wrongCount.count = 11;
+    ASSERT_FALSE(unpackPoints(wrongCount, unpacked, message));
+    PackedPoints unknown = packed;
+    unknown.encoding = 7;
+    ASSERT_FALSE(unpackPoints(unknown, unpacked, message));
+
+    PointPacking zstd;
+    zstd.compression = PackedPoints::COMPRESSION_ZSTD;
+    ASSERT_TRUE(packPoints(xyz.data(), 10, zstd, packed));
+    packed.data.resize(packed.data.size() / 2);
+    ASSERT_FALSE(unpackPoints(packed, unpacked, message));
+
+    ASSERT_TRUE(packPoints(nullptr, 0, zstd, packed));
+    ASSERT_TRUE(unpackPoints(packed, unpacked, message)) << message;
+    ASSERT_TRUE(unpacked.empty());
+}
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
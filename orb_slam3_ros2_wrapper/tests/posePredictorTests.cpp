@@ -0,0 +1,94 @@
+#include <gtest/gtest.h>
+#include "orb_slam3_ros2_wrapper/pose_predictor.hpp"
+
+using namespace ORB_SLAM3_Wrapper;
+
+namespace
+{
+    Eigen::Affine3d makePose(double x, double y, double yaw)
+    {
+        return Eigen::Affine3d(Eigen::Translation3d(x, y, 0.0) * Eigen::AngleAxisd(yaw, Eigen::Vector3d::UnitZ()));
+    }
+}
+
+TEST(PosePredictorTest, NothingBeforeTheFirstTrackedFrame) {
+    PosePredictor predictor;
+    Eigen::Affine3d pose;
+    ASSERT_FALSE(predictor.predict(1.0, pose));
+    ASSERT_FALSE(predictor.mapToOdom(pose));
+    PredictionError error;
+    ASSERT_FALSE(predictor.correct(1.0, makePose(1.0, 2.0, 0.3), error));
+    ASSERT_TRUE(predictor.predict(1.0, pose));
+    ASSERT_TRUE(pose.isApprox(makePose(1.0, 2.0, 0.3)));
+    // without odometry there is no map -> odom.
+    ASSERT_FALSE(predictor.mapToOdom(pose));
+}
+
+TEST(PosePredictorTest, ConstantVelocityWithinTheHorizon) {
+    PosePredictorConfig config;
+    config.maxHorizon = 0.5;
+    PosePredictor predictor(config);
+    PredictionError error;
+    // 1 m/s forward while turning at 0.2 rad/s.
+    predictor.correct(0.0, makePose(0.0, 0.0, 0.0), error);
+    ASSERT_TRUE(predictor.correct(0.1, makePose(0.1, 0.0, 0.02), error));
+    Eigen::Affine3d pose;
+    ASSERT_TRUE(predictor.predict(0.2, pose));
+    const Eigen::Affine3d expected = makePose(0.1, 0.0, 0.02) * makePose(0.1, 0.0, 0.02);
+    ASSERT_TRUE(pose.isApprox(expected, 1e-9));
+    ASSERT_TRUE(predictor.correct(0.2, expected, error));
+    ASSERT_NEAR(error.translation, 0.0, 1e-9);
+    ASSERT_NEAR(error.rotation, 0.0, 1e-9);
+    ASSERT_NEAR(error.horizon, 0.1, 1e-12);
+    ASSERT_FALSE(predictor.predict(0.71, pose));
+
+    // the gyroscope replaces the constant rotation rate.
+    predictor.addAngularVelocity(0.25, Eigen::Vector3d(0.0, 0.0, 1.0));
+    predictor.addAngularVelocity(0.30, Eigen::Vector3d(0.0, 0.0, 1.0));
+    ASSERT_TRUE(predictor.predict(0.3, pose));
+    ASSERT_NEAR(Eigen::AngleAxisd(Eigen::Matrix3d(expected.linear().transpose() * pose.linear())).angle(), 0.1, 1e-9);
+    ASSERT_NEAR(pose.translation().x(), expected.translation().x() + 0.1 * std::cos(0.04), 1e-9);
+}
+
+TEST(PosePredictorTest, FollowsTheOdometry) {
+    PosePredictor predictor;
+    // the odometry frame is rotated and shifted from the map frame.
+    const Eigen::Affine3d mapToOdom = makePose(2.0, -1.0, 0.5);
+    for (int i = 0; i <= 10; i++)
+        predictor.addOdometry(0.1 * i, makePose(0.2 * i, 0.0, 0.1 * i));
+    predictor.addOdometry(0.5, makePose(100.0, 0.0, 0.0));
+
+    PredictionError error;
+    // the frame falls between two odometry samples.
+    const Eigen::Affine3d odomAtFrame = makePose(0.5, 0.0, 0.25);
+    ASSERT_FALSE(predictor.correct(0.25, mapToOdom * odomAtFrame, error));
+    Eigen::Affine3d pose;
+    ASSERT_TRUE(predictor.mapToOdom(pose));
+    ASSERT_TRUE(pose.isApprox(mapToOdom, 1e-9));
+    ASSERT_TRUE(predictor.predict(0.7, pose));
+    ASSERT_TRUE(pose.isApprox(mapToOdom * makePose(1.4, 0.0, 0.7), 1e-9));
+    // past the newest sample the odometry is extrapolated up to the horizon.
+    ASSERT_TRUE(predictor.predict(1.2, pose));
+    const Eigen::Affine3d lastMotion = makePose(1.8, 0.0, 0.9).inverse() * makePose(2.0, 0.0, 1.0);
+    const Eigen::Affine3d extrapolated(Eigen::Translation3d(2.0 * lastMotion.translation()) * Eigen::AngleAxisd(0.2, Eigen::Vector3d::UnitZ()));
+    ASSERT_TRUE(pose.isApprox(mapToOdom * makePose(2.0, 0.0, 1.0) * extrapolated, 1e-9));
+    ASSERT_FALSE(predictor.predict(1.6, pose));
+
+    // the next frame reports the drift of the odometry.
+    const Eigen::Affine3d tracked = mapToOdom * makePose(1.4, 0.05, 0.7);
+    ASSERT_TRUE(predictor.correct(0.7, tracked, error));
+    ASSERT_NEAR(error.translation, 0.05, 1e-9);
+    ASSERT_NEAR(error.rotation, 0.0, 1e-9);
+    ASSERT_EQ(predictor.stats().count, 1u);
+    ASSERT_NEAR(predictor.stats().rmsTranslation, 0.05, 1e-9);
+
+    predictor.reset();
+    ASSERT_FALSE(predictor.predict(0.7, pose));
+    ASSERT_FALSE(predictor.mapToOdom(pose));
+}
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
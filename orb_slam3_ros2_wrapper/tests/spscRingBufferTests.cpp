@@ -0,0 +1,77 @@
+#include <gtest/gtest.h>
+#include <thread>
+#include <memory>
+#include "orb_slam3_ros2_wrapper/spsc_ring_buffer.hpp"
+
+TEST(SPSCRingBufferTest, FifoOrderAndCapacity) {
+    ORB_SLAM3_Wrapper::SPSCRingBuffer<int> ring(3);
+    ASSERT_EQ(ring.capacity(), 3u);
+    ASSERT_TRUE(ring.empty());
+
+    ASSERT_TRUE(ring.push(1));
+    ASSERT_TRUE(ring.push(2));
+    ASSERT_TRUE(ring.push(3));
+    // full, the element must be rejected.
+    ASSERT_FALSE(ring.push(4));
+    ASSERT_EQ(ring.size(), 3u);
+
+    int value = 0;
+    ASSERT_TRUE(ring.pop(value));
+    ASSERT_EQ(value, 1);
+    ASSERT_TRUE(ring.push(5));
+    ASSERT_TRUE(ring.pop(value));
+    ASSERT_EQ(value, 2);
+    ASSERT_TRUE(ring.pop(value));
+    ASSERT_EQ(value, 3);
+    ASSERT_TRUE(ring.pop(value));
+    ASSERT_EQ(value, 5);
+    ASSERT_FALSE(ring.pop(value));
+}
+
+TEST(SPSCRingBufferTest, PopLatestDiscardsOlderElements) {
+    ORB_SLAM3_Wrapper::SPSCRingBuffer<std::shared_ptr<int>> ring(4);
+    for (int i = 0; i < 4; i++)
+        ASSERT_TRUE(ring.push(std::make_shared<int>(i)));
+
+    std::shared_ptr<int> latest;
+    size_t discarded = 0;
+    ASSERT_TRUE(ring.popLatest(latest, discarded));
+    ASSERT_EQ(*latest, 3);
+    ASSERT_EQ(discarded, 3u);
+    ASSERT_TRUE(ring.empty());
+    ASSERT_FALSE(ring.popLatest(latest, discarded));
+}
+
+TEST(SPSCRingBufferTest, ConcurrentProducerConsumer) {
+    const int numItems = 200000;
+    ORB_SLAM3_Wrapper::SPSCRingBuffer<int> ring(16);
+
+    std::thread producer([&ring, numItems]() {
+        for (int i = 0; i < numItems; i++)
+        {
+            while (!ring.push(i))
+                std::this_thread::yield();
+        }
+    });
+
+    int expected = 0;
+    while (expected < numItems)
+    {
+        int value;
+        if (ring.pop(value))
+        {
+            ASSERT_EQ(value, expected);
+            ++expected;
+        }
+        else
+            std::this_thread::yield();
+    }
+    producer.join();
+    ASSERT_TRUE(ring.empty());
+}
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,156 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "orb_slam3_ros2_wrapper/thread_config.hpp"
+
+using ORB_SLAM3_Wrapper::parseCpuSet;
+using ORB_SLAM3_Wrapper::formatCpuSet;
+
+TEST(ThreadConfigTest, ParseCpuSet) {
+    std::vector<int> cpus;
+    ASSERT_TRUE(parseCpuSet("0-3,6", cpus));
+    ASSERT_EQ(cpus, std::vector<int>({0, 1, 2, 3, 6}));
+    // sorted and deduplicated.
+    ASSERT_TRUE(parseCpuSet("7, 2-3,3", cpus));
+    ASSERT_EQ(cpus, std::vector<int>({2, 3, 7}));
+    ASSERT_EQ(formatCpuSet({0, 1, 2, 3, 6, 8, 9}), "0-3,6,8-9");
+
+    ASSERT_FALSE(parseCpuSet("", cpus));
+    ASSERT_FALSE(parseCpuSet("3-1", cpus));
+    ASSERT_FALSE(parseCpuSet("a", cpus));
+    ASSERT_FALSE(parseCpuSet("1,,2", cpus));
+    ASSERT_FALSE(parseCpuSet("-1", cpus));
+}
+
+TEST(ThreadConfigTest, ScopedAffinityIsInherited) {
+    std::vector<int> original;
+    ASSERT_TRUE(ORB_SLAM3_Wrapper::getCurrentThreadAffinity(original));
+    ASSERT_FALSE(original.empty());
+    const std::vector<int> pinned = {original.front()};
+    {
+        ORB_SLAM3_Wrapper::ScopedThreadAffinity affinity(pinned);
+        ASSERT_TRUE(affinity.applied());
+        // a thread created in the scope inherits the set.
+        std::vector<int> child;
+        std::thread thread([&child]()
+                           { ORB_SLAM3_Wrapper::getCurrentThreadAffinity(child); });
+        thread.join();
+        ASSERT_EQ(child, pinned);
+    }
+    std::vector<int> restored;
+    ASSERT_TRUE(ORB_SLAM3_Wrapper::getCurrentThreadAffinity(restored));
+    ASSERT_EQ(restored, original);
+
+    ORB_SLAM3_Wrapper::ScopedThreadAffinity unchanged{std::vector<int>()};
+    ASSERT_FALSE(unchanged.applied());
+}
+
+TEST(ThreadConfigTest, CreatedThreadsAreTracked) {
+    const std::string name = ORB_SLAM3_Wrapper::getThreadName(ORB_SLAM3_Wrapper::currentThreadId());
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool done = false;
+    auto wait = [&]()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        condition.wait(lock, [&done]() { return done; });
+    };
+    // started before the scope, it starts its own thread inside it.
+    std::thread outsider;
+    std::thread other([&]()
+                      { outsider = std::thread(wait); wait(); });
+    std::vector<int> created;
+    std::thread inside;
+    {
+        ORB_SLAM3_Wrapper::ScopedThreadCreationTracker tracker;
+        inside = std::thread(wait);
+        // the outsider may still be starting, give it the time to show up.
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        created = tracker.created();
+    }
+    ASSERT_EQ(ORB_SLAM3_Wrapper::getThreadName(ORB_SLAM3_Wrapper::currentThreadId()), name);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        done = true;
+    }
+    condition.notify_all();
+    const int insideId = created.size() == 1 ? created.front() : 0;
+    inside.join();
+    other.join();
+    outsider.join();
+    ASSERT_EQ(created.size(), 1u);
+    ASSERT_GT(insideId, 0);
+}
+
+TEST(ThreadConfigTest, OtherThreadsById) {
+    std::vector<int> original;
+    ASSERT_TRUE(ORB_SLAM3_Wrapper::getCurrentThreadAffinity(original));
+    const int mainId = ORB_SLAM3_Wrapper::currentThreadId();
+    const auto before = ORB_SLAM3_Wrapper::processThreadIds();
+    ASSERT_NE(std::find(before.begin(), before.end(), mainId), before.end());
+
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool done = false;
+    int workerId = 0;
+    std::thread worker([&]()
+                       {
+        std::unique_lock<std::mutex> lock(mutex);
+        workerId = ORB_SLAM3_Wrapper::currentThreadId();
+        condition.notify_all();
+        condition.wait(lock, [&done]() { return done; }); });
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        condition.wait(lock, [&workerId]()
+                       { return workerId != 0; });
+    }
+    const auto during = ORB_SLAM3_Wrapper::processThreadIds();
+    ASSERT_EQ(during.size(), before.size() + 1);
+    ASSERT_NE(std::find(during.begin(), during.end(), workerId), during.end());
+
+    // the worker is pinned from here, the calling thread keeps its set.
+    const std::vector<int> pinned = {original.back()};
+    ASSERT_TRUE(ORB_SLAM3_Wrapper::setThreadAffinity(workerId, pinned));
+    std::vector<int> cpus;
+    ASSERT_TRUE(ORB_SLAM3_Wrapper::getThreadAffinity(workerId, cpus));
+    ASSERT_EQ(cpus, pinned);
+    ASSERT_TRUE(ORB_SLAM3_Wrapper::getThreadAffinity(mainId, cpus));
+    ASSERT_EQ(cpus, original);
+    ASSERT_EQ(ORB_SLAM3_Wrapper::describeThread(workerId), "cpus " + formatCpuSet(pinned));
+    ASSERT_TRUE(ORB_SLAM3_Wrapper::setThreadName(workerId, "wrapper_test_worker"));
+    std::ifstream comm("/proc/self/task/" + std::to_string(workerId) + "/comm");
+    std::string name;
+    std::getline(comm, name);
+    ASSERT_EQ(name, "wrapper_test_wo");
+
+    int priority;
+    bool realtime;
+    ASSERT_TRUE(ORB_SLAM3_Wrapper::getThreadPriority(workerId, priority, realtime));
+    ASSERT_FALSE(realtime);
+    // SCHED_FIFO only with the privileges, going back to SCHED_OTHER always works.
+    if (ORB_SLAM3_Wrapper::setThreadPriority(workerId, 10))
+    {
+        ASSERT_TRUE(ORB_SLAM3_Wrapper::getThreadPriority(workerId, priority, realtime));
+        ASSERT_TRUE(realtime);
+        ASSERT_EQ(priority, 10);
+    }
+    ASSERT_TRUE(ORB_SLAM3_Wrapper::setThreadPriority(workerId, 0));
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        done = true;
+    }
+    condition.notify_all();
+    worker.join();
+}
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -4,6 +4,101 @@
 #include <sophus/se3.hpp>
 #include "orb_slam3_ros2_wrapper/type_conversion.hpp"
 #include <cstddef>
+#include <cstring>
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+namespace
+{
+    // the cloud layout and the per-point memcpy of the original MapPointsToPCL.
+    sensor_msgs::msg::PointCloud2 legacyCloud(const std::vector<Eigen::Vector3f> &points, bool orbToRos)
+    {
+        const int numChannels = 3;
+        sensor_msgs::msg::PointCloud2 cloud;
+        cloud.header.frame_id = "map";
+        cloud.height = 1;
+        cloud.width = points.size();
+        cloud.is_bigendian = false;
+        cloud.is_dense = true;
+        cloud.point_step = numChannels * sizeof(float);
+        cloud.row_step = cloud.point_step * cloud.width;
+        cloud.fields.resize(numChannels);
+        std::string channel_id[] = {"x", "y", "z"};
+        for (int i = 0; i < numChannels; i++)
+        {
+            cloud.fields[i].name = channel_id[i];
+            cloud.fields[i].offset = i * sizeof(float);
+            cloud.fields[i].count = 1;
+            cloud.fields[i].datatype = sensor_msgs::msg::PointField::FLOAT32;
+        }
+        cloud.data.resize(cloud.row_step * cloud.height);
+        Eigen::Matrix3f tfORBToROS;
+        tfORBToROS << 0, 0, 1,
+            -1, 0, 0,
+            0, -1, 0;
+        for (unsigned int i = 0; i < cloud.width; i++)
+        {
+            Eigen::Vector3f p = orbToRos ? Eigen::Vector3f(tfORBToROS * points[i]) : points[i];
+            float data_array[numChannels] = {p.x(), p.y(), p.z()};
+            memcpy(&cloud.data[0] + (i * cloud.point_step), data_array, numChannels * sizeof(float));
+        }
+        return cloud;
+    }
+
+    // the matrix products of the original se3ORBToROS, on Tcw.
+    Eigen::Affine3f legacyORBToROS(const Eigen::Matrix3f &Rcw, const Eigen::Vector3f &tcw)
+    {
+        Eigen::Matrix3f tfORBToROS;
+        tfORBToROS << 0, 0, 1,
+            -1, 0, 0,
+            0, -1, 0;
+        Eigen::Matrix3f rotationTemp = tfORBToROS * Rcw;
+        Eigen::Vector3f translationTemp = tfORBToROS * tcw;
+        Eigen::Matrix3f rotationInv = rotationTemp.transpose();
+        Eigen::Vector3f translationInv = -(rotationInv * translationTemp);
+        Eigen::Affine3f affineMatrix = Eigen::Affine3f::Identity();
+        affineMatrix.rotate(Eigen::Matrix3f(tfORBToROS * rotationInv));
+        affineMatrix.translation() = tfORBToROS * translationInv;
+        return affineMatrix;
+    }
+
+    Eigen::Matrix3f randomRotation(std::mt19937 &gen)
+    {
+        std::uniform_real_distribution<float> dis(-1.0f, 1.0f);
+        Eigen::Matrix3f rotation;
+        rotation = Eigen::AngleAxisf(dis(gen) * M_PI, Eigen::Vector3f::UnitX())
+                 * Eigen::AngleAxisf(dis(gen) * M_PI, Eigen::Vector3f::UnitY())
+                 * Eigen::AngleAxisf(dis(gen) * M_PI, Eigen::Vector3f::UnitZ());
+        return rotation;
+    }
+
+    std::vector<Eigen::Vector3f> randomPoints(size_t numPoints)
+    {
+        std::mt19937 gen(3);
+        std::uniform_real_distribution<float> dis(-50.0f, 50.0f);
+        std::vector<Eigen::Vector3f> points;
+        for (size_t i = 0; i < numPoints; i++)
+            points.emplace_back(dis(gen), dis(gen), dis(gen));
+        return points;
+    }
+
+    void expectSameLayout(const sensor_msgs::msg::PointCloud2 &a, const sensor_msgs::msg::PointCloud2 &b)
+    {
+        ASSERT_EQ(a.width, b.width);
+        ASSERT_EQ(a.height, b.height);
+        ASSERT_EQ(a.point_step, b.point_step);
+        ASSERT_EQ(a.row_step, b.row_step);
+        ASSERT_EQ(a.fields.size(), b.fields.size());
+        for (size_t i = 0; i < a.fields.size(); i++)
+        {
+            ASSERT_EQ(a.fields[i].name, b.fields[i].name);
+            ASSERT_EQ(a.fields[i].offset, b.fields[i].offset);
+            ASSERT_EQ(a.fields[i].datatype, b.fields[i].datatype);
+            ASSERT_EQ(a.fields[i].count, b.fields[i].count);
+        }
+    }
+}
 
 TEST(TypeConversionsTest, SE3ConversionRoundTrip) {
     ORB_SLAM3_Wrapper::WrapperTypeConversions typeConversion_;
@@ -33,6 +128,214 @@ TEST(TypeConversionsTest, SE3ConversionRoundTrip) {
         << "Original:\n" << randomAffine.matrix() << "\nConverted:\n" << convertedAffine.matrix();
 }
 
+TEST(TypeConversionsTest, SerializerMatchesLegacyCloudBytes) {
+    const auto points = randomPoints(1001);
+    for (bool orbToRos : {false, true})
+    {
+        sensor_msgs::msg::PointCloud2 cloud;
+        ORB_SLAM3_Wrapper::initMapPointCloud(cloud, points.size());
+        if (orbToRos)
+            ORB_SLAM3_Wrapper::writeCloudXYZ<ORB_SLAM3_Wrapper::ORBToROSPermutation>(cloud, points.data(), points.size());
+        else
+            ORB_SLAM3_Wrapper::writeCloudXYZ(cloud, points.data(), points.size());
+        const auto reference = legacyCloud(points, orbToRos);
+        expectSameLayout(cloud, reference);
+        ASSERT_EQ(cloud.data, reference.data);
+    }
+
+    ORB_SLAM3_Wrapper::WrapperTypeConversions typeConversion_;
+    auto mutablePoints = points;
+    const auto cloud = typeConversion_.MapPointsToPCL(mutablePoints);
+    const auto reference = legacyCloud(points, false);
+    expectSameLayout(cloud, reference);
+    ASSERT_EQ(cloud.data, reference.data);
+}
+
+TEST(TypeConversionsTest, SerializerExtraChannels) {
+    using namespace ORB_SLAM3_Wrapper;
+    const auto points = randomPoints(17);
+    const uint32_t channels = CHANNEL_OBSERVATIONS | CHANNEL_FOUND_RATIO | CHANNEL_DESCRIPTOR_HASH;
+    std::vector<MapPointChannelValues> values(points.size());
+    for (size_t i = 0; i < values.size(); i++)
+    {
+        values[i].observations = i;
+        values[i].foundRatio = 0.5f * i;
+        values[i].descriptorHash = 1000 + i;
+    }
+    sensor_msgs::msg::PointCloud2 cloud;
+    initMapPointCloud(cloud, points.size(), channels);
+    writeCloudXYZ<ORBToROSPermutation>(cloud, points.data(), points.size());
+    writeCloudChannels(cloud, values.data(), values.size(), channels);
+
+    ASSERT_EQ(cloud.point_step, 24u);
+    ASSERT_EQ(cloud.fields.size(), 6u);
+    ASSERT_EQ(cloud.fields[3].name, "observations");
+    ASSERT_EQ(cloud.fields[4].name, "found_ratio");
+    ASSERT_EQ(cloud.fields[5].name, "descriptor_hash");
+    for (size_t i = 0; i < points.size(); i++)
+    {
+        const uint8_t *point = cloud.data.data() + i * cloud.point_step;
+        float xyz[3], ratio;
+        uint32_t observations, hash;
+        memcpy(xyz, point, sizeof(xyz));
+        memcpy(&observations, point + cloud.fields[3].offset, sizeof(observations));
+        memcpy(&ratio, point + cloud.fields[4].offset, sizeof(ratio));
+        memcpy(&hash, point + cloud.fields[5].offset, sizeof(hash));
+        ASSERT_EQ(xyz[0], points[i].z());
+        ASSERT_EQ(xyz[1], -points[i].x());
+        ASSERT_EQ(xyz[2], -points[i].y());
+        ASSERT_EQ(observations, values[i].observations);
+        ASSERT_EQ(ratio, values[i].foundRatio);
+        ASSERT_EQ(hash, values[i].descriptorHash);
+    }
+
+    // reference value of FNV-1a for "a".
+    const uint8_t a = 'a';
+    ASSERT_EQ(descriptorHash(&a, 1), 0xe40c292cu);
+}
+
+TEST(TypeConversionsTest, PermutationMatchesMatrixProducts) {
+    using namespace ORB_SLAM3_Wrapper;
+    std::mt19937 gen(5);
+    Eigen::Matrix3f tfORBToROS;
+    tfORBToROS << 0, 0, 1,
+        -1, 0, 0,
+        0, -1, 0;
+    const Eigen::Matrix3f tfROSToORB = tfORBToROS.transpose();
+    for (const auto &point : randomPoints(100))
+    {
+        ASSERT_TRUE(ORBToROSPermutation::apply(point).isApprox(tfORBToROS * point));
+        ASSERT_TRUE(ROSToORBPermutation::apply(point).isApprox(tfROSToORB * point));
+        ASSERT_TRUE(ROSToORBPermutation::apply(ORBToROSPermutation::apply(point)) == point);
+    }
+    for (int i = 0; i < 100; i++)
+    {
+        const Eigen::Matrix3f R = randomRotation(gen);
+        ASSERT_TRUE(ORBToROSPermutation::conjugate(R).isApprox(tfORBToROS * R * tfORBToROS.transpose()));
+    }
+
+    const auto points = randomPoints(33);
+    std::vector<float> packed(3 * points.size());
+    memcpy(packed.data(), points.data()->data(), packed.size() * sizeof(float));
+    ORBToROSPermutation::applyBatch(packed.data(), packed.data(), points.size());
+    for (size_t i = 0; i < points.size(); i++)
+        ASSERT_TRUE(Eigen::Map<const Eigen::Vector3f>(packed.data() + 3 * i) == ORBToROSPermutation::apply(points[i]));
+}
+
+TEST(TypeConversionsTest, PoseConversionsMatchLegacy) {
+    using namespace ORB_SLAM3_Wrapper;
+    std::mt19937 gen(9);
+    std::uniform_real_distribution<float> dis(-100.0f, 100.0f);
+    for (int i = 0; i < 200; i++)
+    {
+        const Eigen::Matrix3f Rcw = randomRotation(gen);
+        const Eigen::Vector3f tcw(dis(gen), dis(gen), dis(gen));
+        const Eigen::Affine3f reference = legacyORBToROS(Rcw, tcw);
+        const Eigen::Affine3f Twc = orbTcwToROSTwc<float>(Rcw, tcw);
+        ASSERT_TRUE(Twc.isApprox(reference, 1e-5)) << "Legacy:\n" << reference.matrix() << "\nNew:\n" << Twc.matrix();
+        // double variant computed from the float inputs.
+        const Eigen::Affine3d TwcD = orbTcwToROSTwc<double>(Rcw, tcw);
+        ASSERT_TRUE(TwcD.cast<float>().isApprox(reference, 1e-5));
+
+        // the round trip is exact up to the orthonormality of the float Rcw.
+        Eigen::Matrix3d RcwBack;
+        Eigen::Vector3d tcwBack;
+        rosTwcToORBTcw(TwcD, RcwBack, tcwBack);
+        ASSERT_TRUE(RcwBack.isApprox(Rcw.cast<double>(), 1e-5));
+        ASSERT_TRUE(tcwBack.isApprox(tcw.cast<double>(), 1e-5));
+    }
+
+    ORB_SLAM3_Wrapper::WrapperTypeConversions typeConversion_;
+    std::vector<Sophus::SE3f> poses;
+    for (int i = 0; i < 20; i++)
+        poses.emplace_back(Eigen::Quaternionf(randomRotation(gen)), Eigen::Vector3f(dis(gen), dis(gen), dis(gen)));
+    std::vector<Eigen::Affine3d> affines;
+    typeConversion_.se3ToAffine(poses, affines);
+    ASSERT_EQ(affines.size(), poses.size());
+    for (size_t i = 0; i < poses.size(); i++)
+    {
+        const Eigen::Affine3f reference = legacyORBToROS(poses[i].rotationMatrix(), poses[i].translation());
+        ASSERT_TRUE(typeConversion_.se3ORBToROS(poses[i]).isApprox(reference, 1e-5));
+        ASSERT_TRUE(affines[i].isApprox(typeConversion_.se3ToAffine(poses[i])));
+        ASSERT_TRUE(affines[i].cast<float>().isApprox(reference, 1e-5));
+    }
+    const auto points = randomPoints(50);
+    std::vector<Eigen::Vector3f> rosPoints;
+    typeConversion_.vector3fORBToROS(points, rosPoints);
+    for (size_t i = 0; i < points.size(); i++)
+        ASSERT_TRUE(rosPoints[i] == typeConversion_.vector3fORBToROS(points[i]));
+}
+
+TEST(TypeConversionsTest, BenchmarkPoseConversions) {
+    using namespace ORB_SLAM3_Wrapper;
+    std::mt19937 gen(21);
+    std::uniform_real_distribution<float> dis(-100.0f, 100.0f);
+    const size_t numPoses = 20000;
+    std::vector<Eigen::Matrix3f> rotations;
+    std::vector<Eigen::Vector3f> translations;
+    for (size_t i = 0; i < numPoses; i++)
+    {
+        rotations.push_back(randomRotation(gen));
+        translations.emplace_back(dis(gen), dis(gen), dis(gen));
+    }
+    // keeps the conversions from being optimized away.
+    double checksum[2] = {0.0, 0.0};
+    auto t0 = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < numPoses; i++)
+        checksum[0] += legacyORBToROS(rotations[i], translations[i]).cast<double>().translation().sum();
+    auto t1 = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < numPoses; i++)
+        checksum[1] += orbTcwToROSTwc<double>(rotations[i], translations[i]).translation().sum();
+    auto t2 = std::chrono::steady_clock::now();
+
+    ASSERT_NEAR(checksum[0], checksum[1], 1e-3 * numPoses);
+    const double legacyNs = std::chrono::duration<double, std::nano>(t1 - t0).count() / numPoses;
+    const double permutationNs = std::chrono::duration<double, std::nano>(t2 - t1).count() / numPoses;
+    std::cout << "Tcw ORB -> Twc ROS (double). Matrix products: " << legacyNs
+              << " ns / pose, compile-time permutation: " << permutationNs << " ns / pose" << std::endl;
+}
+
+TEST(TypeConversionsTest, PackedMapDataRoundTrip) {
+    ORB_SLAM3_Wrapper::WrapperTypeConversions typeConversion_;
+    slam_msgs::msg::MapData mapData;
+    mapData.header.frame_id = "map";
+    const auto points = randomPoints(301);
+    size_t next = 0;
+    for (int32_t id : {4, 9, 12})
+    {
+        slam_msgs::msg::KeyFrame node;
+        node.id = id;
+        // the middle keyframe has no points.
+        const size_t count = id == 9 ? 0 : 150 + (id == 12);
+        for (size_t i = 0; i < count; i++, next++)
+        {
+            geometry_msgs::msg::Point point;
+            point.x = points[next].x();
+            point.y = points[next].y();
+            point.z = points[next].z();
+            node.word_pts.push_back(point);
+        }
+        mapData.nodes.push_back(node);
+        mapData.graph.poses_id.push_back(id);
+        mapData.graph.poses.emplace_back();
+    }
+
+    ORB_SLAM3_Wrapper::PointPacking packing;
+    packing.compression = slam_msgs::msg::PackedPoints::COMPRESSION_ZSTD;
+    slam_msgs::msg::PackedMapData packed;
+    ASSERT_TRUE(typeConversion_.mapDataToPacked(mapData, packing, packed));
+    ASSERT_EQ(packed.points.count, 301u);
+    ASSERT_EQ(packed.graph.poses_id, mapData.graph.poses_id);
+    slam_msgs::msg::MapData unpacked;
+    std::string message;
+    ASSERT_TRUE(typeConversion_.packedToMapData(packed, unpacked, message)) << message;
+    // the points are float32 on both sides, the round trip is exact.
+    ASSERT_EQ(unpacked, mapData);
+
+    packed.point_counts[0]++;
+    ASSERT_FALSE(typeConversion_.packedToMapData(packed, unpacked, message));
+}
+
 int main(int argc, char **argv)
 {
     testing::InitGoogleTest(&argc, argv);
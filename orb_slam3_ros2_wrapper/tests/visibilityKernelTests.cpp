@@ -0,0 +1,110 @@
+#include <gtest/gtest.h>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <Eigen/Dense>
+#include "orb_slam3_ros2_wrapper/visibility_kernel.hpp"
+
+namespace
+{
+    ORB_SLAM3_Wrapper::MapPointSoA randomMapPoints(size_t numPoints, unsigned int seed)
+    {
+        std::mt19937 gen(seed);
+        std::uniform_real_distribution<float> pos(-6.0f, 6.0f);
+        std::uniform_real_distribution<float> dir(-1.0f, 1.0f);
+        std::uniform_real_distribution<float> minDist(0.0f, 1.0f);
+        std::uniform_real_distribution<float> maxDist(3.0f, 10.0f);
+        ORB_SLAM3_Wrapper::MapPointSoA points;
+        points.reserve(numPoints);
+        for (size_t i = 0; i < numPoints; i++)
+        {
+            Eigen::Vector3f position(pos(gen), pos(gen), pos(gen));
+            Eigen::Vector3f normal = Eigen::Vector3f(dir(gen), dir(gen), dir(gen)).normalized();
+            points.push_back(position, normal, minDist(gen), maxDist(gen));
+        }
+        return points;
+    }
+
+    ORB_SLAM3_Wrapper::VisibilityQuery makeQuery()
+    {
+        ORB_SLAM3_Wrapper::VisibilityQuery query;
+        Eigen::Matrix3f Rwc;
+        Rwc = Eigen::AngleAxisf(0.3f, Eigen::Vector3f::UnitY()) * Eigen::AngleAxisf(-0.2f, Eigen::Vector3f::UnitX());
+        query.Ow = Eigen::Vector3f(0.5f, -0.2f, -3.0f);
+        query.Rcw = Rwc.transpose();
+        query.tcw = -query.Rcw * query.Ow;
+        // map points with their mean viewing direction towards the camera pass the viewing angle check.
+        query.viewingCosLimit = -0.5f;
+        return query;
+    }
+
+    const ORB_SLAM3_Wrapper::PinholeFrustum kFrustum = {528.43f, 528.43f, 320.5f, 240.5f, 0.0f, 640.0f, 0.0f, 480.0f};
+}
+
+TEST(VisibilityKernelTest, MatchesPerPointReference) {
+    auto points = randomMapPoints(5000, 3);
+    auto query = makeQuery();
+
+    std::vector<uint8_t> visible;
+    ORB_SLAM3_Wrapper::computeVisibility(points, kFrustum, query, visible);
+    ASSERT_EQ(visible.size(), points.size());
+
+    size_t numVisible = 0;
+    for (size_t i = 0; i < points.size(); i++)
+    {
+        // per point version, written like the original loop over ORB_SLAM3::MapPoint.
+        Eigen::Vector3f P(points.x[i], points.y[i], points.z[i]);
+        Eigen::Vector3f Pc = query.Rcw * P + query.tcw;
+        bool expected = true;
+        if (Pc(2) < 0.0f)
+            expected = false;
+        else
+        {
+            float u = kFrustum.fx * Pc(0) / Pc(2) + kFrustum.cx;
+            float v = kFrustum.fy * Pc(1) / Pc(2) + kFrustum.cy;
+            Eigen::Vector3f PO = P - query.Ow;
+            float dist = PO.norm();
+            Eigen::Vector3f Pn(points.nx[i], points.ny[i], points.nz[i]);
+            if (u < kFrustum.minX || u > kFrustum.maxX || v < kFrustum.minY || v > kFrustum.maxY)
+                expected = false;
+            else if (dist < points.minDistance[i] || dist > points.maxDistance[i])
+                expected = false;
+            else if (PO.dot(Pn) / dist < query.viewingCosLimit)
+                expected = false;
+        }
+        ASSERT_EQ(visible[i] != 0, expected) << "Point " << i << ": " << P.transpose();
+        numVisible += expected;
+    }
+    ASSERT_GT(numVisible, 0u);
+}
+
+TEST(VisibilityKernelTest, VectorizedMatchesScalar) {
+    // odd size, so the last block is partial.
+    auto points = randomMapPoints(100003, 5);
+    auto query = makeQuery();
+
+    std::vector<uint8_t> vectorized, scalar;
+    auto t0 = std::chrono::steady_clock::now();
+    ORB_SLAM3_Wrapper::computeVisibility(points, kFrustum, query, vectorized);
+    auto t1 = std::chrono::steady_clock::now();
+    ORB_SLAM3_Wrapper::computeVisibilityScalar(points, kFrustum, query, scalar);
+    auto t2 = std::chrono::steady_clock::now();
+
+    ASSERT_EQ(vectorized, scalar);
+    std::cout << "Visibility of " << points.size() << " points. Batched: "
+              << std::chrono::duration<double, std::milli>(t1 - t0).count() << " ms, scalar: "
+              << std::chrono::duration<double, std::milli>(t2 - t1).count() << " ms" << std::endl;
+}
+
+TEST(VisibilityKernelTest, EmptySnapshot) {
+    ORB_SLAM3_Wrapper::MapPointSoA points;
+    std::vector<uint8_t> visible(3, 1);
+    ORB_SLAM3_Wrapper::computeVisibility(points, kFrustum, makeQuery(), visible);
+    ASSERT_TRUE(visible.empty());
+}
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
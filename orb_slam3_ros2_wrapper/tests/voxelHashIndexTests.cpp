@@ -0,0 +1,118 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+#include <Eigen/Dense>
+#include "orb_slam3_ros2_wrapper/voxel_hash_index.hpp"
+
+namespace
+{
+    std::vector<Eigen::Vector3f> randomPositions(size_t numPositions, float extent, unsigned int seed)
+    {
+        std::mt19937 gen(seed);
+        std::uniform_real_distribution<float> dis(-extent, extent);
+        std::vector<Eigen::Vector3f> positions;
+        positions.reserve(numPositions);
+        for (size_t i = 0; i < numPositions; i++)
+            positions.emplace_back(dis(gen), dis(gen), 0.1f * dis(gen));
+        return positions;
+    }
+}
+
+TEST(VoxelHashIndexTest, InsertMoveErase) {
+    ORB_SLAM3_Wrapper::VoxelHashIndex<int> index(1.0f);
+    index.insert(1, Eigen::Vector3f(0.5f, 0.5f, 0.5f));
+    index.insert(2, Eigen::Vector3f(10.5f, 0.5f, 0.5f));
+    ASSERT_EQ(index.size(), 2u);
+    ASSERT_EQ(index.numVoxels(), 2u);
+
+    std::vector<int> items;
+    index.queryRadius(Eigen::Vector3f::Zero(), 2.0f, items);
+    ASSERT_EQ(items, std::vector<int>({1}));
+
+    // moving an item to another voxel must drop it from the old one.
+    index.insert(1, Eigen::Vector3f(10.6f, 0.5f, 0.5f));
+    ASSERT_EQ(index.size(), 2u);
+    ASSERT_EQ(index.numVoxels(), 1u);
+    items.clear();
+    index.queryRadius(Eigen::Vector3f::Zero(), 2.0f, items);
+    ASSERT_TRUE(items.empty());
+
+    ASSERT_TRUE(index.erase(1));
+    ASSERT_FALSE(index.erase(1));
+    ASSERT_FALSE(index.contains(1));
+    ASSERT_TRUE(index.contains(2));
+    ASSERT_EQ(index.size(), 1u);
+}
+
+TEST(VoxelHashIndexTest, ConeQueryMatchesLinearScan) {
+    const auto positions = randomPositions(20000, 50.0f, 7);
+    ORB_SLAM3_Wrapper::VoxelHashIndex<size_t> index(1.0f);
+    for (size_t i = 0; i < positions.size(); i++)
+        index.insert(i, positions[i]);
+
+    const Eigen::Vector3f apex(3.0f, -4.0f, 0.0f);
+    const Eigen::Vector3f direction = Eigen::Vector3f(1.0f, 1.0f, 0.0f).normalized();
+    const float radius = 5.0f;
+    const float cosHalfAngle = std::cos(0.6f);
+
+    std::vector<size_t> fromIndex;
+    index.queryCone(apex, direction, radius, cosHalfAngle, fromIndex);
+
+    std::vector<size_t> fromScan;
+    for (size_t i = 0; i < positions.size(); i++)
+    {
+        const Eigen::Vector3f offset = positions[i] - apex;
+        const float dist = offset.norm();
+        if (dist <= radius && offset.dot(direction) >= cosHalfAngle * dist)
+            fromScan.push_back(i);
+    }
+
+    std::sort(fromIndex.begin(), fromIndex.end());
+    ASSERT_FALSE(fromScan.empty());
+    ASSERT_EQ(fromIndex, fromScan);
+}
+
+TEST(VoxelHashIndexTest, BenchmarkAgainstLinearScan) {
+    const auto positions = randomPositions(100000, 500.0f, 11);
+    ORB_SLAM3_Wrapper::VoxelHashIndex<size_t> index(2.5f);
+    for (size_t i = 0; i < positions.size(); i++)
+        index.insert(i, positions[i]);
+    const auto queries = randomPositions(200, 450.0f, 13);
+    const float radius = 5.0f;
+
+    size_t scanHits = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    for (const auto &query : queries)
+    {
+        for (const auto &position : positions)
+        {
+            if ((position - query).squaredNorm() <= radius * radius)
+                ++scanHits;
+        }
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    size_t indexHits = 0;
+    std::vector<size_t> items;
+    for (const auto &query : queries)
+    {
+        items.clear();
+        index.queryRadius(query, radius, items);
+        indexHits += items.size();
+    }
+    auto t2 = std::chrono::steady_clock::now();
+
+    ASSERT_EQ(scanHits, indexHits);
+    const double scanMs = std::chrono::duration<double, std::milli>(t1 - t0).count() / queries.size();
+    const double indexMs = std::chrono::duration<double, std::milli>(t2 - t1).count() / queries.size();
+    std::cout << "Radius query over " << positions.size() << " positions. Linear scan: " << scanMs
+              << " ms / query, voxel hash: " << indexMs << " ms / query" << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,61 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "orb_slam3_ros2_wrapper/worker_pool.hpp"
+
+using namespace ORB_SLAM3_Wrapper;
+
+TEST(WorkerPoolTest, EveryTaskRunsOnce) {
+    WorkerPool pool(3);
+    ASSERT_EQ(pool.concurrency(), 4u);
+    std::vector<std::atomic<int>> runs(1000);
+    for (int pass = 0; pass < 20; pass++)
+    {
+        pool.parallelFor(runs.size(), [&runs](size_t i)
+                         { ++runs[i]; });
+        for (const auto &count : runs)
+            ASSERT_EQ(count.load(), pass + 1);
+    }
+    // without workers the caller runs everything.
+    WorkerPool inlinePool(0);
+    const auto caller = std::this_thread::get_id();
+    bool onCaller = true;
+    inlinePool.parallelFor(10, [&](size_t)
+                           { onCaller = onCaller && std::this_thread::get_id() == caller; });
+    ASSERT_TRUE(onCaller);
+    pool.parallelFor(0, [](size_t)
+                     { FAIL(); });
+}
+
+TEST(WorkerPoolTest, ConcurrentCallersShareThePool) {
+    auto pool = WorkerPool::shared(3);
+    // later calls share the existing pool, whatever size they ask for.
+    ASSERT_EQ(WorkerPool::shared(8).get(), pool.get());
+    ASSERT_EQ(pool->concurrency(), 3u);
+    std::atomic<size_t> total{0};
+    std::vector<std::thread> callers;
+    for (int c = 0; c < 4; c++)
+    {
+        callers.emplace_back([&pool, &total]()
+                             {
+            for (int pass = 0; pass < 50; pass++)
+            {
+                std::atomic<size_t> done{0};
+                pool->parallelFor(64, [&done](size_t)
+                                  { ++done; });
+                // every task of this call is done when it returns.
+                ASSERT_EQ(done.load(), 64u);
+                total += done;
+            } });
+    }
+    for (auto &caller : callers)
+        caller.join();
+    ASSERT_EQ(total.load(), 4u * 50u * 64u);
+}
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}